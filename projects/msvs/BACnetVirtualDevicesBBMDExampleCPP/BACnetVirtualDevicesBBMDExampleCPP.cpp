@@ -17,24 +17,73 @@
 
 #include "CIBuildSettings.h"
 
-#include "SimpleUDP.h"
+#include "MultiHomedUDP.h"
 #include "ExampleDatabase.h"
 #include "ExampleConstants.h"
+#include "StartupProfiler.h"
+#include "IngressScheduler.h"
+#include "TopologyQueue.h"
+#include "ControlPlane.h"
+#include "StallWatchdog.h"
+#include "ShardRouter.h"
+#include "RealtimeProfile.h"
+#include "PacketPool.h"
+#include "ServiceTimeTracer.h"
+#include "WhoHasFilter.h"
+#include "ResponseCache.h"
+#include "WriteBackend.h"
+#include "Metrics.h"
+#include "LatencyHistogram.h"
 #include "ChipkinConvert.h"
 #include "ChipkinEndianness.h"
+#ifdef BACNET_EXAMPLE_BENCHMARKS
+#include "Benchmarks/Benchmarks.h"
+#endif // BACNET_EXAMPLE_BENCHMARKS
 
 #include <iostream>
+#include <fstream>
+#include <set>
+#include <sstream>
+#include <thread>
 
 // Globals
 // =======================================
-CSimpleUDP g_udp; // UDP resource
+CMultiHomedUDP g_udp; // UDP resources, one per network interface
+CSimpleUDP g_udp6; // BACnet/IPv6 resource, only connected with --ipv6
 ExampleDatabase g_database; // The example database that stores current values.
 uint8_t g_bbmdAddress[6];	// Holds the bbmd to connect to
+bool g_quietStartup = false;	// Skip the per device logging while registering
+CWriteBackend g_writeBackend; // Batched write-through of written values
+CMetrics g_metrics; // Runtime counters, see --metrics-port
+CMetricsServer g_metricsServer; // Serves g_metrics to Prometheus
+CLatencyHistograms g_latency; // Latency of the callbacks and the main loop
+CServiceTimeTracer g_serviceTimes; // Confirmed request to answer times by service and virtual network
+CWhoHasFilter g_whoHasFilter; // Drops the Who-Has for names no device has, see --who-has-filter
+CResponseCache g_responseCache; // Encoded answers of the hot ReadProperty requests, see --response-cache
+CSimulatedValueCacheBackend g_valueCacheBackend(50, 500); // Slow downstream devices behind the value cache, see --cache-ttl
+CPacketPool g_packetPool; // Buffers of the received messages queued by g_ingress, see --packet-pool
+CIngressScheduler g_ingress; // Priority queues between the sockets and the stack, see --ingress-queue
+CTopologyQueue g_topology; // Networks, devices and objects added or removed while running
+std::set<uint16_t> g_registeredNetworks; // Virtual networks added to the stack, it can not remove them
+CControlPlane g_control; // Commands from the keyboard and the --control socket
+CStallWatchdog g_watchdog; // Snapshot of the BACnet thread when the main loop stops, see --watchdog
+int g_traceLevel = 2; // Logging of each message sent and received, see TRACE_LEVEL_*
+std::string g_bdtPath; // Broadcast Distribution Table file, see --bdt
+std::vector<std::vector<uint8_t> > g_bdtEntries; // The loaded BDT, address, port and mask of each entry
+CShardFrontEnd g_shards; // Worker processes that host the virtual networks, see --shards
+CShardWorker g_shardWorker; // Connection of a worker to the front end
 
 // Constants
 // =======================================
 const std::string APPLICATION_VERSION = "1.0.0";  // See CHANGELOG.md for a full list of changes.
 const uint32_t MAX_XML_RENDER_BUFFER_LENGTH = 1024 * 20;
+const uint16_t BACNET_IPV6_UDP_PORT = 47808;
+const uint8_t BACNET_IPV6_MULTICAST_LINK_LOCAL[16] = { 0xFF, 0x02, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0xBA, 0xC0 }; // FF02::BAC0, Annex U
+const uint16_t MAX_IPV6_DATAGRAM_LENGTH = 1500;
+const uint32_t TOPOLOGY_DELTA_DEVICES = 1000; // Devices of the floor added with the 'a' key
+const int TRACE_LEVEL_NONE = 0;
+const int TRACE_LEVEL_MESSAGES = 1; // One line per message
+const int TRACE_LEVEL_XML = 2; // And the message decoded as XML
 
 // Callback Functions to Register to the DLL
 // Message Functions
@@ -50,11 +99,55 @@ bool CallbackGetPropertyEnum(const uint32_t deviceInstance, const uint16_t objec
 bool CallbackGetPropertyOctetString(const uint32_t deviceInstance, const uint16_t objectType, const uint32_t objectInstance, const uint32_t propertyIdentifier, uint8_t* value, uint32_t* valueElementCount, const uint32_t maxElementCount, const bool useArrayIndex, const uint32_t propertyArrayIndex);
 bool CallbackGetPropertyReal(const uint32_t deviceInstance, const uint16_t objectType, const uint32_t objectInstance, const uint32_t propertyIdentifier, float* value, const bool useArrayIndex, const uint32_t propertyArrayIndex);
 bool CallbackGetPropertyUInt(const uint32_t deviceInstance, const uint16_t objectType, const uint32_t objectInstance, const uint32_t propertyIdentifier, uint32_t* value, const bool useArrayIndex, const uint32_t propertyArrayIndex);
+bool CallbackGetPropertyBool(const uint32_t deviceInstance, const uint16_t objectType, const uint32_t objectInstance, const uint32_t propertyIdentifier, bool* value, const bool useArrayIndex, const uint32_t propertyArrayIndex);
+
+// Property lookups behind the Get Property Functions
+bool GetPropertyCharString(const uint32_t deviceInstance, const uint16_t objectType, const uint32_t objectInstance, const uint32_t propertyIdentifier, char* value, uint32_t* valueElementCount, const uint32_t maxElementCount, uint8_t* encodingType, const bool useArrayIndex, const uint32_t propertyArrayIndex);
+bool GetPropertyEnum(const uint32_t deviceInstance, const uint16_t objectType, const uint32_t objectInstance, const uint32_t propertyIdentifier, uint32_t* value, const bool useArrayIndex, const uint32_t propertyArrayIndex);
+bool GetPropertyOctetString(const uint32_t deviceInstance, const uint16_t objectType, const uint32_t objectInstance, const uint32_t propertyIdentifier, uint8_t* value, uint32_t* valueElementCount, const uint32_t maxElementCount, const bool useArrayIndex, const uint32_t propertyArrayIndex);
+bool GetPropertyReal(const uint32_t deviceInstance, const uint16_t objectType, const uint32_t objectInstance, const uint32_t propertyIdentifier, float* value, const bool useArrayIndex, const uint32_t propertyArrayIndex);
+bool GetPropertyUInt(const uint32_t deviceInstance, const uint16_t objectType, const uint32_t objectInstance, const uint32_t propertyIdentifier, uint32_t* value, const bool useArrayIndex, const uint32_t propertyArrayIndex);
+bool GetPropertyBool(const uint32_t deviceInstance, const uint16_t objectType, const uint32_t objectInstance, const uint32_t propertyIdentifier, bool* value, const bool useArrayIndex, const uint32_t propertyArrayIndex);
+
+// Set Property Functions
+bool CallbackSetPropertyReal(const uint32_t deviceInstance, const uint16_t objectType, const uint32_t objectInstance, const uint32_t propertyIdentifier, const float value, const bool useArrayIndex, const uint32_t propertyArrayIndex, const uint8_t priority, uint32_t* errorCode);
+bool CallbackSetPropertyEnum(const uint32_t deviceInstance, const uint16_t objectType, const uint32_t objectInstance, const uint32_t propertyIdentifier, const uint32_t value, const bool useArrayIndex, const uint32_t propertyArrayIndex, const uint8_t priority, uint32_t* errorCode);
+bool CallbackSetPropertyNull(const uint32_t deviceInstance, const uint16_t objectType, const uint32_t objectInstance, const uint32_t propertyIdentifier, const bool useArrayIndex, const uint32_t propertyArrayIndex, const uint8_t priority, uint32_t* errorCode);
+bool CallbackSetPropertyUInt(const uint32_t deviceInstance, const uint16_t objectType, const uint32_t objectInstance, const uint32_t propertyIdentifier, const uint32_t value, const bool useArrayIndex, const uint32_t propertyArrayIndex, const uint8_t priority, uint32_t* errorCode);
 
 // Helper functions 
-bool DoUserInput();
+bool ExecuteCommand(const std::string& command, std::ostream& out);
+bool LoadBroadcastDistributionTable(std::ostream& out);
+void WriteQueueDepths(std::ostream& out);
+bool RegisterVirtualDevices(const std::vector<ExampleDatabaseVirtualDeviceEntry>& entries, const bool verbose);
+bool RegisterVirtualDevice(const ExampleDatabaseVirtualDeviceEntry& entry, const bool verbose);
+template <typename Record>
+bool RegisterObjectStore(ExampleDatabaseObjectStore<Record>& store, const char* typeName);
+template <typename Record>
+bool RegisterDeviceObjects(ExampleDatabaseObjectStore<Record>& store, const uint32_t deviceInstance);
+bool IsPresentValueWritable(const uint16_t objectType);
+bool AnnounceDevice(const uint32_t deviceInstance);
+bool AnnounceRouterToNetwork();
+void QueueAddFloor(std::ostream& out);
+void QueueRemoveLastNetwork(std::ostream& out);
 bool GetObjectName(const uint32_t deviceInstance, const uint16_t objectType, const uint32_t objectInstance, char* value, uint32_t* valueElementCount, const uint32_t maxElementCount);
 bool GetDeviceDescription(const uint32_t deviceInstance, char* value, uint32_t* valueElementCount, const uint32_t maxElementCount);
+bool QueueBackendWrite(const uint32_t deviceInstance, const uint16_t objectType, const uint32_t objectInstance, const uint32_t propertyIdentifier, const float value, const uint8_t priority, const std::chrono::steady_clock::time_point& start, uint32_t* errorCode);
+int ReceiveSocketMessage(uint8_t* message, const uint16_t maxMessageLength, uint8_t* sourceConnectionString, uint8_t* sourceConnectionStringLength, uint8_t* destinationConnectionString, uint8_t* destinationConnectionStringLength, const uint8_t maxConnectionStringLength, uint8_t* networkType);
+int ReceiveScheduledMessage(uint8_t* message, const uint16_t maxMessageLength, uint8_t* sourceConnectionString, uint8_t* sourceConnectionStringLength, uint8_t* destinationConnectionString, uint8_t* destinationConnectionStringLength, const uint8_t maxConnectionStringLength, uint8_t* networkType);
+int ReceiveShardMessage(uint8_t* message, const uint16_t maxMessageLength, uint8_t* sourceConnectionString, uint8_t* sourceConnectionStringLength, uint8_t* destinationConnectionString, uint8_t* destinationConnectionStringLength, const uint8_t maxConnectionStringLength, uint8_t* networkType);
+void SendShardMessages();
+int ReceiveIPv6Message(uint8_t* message, const uint16_t maxMessageLength, uint8_t* ipAddress, uint16_t* port);
+std::string IPv6AddressToString(const uint8_t* ipAddress);
+void PrintMemoryUsage(std::ostream& out);
+
+// Applies the topology changes to the database and registers them with the
+// CAS BACnet Stack. New devices are announced with an I-Am of their own.
+class CStackTopologyApplier : public CTopologyApplier
+{
+public:
+	virtual bool Apply(const TopologyChange& change);
+};
 
 
 int main(int argc, char** argv)
@@ -64,21 +157,351 @@ int main(int argc, char** argv)
 	std::cout << "https://github.com/chipkin/BACnetVirtualDevicesBBMDExampleCPP" << std::endl << std::endl;
 
 	// Check for bbmd address from the command arguments, otherwise use a default
-	if (argc >= 2) {
-		std::string bbmdAddressStr = std::string(argv[1]);
-		sscanf_s(bbmdAddressStr.c_str(), "%hhd.%hhd.%hhd.%hhd", &g_bbmdAddress[0], &g_bbmdAddress[1], &g_bbmdAddress[2], &g_bbmdAddress[3]);
-	}
-	else {
-		g_bbmdAddress[0] = 192;
-		g_bbmdAddress[1] = 168;
-		g_bbmdAddress[2] = 0;
-		g_bbmdAddress[3] = 100;
+	// Options:
+	//		--image=<path>			Load the database from an image, if it exists
+	//		--write-image=<path>	Write the database to an image after setup
+	//		--quiet					No per device logging during startup
+	//		--interface=<name>		Add a Network Port on this interface, can be repeated
+	//		--ipv6[=<name>]			Also run BACnet/IPv6 (Annex U), on the named interface
+	//		--write-delay=<us>		Simulated backend round trip for each batch of written values
+	//		--objects-per-type=<n>	Number of BI, BV, MSV and AV objects in each virtual device
+	//		--devices-per-network=<n>	Number of virtual devices on each virtual network
+	//		--trend-interval=<s>	Log the analog inputs every <s> seconds, 0 disables the trend logs
+	//		--trend-capacity=<kb>	Largest size of the trend log of each analog input
+	//		--metrics-port=<port>	Serve the runtime counters in the Prometheus text format on 127.0.0.1:<port>
+	//		--ingest=<name>			Create a shared memory segment that other processes publish analog input values into
+	//		--cache-ttl=<ms>		Serve the analog inputs from a stale-while-revalidate cache of a slow backend
+	//		--cache-workers=<n>		Number of concurrent refreshes of the value cache
+	//		--cache-deadline=<ms>	Deadline of each refresh of the value cache
+	//		--ingress-queue=<n>		Queue up to <n> received messages by priority before the stack, shedding broadcasts first
+	//		--ingress-weights=<c>,<u>,<b>	Messages delivered per round from the confirmed, unicast and broadcast queues
+	//		--topology-budget=<us>	Longest time spent applying topology changes between two ticks
+	//		--control=<path>		Take commands on a UNIX domain socket, see ExecuteCommand()
+	//		--no-keyboard			Do not read commands from the keyboard, for running as a service
+	//		--trace=<level>			0 no logging of the messages, 1 one line per message, 2 also decoded as XML (default)
+	//		--bdt=<path>			Broadcast Distribution Table, one <ip>[:<port>] [<mask>] per line
+	//		--watchdog=<ms>			Take a snapshot when the main loop stops for longer than this, default 1000, 0 disables
+	//		--virtual-networks=<n>	Number of virtual networks, 1000, 2000, ... up to 40
+	//		--shards=<n>			Host the virtual networks in <n> worker processes behind this one
+	//		--loop-cpus=<list>		Pin the BACnet thread to these CPUs, for example 3 or 2-3
+	//		--helper-cpus=<list>	Pin every other thread to these CPUs
+	//		--sched-fifo[=<prio>]	Run the BACnet thread SCHED_FIFO, default priority 50
+	//		--mlock					Lock all the memory and prefault the stack of the BACnet thread
+	//		--packet-pool=<n>		Number of packet buffers behind --ingress-queue, at least the queue length + 2
+	//		--packet-pool-hugepages	Back the packet buffers with huge pages
+	//		--who-has-filter		Drop the Who-Has requests for object names that no device in their range has
+	//		--no-lookup-memo		Find the object again for every property callback, instead of once per tick
+	//		--response-cache=<n>	Answer the ReadProperty requests answered before from up to n cached responses
+	//		--response-cache-verify	Pass the cache hits to the stack anyway and compare its answers with the cached ones
+	//		--benchmark-<name>		Run a benchmark and exit, only in the benchmark project, see Benchmarks/Benchmarks.cpp
+	g_bbmdAddress[0] = 192;
+	g_bbmdAddress[1] = 168;
+	g_bbmdAddress[2] = 0;
+	g_bbmdAddress[3] = 100;
+	std::string imagePath;
+	std::string writeImagePath;
+	bool useIPv6 = false;
+	std::string ipv6InterfaceName;
+	uint32_t writeBackendDelayMicroseconds = 5000;
+	uint16_t metricsPort = 0;
+	std::string ingestionName;
+	uint32_t valueCacheTTLMilliseconds = 0;
+	uint32_t valueCacheWorkers = 64;
+	uint32_t valueCacheDeadlineMilliseconds = 2000;
+	uint32_t ingressCapacity = 0;
+	uint32_t ingressWeights[INGRESS_CLASS_COUNT] = { 8, 2, 1 };
+	uint32_t packetPoolCount = PACKET_POOL_DEFAULT_COUNT;
+	bool packetPoolHugePages = false;
+	uint32_t topologyBudgetMicroseconds = 2000;
+	std::string controlPath;
+	bool useKeyboard = true;
+	uint32_t watchdogThresholdMilliseconds = 1000;
+	uint32_t shardCount = 0;
+	CRealtimeProfile realtimeProfile;
+	std::string benchmarkOption;
+	for (int argIndex = 1; argIndex < argc; argIndex++) {
+		std::string arg = std::string(argv[argIndex]);
+		if (arg.compare(0, 8, "--image=") == 0) {
+			imagePath = arg.substr(8);
+		}
+		else if (arg.compare(0, 14, "--write-image=") == 0) {
+			writeImagePath = arg.substr(14);
+		}
+		else if (arg == "--quiet") {
+			g_quietStartup = true;
+		}
+		else if (arg.compare(0, 12, "--interface=") == 0) {
+			g_database.AddNetworkInterface(arg.substr(12));
+		}
+		else if (arg == "--ipv6" || arg.compare(0, 7, "--ipv6=") == 0) {
+			useIPv6 = true;
+			ipv6InterfaceName = arg.size() > 7 ? arg.substr(7) : "";
+		}
+		else if (arg.compare(0, 14, "--write-delay=") == 0) {
+			writeBackendDelayMicroseconds = (uint32_t)strtoul(arg.c_str() + 14, NULL, 10);
+		}
+		else if (arg.compare(0, 19, "--objects-per-type=") == 0) {
+			g_database.objectsPerType = (uint32_t)strtoul(arg.c_str() + 19, NULL, 10);
+		}
+		else if (arg.compare(0, 22, "--devices-per-network=") == 0) {
+			g_database.devicesPerNetwork = (uint32_t)strtoul(arg.c_str() + 22, NULL, 10);
+		}
+		else if (arg.compare(0, 17, "--trend-interval=") == 0) {
+			g_database.trendLogIntervalSeconds = (uint32_t)strtoul(arg.c_str() + 17, NULL, 10);
+		}
+		else if (arg.compare(0, 17, "--trend-capacity=") == 0) {
+			g_database.trendLogCapacity = (size_t)strtoul(arg.c_str() + 17, NULL, 10) * 1024;
+		}
+		else if (arg.compare(0, 15, "--metrics-port=") == 0) {
+			metricsPort = (uint16_t)strtoul(arg.c_str() + 15, NULL, 10);
+		}
+		else if (arg.compare(0, 9, "--ingest=") == 0) {
+			ingestionName = arg.substr(9);
+		}
+		else if (arg.compare(0, 12, "--cache-ttl=") == 0) {
+			valueCacheTTLMilliseconds = (uint32_t)strtoul(arg.c_str() + 12, NULL, 10);
+		}
+		else if (arg.compare(0, 16, "--cache-workers=") == 0) {
+			valueCacheWorkers = (uint32_t)strtoul(arg.c_str() + 16, NULL, 10);
+		}
+		else if (arg.compare(0, 17, "--cache-deadline=") == 0) {
+			valueCacheDeadlineMilliseconds = (uint32_t)strtoul(arg.c_str() + 17, NULL, 10);
+		}
+		else if (arg.compare(0, 16, "--ingress-queue=") == 0) {
+			ingressCapacity = (uint32_t)strtoul(arg.c_str() + 16, NULL, 10);
+		}
+		else if (arg.compare(0, 18, "--ingress-weights=") == 0) {
+			if (sscanf_s(arg.c_str() + 18, "%u,%u,%u", &ingressWeights[INGRESS_CLASS_CONFIRMED], &ingressWeights[INGRESS_CLASS_UNICAST], &ingressWeights[INGRESS_CLASS_BROADCAST]) != INGRESS_CLASS_COUNT) {
+				std::cerr << "Invalid ingress weights [" << arg.substr(18) << "]" << std::endl;
+				return -1;
+			}
+		}
+		else if (arg.compare(0, 18, "--topology-budget=") == 0) {
+			topologyBudgetMicroseconds = (uint32_t)strtoul(arg.c_str() + 18, NULL, 10);
+		}
+		else if (arg.compare(0, 10, "--control=") == 0) {
+			controlPath = arg.substr(10);
+		}
+		else if (arg == "--no-keyboard") {
+			useKeyboard = false;
+		}
+		else if (arg.compare(0, 8, "--trace=") == 0) {
+			g_traceLevel = atoi(arg.c_str() + 8);
+		}
+		else if (arg.compare(0, 11, "--watchdog=") == 0) {
+			watchdogThresholdMilliseconds = (uint32_t)strtoul(arg.c_str() + 11, NULL, 10);
+		}
+		else if (arg.compare(0, 6, "--bdt=") == 0) {
+			g_bdtPath = arg.substr(6);
+		}
+		else if (arg.compare(0, 19, "--virtual-networks=") == 0) {
+			g_database.virtualNetworkCount = (uint32_t)strtoul(arg.c_str() + 19, NULL, 10);
+			if (g_database.virtualNetworkCount > MAX_VIRTUAL_NETWORKS) {
+				std::cerr << "At most " << MAX_VIRTUAL_NETWORKS << " virtual networks" << std::endl;
+				return -1;
+			}
+		}
+		else if (arg.compare(0, 12, "--loop-cpus=") == 0) {
+			if (!CRealtimeProfile::ParseCpuList(arg.substr(12), realtimeProfile.loopCpus)) {
+				std::cerr << "Invalid CPU list [" << arg.substr(12) << "]" << std::endl;
+				return -1;
+			}
+		}
+		else if (arg.compare(0, 14, "--helper-cpus=") == 0) {
+			if (!CRealtimeProfile::ParseCpuList(arg.substr(14), realtimeProfile.helperCpus)) {
+				std::cerr << "Invalid CPU list [" << arg.substr(14) << "]" << std::endl;
+				return -1;
+			}
+		}
+		else if (arg == "--sched-fifo" || arg.compare(0, 13, "--sched-fifo=") == 0) {
+			realtimeProfile.fifoPriority = arg.size() > 13 ? atoi(arg.c_str() + 13) : REALTIME_PROFILE_DEFAULT_PRIORITY;
+			if (realtimeProfile.fifoPriority < 1 || realtimeProfile.fifoPriority > 99) {
+				std::cerr << "The SCHED_FIFO priority must be 1 to 99" << std::endl;
+				return -1;
+			}
+		}
+		else if (arg == "--mlock") {
+			realtimeProfile.lockMemory = true;
+		}
+		else if (arg.compare(0, 14, "--packet-pool=") == 0) {
+			packetPoolCount = (uint32_t)strtoul(arg.c_str() + 14, NULL, 10);
+		}
+		else if (arg == "--packet-pool-hugepages") {
+			packetPoolHugePages = true;
+		}
+		else if (arg == "--who-has-filter") {
+			g_whoHasFilter.SetEnabled(true);
+		}
+		else if (arg == "--no-lookup-memo") {
+			g_database.lookupMemo.SetEnabled(false);
+		}
+		else if (arg.compare(0, 17, "--response-cache=") == 0) {
+			g_responseCache.SetCapacity((size_t)strtoul(arg.c_str() + 17, NULL, 10));
+		}
+		else if (arg == "--response-cache-verify") {
+			g_responseCache.SetVerify(true);
+		}
+		else if (arg.compare(0, 9, "--shards=") == 0) {
+			shardCount = (uint32_t)strtoul(arg.c_str() + 9, NULL, 10);
+		}
+		else if (arg.compare(0, 12, "--benchmark-") == 0) {
+			benchmarkOption = arg;
+		}
+		else {
+			sscanf_s(arg.c_str(), "%hhu.%hhu.%hhu.%hhu", &g_bbmdAddress[0], &g_bbmdAddress[1], &g_bbmdAddress[2], &g_bbmdAddress[3]);
+		}
 	}
 	g_bbmdAddress[4] = 0xba;
 	g_bbmdAddress[5] = 0xc0;
+	if (g_database.devicesPerNetwork > ExampleDatabase::GetMaxDevicesPerNetwork(g_database.virtualNetworkCount)) {
+		std::cerr << "At most " << ExampleDatabase::GetMaxDevicesPerNetwork(g_database.virtualNetworkCount) << " devices on each of " << g_database.virtualNetworkCount << " virtual networks" << std::endl;
+		return -1;
+	}
+
+	// Run a benchmark instead of the server, with the other options
+	if (!benchmarkOption.empty()) {
+#ifdef BACNET_EXAMPLE_BENCHMARKS
+		BenchmarkContext context;
+		context.database = &g_database;
+		context.responseCache = &g_responseCache;
+		context.callbacks.getCharString = CallbackGetPropertyCharString;
+		context.callbacks.getEnum = CallbackGetPropertyEnum;
+		context.callbacks.getReal = CallbackGetPropertyReal;
+		context.callbacks.getUInt = CallbackGetPropertyUInt;
+		context.callbacks.getBool = CallbackGetPropertyBool;
+		memcpy(context.ingressWeights, ingressWeights, sizeof(context.ingressWeights));
+		context.realtimeProfile = &realtimeProfile;
+		return RunBenchmark(std::cout, benchmarkOption, context) ? 0 : -1;
+#else
+		std::cerr << "The benchmarks are only built into the BACnetVirtualDevicesBBMDExampleCPPBenchmarks project" << std::endl;
+		return -1;
+#endif // BACNET_EXAMPLE_BENCHMARKS
+	}
+
+	// Fork the shard workers before any thread is started. Each worker
+	// continues from here with the virtual networks of its shard.
+	if (shardCount > 0) {
+		if (!imagePath.empty()) {
+			std::cerr << "A database image can not be used with --shards" << std::endl;
+			return -1;
+		}
+		std::cout << "FYI: Starting [" << shardCount << "] shard workers... " << std::flush;
+		int shardIndex = g_shards.Start(shardCount, &g_shardWorker);
+		if (shardIndex < 0) {
+			std::cerr << "Failed to start the shard workers" << std::endl;
+			return -1;
+		}
+		// The front end is shard shardCount and hosts no virtual network
+		const uint32_t shard = (uint32_t)shardIndex;
+		g_database.hostsNetwork = [shardCount, shard](const uint16_t network) {
+			return CShardFrontEnd::GetShard(network, shardCount) == shard;
+		};
+		if (g_shardWorker.IsOpen()) {
+			// The front end owns the sockets, the commands, the metrics and
+			// the ingested points
+			std::cout << "FYI: Shard worker [" << shardIndex << "] started" << std::endl;
+			writeImagePath.clear();
+			useIPv6 = false;
+			metricsPort = 0;
+			ingestionName.clear();
+			controlPath.clear();
+			useKeyboard = false;
+		}
+		else {
+			std::cout << "OK" << std::endl;
+		}
+	}
+
+	// Timed breakdown of the startup, printed once before entering the main loop
+	CStartupProfiler startupProfiler;
+
+	// 0. Load the example database
+	// ---------------------------------------------------------------------------
+	startupProfiler.Begin("load_database");
+	if (!imagePath.empty() && g_database.LoadImage(imagePath.c_str())) {
+		std::cout << "FYI: Mapped database image [" << imagePath << "]" << std::endl;
+	}
+	else {
+		if (!imagePath.empty()) {
+			std::cout << "FYI: Could not map database image [" << imagePath << "], using Setup()" << std::endl;
+		}
+		g_database.Setup();
+	}
+	// The main device of a worker is never seen on the network, it only
+	// routes to the virtual networks. It gets an instance of its own anyway.
+	static_assert(SHARD_ROUTER_MAX_WORKERS < RESERVED_DEVICE_INSTANCES, "The main devices of the shard workers run past the reserved device instances");
+	if (g_shardWorker.IsOpen()) {
+		g_database.mainDevice.instance += 1 + g_shardWorker.GetIndex();
+	}
+	// Now that the main device has its final instance. The BBMD, the front
+	// end when sharded, distributes every broadcast it receives.
+	g_database.BuildNameIndex();
+	g_whoHasFilter.SetForwardsBroadcasts(!g_shardWorker.IsOpen());
+	std::vector<ExampleDatabaseVirtualDeviceEntry> virtualDeviceList;
+	g_database.GetVirtualDeviceList(virtualDeviceList);
+	startupProfiler.End((uint32_t)virtualDeviceList.size());
+
+	size_t priorityArrayCompactBytes, priorityArrayNaiveBytes, priorityArrayPoints;
+	g_database.GetPriorityArrayMemoryUsage(&priorityArrayCompactBytes, &priorityArrayNaiveBytes, &priorityArrayPoints);
+	std::cout << "FYI: Priority arrays: points=[" << priorityArrayPoints << "], compact=[" << priorityArrayCompactBytes << "] bytes, naive=[" << priorityArrayNaiveBytes << "] bytes" << std::endl;
+	PrintMemoryUsage(std::cout);
+
+	if (!writeImagePath.empty()) {
+		std::cout << "FYI: Writing database image [" << writeImagePath << "]... ";
+		if (!g_database.SaveImage(writeImagePath.c_str())) {
+			std::cerr << "Failed to write the database image" << std::endl;
+		}
+		else {
+			std::cout << "OK" << std::endl;
+		}
+	}
+
+	if (!ingestionName.empty()) {
+		std::cout << "FYI: Creating point ingestion segment [" << ingestionName << "]... ";
+		if (!g_database.OpenPointIngestion(ingestionName.c_str())) {
+			std::cerr << "Failed to create the point ingestion segment" << std::endl;
+			return -1;
+		}
+		std::cout << "OK, points=[" << g_database.pointIngestion.GetPointCount() << "]" << std::endl;
+	}
+
+	if (valueCacheTTLMilliseconds != 0) {
+		std::cout << "FYI: Starting the value cache, ttl=[" << valueCacheTTLMilliseconds << "] ms, workers=[" << valueCacheWorkers << "], deadline=[" << valueCacheDeadlineMilliseconds << "] ms... ";
+		if (!g_database.StartValueCache(&g_valueCacheBackend, valueCacheTTLMilliseconds, valueCacheWorkers, valueCacheDeadlineMilliseconds)) {
+			std::cerr << "Failed to start the value cache" << std::endl;
+			return -1;
+		}
+		std::cout << "OK, points=[" << g_database.valueCache.GetPointCount() << "]" << std::endl;
+	}
+
+	// The database drops the cached answers of the objects it changes
+	if (g_responseCache.IsEnabled()) {
+		g_database.changeListener = &g_responseCache;
+		std::cout << "FYI: Response cache enabled" << std::endl;
+	}
+
+	if (ingressCapacity != 0) {
+		if (packetPoolCount < ingressCapacity + 2) {
+			packetPoolCount = ingressCapacity + 2;
+		}
+		std::cout << "FYI: Starting the packet pool, count=[" << packetPoolCount << "], hugepages=[" << (packetPoolHugePages ? "true" : "false") << "]... ";
+		if (!g_packetPool.Start(packetPoolCount, packetPoolHugePages)) {
+			std::cerr << "Failed to map the packet pool" << std::endl;
+			return -1;
+		}
+		std::cout << "OK, backing=[" << CPacketPool::GetBackingName(g_packetPool.GetBacking()) << "]" << std::endl;
+
+		std::cout << "FYI: Starting the ingress scheduler, capacity=[" << ingressCapacity << "], weights=[" << ingressWeights[INGRESS_CLASS_CONFIRMED] << "," << ingressWeights[INGRESS_CLASS_UNICAST] << "," << ingressWeights[INGRESS_CLASS_BROADCAST] << "]... ";
+		if (!g_ingress.Start(&g_packetPool, ingressCapacity, ingressWeights)) {
+			std::cerr << "Failed to start the ingress scheduler" << std::endl;
+			return -1;
+		}
+		std::cout << "OK" << std::endl;
+	}
 
 	// 1. Load the CAS BACnet stack functions
 	// ---------------------------------------------------------------------------
+	startupProfiler.Begin("stack_load");
 	std::cout << "FYI: Loading CAS BACnet Stack functions... ";
 	if (!LoadBACnetFunctions()) {
 		std::cerr << "Failed to load the functions from the DLL" << std::endl;
@@ -89,17 +512,46 @@ int main(int argc, char** argv)
 
 	// 2. Connect the UDP resource to the BACnet Port
 	// ---------------------------------------------------------------------------
-	std::cout << "FYI: Connecting UDP Resource to port=[" << g_database.networkPort.BACnetIPUDPPort << "]... ";
-	if (!g_udp.Connect(g_database.networkPort.BACnetIPUDPPort)) {
-		std::cerr << "Failed to connect to UDP Resource" << std::endl;
-		std::cerr << "Press any key to exit the application..." << std::endl;
-		(void)getchar();
-		return -1;
+	// One socket for each Network Port. The interface index of each socket is
+	// the same as the index of its Network Port. A shard worker has none, its
+	// messages go through the front end.
+	startupProfiler.Begin("socket_connect");
+	std::vector<ExampleDatabaseNetworkPort>::iterator portIt;
+	for (portIt = g_database.networkPorts.begin(); portIt != g_database.networkPorts.end() && !g_shardWorker.IsOpen(); ++portIt) {
+		std::cout << "FYI: Connecting UDP Resource to interface=[" << portIt->interfaceName << "], port=[" << portIt->BACnetIPUDPPort << "]... ";
+		if (g_udp.AddInterface(portIt->interfaceName, portIt->IPAddress, portIt->IPSubnetMask, portIt->BACnetIPUDPPort) < 0) {
+			std::cerr << "Failed to connect to UDP Resource" << std::endl;
+			std::cerr << "Press any key to exit the application..." << std::endl;
+			(void)getchar();
+			return -1;
+		}
+		std::cout << "OK, Connected to port" << std::endl;
+	}
+	uint32_t networkPortsRevision = g_database.networkPortsRevision;
+
+	// BACnet/IPv6 uses its own socket. Broadcasts are sent to and received
+	// from the link-local BACnet multicast group.
+	if (useIPv6) {
+		unsigned int ipv6InterfaceIndex = 0;
+		if (!ipv6InterfaceName.empty()) {
+			ipv6InterfaceIndex = if_nametoindex(ipv6InterfaceName.c_str());
+			if (ipv6InterfaceIndex == 0) {
+				std::cerr << "Unknown IPv6 interface [" << ipv6InterfaceName << "]" << std::endl;
+				return -1;
+			}
+		}
+		std::cout << "FYI: Connecting BACnet/IPv6 UDP Resource to interface=[" << ipv6InterfaceName << "], port=[" << BACNET_IPV6_UDP_PORT << "]... ";
+		if (!g_udp6.ConnectIPv6(BACNET_IPV6_UDP_PORT, BACNET_IPV6_MULTICAST_LINK_LOCAL, ipv6InterfaceIndex)) {
+			std::cerr << "Failed to connect to the BACnet/IPv6 UDP Resource" << std::endl;
+			return -1;
+		}
+		std::cout << "OK, Connected to port" << std::endl;
 	}
-	std::cout << "OK, Connected to port" << std::endl;
+	startupProfiler.End((uint32_t)g_database.networkPorts.size() + (useIPv6 ? 1 : 0));
 
 	// 3. Setup the callbacks
 	// ---------------------------------------------------------------------------
+	startupProfiler.Begin("device_registration");
 	std::cout << "FYI: Registering the callback Functions with the CAS BACnet Stack" << std::endl;
 
 	// Message Callback Functions
@@ -115,6 +567,29 @@ int main(int argc, char** argv)
 	fpRegisterCallbackGetPropertyOctetString(CallbackGetPropertyOctetString);
 	fpRegisterCallbackGetPropertyReal(CallbackGetPropertyReal);
 	fpRegisterCallbackGetPropertyUnsignedInteger(CallbackGetPropertyUInt);
+	fpRegisterCallbackGetPropertyBool(CallbackGetPropertyBool);
+
+	// Set Property Callback Functions
+	fpRegisterCallbackSetPropertyReal(CallbackSetPropertyReal);
+	fpRegisterCallbackSetPropertyEnumerated(CallbackSetPropertyEnum);
+	fpRegisterCallbackSetPropertyNull(CallbackSetPropertyNull);
+	fpRegisterCallbackSetPropertyUnsignedInteger(CallbackSetPropertyUInt);
+
+	// Written values are passed on to the backend by a worker thread
+	g_writeBackend.Start(writeBackendDelayMicroseconds);
+
+	// The metrics are served from their own thread
+	g_metrics.Set(METRIC_GAUGE_START_TIME, (uint64_t)time(0));
+	g_metrics.Set(METRIC_GAUGE_VIRTUAL_DEVICES, virtualDeviceList.size());
+	g_metrics.Set(METRIC_GAUGE_NETWORK_PORTS, g_database.networkPorts.size());
+	if (metricsPort != 0) {
+		std::cout << "FYI: Serving metrics on http://127.0.0.1:" << metricsPort << "/metrics... ";
+		if (!g_metricsServer.Start(&g_metrics, "127.0.0.1", metricsPort)) {
+			std::cerr << "Failed to start the metrics listener" << std::endl;
+			return -1;
+		}
+		std::cout << "OK" << std::endl;
+	}
 
 	// 4. Setup the BACnet device
 	// ---------------------------------------------------------------------------
@@ -156,273 +631,1340 @@ int main(int argc, char** argv)
 	// Add Main Device Objects
 	// ---------------------------------------
 
-	// Add the Network Port Object
-	std::cout << "Adding NetworkPort. networkPort.instance=[" << g_database.networkPort.instance << "]... ";
-	if (!fpAddNetworkPortObject(g_database.mainDevice.instance, g_database.networkPort.instance, ExampleConstants::NETWORK_TYPE_IPV4, ExampleConstants::PROTOCOL_LEVEL_BACNET_APPLICATION, ExampleConstants::NETWORK_PORT_LOWEST_PROTOCOL_LAYER)) {
-		std::cerr << "Failed to add NetworkPort" << std::endl;
-		return -1;
+	// Add a Network Port Object for each interface
+	for (portIt = g_database.networkPorts.begin(); portIt != g_database.networkPorts.end(); ++portIt) {
+		std::cout << "Adding NetworkPort. networkPort.instance=[" << portIt->instance << "]... ";
+		if (!fpAddNetworkPortObject(g_database.mainDevice.instance, portIt->instance, ExampleConstants::NETWORK_TYPE_IPV4, ExampleConstants::PROTOCOL_LEVEL_BACNET_APPLICATION, ExampleConstants::NETWORK_PORT_LOWEST_PROTOCOL_LAYER)) {
+			std::cerr << "Failed to add NetworkPort" << std::endl;
+			return -1;
+		}
+		std::cout << "OK" << std::endl;
 	}
-	std::cout << "OK" << std::endl;
 
 	// Add Virtual Devices and Objects
 	std::cout << "Adding Virtual Devices and Objects..." << std::endl;
-	std::map<uint16_t, std::vector<ExampleDatabaseDevice> >::iterator it;
-	for (it = g_database.virtualDevices.begin(); it != g_database.virtualDevices.end(); ++it) {
-		// Add the Virtual network
-		if (!fpAddVirtualNetwork(g_database.mainDevice.instance, it->first, it->first)) {
-			std::cerr << "Failed to add virtual network " << it->first << std::endl;
+	if (!RegisterVirtualDevices(virtualDeviceList, !g_quietStartup)) {
+		return -1;
+	}
+	if (!RegisterObjectStore(g_database.binaryInputs, "BinaryInput") ||
+		!RegisterObjectStore(g_database.binaryValues, "BinaryValue") ||
+		!RegisterObjectStore(g_database.multiStateValues, "MultiStateValue") ||
+		!RegisterObjectStore(g_database.analogValues, "AnalogValue")) {
+		return -1;
+	}
+	startupProfiler.End((uint32_t)(virtualDeviceList.size() + g_database.networkPorts.size()));
+
+	// 4.Enable BBMD Functionality
+	// ---------------------------------------------------------------------------
+	// The BBMD runs on the first Network Port
+	startupProfiler.Begin("bbmd_setup");
+	// The BBMD of a sharded deployment is the front end
+	if (!g_shardWorker.IsOpen()) {
+		const ExampleDatabaseNetworkPort& bbmdPort = g_database.networkPorts[0];
+
+		// Add BBMD specific network port properties to the main device such as accept registrations, FDT, and BDT
+		std::cout << "Enabling bbmd_accept_fd_registrations property to the Main Network Port Object networkPort.instance=[" << bbmdPort.instance << "]... ";
+		if (!fpSetPropertyEnabled(g_database.mainDevice.instance, ExampleConstants::OBJECT_TYPE_NETWORK_PORT, bbmdPort.instance, ExampleConstants::PROPERTY_IDENTIFIER_BBMD_ACCEPT_FD_REGISTRATIONS, true)) {
+			std::cerr << "Failed to enable the bbmd_accept_fd_registrations property for the Main Network Port Object" << std::endl;
 			return -1;
 		}
+		std::cout << "OK" << std::endl;
 
-		std::vector<ExampleDatabaseDevice>::iterator devIt;
-		for (devIt = it->second.begin(); devIt != it->second.end(); ++devIt) {
-			// Add the Virtual Device
-			std::cout << "Adding Virtual Device. device.instance=[" << devIt->instance << "] to network=[" << it->first << "]...";
-			if (!fpAddDeviceToVirtualNetwork(devIt->instance, it->first)) {
-				std::cerr << "Failed to add Virtual Device" << std::endl;
-				return -1;
-			}
-			std::cout << "OK" << std::endl;
-
-			// Enable IAm
-			std::cout << "Enabling IAm... ";
-			if (!fpSetServiceEnabled(devIt->instance, ExampleConstants::SERVICE_I_AM, true)) {
-				std::cerr << "Failed to enable IAm" << std::endl;
-				return -1;
-			}
-			std::cout << "OK" << std::endl;
+		std::cout << "Enabling bbmd_broadcast_distribution_table property to the Main Network Port Object networkPort.instance=[" << bbmdPort.instance << "]... ";
+		if (!fpSetPropertyEnabled(g_database.mainDevice.instance, ExampleConstants::OBJECT_TYPE_NETWORK_PORT, bbmdPort.instance, ExampleConstants::PROPERTY_IDENTIFIER_BBMD_BROADCAST_DISTRIBUTION_TABLE, true)) {
+			std::cerr << "Failed to enable the bbmd_broadcast_distribution_table property for the Main Network Port Object" << std::endl;
+			return -1;
+		}
+		std::cout << "OK" << std::endl;
 
-			// Enable Read Property Multiple
-			if (!fpSetServiceEnabled(devIt->instance, ExampleConstants::SERVICE_READ_PROPERTY_MULTIPLE, true)) {
-				std::cerr << "Failed to enable ReadPropertyMultiple" << std::endl;
-				return -1;
-			}
-			std::cout << "OK" << std::endl;
+		std::cout << "Enabling bbmd_foreign_device_table property to the Main Network Port Object networkPort.instance=[" << bbmdPort.instance << "]... ";
+		if (!fpSetPropertyEnabled(g_database.mainDevice.instance, ExampleConstants::OBJECT_TYPE_NETWORK_PORT, bbmdPort.instance, ExampleConstants::PROPERTY_IDENTIFIER_BBMD_FOREIGN_DEVICE_TABLE, true)) {
+			std::cerr << "Failed to enable the bbmd_foreign_device_table property for the Main Network Port Object" << std::endl;
+			return -1;
+		}
+		std::cout << "OK" << std::endl;
 
-			// Add the Analog Input to the Virtual Device
-			std::cout << "Adding Analog Input to Virtual Device. device.instance=[" << devIt->instance << "], analogInput.instance=[" << g_database.analogInputs[devIt->instance].instance << "]...";
-			if (!fpAddObject(devIt->instance, ExampleConstants::OBJECT_TYPE_ANALOG_INPUT, g_database.analogInputs[devIt->instance].instance)) {
-				std::cerr << "Failed to add AnalogInput" << std::endl;
-				return -1;
-			}
-			std::cout << "OK" << std::endl;
+		// Fill the BDT, the first entry must be this device. It can be reloaded
+		// with the reload-bdt command.
+		std::cout << "Loading the BDT Table... ";
+		if (!LoadBroadcastDistributionTable(std::cout)) {
+			std::cerr << "Failed to load the BDT Table" << std::endl;
+			return -1;
+		}
+		std::cout << "OK" << std::endl;
 
-			// Enable Reliability property 
-			fpSetPropertyByObjectTypeEnabled(devIt->instance, ExampleConstants::OBJECT_TYPE_ANALOG_INPUT, ExampleConstants::PROPERTY_IDENTIFIER_RELIABILITY, true);
+		// Enable BBMD
+		std::cout << "Enabling BBMD... ";
+		if (!fpSetBBMD(g_database.mainDevice.instance, bbmdPort.instance)) {
+			std::cerr << "Failed to enable the BBMD" << std::endl;
+			return -1;
 		}
+		std::cout << "OK" << std::endl;
 	}
 
-	// 4.Enable BBMD Functionality
-	// ---------------------------------------------------------------------------
 
-	// Add BBMD specific network port properties to the main device such as accept registrations, FDT, and BDT
-	std::cout << "Enabling bbmd_accept_fd_registrations property to the Main Network Port Object networkPort.instance=[" << g_database.networkPort.instance << "]... ";
-	if (!fpSetPropertyEnabled(g_database.mainDevice.instance, ExampleConstants::OBJECT_TYPE_NETWORK_PORT, g_database.networkPort.instance, ExampleConstants::PROPERTY_IDENTIFIER_BBMD_ACCEPT_FD_REGISTRATIONS, true)) {
-		std::cerr << "Failed to enable the bbmd_accept_fd_registrations property for the Main Network Port Object" << std::endl;
-		return -1;
-	}
-	std::cout << "OK" << std::endl;
+	// 5. Send I-Am of this device
+	// ---------------------------------------------------------------------------
+	// To be a good citizen on a BACnet network. We should announce  ourselves when we start up. 
+	startupProfiler.Begin("announcements");
+	// Announce on the subnet of every Network Port
+	for (portIt = g_database.networkPorts.begin(); portIt != g_database.networkPorts.end(); ++portIt) {
+		std::cout << "FYI: Sending I-AM broadcast on interface=[" << portIt->interfaceName << "]" << std::endl;
+		uint8_t connectionString[6]; //= { 0xC0, 0xA8, 0x01, 0xFF, 0xBA, 0xC0 };
+		memcpy(connectionString, portIt->BroadcastIPAddress, 4);
+		connectionString[4] = portIt->BACnetIPUDPPort / 256;
+		connectionString[5] = portIt->BACnetIPUDPPort % 256;
+
+		// Send IAm for the Main Device
+		if (!fpSendIAm(g_database.mainDevice.instance, connectionString, 6, ExampleConstants::NETWORK_TYPE_IP, true, 65535, NULL, 0)) {
+			std::cerr << "Unable to send IAm broadcast for mainDevice.instance=[" << g_database.mainDevice.instance << "]" << std::endl;
+			return false;
+		}
 
-	std::cout << "Enabling bbmd_broadcast_distribution_table property to the Main Network Port Object networkPort.instance=[" << g_database.networkPort.instance << "]... ";
-	if (!fpSetPropertyEnabled(g_database.mainDevice.instance, ExampleConstants::OBJECT_TYPE_NETWORK_PORT, g_database.networkPort.instance, ExampleConstants::PROPERTY_IDENTIFIER_BBMD_BROADCAST_DISTRIBUTION_TABLE, true)) {
-		std::cerr << "Failed to enable the bbmd_broadcast_distribution_table property for the Main Network Port Object" << std::endl;
-		return -1;
-	}
-	std::cout << "OK" << std::endl;
+		// Send IAm for each virtual device
+		std::vector<ExampleDatabaseVirtualDeviceEntry>::iterator devIt;
+		for (devIt = virtualDeviceList.begin(); devIt != virtualDeviceList.end(); ++devIt) {
+			if (!fpSendIAm(devIt->deviceInstance, connectionString, 6, ExampleConstants::NETWORK_TYPE_IP, true, 65535, NULL, 0)) {
+				std::cerr << "Unable to send IAm broadcast for virtualDevice.instance=[" << devIt->deviceInstance << "]" << std::endl;
+				return false;
+			}
+		}
 
-	std::cout << "Enabling bbmd_foreign_device_table property to the Main Network Port Object networkPort.instance=[" << g_database.networkPort.instance << "]... ";
-	if (!fpSetPropertyEnabled(g_database.mainDevice.instance, ExampleConstants::OBJECT_TYPE_NETWORK_PORT, g_database.networkPort.instance, ExampleConstants::PROPERTY_IDENTIFIER_BBMD_FOREIGN_DEVICE_TABLE, true)) {
-		std::cerr << "Failed to enable the bbmd_foreign_device_table property for the Main Network Port Object" << std::endl;
-		return -1;
+		// Send IAmRouterToNetwork
+		if (!fpSendIAmRouterToNetwork(connectionString, 6, ExampleConstants::NETWORK_TYPE_IP, true, 65535, NULL, 0)) {
+			std::cerr << "Unable to send IAmRouterToNetwork broadcast" << std::endl;
+			return false;
+		}
 	}
-	std::cout << "OK" << std::endl;
 
-	// Add Main Device to the BDT Table (the first entry must be this device)
-	std::cout << "Adding Main Device to BDT Table... ";
-	uint8_t bdtAddress[6];
-	memcpy(bdtAddress, g_database.networkPort.IPAddress, 4);
-	bdtAddress[4] = g_database.networkPort.BACnetIPUDPPort / 256;
-	bdtAddress[5] = g_database.networkPort.BACnetIPUDPPort % 256;
-	uint8_t bdtMask[4] = { 255, 255, 255, 255 };
-	if (!fpAddBDTEntry(bdtAddress, 6, bdtMask, 4)) {
-		std::cerr << "Failed to add the Main Device to the BDT Table" << std::endl;
-		return -1;
-	}
-	std::cout << "OK" << std::endl;
+	// Announce on the BACnet/IPv6 multicast group
+	if (useIPv6) {
+		std::cout << "FYI: Sending I-AM broadcast on BACnet/IPv6" << std::endl;
+		uint8_t connectionString[ExampleConstants::CONNECTION_STRING_LENGTH_IPV6];
+		memcpy(connectionString, BACNET_IPV6_MULTICAST_LINK_LOCAL, 16);
+		connectionString[16] = BACNET_IPV6_UDP_PORT / 256;
+		connectionString[17] = BACNET_IPV6_UDP_PORT % 256;
 
-	// Add BBMD to the BDT Table. In this example, this is a hard-coded value for testing.
-	// In an actual implementation, this should be configurable from a settings file / gui
-	// or users can use the BACnet BVLL function WriteBroadcastDistributionTable to update the BDT.
-	std::cout << "Adding BBMD to BDT Table... ";
-	if (!fpAddBDTEntry(g_bbmdAddress, 6, bdtMask, 4)) {
-		std::cerr << "Failed to add the BBMD to the BDT Table" << std::endl;
-		return -1;
+		if (!fpSendIAm(g_database.mainDevice.instance, connectionString, ExampleConstants::CONNECTION_STRING_LENGTH_IPV6, ExampleConstants::NETWORK_TYPE_BACNET_IPV6, true, 65535, NULL, 0)) {
+			std::cerr << "Unable to send BACnet/IPv6 IAm broadcast for mainDevice.instance=[" << g_database.mainDevice.instance << "]" << std::endl;
+			return false;
+		}
+		std::vector<ExampleDatabaseVirtualDeviceEntry>::iterator devIt;
+		for (devIt = virtualDeviceList.begin(); devIt != virtualDeviceList.end(); ++devIt) {
+			if (!fpSendIAm(devIt->deviceInstance, connectionString, ExampleConstants::CONNECTION_STRING_LENGTH_IPV6, ExampleConstants::NETWORK_TYPE_BACNET_IPV6, true, 65535, NULL, 0)) {
+				std::cerr << "Unable to send BACnet/IPv6 IAm broadcast for virtualDevice.instance=[" << devIt->deviceInstance << "]" << std::endl;
+				return false;
+			}
+		}
+		if (!fpSendIAmRouterToNetwork(connectionString, ExampleConstants::CONNECTION_STRING_LENGTH_IPV6, ExampleConstants::NETWORK_TYPE_BACNET_IPV6, true, 65535, NULL, 0)) {
+			std::cerr << "Unable to send BACnet/IPv6 IAmRouterToNetwork broadcast" << std::endl;
+			return false;
+		}
 	}
-	std::cout << "OK" << std::endl;
+	startupProfiler.End((uint32_t)((virtualDeviceList.size() + 2) * (g_database.networkPorts.size() + (useIPv6 ? 1 : 0))));
 
-	// Enable BBMD
-	std::cout << "Enabling BBMD... ";
-	if (!fpSetBBMD(g_database.mainDevice.instance, g_database.networkPort.instance)) {
-		std::cerr << "Failed to enable the BBMD" << std::endl;
-		return -1;
-	}
-	std::cout << "OK" << std::endl;
+	std::cout << "FYI: Startup profile: ";
+	startupProfiler.Report(std::cout);
 
+	// Rate of the latency clock, and the cost of timing one scope with it
+	CLatencyClock::Calibrate();
+	std::cout << "FYI: Latency timer overhead: [" << g_latency.MeasureOverhead() << "] ns" << std::endl;
 
-	// 5. Send I-Am of this device
+	// 6. Start the main loop
 	// ---------------------------------------------------------------------------
-	// To be a good citizen on a BACnet network. We should announce  ourselves when we start up. 
-	std::cout << "FYI: Sending I-AM broadcast" << std::endl;
-	uint8_t connectionString[6]; //= { 0xC0, 0xA8, 0x01, 0xFF, 0xBA, 0xC0 };
-	memcpy(connectionString, g_database.networkPort.BroadcastIPAddress, 4);
-	connectionString[4] = g_database.networkPort.BACnetIPUDPPort / 256;
-	connectionString[5] = g_database.networkPort.BACnetIPUDPPort % 256;
-
-	// Send IAm for the Main Device
-	if (!fpSendIAm(g_database.mainDevice.instance, connectionString, 6, ExampleConstants::NETWORK_TYPE_IP, true, 65535, NULL, 0)) {
-		std::cerr << "Unable to send IAm broadcast for mainDevice.instance=[" << g_database.mainDevice.instance << "]" << std::endl;
-		return false;
+	CStackTopologyApplier topologyApplier;
+	if (!controlPath.empty()) {
+		if (!g_control.StartSocket(controlPath.c_str())) {
+			std::cerr << "Failed to listen for commands on [" << controlPath << "]" << std::endl;
+			return -1;
+		}
+		std::cout << "FYI: Listening for commands on [" << controlPath << "]" << std::endl;
 	}
-
-	// Send IAm for each virtual device
-	for (it = g_database.virtualDevices.begin(); it != g_database.virtualDevices.end(); ++it) {
-		std::vector<ExampleDatabaseDevice>::iterator devIt;
-		for (devIt = it->second.begin(); devIt != it->second.end(); ++devIt) {
-			if (!fpSendIAm(devIt->instance, connectionString, 6, ExampleConstants::NETWORK_TYPE_IP, true, 65535, NULL, 0)) {
-				std::cerr << "Unable to send IAm broadcast for virtualDevice.instance=[" << devIt->instance << "]" << std::endl;
-				return false;
-			}
+	if (useKeyboard) {
+		g_control.StartKeyboard();
+	}
+	if (watchdogThresholdMilliseconds > 0) {
+		if (!g_watchdog.Start(watchdogThresholdMilliseconds, &g_latency, WriteQueueDepths, &g_metrics)) {
+			std::cerr << "Failed to start the stall watchdog" << std::endl;
+			return -1;
 		}
+		std::cout << "FYI: Stall watchdog threshold [" << watchdogThresholdMilliseconds << "] ms" << std::endl;
 	}
 
-	// Send IAmRouterToNetwork
-	if (!fpSendIAmRouterToNetwork(connectionString, 6, ExampleConstants::NETWORK_TYPE_IP, true, 65535, NULL, 0)) {
-		std::cerr << "Unable to send IAmRouterToNetwork broadcast" << std::endl;
-		return false;
+	// Pin, schedule and lock the BACnet thread, and pin the threads started
+	// above. The processes of --shards each take one of the loop CPUs.
+	int processIndex = -1;
+	if (g_shardWorker.IsOpen()) {
+		processIndex = (int)g_shardWorker.GetIndex();
 	}
-
-	// 6. Start the main loop
-	// ---------------------------------------------------------------------------
+	else if (g_shards.IsRunning()) {
+		processIndex = (int)g_shards.GetWorkerCount();
+	}
+	if (!realtimeProfile.Apply(processIndex)) {
+		std::cerr << "Some settings of the realtime profile could not be applied" << std::endl;
+	}
+	std::cout << "FYI: Realtime profile: ";
+	realtimeProfile.Report(std::cout);
 	std::cout << "FYI: Entering main loop..." << std::endl;
 	for (;;) {
+		// Tell the watchdog the loop is still going around
+		g_watchdog.Beat();
+
 		// Call the DLLs loop function which checks for messages and processes them.
-		fpTick();
-
-		// Handle any user input.
-		// Note: User input in this example is used for the following:
-		//		h - Display options
-		//		q - Quit
-		if (!DoUserInput()) {
-			// User press 'q' to quit the example application.
+		// The objects found by the callbacks are kept for the rest of the tick.
+		{
+			CLatencyTimer timer(g_latency, LATENCY_TICK);
+			g_database.lookupMemo.Begin();
+			fpTick();
+			g_database.lookupMemo.End();
+		}
+		g_metrics.Add(METRIC_LOOP_ITERATIONS);
+
+		// Send the messages of the shard workers to the network
+		if (g_shards.IsRunning()) {
+			SendShardMessages();
+		}
+
+		// Run the commands from the keyboard and the control socket. They
+		// are read by other threads, only a counter is checked here.
+		if (g_control.HasCommands() && !g_control.Service(ExecuteCommand)) {
+			// 'q' or quit
 			break;
 		}
 
+		// Apply the queued topology changes, a slice at a time so that the
+		// requests keep being answered
+		if (!g_topology.IsEmpty()) {
+			uint64_t startTicks = CLatencyClock::Now();
+			bool deltaApplied = g_topology.Apply(&topologyApplier, topologyBudgetMicroseconds);
+			g_latency.Record(LATENCY_TOPOLOGY, CLatencyClock::Now() - startTicks);
+			if (deltaApplied) {
+				g_metrics.Set(METRIC_GAUGE_VIRTUAL_DEVICES, g_database.GetVirtualDeviceCount());
+				std::cout << "FYI: Topology: ";
+				g_topology.Report(std::cout);
+			}
+		}
+
 		// Update values in the example database
-		g_database.Loop();
+		{
+			CLatencyTimer timer(g_latency, LATENCY_LOOP);
+			g_database.Loop();
+		}
+
+		// Follow address changes on the network interfaces
+		if (networkPortsRevision != g_database.networkPortsRevision) {
+			networkPortsRevision = g_database.networkPortsRevision;
+			for (size_t portIndex = 0; portIndex < g_database.networkPorts.size(); portIndex++) {
+				g_udp.UpdateInterface(portIndex, g_database.networkPorts[portIndex].IPAddress, g_database.networkPorts[portIndex].IPSubnetMask);
+			}
+		}
 
 		// Call Sleep to give some time back to the system
 		Sleep(0); // Windows 
 	}
 
 	// All done. 
+	g_control.Stop();
+	if (g_shards.IsRunning()) {
+		std::cout << "FYI: Shards: ";
+		g_shards.Report(std::cout);
+		g_shards.Stop();
+	}
+	if (g_watchdog.IsRunning()) {
+		g_watchdog.Stop();
+		std::cout << "FYI: Stalls: ";
+		g_watchdog.Report(std::cout);
+	}
+	g_metricsServer.Stop();
+	g_writeBackend.Stop();
+	std::cout << "FYI: Write backend: ";
+	g_writeBackend.Report(std::cout);
+	if (g_database.valueCache.IsRunning()) {
+		std::cout << "FYI: Value cache: ";
+		g_database.valueCache.Report(std::cout);
+		g_database.valueCache.Stop();
+	}
+	if (g_ingress.IsEnabled()) {
+		std::cout << "FYI: Ingress: ";
+		g_ingress.Report(std::cout);
+		std::cout << "FYI: Packet pool: ";
+		g_packetPool.Report(std::cout);
+	}
+	std::cout << "FYI: Latency: ";
+	g_latency.Report(std::cout);
+	std::cout << "FYI: Service times: ";
+	g_serviceTimes.Report(std::cout);
+	if (g_whoHasFilter.IsEnabled()) {
+		std::cout << "FYI: Who-Has: ";
+		g_whoHasFilter.Report(std::cout);
+	}
+	std::cout << "FYI: Lookup memo: ";
+	g_database.lookupMemo.Report(std::cout);
+	if (g_responseCache.IsEnabled()) {
+		std::cout << "FYI: Response cache: ";
+		g_responseCache.Report(std::cout);
+	}
 	return 0;
 }
 
 // Helper Functions
 
-// Handle any user input.
-// Note: User input in this example is used for the following:
-//		h - Display options
-//		q - Quit
-bool DoUserInput()
+// Commands of the keyboard and the control socket. A key runs the command of
+// the same letter, the socket takes the names.
+enum ControlCommandId
+{
+	CONTROL_COMMAND_HELP,
+	CONTROL_COMMAND_QUIT,
+	CONTROL_COMMAND_STATS,
+	CONTROL_COMMAND_METRICS,
+	CONTROL_COMMAND_WRITE,
+	CONTROL_COMMAND_TREND,
+	CONTROL_COMMAND_INGEST,
+	CONTROL_COMMAND_CACHE,
+	CONTROL_COMMAND_INGRESS,
+	CONTROL_COMMAND_MEMORY,
+	CONTROL_COMMAND_LATENCY,
+	CONTROL_COMMAND_RESET_LATENCY,
+	CONTROL_COMMAND_SERVICE_TIMES,
+	CONTROL_COMMAND_STALLS,
+	CONTROL_COMMAND_SHARDS,
+	CONTROL_COMMAND_FIND,
+	CONTROL_COMMAND_TRACE,
+	CONTROL_COMMAND_RELOAD_BDT,
+	CONTROL_COMMAND_ADD_NETWORK,
+	CONTROL_COMMAND_REMOVE_NETWORK,
+	CONTROL_COMMAND_ADD_DEVICE,
+	CONTROL_COMMAND_REMOVE_DEVICE,
+	CONTROL_COMMAND_COUNT
+};
+
+struct ControlCommand
+{
+	char key;			// 0 for the socket only
+	const char* name;
+	const char* help;
+};
+
+static const ControlCommand CONTROL_COMMANDS[CONTROL_COMMAND_COUNT] = {
+	{ 'h', "help", "(h)elp" },
+	{ 'q', "quit", "(q)uit" },
+	{ 0, "stats", "write backend, value cache, ingress, topology, latency, service time, Who-Has, stall and memory statistics" },
+	{ 0, "metrics", "the metrics in the Prometheus text format" },
+	{ 'w', "write", "(w)rite backend statistics" },
+	{ 't', "trend", "(t)rend log memory usage and the last records" },
+	{ 'i', "ingest", "(i)ngested point counts" },
+	{ 'c', "cache", "value (c)ache statistics" },
+	{ 'p', "ingress", "(p)riority queues of the received messages" },
+	{ 'm', "memory", "(m)emory used by the device and object records and their names" },
+	{ 'l', "latency", "(l)atency percentiles of the callbacks and the main loop" },
+	{ 'r', "reset-latency", "(r)eset the latency and service time histograms" },
+	{ 'v', "services", "ser(v)ice times of the confirmed requests by service and virtual network" },
+	{ 's', "stalls", "main loop (s)talls and the snapshot of the last one" },
+	{ 0, "shards", "messages routed to and from each shard worker" },
+	{ 0, "find <name>", "the objects with that object name, through the name index" },
+	{ 0, "trace <level>", "log no messages (0), one line per message (1) or also the decoded XML (2)" },
+	{ 0, "reload-bdt", "reload the Broadcast Distribution Table from the --bdt file" },
+	{ 'a', "add-network", "(a)dd a virtual network of 1000 devices while running" },
+	{ 'd', "remove-network", "(d)elete the last virtual network and its devices while running" },
+	{ 0, "add-device <network> <instance>", "add a virtual device to a virtual network while running" },
+	{ 0, "remove-device <instance>", "remove a virtual device while running" },
+};
+
+// Runs one command from the keyboard or the control socket, on the BACnet
+// thread. Returns false to quit.
+bool ExecuteCommand(const std::string& command, std::ostream& out)
 {
-	// Check to see if the user hit any key
-	if (!_kbhit()) {
-		// No keys have been hit
+	std::istringstream arguments(command);
+	std::string name;
+	arguments >> name;
+	for (size_t i = 0; i < name.size(); i++) {
+		name[i] = (char)tolower(name[i]);
+	}
+
+	// A single letter is a key, anything else the name of the command
+	int id = CONTROL_COMMAND_COUNT;
+	for (int i = 0; i < CONTROL_COMMAND_COUNT; i++) {
+		const ControlCommand& candidate = CONTROL_COMMANDS[i];
+		size_t nameLength = strcspn(candidate.name, " ");
+		if ((name.size() == 1 && name[0] == candidate.key) || (name.size() == nameLength && name.compare(0, nameLength, candidate.name, nameLength) == 0)) {
+			id = i;
+			break;
+		}
+	}
+
+	// The virtual networks of a sharded deployment are in the workers
+	if (g_shards.IsRunning() && id >= CONTROL_COMMAND_ADD_NETWORK && id <= CONTROL_COMMAND_REMOVE_DEVICE) {
+		out << "ERROR: [" << name << "] is not available with --shards" << std::endl;
 		return true;
 	}
 
-	// Extract the letter that the user hit and convert it to lower case
-	char action = tolower(getchar());
-
-	// Handle the action 
-	switch (action) {
-		// Quit
-	case 'q': {
-		return false;
+	switch (id) {
+	case CONTROL_COMMAND_QUIT: {
+		out << "FYI: Quitting" << std::endl;
+		return false;
+	}
+	case CONTROL_COMMAND_STATS: {
+		out << "FYI: Write backend: ";
+		g_writeBackend.Report(out);
+		if (g_database.valueCache.IsRunning()) {
+			out << "FYI: Value cache: ";
+			g_database.valueCache.Report(out);
+		}
+		if (g_ingress.IsEnabled()) {
+			out << "FYI: Ingress: ";
+			g_ingress.Report(out);
+			out << "FYI: Packet pool: ";
+			g_packetPool.Report(out);
+		}
+		out << "FYI: Topology: ";
+		g_topology.Report(out);
+		out << "FYI: Latency: ";
+		g_latency.Report(out);
+		out << "FYI: Service times: ";
+		g_serviceTimes.Report(out);
+		out << "FYI: Who-Has: ";
+		g_whoHasFilter.Report(out);
+		out << "FYI: Lookup memo: ";
+		g_database.lookupMemo.Report(out);
+		out << "FYI: Response cache: ";
+		g_responseCache.Report(out);
+		out << "FYI: Stalls: ";
+		g_watchdog.Report(out);
+		if (g_shards.IsRunning()) {
+			out << "FYI: Shards: ";
+			g_shards.Report(out);
+		}
+		PrintMemoryUsage(out);
+		break;
+	}
+	case CONTROL_COMMAND_METRICS: {
+		std::string text;
+		g_metrics.Render(text);
+		out << text;
+		break;
+	}
+	case CONTROL_COMMAND_WRITE: {
+		out << "FYI: Write backend: ";
+		g_writeBackend.Report(out);
+		break;
+	}
+	case CONTROL_COMMAND_TREND: {
+		size_t trendLogBytes, trendLogPoints;
+		uint64_t trendLogRecords;
+		g_database.GetTrendLogMemoryUsage(&trendLogBytes, &trendLogRecords, &trendLogPoints);
+		out << "FYI: Trend logs: points=[" << trendLogPoints << "], records=[" << trendLogRecords << "], memory=[" << trendLogBytes << "] bytes" << std::endl;
+
+		// The last few records of the first analog input, read the way a
+		// ReadRange by sequence number would
+		if (!g_database.trendLogs.empty()) {
+			const CTrendLog& trendLog = g_database.trendLogs.begin()->second.log;
+			TrendLogRecord records[5];
+			uint64_t total = trendLog.GetTotalRecordCount();
+			uint32_t count = trendLog.ReadBySequenceNumber(total > 5 ? total - 4 : 1, 5, records);
+			for (uint32_t i = 0; i < count; i++) {
+				out << "  device.instance=[" << g_database.trendLogs.begin()->first << "], sequence=[" << records[i].sequenceNumber << "], timestamp=[" << records[i].timestamp << "], value=[" << records[i].value << "]" << std::endl;
+			}
+		}
+		break;
+	}
+	case CONTROL_COMMAND_MEMORY: {
+		PrintMemoryUsage(out);
+		break;
+	}
+	case CONTROL_COMMAND_CACHE: {
+		out << "FYI: Value cache: ";
+		g_database.valueCache.Report(out);
+		break;
+	}
+	case CONTROL_COMMAND_INGEST: {
+		out << "FYI: Point ingestion: points=[" << g_database.pointIngestion.GetPointCount() << "], published=[" << g_database.pointIngestion.GetPublishCount() << "], applied=[" << g_database.pointIngestionCount << "]" << std::endl;
+		break;
+	}
+	case CONTROL_COMMAND_INGRESS: {
+		out << "FYI: Ingress: ";
+		g_ingress.Report(out);
+		out << "FYI: Packet pool: ";
+		g_packetPool.Report(out);
+		break;
+	}
+	case CONTROL_COMMAND_LATENCY: {
+		out << "FYI: Latency: ";
+		g_latency.Report(out);
+		break;
+	}
+	case CONTROL_COMMAND_RESET_LATENCY: {
+		g_latency.Clear();
+		g_serviceTimes.Clear();
+		out << "FYI: Latency histograms cleared" << std::endl;
+		break;
+	}
+	case CONTROL_COMMAND_SERVICE_TIMES: {
+		out << "FYI: Service times: ";
+		g_serviceTimes.Report(out);
+		break;
+	}
+	case CONTROL_COMMAND_STALLS: {
+		out << "FYI: Stalls: ";
+		g_watchdog.Report(out);
+		break;
+	}
+	case CONTROL_COMMAND_SHARDS: {
+		if (!g_shards.IsRunning()) {
+			out << "FYI: Not sharded, see --shards" << std::endl;
+			break;
+		}
+		out << "FYI: Shards: ";
+		g_shards.Report(out);
+		break;
+	}
+	case CONTROL_COMMAND_FIND: {
+		// The rest of the line, names have spaces
+		std::string objectName;
+		std::getline(arguments >> std::ws, objectName);
+		if (objectName.empty()) {
+			out << "ERROR: Usage: find <name>" << std::endl;
+			break;
+		}
+		ExampleDatabaseObjectReference objects[16];
+		size_t count = g_database.FindObjectsByName(objectName.data(), objectName.size(), objects, sizeof(objects) / sizeof(objects[0]));
+		out << "FYI: Objects named [" << objectName << "]: {\"count\":" << count << ",\"objects\":[";
+		for (size_t i = 0; i < count && i < sizeof(objects) / sizeof(objects[0]); i++) {
+			out << (i > 0 ? "," : "") << "{\"device\":" << objects[i].deviceInstance << ",\"type\":" << objects[i].objectType << ",\"instance\":" << objects[i].objectInstance << "}";
+		}
+		out << "]}" << std::endl;
+		break;
+	}
+	case CONTROL_COMMAND_TRACE: {
+		int level;
+		if (!(arguments >> level) || level < TRACE_LEVEL_NONE || level > TRACE_LEVEL_XML) {
+			out << "ERROR: Usage: trace <0-2>" << std::endl;
+			break;
+		}
+		g_traceLevel = level;
+		out << "FYI: Trace level [" << g_traceLevel << "]" << std::endl;
+		break;
+	}
+	case CONTROL_COMMAND_RELOAD_BDT: {
+		if (!LoadBroadcastDistributionTable(out)) {
+			out << "ERROR: Failed to load the BDT Table" << std::endl;
+			break;
+		}
+		out << "FYI: BDT Table reloaded" << std::endl;
+		break;
+	}
+	case CONTROL_COMMAND_ADD_NETWORK: {
+		QueueAddFloor(out);
+		break;
+	}
+	case CONTROL_COMMAND_REMOVE_NETWORK: {
+		QueueRemoveLastNetwork(out);
+		break;
+	}
+	case CONTROL_COMMAND_ADD_DEVICE: {
+		uint32_t network, deviceInstance;
+		if (!(arguments >> network >> deviceInstance) || network == 0 || network > 0xFFFE) {
+			out << "ERROR: Usage: add-device <network> <instance>" << std::endl;
+			break;
+		}
+		if (ExampleDatabase::IsReservedDeviceInstance(deviceInstance)) {
+			out << "ERROR: device.instance=[" << deviceInstance << "] is the main device, the main device of a shard worker or past " << LAST_DEVICE_INSTANCE << std::endl;
+			break;
+		}
+		// The network is added first if it is new
+		if (g_database.virtualDevices.count((uint16_t)network) == 0) {
+			g_topology.AddNetwork((uint16_t)network);
+		}
+		g_topology.AddDevice((uint16_t)network, deviceInstance);
+		out << "FYI: Queued device.instance=[" << deviceInstance << "] on virtual network [" << network << "]" << std::endl;
+		break;
+	}
+	case CONTROL_COMMAND_REMOVE_DEVICE: {
+		uint32_t deviceInstance;
+		if (!(arguments >> deviceInstance)) {
+			out << "ERROR: Usage: remove-device <instance>" << std::endl;
+			break;
+		}
+		g_topology.RemoveDevice(deviceInstance);
+		out << "FYI: Queued the removal of device.instance=[" << deviceInstance << "]" << std::endl;
+		break;
+	}
+	case CONTROL_COMMAND_HELP:
+	default: {
+		if (id == CONTROL_COMMAND_COUNT && !name.empty() && name != "?") {
+			out << "ERROR: Unknown command [" << name << "]" << std::endl;
+		}
+		// Print the Help
+		out << std::endl << std::endl;
+		// Print the application version information
+		out << "CAS BACnet Stack Virtual Devices and BBMD Example v" << APPLICATION_VERSION << "." << CIBUILDNUMBER << std::endl;
+		out << "https://github.com/chipkin/BACnetVirtualDevicesBBMDExampleCPP" << std::endl << std::endl;
+
+		out << "Help:" << std::endl;
+		for (int i = 0; i < CONTROL_COMMAND_COUNT; i++) {
+			const ControlCommand& help = CONTROL_COMMANDS[i];
+			out << (help.key != 0 ? help.key : ' ') << " " << help.name << " - " << help.help << std::endl;
+		}
+		out << std::endl;
+		break;
+	}
+	}
+
+	return true;
+}
+
+// Queue depths for the stall watchdog. Called from the watchdog thread while
+// the BACnet thread is stuck, so only the atomic counts that the queues keep
+// for the other threads are read.
+void WriteQueueDepths(std::ostream& out)
+{
+	out << "\"ingress\":" << g_ingress.GetQueuedCount()
+		<< ",\"writeBackend\":" << g_writeBackend.GetQueuedCount()
+		<< ",\"topology\":" << g_topology.GetPendingCount()
+		<< ",\"commands\":" << g_control.GetPendingCount();
+}
+
+// Clears the Broadcast Distribution Table and fills it again: this device,
+// then the entries of the --bdt file, or the BBMD from the command line.
+// Each line of the file is <ip>[:<port>] [<mask>], # starts a comment. The
+// table is only touched once every entry is valid. If the stack refuses one
+// of them the previous table is put back.
+bool LoadBroadcastDistributionTable(std::ostream& out)
+{
+	std::vector<std::vector<uint8_t> > entries;
+
+	const ExampleDatabaseNetworkPort& bbmdPort = g_database.networkPorts[0];
+	std::vector<uint8_t> entry(10, 255);
+	memcpy(&entry[0], bbmdPort.IPAddress, 4);
+	entry[4] = bbmdPort.BACnetIPUDPPort / 256;
+	entry[5] = bbmdPort.BACnetIPUDPPort % 256;
+	entries.push_back(entry);
+
+	if (g_bdtPath.empty()) {
+		memcpy(&entry[0], g_bbmdAddress, 6);
+		entries.push_back(entry);
+	}
+	else {
+		std::ifstream file(g_bdtPath.c_str());
+		if (!file) {
+			out << "ERROR: Can not open [" << g_bdtPath << "]" << std::endl;
+			return false;
+		}
+		std::string line;
+		for (size_t lineNumber = 1; std::getline(file, line); lineNumber++) {
+			line = line.substr(0, line.find('#'));
+			if (line.find_first_not_of(" \t\r") == std::string::npos) {
+				continue;
+			}
+			unsigned int ip[4], port = 0xBAC0, mask[4] = { 255, 255, 255, 255 };
+			bool valid;
+			if (line.find(':') != std::string::npos) {
+				int fields = sscanf_s(line.c_str(), " %u.%u.%u.%u:%u %u.%u.%u.%u", &ip[0], &ip[1], &ip[2], &ip[3], &port, &mask[0], &mask[1], &mask[2], &mask[3]);
+				valid = fields == 5 || fields == 9;
+			}
+			else {
+				int fields = sscanf_s(line.c_str(), " %u.%u.%u.%u %u.%u.%u.%u", &ip[0], &ip[1], &ip[2], &ip[3], &mask[0], &mask[1], &mask[2], &mask[3]);
+				valid = fields == 4 || fields == 8;
+			}
+			// Octets and port in range, and a mask of contiguous ones
+			uint32_t maskBits = 0;
+			for (int i = 0; valid && i < 4; i++) {
+				valid = ip[i] <= 255 && mask[i] <= 255;
+				maskBits = (maskBits << 8) | (mask[i] & 0xFF);
+			}
+			valid = valid && port != 0 && port <= 0xFFFF && (~maskBits & (~maskBits + 1)) == 0;
+			if (!valid) {
+				out << "ERROR: [" << g_bdtPath << "] line " << lineNumber << " is not <ip>[:<port>] [<mask>]" << std::endl;
+				return false;
+			}
+			for (int i = 0; i < 4; i++) {
+				entry[i] = (uint8_t)ip[i];
+				entry[6 + i] = (uint8_t)mask[i];
+			}
+			entry[4] = (uint8_t)(port / 256);
+			entry[5] = (uint8_t)(port % 256);
+			// A shared file may list this device too, it is already first
+			if (memcmp(&entries[0][0], &entry[0], 6) == 0) {
+				continue;
+			}
+			for (size_t i = 1; i < entries.size(); i++) {
+				if (memcmp(&entries[i][0], &entry[0], 6) == 0) {
+					out << "ERROR: [" << g_bdtPath << "] line " << lineNumber << " repeats " << ip[0] << "." << ip[1] << "." << ip[2] << "." << ip[3] << ":" << port << std::endl;
+					return false;
+				}
+			}
+			entries.push_back(entry);
+		}
+	}
+
+	if (!fpClearBDT()) {
+		return false;
+	}
+	for (size_t i = 0; i < entries.size(); i++) {
+		if (!fpAddBDTEntry(&entries[i][0], 6, &entries[i][6], 4)) {
+			out << "ERROR: Failed to add BDT entry " << (int)entries[i][0] << "." << (int)entries[i][1] << "." << (int)entries[i][2] << "." << (int)entries[i][3] << ":" << (entries[i][4] * 256 + entries[i][5]) << ", keeping the previous table" << std::endl;
+			fpClearBDT();
+			for (size_t previous = 0; previous < g_bdtEntries.size(); previous++) {
+				fpAddBDTEntry(&g_bdtEntries[previous][0], 6, &g_bdtEntries[previous][6], 4);
+			}
+			return false;
+		}
+	}
+	g_bdtEntries = entries;
+	return true;
+}
+
+// Adds the virtual networks, virtual devices and their objects to the stack.
+// The list is walked once. If verbose is false, only errors are logged.
+bool RegisterVirtualDevices(const std::vector<ExampleDatabaseVirtualDeviceEntry>& entries, const bool verbose)
+{
+	std::vector<ExampleDatabaseVirtualDeviceEntry>::const_iterator devIt;
+	for (devIt = entries.begin(); devIt != entries.end(); ++devIt) {
+		// Add the Virtual network. The list is ordered by network.
+		if (devIt == entries.begin() || (devIt - 1)->network != devIt->network) {
+			if (!fpAddVirtualNetwork(g_database.mainDevice.instance, devIt->network, devIt->network)) {
+				std::cerr << "Failed to add virtual network " << devIt->network << std::endl;
+				return false;
+			}
+			g_registeredNetworks.insert(devIt->network);
+		}
+		if (!RegisterVirtualDevice(*devIt, verbose)) {
+			return false;
+		}
+	}
+
+	if (!verbose) {
+		std::cout << "FYI: Registered [" << entries.size() << "] virtual devices" << std::endl;
+	}
+	return true;
+}
+
+// Adds a virtual device and its analog input and outputs to the stack. The
+// virtual network must already be added.
+bool RegisterVirtualDevice(const ExampleDatabaseVirtualDeviceEntry& entry, const bool verbose)
+{
+	// Add the Virtual Device
+	if (verbose) {
+		std::cout << "Adding Virtual Device. device.instance=[" << entry.deviceInstance << "] to network=[" << entry.network << "]...";
+	}
+	if (!fpAddDeviceToVirtualNetwork(entry.deviceInstance, entry.network)) {
+		std::cerr << "Failed to add Virtual Device. device.instance=[" << entry.deviceInstance << "]" << std::endl;
+		return false;
+	}
+	if (verbose) {
+		std::cout << "OK" << std::endl;
+	}
+
+	// Enable IAm
+	if (!fpSetServiceEnabled(entry.deviceInstance, ExampleConstants::SERVICE_I_AM, true)) {
+		std::cerr << "Failed to enable IAm. device.instance=[" << entry.deviceInstance << "]" << std::endl;
+		return false;
+	}
+
+	// Enable Read Property Multiple
+	if (!fpSetServiceEnabled(entry.deviceInstance, ExampleConstants::SERVICE_READ_PROPERTY_MULTIPLE, true)) {
+		std::cerr << "Failed to enable ReadPropertyMultiple. device.instance=[" << entry.deviceInstance << "]" << std::endl;
+		return false;
+	}
+
+	// Enable Write Property and Write Property Multiple
+	if (!fpSetServiceEnabled(entry.deviceInstance, ExampleConstants::SERVICE_WRITE_PROPERTY, true) ||
+		!fpSetServiceEnabled(entry.deviceInstance, ExampleConstants::SERVICE_WRITE_PROPERTY_MULTIPLE, true)) {
+		std::cerr << "Failed to enable WriteProperty. device.instance=[" << entry.deviceInstance << "]" << std::endl;
+		return false;
+	}
+
+	// Add the Analog Input to the Virtual Device
+	if (entry.hasAnalogInput) {
+		if (verbose) {
+			std::cout << "Adding Analog Input to Virtual Device. device.instance=[" << entry.deviceInstance << "], analogInput.instance=[" << entry.analogInputInstance << "]...";
+		}
+		if (!fpAddObject(entry.deviceInstance, ExampleConstants::OBJECT_TYPE_ANALOG_INPUT, entry.analogInputInstance)) {
+			std::cerr << "Failed to add AnalogInput. device.instance=[" << entry.deviceInstance << "]" << std::endl;
+			return false;
+		}
+		if (verbose) {
+			std::cout << "OK" << std::endl;
+		}
+
+		// Enable Reliability property 
+		fpSetPropertyByObjectTypeEnabled(entry.deviceInstance, ExampleConstants::OBJECT_TYPE_ANALOG_INPUT, ExampleConstants::PROPERTY_IDENTIFIER_RELIABILITY, true);
+	}
+
+	// Add the commandable outputs. Their present value is written through
+	// the priority array.
+	if (entry.hasAnalogOutput) {
+		if (!fpAddObject(entry.deviceInstance, ExampleConstants::OBJECT_TYPE_ANALOG_OUTPUT, entry.analogOutputInstance)) {
+			std::cerr << "Failed to add AnalogOutput. device.instance=[" << entry.deviceInstance << "]" << std::endl;
+			return false;
+		}
+		fpSetPropertyWritable(entry.deviceInstance, ExampleConstants::OBJECT_TYPE_ANALOG_OUTPUT, entry.analogOutputInstance, ExampleConstants::PROPERTY_IDENTIFIER_PRESENT_VALUE, true);
+	}
+	if (entry.hasBinaryOutput) {
+		if (!fpAddObject(entry.deviceInstance, ExampleConstants::OBJECT_TYPE_BINARY_OUTPUT, entry.binaryOutputInstance)) {
+			std::cerr << "Failed to add BinaryOutput. device.instance=[" << entry.deviceInstance << "]" << std::endl;
+			return false;
+		}
+		fpSetPropertyWritable(entry.deviceInstance, ExampleConstants::OBJECT_TYPE_BINARY_OUTPUT, entry.binaryOutputInstance, ExampleConstants::PROPERTY_IDENTIFIER_PRESENT_VALUE, true);
+	}
+
+	return true;
+}
+
+// Adds the objects of one device in an object store to the stack
+template <typename Record>
+bool RegisterDeviceObjects(ExampleDatabaseObjectStore<Record>& store, const uint32_t deviceInstance)
+{
+	const uint16_t objectType = store.GetObjectType();
+	const bool presentValueWritable = store.IsWritable(ExampleConstants::PROPERTY_IDENTIFIER_PRESENT_VALUE);
+	size_t first;
+	size_t count = store.FindDevice(deviceInstance, &first);
+	for (size_t index = first; index < first + count; index++) {
+		const Record& record = store.At(index);
+		if (!fpAddObject(deviceInstance, objectType, record.instance)) {
+			std::cerr << "Failed to add object. device.instance=[" << deviceInstance << "], objectType=[" << objectType << "], instance=[" << record.instance << "]" << std::endl;
+			return false;
+		}
+		if (presentValueWritable) {
+			fpSetPropertyWritable(deviceInstance, objectType, record.instance, ExampleConstants::PROPERTY_IDENTIFIER_PRESENT_VALUE, true);
+		}
+	}
+	return true;
+}
+
+bool IsPresentValueWritable(const uint16_t objectType)
+{
+	switch (objectType) {
+	case ExampleConstants::OBJECT_TYPE_BINARY_INPUT:
+		return g_database.binaryInputs.IsWritable(ExampleConstants::PROPERTY_IDENTIFIER_PRESENT_VALUE);
+	case ExampleConstants::OBJECT_TYPE_BINARY_VALUE:
+		return g_database.binaryValues.IsWritable(ExampleConstants::PROPERTY_IDENTIFIER_PRESENT_VALUE);
+	case ExampleConstants::OBJECT_TYPE_MULTI_STATE_VALUE:
+		return g_database.multiStateValues.IsWritable(ExampleConstants::PROPERTY_IDENTIFIER_PRESENT_VALUE);
+	case ExampleConstants::OBJECT_TYPE_ANALOG_VALUE:
+		return g_database.analogValues.IsWritable(ExampleConstants::PROPERTY_IDENTIFIER_PRESENT_VALUE);
+	default:
+		return false;
+	}
+}
+
+bool CStackTopologyApplier::Apply(const TopologyChange& change)
+{
+	switch (change.type) {
+	case TOPOLOGY_ADD_NETWORK: {
+		if (!g_database.AddVirtualNetwork(change.network)) {
+			std::cerr << "Failed to add virtual network " << change.network << std::endl;
+			return false;
+		}
+		// A network that was removed and added again is still registered
+		if (g_registeredNetworks.count(change.network) == 0) {
+			if (!fpAddVirtualNetwork(g_database.mainDevice.instance, change.network, change.network)) {
+				std::cerr << "Failed to add virtual network " << change.network << std::endl;
+				g_database.RemoveVirtualNetwork(change.network);
+				return false;
+			}
+			g_registeredNetworks.insert(change.network);
+		}
+		return AnnounceRouterToNetwork();
+	}
+	case TOPOLOGY_REMOVE_NETWORK: {
+		// The stack keeps routing to the network, it just has no devices
+		if (!g_database.RemoveVirtualNetwork(change.network)) {
+			std::cerr << "Failed to remove virtual network " << change.network << ", it still has devices" << std::endl;
+			return false;
+		}
+		return true;
+	}
+	case TOPOLOGY_ADD_DEVICE: {
+		ExampleDatabaseVirtualDeviceEntry entry;
+		if (!g_database.AddVirtualDevice(change.network, change.deviceInstance) || !g_database.GetVirtualDeviceEntry(change.deviceInstance, &entry)) {
+			std::cerr << "Failed to add Virtual Device. device.instance=[" << change.deviceInstance << "] to network=[" << change.network << "]" << std::endl;
+			return false;
+		}
+		if (!RegisterVirtualDevice(entry, false) ||
+			!RegisterDeviceObjects(g_database.binaryInputs, change.deviceInstance) ||
+			!RegisterDeviceObjects(g_database.binaryValues, change.deviceInstance) ||
+			!RegisterDeviceObjects(g_database.multiStateValues, change.deviceInstance) ||
+			!RegisterDeviceObjects(g_database.analogValues, change.deviceInstance)) {
+			fpRemoveDevice(change.deviceInstance);
+			g_database.RemoveVirtualDevice(change.deviceInstance);
+			return false;
+		}
+		return AnnounceDevice(change.deviceInstance);
+	}
+	case TOPOLOGY_REMOVE_DEVICE: {
+		if (!fpRemoveDevice(change.deviceInstance)) {
+			std::cerr << "Failed to remove Virtual Device. device.instance=[" << change.deviceInstance << "]" << std::endl;
+			return false;
+		}
+		g_database.RemoveVirtualDevice(change.deviceInstance);
+		return true;
+	}
+	case TOPOLOGY_ADD_OBJECT: {
+		if (!g_database.AddStoredObject(change.deviceInstance, change.objectType, change.objectInstance)) {
+			std::cerr << "Failed to add object. device.instance=[" << change.deviceInstance << "], objectType=[" << change.objectType << "], instance=[" << change.objectInstance << "]" << std::endl;
+			return false;
+		}
+		if (!fpAddObject(change.deviceInstance, change.objectType, change.objectInstance)) {
+			std::cerr << "Failed to add object. device.instance=[" << change.deviceInstance << "], objectType=[" << change.objectType << "], instance=[" << change.objectInstance << "]" << std::endl;
+			g_database.RemoveStoredObject(change.deviceInstance, change.objectType, change.objectInstance);
+			return false;
+		}
+		if (IsPresentValueWritable(change.objectType)) {
+			fpSetPropertyWritable(change.deviceInstance, change.objectType, change.objectInstance, ExampleConstants::PROPERTY_IDENTIFIER_PRESENT_VALUE, true);
+		}
+		return true;
+	}
+	case TOPOLOGY_REMOVE_OBJECT: {
+		if (!fpRemoveObject(change.deviceInstance, change.objectType, change.objectInstance)) {
+			std::cerr << "Failed to remove object. device.instance=[" << change.deviceInstance << "], objectType=[" << change.objectType << "], instance=[" << change.objectInstance << "]" << std::endl;
+			return false;
+		}
+		g_database.RemoveStoredObject(change.deviceInstance, change.objectType, change.objectInstance);
+		return true;
+	}
+	}
+	return false;
+}
+
+// Sends an I-Am for one device on the subnet of every Network Port and on
+// the BACnet/IPv6 multicast group
+bool AnnounceDevice(const uint32_t deviceInstance)
+{
+	std::vector<ExampleDatabaseNetworkPort>::const_iterator portIt;
+	for (portIt = g_database.networkPorts.begin(); portIt != g_database.networkPorts.end(); ++portIt) {
+		uint8_t connectionString[6];
+		memcpy(connectionString, portIt->BroadcastIPAddress, 4);
+		connectionString[4] = portIt->BACnetIPUDPPort / 256;
+		connectionString[5] = portIt->BACnetIPUDPPort % 256;
+		if (!fpSendIAm(deviceInstance, connectionString, 6, ExampleConstants::NETWORK_TYPE_IP, true, 65535, NULL, 0)) {
+			std::cerr << "Unable to send IAm broadcast for virtualDevice.instance=[" << deviceInstance << "]" << std::endl;
+			return false;
+		}
+	}
+	if (g_udp6.IsConnected()) {
+		uint8_t connectionString[ExampleConstants::CONNECTION_STRING_LENGTH_IPV6];
+		memcpy(connectionString, BACNET_IPV6_MULTICAST_LINK_LOCAL, 16);
+		connectionString[16] = BACNET_IPV6_UDP_PORT / 256;
+		connectionString[17] = BACNET_IPV6_UDP_PORT % 256;
+		if (!fpSendIAm(deviceInstance, connectionString, ExampleConstants::CONNECTION_STRING_LENGTH_IPV6, ExampleConstants::NETWORK_TYPE_BACNET_IPV6, true, 65535, NULL, 0)) {
+			std::cerr << "Unable to send BACnet/IPv6 IAm broadcast for virtualDevice.instance=[" << deviceInstance << "]" << std::endl;
+			return false;
+		}
+	}
+	return true;
+}
+
+// Tells the routers on every subnet about the virtual networks
+bool AnnounceRouterToNetwork()
+{
+	std::vector<ExampleDatabaseNetworkPort>::const_iterator portIt;
+	for (portIt = g_database.networkPorts.begin(); portIt != g_database.networkPorts.end(); ++portIt) {
+		uint8_t connectionString[6];
+		memcpy(connectionString, portIt->BroadcastIPAddress, 4);
+		connectionString[4] = portIt->BACnetIPUDPPort / 256;
+		connectionString[5] = portIt->BACnetIPUDPPort % 256;
+		if (!fpSendIAmRouterToNetwork(connectionString, 6, ExampleConstants::NETWORK_TYPE_IP, true, 65535, NULL, 0)) {
+			std::cerr << "Unable to send IAmRouterToNetwork broadcast" << std::endl;
+			return false;
+		}
+	}
+	return true;
+}
+
+// Commissions a new floor: a virtual network after the last one, with
+// TOPOLOGY_DELTA_DEVICES devices numbered the way Setup() numbers them.
+// Refused while an earlier change is queued, the last network it works
+// from is not there yet.
+void QueueAddFloor(std::ostream& out)
+{
+	static_assert(TOPOLOGY_DELTA_DEVICES <= ExampleDatabase::GetMaxDevicesPerNetwork(MAX_VIRTUAL_NETWORKS), "A floor runs past the device instances of its network");
+	if (!g_topology.IsEmpty()) {
+		out << "FYI: The topology changes queued before are still being applied, try again once they are done" << std::endl;
+		return;
+	}
+	uint32_t network = STARTING_VIRTUAL_NETWORK;
+	if (!g_database.virtualDevices.empty()) {
+		network = (uint32_t)g_database.virtualDevices.rbegin()->first + VIRTUAL_NETWORK_OFFSET;
+	}
+	// The same limit as --virtual-networks
+	if (network < STARTING_VIRTUAL_NETWORK || (network - STARTING_VIRTUAL_NETWORK) / VIRTUAL_NETWORK_OFFSET >= MAX_VIRTUAL_NETWORKS) {
+		out << "FYI: At most " << MAX_VIRTUAL_NETWORKS << " virtual networks, up to " << STARTING_VIRTUAL_NETWORK + (MAX_VIRTUAL_NETWORKS - 1) * VIRTUAL_NETWORK_OFFSET << std::endl;
+		return;
+	}
+	const uint32_t firstDeviceInstance = network / VIRTUAL_NETWORK_OFFSET * STARTING_DEVICE_INSTANCE;
+	g_topology.AddNetwork((uint16_t)network);
+	for (uint32_t i = 0; i < TOPOLOGY_DELTA_DEVICES; i++) {
+		g_topology.AddDevice((uint16_t)network, firstDeviceInstance + i);
+	}
+	out << "FYI: Queued virtual network [" << network << "] with [" << TOPOLOGY_DELTA_DEVICES << "] devices from device.instance=[" << firstDeviceInstance << "]" << std::endl;
+}
+
+// Decommissions the last virtual network and all its devices. Refused while
+// an earlier change is queued, like QueueAddFloor().
+void QueueRemoveLastNetwork(std::ostream& out)
+{
+	if (!g_topology.IsEmpty()) {
+		out << "FYI: The topology changes queued before are still being applied, try again once they are done" << std::endl;
+		return;
+	}
+	if (g_database.virtualDevices.empty()) {
+		out << "FYI: No virtual network to remove" << std::endl;
+		return;
+	}
+	const uint16_t network = g_database.virtualDevices.rbegin()->first;
+	const std::vector<ExampleDatabaseDevice>& devices = g_database.virtualDevices.rbegin()->second;
+	for (size_t i = 0; i < devices.size(); i++) {
+		g_topology.RemoveDevice(devices[i].instance);
+	}
+	g_topology.RemoveNetwork(network);
+	out << "FYI: Queued the removal of virtual network [" << network << "] and its [" << devices.size() << "] devices" << std::endl;
+}
+
+// Adds all the objects of an object store to their virtual devices
+template <typename Record>
+bool RegisterObjectStore(ExampleDatabaseObjectStore<Record>& store, const char* typeName)
+{
+	const uint16_t objectType = store.GetObjectType();
+	const bool presentValueWritable = store.IsWritable(ExampleConstants::PROPERTY_IDENTIFIER_PRESENT_VALUE);
+	for (size_t index = 0; index < store.Size(); index++) {
+		const Record& record = store.At(index);
+		if (!fpAddObject(record.deviceInstance, objectType, record.instance)) {
+			std::cerr << "Failed to add " << typeName << ". device.instance=[" << record.deviceInstance << "], instance=[" << record.instance << "]" << std::endl;
+			return false;
+		}
+		if (presentValueWritable) {
+			fpSetPropertyWritable(record.deviceInstance, objectType, record.instance, ExampleConstants::PROPERTY_IDENTIFIER_PRESENT_VALUE, true);
+		}
+	}
+	std::cout << "FYI: Registered [" << store.Size() << "] " << typeName << " objects, [" << store.GetMemoryUsage() << "] bytes" << std::endl;
+	return true;
+}
+
+// Callback used by the BACnet Stack to check if there is a message to process
+uint16_t CallbackReceiveMessage(uint8_t* message, const uint16_t maxMessageLength, uint8_t* sourceConnectionString, uint8_t* sourceConnectionStringLength, uint8_t* destinationConnectionString, uint8_t* destinationConnectionStringLength, const uint8_t maxConnectionStringLength, uint8_t* networkType)
+{
+	// Check parameters
+	if (message == NULL || maxMessageLength == 0) {
+		std::cerr << "Invalid input buffer" << std::endl;
+		return 0;
+	}
+	if (sourceConnectionString == NULL || maxConnectionStringLength == 0) {
+		std::cerr << "Invalid connection string buffer" << std::endl;
+		return 0;
+	}
+	if (maxConnectionStringLength < ExampleConstants::CONNECTION_STRING_LENGTH_IP) {
+		std::cerr << "Not enough space for a UDP connection string" << std::endl;
+		return 0;
+	}
+
+	uint64_t startTicks = CLatencyClock::Now();
+	int bytesRead;
+	if (g_shardWorker.IsOpen()) {
+		bytesRead = ReceiveShardMessage(message, maxMessageLength, sourceConnectionString, sourceConnectionStringLength, destinationConnectionString, destinationConnectionStringLength, maxConnectionStringLength, networkType);
+	}
+	else if (g_ingress.IsEnabled()) {
+		bytesRead = ReceiveScheduledMessage(message, maxMessageLength, sourceConnectionString, sourceConnectionStringLength, destinationConnectionString, destinationConnectionStringLength, maxConnectionStringLength, networkType);
+	}
+	else {
+		bytesRead = ReceiveSocketMessage(message, maxMessageLength, sourceConnectionString, sourceConnectionStringLength, destinationConnectionString, destinationConnectionStringLength, maxConnectionStringLength, networkType);
+	}
+
+	if (bytesRead > 0) {
+		g_metrics.Add(METRIC_PACKETS_RECEIVED);
+		g_metrics.Add(METRIC_BYTES_RECEIVED, (uint64_t)bytesRead);
+		g_watchdog.RecordPacket(false, message, (uint16_t)bytesRead);
+		g_serviceTimes.Request(message, (uint16_t)bytesRead, sourceConnectionString, *sourceConnectionStringLength);
+
+		// Process the message as XML
+		static char xmlRenderBuffer[MAX_XML_RENDER_BUFFER_LENGTH];
+		if (g_traceLevel >= TRACE_LEVEL_XML && fpDecodeAsXML((char*)message, bytesRead, xmlRenderBuffer, MAX_XML_RENDER_BUFFER_LENGTH, *networkType) > 0) {
+			std::cout << "---------------------" << std::endl;
+			std::cout << xmlRenderBuffer << std::endl;
+			std::cout << "---------------------" << std::endl;
+			memset(xmlRenderBuffer, 0, MAX_XML_RENDER_BUFFER_LENGTH);
+		}
+
+		// The stack would walk every object to answer nothing
+		if (g_whoHasFilter.Filter(message, (uint16_t)bytesRead, g_database)) {
+			bytesRead = 0;
+		}
+
+		// A ReadProperty answered before is answered again without the stack
+		static uint8_t cachedResponse[RESPONSE_CACHE_MAX_RESPONSE_LENGTH];
+		uint16_t cachedResponseLength;
+		if (bytesRead > 0 && g_responseCache.Request(message, (uint16_t)bytesRead, sourceConnectionString, *sourceConnectionStringLength, cachedResponse, &cachedResponseLength, sizeof(cachedResponse))) {
+			CallbackSendMessage(cachedResponse, cachedResponseLength, sourceConnectionString, *sourceConnectionStringLength, *networkType, false);
+			bytesRead = 0;
+		}
+
+		// Empty polls are not timed, they would hide the messages
+		g_latency.Record(LATENCY_RECEIVE_MESSAGE, CLatencyClock::Now() - startTicks);
+	}
+
+	return bytesRead > 0 ? (uint16_t)bytesRead : 0;
+}
+
+// Reads the next message from the sockets, IPv4 first
+int ReceiveSocketMessage(uint8_t* message, const uint16_t maxMessageLength, uint8_t* sourceConnectionString, uint8_t* sourceConnectionStringLength, uint8_t* destinationConnectionString, uint8_t* destinationConnectionStringLength, const uint8_t maxConnectionStringLength, uint8_t* networkType)
+{
+	uint8_t ipAddress[4];
+	uint16_t port = 0;
+	size_t interfaceIndex = 0;
+
+	// Attempt to read bytes from any of the interfaces. With --shards the
+	// messages for the virtual networks are passed on to the workers here
+	// and the next one is read.
+	int bytesRead = 0;
+	for (int forwarded = 0; forwarded < SHARD_ROUTER_FORWARD_BATCH; forwarded++) {
+		bytesRead = g_udp.GetMessage(message, maxMessageLength, ipAddress, &port, &interfaceIndex);
+		if (bytesRead <= 0 || !g_shards.IsRunning()) {
+			break;
+		}
+		const MultiHomedUDPInterface& ingress = g_udp.GetInterface(interfaceIndex);
+		ShardMessageHeader header;
+		header.networkType = ExampleConstants::NETWORK_TYPE_IP;
+		header.broadcast = 0;
+		header.connectionStringLength = 6;
+		memcpy(header.connectionString, ipAddress, 4);
+		header.connectionString[4] = port / 256;
+		header.connectionString[5] = port % 256;
+		header.destinationConnectionStringLength = 6;
+		memcpy(header.destinationConnectionString, ingress.IPAddress, 4);
+		header.destinationConnectionString[4] = ingress.port / 256;
+		header.destinationConnectionString[5] = ingress.port % 256;
+		if (g_shards.Forward(message, (uint16_t)bytesRead, header)) {
+			break;
+		}
+		bytesRead = 0;
+	}
+	if (bytesRead < 0) {
+		g_metrics.Add(METRIC_SOCKET_ERRORS);
+	}
+	if (bytesRead > 0) {
+		const MultiHomedUDPInterface& ingress = g_udp.GetInterface(interfaceIndex);
+		if (g_traceLevel >= TRACE_LEVEL_MESSAGES) {
+			std::cout << std::endl << "FYI: Received message from [" << (int)ipAddress[0] << "." << (int)ipAddress[1] << "." << (int)ipAddress[2] << "." << (int)ipAddress[3] << ":" << port << "] on interface [" << ingress.name << "], length [" << bytesRead << "]" << std::endl;
+		}
+
+		// Convert the IP Address to the connection string
+		memcpy(sourceConnectionString, ipAddress, 4);
+		sourceConnectionString[4] = port / 256;
+		sourceConnectionString[5] = port % 256;
+
+		*sourceConnectionStringLength = 6;
+		*networkType = ExampleConstants::NETWORK_TYPE_IP;
+
+		// Tag the message with the address of the interface it arrived on
+		if (destinationConnectionString != NULL && destinationConnectionStringLength != NULL) {
+			memcpy(destinationConnectionString, ingress.IPAddress, 4);
+			destinationConnectionString[4] = ingress.port / 256;
+			destinationConnectionString[5] = ingress.port % 256;
+			*destinationConnectionStringLength = 6;
+		}
+
+	}
+	else if (g_udp6.IsConnected() && maxConnectionStringLength >= ExampleConstants::CONNECTION_STRING_LENGTH_IPV6) {
+		// BACnet/IPv6, the connection string is the 16 byte address and the port
+		bytesRead = ReceiveIPv6Message(message, maxMessageLength, sourceConnectionString, &port);
+		if (bytesRead < 0) {
+			g_metrics.Add(METRIC_SOCKET_ERRORS);
+		}
+		if (bytesRead > 0) {
+			if (g_traceLevel >= TRACE_LEVEL_MESSAGES) {
+				std::cout << std::endl << "FYI: Received message from [" << IPv6AddressToString(sourceConnectionString) << "]:" << port << ", length [" << bytesRead << "]" << std::endl;
+			}
+			sourceConnectionString[16] = port / 256;
+			sourceConnectionString[17] = port % 256;
+			*sourceConnectionStringLength = ExampleConstants::CONNECTION_STRING_LENGTH_IPV6;
+			*networkType = ExampleConstants::NETWORK_TYPE_BACNET_IPV6;
+		}
+	}
+
+	return bytesRead;
+}
+
+// Drains the sockets into the ingress scheduler, then hands the stack the
+// next message by priority
+int ReceiveScheduledMessage(uint8_t* message, const uint16_t maxMessageLength, uint8_t* sourceConnectionString, uint8_t* sourceConnectionStringLength, uint8_t* destinationConnectionString, uint8_t* destinationConnectionStringLength, const uint8_t maxConnectionStringLength, uint8_t* networkType)
+{
+	for (int i = 0; i < INGRESS_SCHEDULER_DRAIN_BATCH; i++) {
+		// A buffer of the pool, its handle is queued
+		IngressMessage* received = g_ingress.GetReceiveMessage();
+		if (received == NULL) {
+			break;
+		}
+		int length = ReceiveSocketMessage(received->buffer, sizeof(received->buffer), received->sourceConnectionString, &received->sourceConnectionStringLength, received->destinationConnectionString, &received->destinationConnectionStringLength, sizeof(received->sourceConnectionString), &received->networkType);
+		if (length <= 0) {
+			break;
+		}
+		received->length = (uint16_t)length;
+		if (received->networkType != ExampleConstants::NETWORK_TYPE_IP) {
+			received->destinationConnectionStringLength = 0;
+		}
+		IngressClass shedClass = g_ingress.Enqueue();
+		if (shedClass != INGRESS_CLASS_COUNT) {
+			g_metrics.Add((MetricCounterId)(METRIC_INGRESS_DROPPED_CONFIRMED + shedClass));
+		}
+	}
+
+	const IngressMessage* next = g_ingress.Dequeue();
+	if (next == NULL) {
+		return 0;
 	}
-	case 'h':
-	default: {
-		// Print the Help
-		std::cout << std::endl << std::endl;
-		// Print the application version information 
-		std::cout << "CAS BACnet Stack Virtual Devices and BBMD Example v" << APPLICATION_VERSION << "." << CIBUILDNUMBER << std::endl;
-		std::cout << "https://github.com/chipkin/BACnetVirtualDevicesBBMDExampleCPP" << std::endl << std::endl;
-
-		std::cout << "Help:" << std::endl;
-		std::cout << "h - (h)elp" << std::endl;
-		std::cout << "q - (q)uit" << std::endl;
-		std::cout << std::endl;
-		break;
+	if (next->length > maxMessageLength || next->sourceConnectionStringLength > maxConnectionStringLength) {
+		std::cerr << "Queued message too large, length [" << next->length << "]" << std::endl;
+		return 0;
 	}
+	memcpy(message, next->buffer, next->length);
+	memcpy(sourceConnectionString, next->sourceConnectionString, next->sourceConnectionStringLength);
+	*sourceConnectionStringLength = next->sourceConnectionStringLength;
+	*networkType = next->networkType;
+	if (destinationConnectionString != NULL && destinationConnectionStringLength != NULL && next->destinationConnectionStringLength != 0) {
+		memcpy(destinationConnectionString, next->destinationConnectionString, next->destinationConnectionStringLength);
+		*destinationConnectionStringLength = next->destinationConnectionStringLength;
 	}
-
-	return true;
+	return next->length;
 }
 
-// Callback used by the BACnet Stack to check if there is a message to process
-uint16_t CallbackReceiveMessage(uint8_t* message, const uint16_t maxMessageLength, uint8_t* sourceConnectionString, uint8_t* sourceConnectionStringLength, uint8_t* destinationConnectionString, uint8_t* destinationConnectionStringLength, const uint8_t maxConnectionStringLength, uint8_t* networkType)
+// Reads the next message that the front end forwarded to this shard worker
+int ReceiveShardMessage(uint8_t* message, const uint16_t maxMessageLength, uint8_t* sourceConnectionString, uint8_t* sourceConnectionStringLength, uint8_t* destinationConnectionString, uint8_t* destinationConnectionStringLength, const uint8_t maxConnectionStringLength, uint8_t* networkType)
 {
-	// Check parameters
-	if (message == NULL || maxMessageLength == 0) {
-		std::cerr << "Invalid input buffer" << std::endl;
-		return 0;
+	ShardMessageHeader header;
+	int bytesRead = g_shardWorker.Receive(message, maxMessageLength, &header);
+	if (bytesRead <= 0) {
+		if (bytesRead < 0) {
+			g_metrics.Add(METRIC_SOCKET_ERRORS);
+		}
+		return bytesRead;
 	}
-	if (sourceConnectionString == NULL || maxConnectionStringLength == 0) {
-		std::cerr << "Invalid connection string buffer" << std::endl;
+	if (header.connectionStringLength > maxConnectionStringLength || header.connectionStringLength > SHARD_ROUTER_MAX_CONNECTION_STRING_LENGTH) {
 		return 0;
 	}
-	if (maxConnectionStringLength < 6) {
-		std::cerr << "Not enough space for a UDP connection string" << std::endl;
-		return 0;
+	memcpy(sourceConnectionString, header.connectionString, header.connectionStringLength);
+	*sourceConnectionStringLength = header.connectionStringLength;
+	*networkType = header.networkType;
+	if (destinationConnectionString != NULL && destinationConnectionStringLength != NULL && header.destinationConnectionStringLength != 0 && header.destinationConnectionStringLength <= maxConnectionStringLength) {
+		memcpy(destinationConnectionString, header.destinationConnectionString, header.destinationConnectionStringLength);
+		*destinationConnectionStringLength = header.destinationConnectionStringLength;
 	}
+	return bytesRead;
+}
 
-	char ipAddress[32];
-	uint16_t port = 0;
-
-	// Attempt to read bytes
-	int bytesRead = g_udp.GetMessage(message, maxMessageLength, ipAddress, &port);
-	if (bytesRead > 0) {
-		ChipkinCommon::CEndianness::ToBigEndian(&port, sizeof(uint16_t));
-		std::cout << std::endl << "FYI: Received message from [" << ipAddress << ":" << port << "], length [" << bytesRead << "]" << std::endl;
-
-		// Convert the IP Address to the connection string
-		if (!ChipkinCommon::ChipkinConvert::IPAddressToBytes(ipAddress, sourceConnectionString, maxConnectionStringLength)) {
-			std::cerr << "Failed to convert the ip address into a connectionString" << std::endl;
-			return 0;
+// Sends the messages of the shard workers out of the sockets. Their
+// broadcasts are also forwarded to the other BBMDs of the BDT, like the BBMD
+// of the front end does with its own. Foreign devices are not sent the
+// broadcasts of the workers.
+void SendShardMessages()
+{
+	// Room in front of the message for the longer BVLC of a Forwarded-NPDU
+	const uint16_t FORWARDED_NPDU_EXTRA = 6;
+	static uint8_t buffer[FORWARDED_NPDU_EXTRA + SHARD_ROUTER_MAX_MESSAGE_LENGTH];
+	uint8_t* message = buffer + FORWARDED_NPDU_EXTRA;
+
+	for (int i = 0; i < SHARD_ROUTER_FORWARD_BATCH; i++) {
+		ShardMessageHeader header;
+		int length = g_shards.Receive(message, SHARD_ROUTER_MAX_MESSAGE_LENGTH, &header);
+		if (length <= 0) {
+			break;
 		}
-		sourceConnectionString[4] = port / 256;
-		sourceConnectionString[5] = port % 256;
-
-		*sourceConnectionStringLength = 6;
-		*networkType = ExampleConstants::NETWORK_TYPE_IP;
+		if (header.networkType != ExampleConstants::NETWORK_TYPE_IP || header.connectionStringLength < ExampleConstants::CONNECTION_STRING_LENGTH_IP) {
+			continue;
+		}
+		const uint16_t messageLength = (uint16_t)length;
+		uint16_t port = header.connectionString[4] * 256 + header.connectionString[5];
+		if (g_traceLevel >= TRACE_LEVEL_MESSAGES) {
+			std::cout << std::endl << "FYI: Sending shard message to [" << (int)header.connectionString[0] << "." << (int)header.connectionString[1] << "." << (int)header.connectionString[2] << "." << (int)header.connectionString[3] << ":" << port << "]" << (header.broadcast ? " (broadcast)" : "") << " length [" << messageLength << "]" << std::endl;
+		}
+		g_watchdog.RecordPacket(true, message, messageLength);
+		if (!g_udp.SendTo(header.connectionString, port, message, messageLength, header.broadcast != 0)) {
+			g_metrics.Add(METRIC_SOCKET_ERRORS);
+			continue;
+		}
+		g_metrics.Add(METRIC_PACKETS_SENT);
+		g_metrics.Add(METRIC_BYTES_SENT, messageLength);
+
+		// Original-Broadcast-NPDU to Forwarded-NPDU, from this BBMD. The first
+		// entry of the BDT is this BBMD. A message too short for a BVLC is
+		// not forwarded.
+		if (!header.broadcast || messageLength < ExampleConstants::BVLC_HEADER_LENGTH || message[1] != 0x0B || g_bdtEntries.size() < 2) {
+			continue;
+		}
+		uint8_t* forwarded = message - FORWARDED_NPDU_EXTRA;
+		const uint16_t forwardedLength = messageLength + FORWARDED_NPDU_EXTRA;
+		forwarded[0] = 0x81;
+		forwarded[1] = 0x04;
+		forwarded[2] = (uint8_t)(forwardedLength / 256);
+		forwarded[3] = (uint8_t)(forwardedLength % 256);
+		memcpy(forwarded + 4, &g_bdtEntries[0][0], 6);
+		for (size_t entry = 1; entry < g_bdtEntries.size(); entry++) {
+			// Sent to the BBMD, or to the directed broadcast address of its
+			// subnet for a two hop entry
+			const std::vector<uint8_t>& bdtEntry = g_bdtEntries[entry];
+			uint8_t ipAddress[4];
+			bool directed = false;
+			for (int octet = 0; octet < 4; octet++) {
+				ipAddress[octet] = bdtEntry[octet] | (uint8_t)~bdtEntry[6 + octet];
+				directed = directed || bdtEntry[6 + octet] != 255;
+			}
+			if (!g_udp.SendTo(ipAddress, bdtEntry[4] * 256 + bdtEntry[5], forwarded, forwardedLength, directed)) {
+				g_metrics.Add(METRIC_SOCKET_ERRORS);
+				continue;
+			}
+			g_metrics.Add(METRIC_PACKETS_SENT);
+			g_metrics.Add(METRIC_BYTES_SENT, forwardedLength);
+		}
+	}
+}
 
-		// Process the message as XML
-		static char xmlRenderBuffer[MAX_XML_RENDER_BUFFER_LENGTH];
-		if (fpDecodeAsXML((char*)message, bytesRead, xmlRenderBuffer, MAX_XML_RENDER_BUFFER_LENGTH, ExampleConstants::NETWORK_TYPE_IP) > 0) {
-			std::cout << "---------------------" << std::endl;
-			std::cout << xmlRenderBuffer << std::endl;
-			std::cout << "---------------------" << std::endl;
-			memset(xmlRenderBuffer, 0, MAX_XML_RENDER_BUFFER_LENGTH);
+// Reads the next BACnet/IPv6 message. Datagrams are read from the socket in
+// batches into preallocated buffers and handed to the stack one at a time.
+// Returns -1 on a socket error.
+int ReceiveIPv6Message(uint8_t* message, const uint16_t maxMessageLength, uint8_t* ipAddress, uint16_t* port)
+{
+	static uint8_t buffers[SIMPLE_UDP_MAX_BATCH][MAX_IPV6_DATAGRAM_LENGTH];
+	static SimpleUDPDatagram datagrams[SIMPLE_UDP_MAX_BATCH];
+	static int datagramCount = 0;
+	static int nextDatagram = 0;
+
+	if (nextDatagram >= datagramCount) {
+		for (int i = 0; i < SIMPLE_UDP_MAX_BATCH; i++) {
+			datagrams[i].buffer = buffers[i];
+			datagrams[i].maxLength = MAX_IPV6_DATAGRAM_LENGTH;
+		}
+		nextDatagram = 0;
+		datagramCount = g_udp6.ReceiveBatch(datagrams, SIMPLE_UDP_MAX_BATCH);
+		if (datagramCount <= 0) {
+			// -1 on a socket error
+			int result = datagramCount < 0 ? -1 : 0;
+			datagramCount = 0;
+			return result;
 		}
 	}
 
-	return bytesRead;
+	const SimpleUDPDatagram& datagram = datagrams[nextDatagram++];
+	if (datagram.length > maxMessageLength) {
+		std::cerr << "BACnet/IPv6 message too large, length [" << datagram.length << "]" << std::endl;
+		return 0;
+	}
+	memcpy(message, datagram.buffer, datagram.length);
+	memcpy(ipAddress, datagram.address, 16);
+	*port = datagram.port;
+	return datagram.length;
+}
+
+std::string IPv6AddressToString(const uint8_t* ipAddress)
+{
+	char text[INET6_ADDRSTRLEN];
+	if (inet_ntop(AF_INET6, (void*)ipAddress, text, sizeof(text)) == NULL) {
+		return "";
+	}
+	return text;
 }
 
 // Callback used by the BACnet Stack to send a BACnet message
 uint16_t CallbackSendMessage(const uint8_t* message, const uint16_t messageLength, const uint8_t* connectionString, const uint8_t connectionStringLength, const uint8_t networkType, bool broadcast)
 {
+	CLatencyTimer timer(g_latency, LATENCY_SEND_MESSAGE);
 	if (message == NULL || messageLength == 0) {
 		std::cout << "Nothing to send" << std::endl;
 		return 0;
@@ -431,6 +1973,52 @@ uint16_t CallbackSendMessage(const uint8_t* message, const uint16_t messageLengt
 		std::cout << "No connection string" << std::endl;
 		return 0;
 	}
+	g_watchdog.RecordPacket(true, message, messageLength);
+	if (!broadcast) {
+		g_serviceTimes.Response(message, messageLength, connectionString, connectionStringLength);
+		g_responseCache.Response(message, messageLength, connectionString, connectionStringLength);
+	}
+
+	// A shard worker hands every message to the front end, which sends it
+	if (g_shardWorker.IsOpen()) {
+		ShardMessageHeader header;
+		if (connectionStringLength > SHARD_ROUTER_MAX_CONNECTION_STRING_LENGTH) {
+			return 0;
+		}
+		header.networkType = networkType;
+		header.broadcast = broadcast ? 1 : 0;
+		header.connectionStringLength = connectionStringLength;
+		header.destinationConnectionStringLength = 0;
+		memcpy(header.connectionString, connectionString, connectionStringLength);
+		if (!g_shardWorker.Send(message, messageLength, header)) {
+			g_metrics.Add(METRIC_SOCKET_ERRORS);
+			return 0;
+		}
+		g_metrics.Add(METRIC_PACKETS_SENT);
+		g_metrics.Add(METRIC_BYTES_SENT, messageLength);
+		return messageLength;
+	}
+
+	// BACnet/IPv6, broadcasts go to the BACnet multicast group
+	if (networkType == ExampleConstants::NETWORK_TYPE_BACNET_IPV6) {
+		if (!g_udp6.IsConnected() || connectionStringLength < ExampleConstants::CONNECTION_STRING_LENGTH_IPV6) {
+			std::cout << "Message for different network" << std::endl;
+			return 0;
+		}
+		const uint8_t* ipAddress = broadcast ? BACNET_IPV6_MULTICAST_LINK_LOCAL : connectionString;
+		uint16_t port = connectionString[16] * 256 + connectionString[17];
+		if (g_traceLevel >= TRACE_LEVEL_MESSAGES) {
+			std::cout << std::endl << "FYI: Sending message to [" << IPv6AddressToString(ipAddress) << "]:" << port << " length [" << messageLength << "]" << std::endl;
+		}
+		if (!g_udp6.SendTo(ipAddress, port, message, messageLength)) {
+			std::cout << "Failed to send message" << std::endl;
+			g_metrics.Add(METRIC_SOCKET_ERRORS);
+			return 0;
+		}
+		g_metrics.Add(METRIC_PACKETS_SENT);
+		g_metrics.Add(METRIC_BYTES_SENT, messageLength);
+		return messageLength;
+	}
 
 	// Verify Network Type
 	if (networkType != ExampleConstants::NETWORK_TYPE_IP) {
@@ -438,35 +2026,27 @@ uint16_t CallbackSendMessage(const uint8_t* message, const uint16_t messageLengt
 		return 0;
 	}
 
-	// Prepare the IP Address
-	char ipAddress[32];
-	if (broadcast) {
-		snprintf(ipAddress, 32, "%hhu.%hhu.%hhu.%hhu",
-			connectionString[0] | ~g_database.networkPort.IPSubnetMask[0],
-			connectionString[1] | ~g_database.networkPort.IPSubnetMask[1],
-			connectionString[2] | ~g_database.networkPort.IPSubnetMask[2],
-			connectionString[3] | ~g_database.networkPort.IPSubnetMask[3]);
-	}
-	else {
-		snprintf(ipAddress, 32, "%u.%u.%u.%u", connectionString[0], connectionString[1], connectionString[2], connectionString[3]);
-	}
-
 	// Get the port
 	uint16_t port = 0;
 	port += connectionString[4] * 256;
 	port += connectionString[5];
 
-	std::cout << std::endl << "FYI: Sending message to [" << ipAddress << ":" << port << "] length [" << messageLength << "]" << std::endl;
+	if (g_traceLevel >= TRACE_LEVEL_MESSAGES) {
+		std::cout << std::endl << "FYI: Sending message to [" << (int)connectionString[0] << "." << (int)connectionString[1] << "." << (int)connectionString[2] << "." << (int)connectionString[3] << ":" << port << "]" << (broadcast ? " (broadcast)" : "") << " on interface [" << g_udp.GetInterface(g_udp.Route(connectionString)).name << "] length [" << messageLength << "]" << std::endl;
+	}
 
-	// Send the message
-	if (!g_udp.SendMessage(ipAddress, port, (unsigned char*)message, messageLength)) {
+	// Send the message out of the interface that can reach the destination
+	if (!g_udp.SendTo(connectionString, port, message, messageLength, broadcast)) {
 		std::cout << "Failed to send message" << std::endl;
+		g_metrics.Add(METRIC_SOCKET_ERRORS);
 		return 0;
 	}
+	g_metrics.Add(METRIC_PACKETS_SENT);
+	g_metrics.Add(METRIC_BYTES_SENT, messageLength);
 
 	// Get the XML rendered version of the just sent message
 	static char xmlRenderBuffer[MAX_XML_RENDER_BUFFER_LENGTH];
-	if (fpDecodeAsXML((char*)message, messageLength, xmlRenderBuffer, MAX_XML_RENDER_BUFFER_LENGTH, ExampleConstants::NETWORK_TYPE_IP) > 0) {
+	if (g_traceLevel >= TRACE_LEVEL_XML && fpDecodeAsXML((char*)message, messageLength, xmlRenderBuffer, MAX_XML_RENDER_BUFFER_LENGTH, ExampleConstants::NETWORK_TYPE_IP) > 0) {
 		std::cout << xmlRenderBuffer << std::endl;
 		memset(xmlRenderBuffer, 0, MAX_XML_RENDER_BUFFER_LENGTH);
 	}
@@ -480,8 +2060,64 @@ time_t CallbackGetSystemTime()
 	return time(0);
 }
 
-// Callback used by the BACnet Stack to get Character String property values from the user
+// The Get Property callbacks time the lookup and count every read by value
+// type, and the reads that could not be answered. The response cache learns
+// which requests were answered from the database.
 bool CallbackGetPropertyCharString(const uint32_t deviceInstance, const uint16_t objectType, const uint32_t objectInstance, const uint32_t propertyIdentifier, char* value, uint32_t* valueElementCount, const uint32_t maxElementCount, uint8_t* encodingType, const bool useArrayIndex, const uint32_t propertyArrayIndex)
+{
+	CLatencyTimer timer(g_latency, LATENCY_GET_PROPERTY_CHARACTER_STRING);
+	bool answered = GetPropertyCharString(deviceInstance, objectType, objectInstance, propertyIdentifier, value, valueElementCount, maxElementCount, encodingType, useArrayIndex, propertyArrayIndex);
+	g_metrics.PropertyRead(METRIC_PROPERTY_CHARACTER_STRING, answered);
+	g_responseCache.PropertyRead(deviceInstance, objectType, objectInstance, propertyIdentifier, answered && g_database.IsChangeTracked(objectType, propertyIdentifier));
+	return answered;
+}
+
+bool CallbackGetPropertyEnum(const uint32_t deviceInstance, const uint16_t objectType, const uint32_t objectInstance, const uint32_t propertyIdentifier, uint32_t* value, const bool useArrayIndex, const uint32_t propertyArrayIndex)
+{
+	CLatencyTimer timer(g_latency, LATENCY_GET_PROPERTY_ENUMERATED);
+	bool answered = GetPropertyEnum(deviceInstance, objectType, objectInstance, propertyIdentifier, value, useArrayIndex, propertyArrayIndex);
+	g_metrics.PropertyRead(METRIC_PROPERTY_ENUMERATED, answered);
+	g_responseCache.PropertyRead(deviceInstance, objectType, objectInstance, propertyIdentifier, answered && g_database.IsChangeTracked(objectType, propertyIdentifier));
+	return answered;
+}
+
+bool CallbackGetPropertyOctetString(const uint32_t deviceInstance, const uint16_t objectType, const uint32_t objectInstance, const uint32_t propertyIdentifier, uint8_t* value, uint32_t* valueElementCount, const uint32_t maxElementCount, const bool useArrayIndex, const uint32_t propertyArrayIndex)
+{
+	CLatencyTimer timer(g_latency, LATENCY_GET_PROPERTY_OCTET_STRING);
+	bool answered = GetPropertyOctetString(deviceInstance, objectType, objectInstance, propertyIdentifier, value, valueElementCount, maxElementCount, useArrayIndex, propertyArrayIndex);
+	g_metrics.PropertyRead(METRIC_PROPERTY_OCTET_STRING, answered);
+	return answered;
+}
+
+bool CallbackGetPropertyReal(const uint32_t deviceInstance, const uint16_t objectType, const uint32_t objectInstance, const uint32_t propertyIdentifier, float* value, const bool useArrayIndex, const uint32_t propertyArrayIndex)
+{
+	CLatencyTimer timer(g_latency, LATENCY_GET_PROPERTY_REAL);
+	bool answered = GetPropertyReal(deviceInstance, objectType, objectInstance, propertyIdentifier, value, useArrayIndex, propertyArrayIndex);
+	g_metrics.PropertyRead(METRIC_PROPERTY_REAL, answered);
+	g_responseCache.PropertyRead(deviceInstance, objectType, objectInstance, propertyIdentifier, answered && g_database.IsChangeTracked(objectType, propertyIdentifier));
+	return answered;
+}
+
+bool CallbackGetPropertyUInt(const uint32_t deviceInstance, const uint16_t objectType, const uint32_t objectInstance, const uint32_t propertyIdentifier, uint32_t* value, const bool useArrayIndex, const uint32_t propertyArrayIndex)
+{
+	CLatencyTimer timer(g_latency, LATENCY_GET_PROPERTY_UNSIGNED);
+	bool answered = GetPropertyUInt(deviceInstance, objectType, objectInstance, propertyIdentifier, value, useArrayIndex, propertyArrayIndex);
+	g_metrics.PropertyRead(METRIC_PROPERTY_UNSIGNED, answered);
+	g_responseCache.PropertyRead(deviceInstance, objectType, objectInstance, propertyIdentifier, answered && g_database.IsChangeTracked(objectType, propertyIdentifier));
+	return answered;
+}
+
+bool CallbackGetPropertyBool(const uint32_t deviceInstance, const uint16_t objectType, const uint32_t objectInstance, const uint32_t propertyIdentifier, bool* value, const bool useArrayIndex, const uint32_t propertyArrayIndex)
+{
+	CLatencyTimer timer(g_latency, LATENCY_GET_PROPERTY_BOOLEAN);
+	bool answered = GetPropertyBool(deviceInstance, objectType, objectInstance, propertyIdentifier, value, useArrayIndex, propertyArrayIndex);
+	g_metrics.PropertyRead(METRIC_PROPERTY_BOOLEAN, answered);
+	g_responseCache.PropertyRead(deviceInstance, objectType, objectInstance, propertyIdentifier, answered && g_database.IsChangeTracked(objectType, propertyIdentifier));
+	return answered;
+}
+
+// Gets Character String property values from the user
+bool GetPropertyCharString(const uint32_t deviceInstance, const uint16_t objectType, const uint32_t objectInstance, const uint32_t propertyIdentifier, char* value, uint32_t* valueElementCount, const uint32_t maxElementCount, uint8_t* encodingType, const bool useArrayIndex, const uint32_t propertyArrayIndex)
 {
 	// Example of Object Name property
 	if (propertyIdentifier == ExampleConstants::PROPERTY_IDENTIFIER_OBJECT_NAME) {
@@ -494,18 +2130,46 @@ bool CallbackGetPropertyCharString(const uint32_t deviceInstance, const uint16_t
 	return false;
 }
 
-// Callback used by the BACnet Stack to get Enumerated property values from the user
-bool CallbackGetPropertyEnum(uint32_t deviceInstance, uint16_t objectType, uint32_t objectInstance, uint32_t propertyIdentifier, uint32_t* value, bool useArrayIndex, uint32_t propertyArrayIndex)
+// Gets Enumerated property values from the user
+bool GetPropertyEnum(uint32_t deviceInstance, uint16_t objectType, uint32_t objectInstance, uint32_t propertyIdentifier, uint32_t* value, bool useArrayIndex, uint32_t propertyArrayIndex)
 {
+	// Objects kept in the object stores
+	if (g_database.GetObjectPropertyEnum(deviceInstance, objectType, objectInstance, propertyIdentifier, value)) {
+		return true;
+	}
+
 	// Example of Analog Inputs Reliability Property
 	if (propertyIdentifier == ExampleConstants::PROPERTY_IDENTIFIER_RELIABILITY) {
 		if (objectType == ExampleConstants::OBJECT_TYPE_ANALOG_INPUT) {
-			if (g_database.analogInputs.count(deviceInstance) > 0 && g_database.analogInputs[deviceInstance].instance == objectInstance) {
-				*value = g_database.analogInputs[deviceInstance].reliability;
-				return true;
-			}
+			return g_database.GetAnalogInputReliability(deviceInstance, objectInstance, value);
+		}
+	}
+
+	// Example of Binary Output Present Value, Priority Array and Relinquish Default properties
+	if (objectType == ExampleConstants::OBJECT_TYPE_BINARY_OUTPUT) {
+		ExampleDatabaseBinaryOutput* binaryOutput = g_database.FindBinaryOutput(deviceInstance, objectInstance);
+		if (binaryOutput == NULL) {
 			return false;
 		}
+		if (propertyIdentifier == ExampleConstants::PROPERTY_IDENTIFIER_PRESENT_VALUE) {
+			*value = binaryOutput->priorityArray.GetPresentValue();
+			return true;
+		}
+		else if (propertyIdentifier == ExampleConstants::PROPERTY_IDENTIFIER_RELINQUISH_DEFAULT) {
+			*value = binaryOutput->priorityArray.GetRelinquishDefault();
+			return true;
+		}
+		else if (propertyIdentifier == ExampleConstants::PROPERTY_IDENTIFIER_PRIORITY_ARRAY && useArrayIndex) {
+			// An empty slot is NULL. The index is checked before it is narrowed,
+			// index 257 is not priority 1.
+			uint8_t slot;
+			if (propertyArrayIndex > ExampleDatabaseBaseObject::PRIORITY_ARRAY_LENGTH || !binaryOutput->priorityArray.Get((uint8_t)propertyArrayIndex, &slot)) {
+				return false;
+			}
+			*value = slot;
+			return true;
+		}
+		return false;
 	}
 
 	// Example of System Status
@@ -517,18 +2181,7 @@ bool CallbackGetPropertyEnum(uint32_t deviceInstance, uint16_t objectType, uint3
 			return true;
 		}
 		else {
-			std::map<uint16_t, std::vector<ExampleDatabaseDevice> >::iterator it;
-			for (it = g_database.virtualDevices.begin(); it != g_database.virtualDevices.end(); ++it) {
-				std::vector<ExampleDatabaseDevice>::iterator devIt;
-				for (devIt = it->second.begin(); devIt != it->second.end(); ++devIt) {
-
-					if (objectType == devIt->instance) {
-						*value = devIt->systemStatus;
-						return true;
-					}
-				}
-			}
-			return false;
+			return g_database.GetVirtualDeviceSystemStatus(objectInstance, value);
 		}
 	}
 
@@ -536,41 +2189,47 @@ bool CallbackGetPropertyEnum(uint32_t deviceInstance, uint16_t objectType, uint3
 	return false;
 }
 
-// Callback used by the BACnet Stack to get OctetString property values from the user
-bool CallbackGetPropertyOctetString(const uint32_t deviceInstance, const uint16_t objectType, const uint32_t objectInstance, const uint32_t propertyIdentifier, uint8_t* value, uint32_t* valueElementCount, const uint32_t maxElementCount, const bool useArrayIndex, const uint32_t propertyArrayIndex)
+// Gets OctetString property values from the user
+bool GetPropertyOctetString(const uint32_t deviceInstance, const uint16_t objectType, const uint32_t objectInstance, const uint32_t propertyIdentifier, uint8_t* value, uint32_t* valueElementCount, const uint32_t maxElementCount, const bool useArrayIndex, const uint32_t propertyArrayIndex)
 {
+	// Network Port Objects belong to the main device
+	ExampleDatabaseNetworkPort* networkPort = NULL;
+	if (objectType == ExampleConstants::OBJECT_TYPE_NETWORK_PORT && deviceInstance == g_database.mainDevice.instance) {
+		networkPort = g_database.FindNetworkPort(objectInstance);
+	}
+
 	// Example of Network Port Object IP Address property
 	if (propertyIdentifier == ExampleConstants::PROPERTY_IDENTIFIER_IP_ADDRESS) {
-		if (objectType == ExampleConstants::OBJECT_TYPE_NETWORK_PORT && objectInstance == g_database.networkPort.instance) {
-			memcpy(value, g_database.networkPort.IPAddress, g_database.networkPort.IPAddressLength);
-			*valueElementCount = g_database.networkPort.IPAddressLength;
+		if (networkPort != NULL) {
+			memcpy(value, networkPort->IPAddress, networkPort->IPAddressLength);
+			*valueElementCount = networkPort->IPAddressLength;
 			return true;
 		}
 	}
 	// Example of Network Port Object IP Default Gateway property
 	else if (propertyIdentifier == ExampleConstants::PROPERTY_IDENTIFIER_IP_DEFAULT_GATEWAY) {
-		if (objectType == ExampleConstants::OBJECT_TYPE_NETWORK_PORT && objectInstance == g_database.networkPort.instance) {
-			memcpy(value, g_database.networkPort.IPDefaultGateway, g_database.networkPort.IPDefaultGatewayLength);
-			*valueElementCount = g_database.networkPort.IPDefaultGatewayLength;
+		if (networkPort != NULL) {
+			memcpy(value, networkPort->IPDefaultGateway, networkPort->IPDefaultGatewayLength);
+			*valueElementCount = networkPort->IPDefaultGatewayLength;
 			return true;
 		}
 	}
 	// Example of Network Port Object IP Subnet Mask property
 	else if (propertyIdentifier == ExampleConstants::PROPERTY_IDENTIFIER_IP_SUBNET_MASK) {
-		if (objectType == ExampleConstants::OBJECT_TYPE_NETWORK_PORT && objectInstance == g_database.networkPort.instance) {
-			memcpy(value, g_database.networkPort.IPSubnetMask, g_database.networkPort.IPSubnetMaskLength);
-			*valueElementCount = g_database.networkPort.IPSubnetMaskLength;
+		if (networkPort != NULL) {
+			memcpy(value, networkPort->IPSubnetMask, networkPort->IPSubnetMaskLength);
+			*valueElementCount = networkPort->IPSubnetMaskLength;
 			return true;
 		}
 	}
 	// Example of Network Port Object IP DNS Server property
 	else if (propertyIdentifier == ExampleConstants::PROPERTY_IDENTIFIER_IP_DNS_SERVER) {
-		if (objectType == ExampleConstants::OBJECT_TYPE_NETWORK_PORT && objectInstance == g_database.networkPort.instance) {
+		if (networkPort != NULL) {
 			// The IP DNS Server property is an array of DNS Server addresses
 			if (useArrayIndex) {
-				if (propertyArrayIndex != 0 && propertyArrayIndex <= g_database.networkPort.IPDNSServers.size()) {
-					memcpy(value, g_database.networkPort.IPDNSServers[propertyArrayIndex - 1], g_database.networkPort.IPDNSServerLength);
-					*valueElementCount = g_database.networkPort.IPDNSServerLength;
+				if (propertyArrayIndex != 0 && propertyArrayIndex <= networkPort->IPDNSServers.size()) {
+					memcpy(value, networkPort->IPDNSServers[propertyArrayIndex - 1].data(), networkPort->IPDNSServerLength);
+					*valueElementCount = networkPort->IPDNSServerLength;
 					return true;
 				}
 			}
@@ -579,30 +2238,74 @@ bool CallbackGetPropertyOctetString(const uint32_t deviceInstance, const uint16_
 	return false;
 }
 
-// Callback used by the BACnet Stack to get Real property values from the user
-bool CallbackGetPropertyReal(uint32_t deviceInstance, uint16_t objectType, uint32_t objectInstance, uint32_t propertyIdentifier, float* value, bool useArrayIndex, uint32_t propertyArrayIndex)
+// Gets Real property values from the user
+bool GetPropertyReal(uint32_t deviceInstance, uint16_t objectType, uint32_t objectInstance, uint32_t propertyIdentifier, float* value, bool useArrayIndex, uint32_t propertyArrayIndex)
 {
+	// Objects kept in the object stores
+	if (g_database.GetObjectPropertyReal(deviceInstance, objectType, objectInstance, propertyIdentifier, value)) {
+		return true;
+	}
+
 	// Example of Analog Input / Value Object Present Value property
 	if (propertyIdentifier == ExampleConstants::PROPERTY_IDENTIFIER_PRESENT_VALUE) {
 		if (objectType == ExampleConstants::OBJECT_TYPE_ANALOG_INPUT) {
-			if (g_database.analogInputs.count(deviceInstance) > 0 && g_database.analogInputs[deviceInstance].instance == objectInstance) {
-				*value = g_database.analogInputs[deviceInstance].presentValue;
-				return true;
-			}
+			return g_database.GetAnalogInputPresentValue(deviceInstance, objectInstance, value);
+		}
+	}
+
+	// Example of Analog Output Present Value, Priority Array and Relinquish Default properties
+	if (objectType == ExampleConstants::OBJECT_TYPE_ANALOG_OUTPUT) {
+		ExampleDatabaseAnalogOutput* analogOutput = g_database.FindAnalogOutput(deviceInstance, objectInstance);
+		if (analogOutput == NULL) {
 			return false;
 		}
+		if (propertyIdentifier == ExampleConstants::PROPERTY_IDENTIFIER_PRESENT_VALUE) {
+			*value = analogOutput->priorityArray.GetPresentValue();
+			return true;
+		}
+		else if (propertyIdentifier == ExampleConstants::PROPERTY_IDENTIFIER_RELINQUISH_DEFAULT) {
+			*value = analogOutput->priorityArray.GetRelinquishDefault();
+			return true;
+		}
+		else if (propertyIdentifier == ExampleConstants::PROPERTY_IDENTIFIER_PRIORITY_ARRAY && useArrayIndex) {
+			// An empty slot is NULL. The index is checked before it is narrowed,
+			// like the Binary Output.
+			if (propertyArrayIndex > ExampleDatabaseBaseObject::PRIORITY_ARRAY_LENGTH) {
+				return false;
+			}
+			return analogOutput->priorityArray.Get((uint8_t)propertyArrayIndex, value);
+		}
 	}
 
 	return false;
 }
 
-// Callback used by the BACnet Stack to get Unsigned Integer property values from the user
-bool CallbackGetPropertyUInt(uint32_t deviceInstance, uint16_t objectType, uint32_t objectInstance, uint32_t propertyIdentifier, uint32_t* value, bool useArrayIndex, uint32_t propertyArrayIndex)
+// Gets Unsigned Integer property values from the user
+bool GetPropertyUInt(uint32_t deviceInstance, uint16_t objectType, uint32_t objectInstance, uint32_t propertyIdentifier, uint32_t* value, bool useArrayIndex, uint32_t propertyArrayIndex)
 {
+	// Objects kept in the object stores
+	if (g_database.GetObjectPropertyUInt(deviceInstance, objectType, objectInstance, propertyIdentifier, value)) {
+		return true;
+	}
+
+	// Network Port Objects belong to the main device
+	ExampleDatabaseNetworkPort* networkPort = NULL;
+	if (objectType == ExampleConstants::OBJECT_TYPE_NETWORK_PORT && deviceInstance == g_database.mainDevice.instance) {
+		networkPort = g_database.FindNetworkPort(objectInstance);
+	}
+
 	// Example of Network Port Object BACnet IP UDP Port property
 	if (propertyIdentifier == ExampleConstants::PROPERTY_IDENTIFIER_BACNET_IP_UDP_PORT) {
-		if (objectType == ExampleConstants::OBJECT_TYPE_NETWORK_PORT && objectInstance == g_database.networkPort.instance) {
-			*value = g_database.networkPort.BACnetIPUDPPort;
+		if (networkPort != NULL) {
+			*value = networkPort->BACnetIPUDPPort;
+			return true;
+		}
+	}
+	// Priority Array size of the commandable outputs
+	else if (propertyIdentifier == ExampleConstants::PROPERTY_IDENTIFIER_PRIORITY_ARRAY && useArrayIndex && propertyArrayIndex == 0) {
+		if ((objectType == ExampleConstants::OBJECT_TYPE_ANALOG_OUTPUT && g_database.FindAnalogOutput(deviceInstance, objectInstance) != NULL) ||
+			(objectType == ExampleConstants::OBJECT_TYPE_BINARY_OUTPUT && g_database.FindBinaryOutput(deviceInstance, objectInstance) != NULL)) {
+			*value = ExampleDatabaseBaseObject::PRIORITY_ARRAY_LENGTH;
 			return true;
 		}
 	}
@@ -610,9 +2313,9 @@ bool CallbackGetPropertyUInt(uint32_t deviceInstance, uint16_t objectType, uint3
 	// Any properties that are an array must have an entry here for the array size.
 	// The array size is provided only if the useArrayIndex parameter is set to true and the propertyArrayIndex is zero.
 	else if (propertyIdentifier == ExampleConstants::PROPERTY_IDENTIFIER_IP_DNS_SERVER) {
-		if (objectType == ExampleConstants::OBJECT_TYPE_NETWORK_PORT && objectInstance == g_database.networkPort.instance) {
+		if (networkPort != NULL) {
 			if (useArrayIndex && propertyArrayIndex == 0) {
-				*value = (uint32_t)g_database.networkPort.IPDNSServers.size();
+				*value = (uint32_t)networkPort->IPDNSServers.size();
 				return true;
 			}
 		}
@@ -621,63 +2324,240 @@ bool CallbackGetPropertyUInt(uint32_t deviceInstance, uint16_t objectType, uint3
 	return false;
 }
 
-// Gets the object name based on the provided parameters
-bool GetObjectName(const uint32_t deviceInstance, const uint16_t objectType, const uint32_t objectInstance, char* value, uint32_t* valueElementCount, const uint32_t maxElementCount)
+// Gets Boolean property values from the user
+bool GetPropertyBool(const uint32_t deviceInstance, const uint16_t objectType, const uint32_t objectInstance, const uint32_t propertyIdentifier, bool* value, const bool useArrayIndex, const uint32_t propertyArrayIndex)
 {
-	size_t stringSize = 0;
-	if (objectType == ExampleConstants::OBJECT_TYPE_DEVICE && objectInstance == g_database.mainDevice.instance) {
-		// Get the name of the main device
-		stringSize = g_database.mainDevice.objectName.size();
-		if (stringSize > maxElementCount) {
-			std::cerr << "Error - not enough space to store full name of objectType=[" << objectType << "], objectInstance=[" << objectInstance << " ]" << std::endl;
+	// Example of the Out Of Service property of the objects in the object stores
+	return g_database.GetObjectPropertyBool(deviceInstance, objectType, objectInstance, propertyIdentifier, value);
+}
+
+// Callback used by the BACnet Stack to set Real property values. The value is
+// stored in the database right away and queued for the backend, the write is
+// acknowledged without waiting for the backend.
+bool CallbackSetPropertyReal(const uint32_t deviceInstance, const uint16_t objectType, const uint32_t objectInstance, const uint32_t propertyIdentifier, const float value, const bool useArrayIndex, const uint32_t propertyArrayIndex, const uint8_t priority, uint32_t* errorCode)
+{
+	CLatencyTimer timer(g_latency, LATENCY_SET_PROPERTY_REAL);
+	std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+
+	// Example of Analog Output Present Value property, commanded at a priority
+	if (propertyIdentifier == ExampleConstants::PROPERTY_IDENTIFIER_PRESENT_VALUE && objectType == ExampleConstants::OBJECT_TYPE_ANALOG_OUTPUT) {
+		ExampleDatabaseAnalogOutput* analogOutput = g_database.FindAnalogOutput(deviceInstance, objectInstance);
+		if (analogOutput == NULL) {
 			return false;
 		}
-		memcpy(value, g_database.mainDevice.objectName.c_str(), stringSize);
-		*valueElementCount = (uint32_t)stringSize;
+		if (priority < 1 || priority > ExampleDatabaseBaseObject::PRIORITY_ARRAY_LENGTH) {
+			*errorCode = ExampleConstants::ERROR_VALUE_OUT_OF_RANGE;
+			return false;
+		}
+		// The backend receives the new present value, which is not the written
+		// value if a higher priority is set. The slot is restored if the
+		// backend queue is full.
+		float previousValue;
+		const bool wasSet = analogOutput->priorityArray.Get(priority, &previousValue);
+		analogOutput->priorityArray.Set(priority, value);
+		if (!QueueBackendWrite(deviceInstance, objectType, objectInstance, propertyIdentifier, analogOutput->priorityArray.GetPresentValue(), priority, start, errorCode)) {
+			if (wasSet) {
+				analogOutput->priorityArray.Set(priority, previousValue);
+			}
+			else {
+				analogOutput->priorityArray.Relinquish(priority);
+			}
+			return false;
+		}
+		g_database.ObjectChanged(deviceInstance, objectType, objectInstance);
 		return true;
 	}
-	else if (objectType == ExampleConstants::OBJECT_TYPE_NETWORK_PORT && objectInstance == g_database.networkPort.instance && deviceInstance == g_database.mainDevice.instance) {
-		// Get the name of the main ipv4 Network Port Object
-		stringSize = g_database.networkPort.objectName.size();
-		if (stringSize > maxElementCount) {
-			std::cerr << "Error - not enough space to store full name of objectType=[" << objectType << "], objectInstance=[" << objectInstance << " ]" << std::endl;
+
+	// Objects kept in the object stores. The previous value is restored if the
+	// backend queue is full.
+	float previousValue;
+	bool valueIsValid;
+	if (g_database.GetObjectPropertyReal(deviceInstance, objectType, objectInstance, propertyIdentifier, &previousValue)) {
+		if (!g_database.SetObjectPropertyReal(deviceInstance, objectType, objectInstance, propertyIdentifier, value, &valueIsValid)) {
+			if (!valueIsValid) {
+				*errorCode = ExampleConstants::ERROR_VALUE_OUT_OF_RANGE;
+			}
+			return false;
+		}
+		if (!QueueBackendWrite(deviceInstance, objectType, objectInstance, propertyIdentifier, value, priority, start, errorCode)) {
+			g_database.SetObjectPropertyReal(deviceInstance, objectType, objectInstance, propertyIdentifier, previousValue, &valueIsValid);
 			return false;
 		}
-		memcpy(value, g_database.networkPort.objectName.c_str(), stringSize);
-		*valueElementCount = (uint32_t)stringSize;
 		return true;
 	}
-	else if (objectType == ExampleConstants::OBJECT_TYPE_DEVICE) {
-		// Get the name of a virtual device
-		std::map<uint16_t, std::vector<ExampleDatabaseDevice> >::iterator it;
-		for (it = g_database.virtualDevices.begin(); it != g_database.virtualDevices.end(); ++it) {
-			std::vector<ExampleDatabaseDevice>::iterator devIt;
-			for (devIt = it->second.begin(); devIt != it->second.end(); ++devIt) {
-				if (objectInstance == devIt->instance) {
-					stringSize = devIt->objectName.size();
-					if (stringSize > maxElementCount) {
-						std::cerr << "Error - not enough space to store full name of objectType=[" << objectType << "], objectInstance=[" << objectInstance << " ]" << std::endl;
-						return false;
-					}
-					memcpy(value, devIt->objectName.c_str(), stringSize);
-					*valueElementCount = (uint32_t)stringSize;
-					return true;
-				}
+
+	return false;
+}
+
+// Callback used by the BACnet Stack to set Enumerated property values
+bool CallbackSetPropertyEnum(const uint32_t deviceInstance, const uint16_t objectType, const uint32_t objectInstance, const uint32_t propertyIdentifier, const uint32_t value, const bool useArrayIndex, const uint32_t propertyArrayIndex, const uint8_t priority, uint32_t* errorCode)
+{
+	CLatencyTimer timer(g_latency, LATENCY_SET_PROPERTY_ENUMERATED);
+	std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+
+	// Example of Binary Output Present Value property, commanded at a priority
+	if (propertyIdentifier == ExampleConstants::PROPERTY_IDENTIFIER_PRESENT_VALUE && objectType == ExampleConstants::OBJECT_TYPE_BINARY_OUTPUT) {
+		ExampleDatabaseBinaryOutput* binaryOutput = g_database.FindBinaryOutput(deviceInstance, objectInstance);
+		if (binaryOutput == NULL) {
+			return false;
+		}
+		if (value > 1 || priority < 1 || priority > ExampleDatabaseBaseObject::PRIORITY_ARRAY_LENGTH) {
+			*errorCode = ExampleConstants::ERROR_VALUE_OUT_OF_RANGE;
+			return false;
+		}
+		// The backend receives the new present value, like the Analog Output
+		uint8_t previousValue;
+		const bool wasSet = binaryOutput->priorityArray.Get(priority, &previousValue);
+		binaryOutput->priorityArray.Set(priority, (uint8_t)value);
+		if (!QueueBackendWrite(deviceInstance, objectType, objectInstance, propertyIdentifier, (float)binaryOutput->priorityArray.GetPresentValue(), priority, start, errorCode)) {
+			if (wasSet) {
+				binaryOutput->priorityArray.Set(priority, previousValue);
+			}
+			else {
+				binaryOutput->priorityArray.Relinquish(priority);
 			}
+			return false;
 		}
+		g_database.ObjectChanged(deviceInstance, objectType, objectInstance);
+		return true;
 	}
-	else if (objectType == ExampleConstants::OBJECT_TYPE_ANALOG_INPUT) {
-		// Get the name of an analog input
-		if (g_database.analogInputs.count(deviceInstance) > 0 && g_database.analogInputs[deviceInstance].instance == objectInstance) {
-			stringSize = g_database.analogInputs[deviceInstance].objectName.size();
-			if (stringSize > maxElementCount) {
-				std::cerr << "Error - not enough space to store full name of objectType=[" << objectType << "], objectInstance=[" << objectInstance << " ]" << std::endl;
-				return false;
+
+	// Objects kept in the object stores
+	uint32_t previousValue;
+	bool valueIsValid;
+	if (g_database.GetObjectPropertyEnum(deviceInstance, objectType, objectInstance, propertyIdentifier, &previousValue)) {
+		if (!g_database.SetObjectPropertyEnum(deviceInstance, objectType, objectInstance, propertyIdentifier, value, &valueIsValid)) {
+			if (!valueIsValid) {
+				*errorCode = ExampleConstants::ERROR_VALUE_OUT_OF_RANGE;
 			}
-			memcpy(value, g_database.analogInputs[deviceInstance].objectName.c_str(), stringSize);
-			*valueElementCount = (uint32_t)stringSize;
-			return true;
+			return false;
+		}
+		if (!QueueBackendWrite(deviceInstance, objectType, objectInstance, propertyIdentifier, (float)value, priority, start, errorCode)) {
+			g_database.SetObjectPropertyEnum(deviceInstance, objectType, objectInstance, propertyIdentifier, previousValue, &valueIsValid);
+			return false;
+		}
+		return true;
+	}
+
+	return false;
+}
+
+// Callback used by the BACnet Stack to set Unsigned Integer property values
+bool CallbackSetPropertyUInt(const uint32_t deviceInstance, const uint16_t objectType, const uint32_t objectInstance, const uint32_t propertyIdentifier, const uint32_t value, const bool useArrayIndex, const uint32_t propertyArrayIndex, const uint8_t priority, uint32_t* errorCode)
+{
+	CLatencyTimer timer(g_latency, LATENCY_SET_PROPERTY_UNSIGNED);
+	std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+
+	// Example of Multi-State Value Present Value property, the value must be
+	// one of the states
+	uint32_t previousValue;
+	bool valueIsValid;
+	if (!g_database.GetObjectPropertyUInt(deviceInstance, objectType, objectInstance, propertyIdentifier, &previousValue)) {
+		return false;
+	}
+	if (!g_database.SetObjectPropertyUInt(deviceInstance, objectType, objectInstance, propertyIdentifier, value, &valueIsValid)) {
+		if (!valueIsValid) {
+			*errorCode = ExampleConstants::ERROR_VALUE_OUT_OF_RANGE;
+		}
+		return false;
+	}
+	if (!QueueBackendWrite(deviceInstance, objectType, objectInstance, propertyIdentifier, (float)value, priority, start, errorCode)) {
+		g_database.SetObjectPropertyUInt(deviceInstance, objectType, objectInstance, propertyIdentifier, previousValue, &valueIsValid);
+		return false;
+	}
+	return true;
+}
+
+// Callback used by the BACnet Stack when NULL is written. For the commandable
+// outputs this relinquishes the priority.
+bool CallbackSetPropertyNull(const uint32_t deviceInstance, const uint16_t objectType, const uint32_t objectInstance, const uint32_t propertyIdentifier, const bool useArrayIndex, const uint32_t propertyArrayIndex, const uint8_t priority, uint32_t* errorCode)
+{
+	CLatencyTimer timer(g_latency, LATENCY_SET_PROPERTY_NULL);
+	if (propertyIdentifier != ExampleConstants::PROPERTY_IDENTIFIER_PRESENT_VALUE) {
+		return false;
+	}
+	if (priority < 1 || priority > ExampleDatabaseBaseObject::PRIORITY_ARRAY_LENGTH) {
+		*errorCode = ExampleConstants::ERROR_VALUE_OUT_OF_RANGE;
+		return false;
+	}
+
+	std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+	if (objectType == ExampleConstants::OBJECT_TYPE_ANALOG_OUTPUT) {
+		ExampleDatabaseAnalogOutput* analogOutput = g_database.FindAnalogOutput(deviceInstance, objectInstance);
+		if (analogOutput == NULL) {
+			return false;
+		}
+		// The backend receives the new winning value. The slot is restored
+		// if the backend queue is full.
+		float previousValue;
+		const bool wasSet = analogOutput->priorityArray.Get(priority, &previousValue);
+		analogOutput->priorityArray.Relinquish(priority);
+		if (!QueueBackendWrite(deviceInstance, objectType, objectInstance, propertyIdentifier, analogOutput->priorityArray.GetPresentValue(), priority, start, errorCode)) {
+			if (wasSet) {
+				analogOutput->priorityArray.Set(priority, previousValue);
+			}
+			return false;
+		}
+		g_database.ObjectChanged(deviceInstance, objectType, objectInstance);
+	}
+	else if (objectType == ExampleConstants::OBJECT_TYPE_BINARY_OUTPUT) {
+		ExampleDatabaseBinaryOutput* binaryOutput = g_database.FindBinaryOutput(deviceInstance, objectInstance);
+		if (binaryOutput == NULL) {
+			return false;
+		}
+		uint8_t previousValue;
+		const bool wasSet = binaryOutput->priorityArray.Get(priority, &previousValue);
+		binaryOutput->priorityArray.Relinquish(priority);
+		if (!QueueBackendWrite(deviceInstance, objectType, objectInstance, propertyIdentifier, (float)binaryOutput->priorityArray.GetPresentValue(), priority, start, errorCode)) {
+			if (wasSet) {
+				binaryOutput->priorityArray.Set(priority, previousValue);
+			}
+			return false;
 		}
+		g_database.ObjectChanged(deviceInstance, objectType, objectInstance);
+	}
+	else {
+		return false;
+	}
+	return true;
+}
+
+// Pushes a written value to the backend queue and records the time since
+// start as the acknowledge latency of the write. For the commandable outputs
+// the value is the present value after the write or relinquish. Fails with an error code if
+// the backend is too far behind.
+bool QueueBackendWrite(const uint32_t deviceInstance, const uint16_t objectType, const uint32_t objectInstance, const uint32_t propertyIdentifier, const float value, const uint8_t priority, const std::chrono::steady_clock::time_point& start, uint32_t* errorCode)
+{
+	WriteBackendRecord record;
+	record.deviceInstance = deviceInstance;
+	record.objectType = objectType;
+	record.objectInstance = objectInstance;
+	record.propertyIdentifier = propertyIdentifier;
+	record.value = value;
+	record.priority = priority;
+	record.queued = start;
+	if (!g_writeBackend.Enqueue(record)) {
+		*errorCode = ExampleConstants::ERROR_NO_SPACE_TO_WRITE_PROPERTY;
+		return false;
+	}
+	g_writeBackend.RecordAckLatency((uint64_t)std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::steady_clock::now() - start).count());
+	return true;
+}
+
+// Gets the object name based on the provided parameters
+bool GetObjectName(const uint32_t deviceInstance, const uint16_t objectType, const uint32_t objectInstance, char* value, uint32_t* valueElementCount, const uint32_t maxElementCount)
+{
+	size_t stringSize = 0;
+	const char* storedName = NULL;
+	if (g_database.GetObjectName(deviceInstance, objectType, objectInstance, &storedName, &stringSize)) {
+		// Get the name of the main device, a network port, a virtual device or one of its objects
+		if (stringSize > maxElementCount) {
+			std::cerr << "Error - not enough space to store full name of objectType=[" << objectType << "], objectInstance=[" << objectInstance << " ]" << std::endl;
+			return false;
+		}
+		memcpy(value, storedName, stringSize);
+		*valueElementCount = (uint32_t)stringSize;
+		return true;
 	}
 	else if (objectType == ExampleConstants::OBJECT_TYPE_NETWORK_PORT) {
 		// Get the name of a virtual network port object
@@ -703,33 +2583,40 @@ bool GetObjectName(const uint32_t deviceInstance, const uint16_t objectType, con
 bool GetDeviceDescription(const uint32_t deviceInstance, char* value, uint32_t* valueElementCount, const uint32_t maxElementCount) {
 	size_t stringSize = 0;
 	if (deviceInstance == g_database.mainDevice.instance) {
-		stringSize = g_database.mainDevice.objectName.size();
+		const char* description = g_database.strings.Get(g_database.mainDevice.description, &stringSize);
 		if (stringSize > maxElementCount) {
 			std::cerr << "Error - not enough space to store full description for deviceInstance=[" << deviceInstance << " ]" << std::endl;
 			return false;
 		}
-		memcpy(value, g_database.mainDevice.objectName.c_str(), stringSize);
+		memcpy(value, description, stringSize);
 		*valueElementCount = (uint32_t)stringSize;
 		return true;
 	}
 	else {
-		std::map<uint16_t, std::vector<ExampleDatabaseDevice> >::iterator it;
-		for (it = g_database.virtualDevices.begin(); it != g_database.virtualDevices.end(); ++it) {
-			std::vector<ExampleDatabaseDevice>::iterator devIt;
-			for (devIt = it->second.begin(); devIt != it->second.end(); ++devIt) {
-				if (deviceInstance == devIt->instance) {
-					stringSize = devIt->objectName.size();
-					if (stringSize > maxElementCount) {
-						std::cerr << "Error - not enough space to store full description for deviceInstance=[" << deviceInstance << " ]" << std::endl;
-						return false;
-					}
-					memcpy(value, devIt->objectName.c_str(), stringSize);
-					*valueElementCount = (uint32_t)stringSize;
-					return true;
-				}
+		const char* description = NULL;
+		if (g_database.GetVirtualDeviceDescription(deviceInstance, &description, &stringSize)) {
+			if (stringSize > maxElementCount) {
+				std::cerr << "Error - not enough space to store full description for deviceInstance=[" << deviceInstance << " ]" << std::endl;
+				return false;
 			}
+			memcpy(value, description, stringSize);
+			*valueElementCount = (uint32_t)stringSize;
+			return true;
 		}
 	}
 
 	return false;
 }
+
+void PrintMemoryUsage(std::ostream& out)
+{
+	ExampleDatabaseMemoryUsage usage;
+	g_database.GetMemoryUsage(&usage);
+	size_t bytes = usage.recordBytes + usage.stringPoolBytes;
+	size_t bytesWithoutPool = usage.recordBytes + usage.stringBytesWithoutPool;
+	size_t devices = usage.devices > 0 ? usage.devices : 1;
+	out << "FYI: Memory: {\"memory\":{\"devices\":" << usage.devices << ",\"objects\":" << usage.objects;
+	out << ",\"recordBytes\":" << usage.recordBytes << ",\"strings\":" << usage.strings << ",\"stringReferences\":" << usage.stringReferences;
+	out << ",\"stringPoolBytes\":" << usage.stringPoolBytes << ",\"stringBytesWithoutPool\":" << usage.stringBytesWithoutPool << ",\"nameIndexBytes\":" << usage.nameIndexBytes;
+	out << ",\"bytesPerDevice\":" << bytes / devices << ",\"bytesPerDeviceWithoutPool\":" << bytesWithoutPool / devices << "}}" << std::endl;
+}
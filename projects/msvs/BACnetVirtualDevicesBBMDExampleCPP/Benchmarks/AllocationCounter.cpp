@@ -0,0 +1,161 @@
+/*
+ * BACnet Virtual Devices and BBMD Example C++
+ * ----------------------------------------------------------------------------
+ * AllocationCounter.cpp
+ *
+ * Counting replacements of the global operator new and delete.
+ */
+
+#ifndef BACNET_EXAMPLE_BENCHMARKS
+#error Only the benchmark project replaces operator new, see Benchmarks.h
+#endif // BACNET_EXAMPLE_BENCHMARKS
+
+#include "AllocationCounter.h"
+
+#include <atomic>
+#include <new>
+#include <stdlib.h>
+#ifdef _WIN32
+#include <malloc.h>
+#endif // _WIN32
+
+static std::atomic<uint64_t> g_allocationCount(0);
+static std::atomic<uint64_t> g_allocationBytes(0);
+
+static void* CountedAllocate(size_t size) {
+	g_allocationCount.fetch_add(1, std::memory_order_relaxed);
+	g_allocationBytes.fetch_add(size, std::memory_order_relaxed);
+	return malloc(size == 0 ? 1 : size);
+}
+
+#ifdef __cpp_aligned_new
+// _aligned_malloc() memory has to be freed with _aligned_free(), the aligned
+// forms of delete are always called for the aligned forms of new
+static void* CountedAllocateAligned(size_t size, std::align_val_t alignment) {
+	g_allocationCount.fetch_add(1, std::memory_order_relaxed);
+	g_allocationBytes.fetch_add(size, std::memory_order_relaxed);
+#ifdef _WIN32
+	return _aligned_malloc(size == 0 ? 1 : size, (size_t)alignment);
+#else
+	void* memory = NULL;
+	if (posix_memalign(&memory, (size_t)alignment, size == 0 ? 1 : size) != 0) {
+		return NULL;
+	}
+	return memory;
+#endif // _WIN32
+}
+
+static void FreeAligned(void* memory) {
+#ifdef _WIN32
+	_aligned_free(memory);
+#else
+	free(memory);
+#endif // _WIN32
+}
+#endif // __cpp_aligned_new
+
+uint64_t CAllocationCounter::GetCount() {
+	return g_allocationCount.load(std::memory_order_relaxed);
+}
+
+uint64_t CAllocationCounter::GetBytes() {
+	return g_allocationBytes.load(std::memory_order_relaxed);
+}
+
+void* operator new(size_t size) {
+	void* memory = CountedAllocate(size);
+	if (memory == NULL) {
+		throw std::bad_alloc();
+	}
+	return memory;
+}
+
+void* operator new[](size_t size) {
+	void* memory = CountedAllocate(size);
+	if (memory == NULL) {
+		throw std::bad_alloc();
+	}
+	return memory;
+}
+
+void* operator new(size_t size, const std::nothrow_t&) noexcept {
+	return CountedAllocate(size);
+}
+
+void* operator new[](size_t size, const std::nothrow_t&) noexcept {
+	return CountedAllocate(size);
+}
+
+void operator delete(void* memory) noexcept {
+	free(memory);
+}
+
+void operator delete[](void* memory) noexcept {
+	free(memory);
+}
+
+void operator delete(void* memory, size_t) noexcept {
+	free(memory);
+}
+
+void operator delete[](void* memory, size_t) noexcept {
+	free(memory);
+}
+
+void operator delete(void* memory, const std::nothrow_t&) noexcept {
+	free(memory);
+}
+
+void operator delete[](void* memory, const std::nothrow_t&) noexcept {
+	free(memory);
+}
+
+#ifdef __cpp_aligned_new
+void* operator new(size_t size, std::align_val_t alignment) {
+	void* memory = CountedAllocateAligned(size, alignment);
+	if (memory == NULL) {
+		throw std::bad_alloc();
+	}
+	return memory;
+}
+
+void* operator new[](size_t size, std::align_val_t alignment) {
+	void* memory = CountedAllocateAligned(size, alignment);
+	if (memory == NULL) {
+		throw std::bad_alloc();
+	}
+	return memory;
+}
+
+void* operator new(size_t size, std::align_val_t alignment, const std::nothrow_t&) noexcept {
+	return CountedAllocateAligned(size, alignment);
+}
+
+void* operator new[](size_t size, std::align_val_t alignment, const std::nothrow_t&) noexcept {
+	return CountedAllocateAligned(size, alignment);
+}
+
+void operator delete(void* memory, std::align_val_t) noexcept {
+	FreeAligned(memory);
+}
+
+void operator delete[](void* memory, std::align_val_t) noexcept {
+	FreeAligned(memory);
+}
+
+void operator delete(void* memory, size_t, std::align_val_t) noexcept {
+	FreeAligned(memory);
+}
+
+void operator delete[](void* memory, size_t, std::align_val_t) noexcept {
+	FreeAligned(memory);
+}
+
+void operator delete(void* memory, std::align_val_t, const std::nothrow_t&) noexcept {
+	FreeAligned(memory);
+}
+
+void operator delete[](void* memory, std::align_val_t, const std::nothrow_t&) noexcept {
+	FreeAligned(memory);
+}
+#endif // __cpp_aligned_new
@@ -0,0 +1,27 @@
+/*
+ * BACnet Virtual Devices and BBMD Example C++
+ * ----------------------------------------------------------------------------
+ * AllocationCounter.h
+ *
+ * Counts the calls to the global operator new, to show that a path does not
+ * allocate once it is warmed up. AllocationCounter.cpp replaces operator new
+ * and delete for the whole application, the aligned forms too, they forward
+ * to malloc() and free() and add one relaxed atomic increment. It is only
+ * built into the benchmark project. Memory the CAS BACnet Stack or the C
+ * library allocate with malloc() directly is not counted.
+ */
+
+#ifndef __AllocationCounter_h__
+#define __AllocationCounter_h__
+
+#include <stdint.h>
+
+class CAllocationCounter
+{
+public:
+	// Since the start of the application, from every thread
+	static uint64_t GetCount();
+	static uint64_t GetBytes();
+};
+
+#endif // __AllocationCounter_h__
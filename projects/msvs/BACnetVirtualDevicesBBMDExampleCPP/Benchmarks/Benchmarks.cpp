@@ -0,0 +1,233 @@
+/*
+ * BACnet Virtual Devices and BBMD Example C++
+ * ----------------------------------------------------------------------------
+ * Benchmarks.cpp
+ *
+ * See Benchmarks.h
+ */
+
+#include "Benchmarks.h"
+#include "UDPBenchmark.h"
+#include "TrendLogBenchmark.h"
+#include "PointIngestionBenchmark.h"
+#include "ValueCacheBenchmark.h"
+#include "IngressSchedulerBenchmark.h"
+#include "ShardBenchmark.h"
+#include "JitterBenchmark.h"
+#include "PacketPoolBenchmark.h"
+#include "WhoHasBenchmark.h"
+#include "RpmAllBenchmark.h"
+#include "ResponseCacheBenchmark.h"
+#include "RealtimeProfile.h"
+
+#include <iostream>
+#include <string.h>
+#include <thread>
+
+static bool RunIngest(std::ostream& out, const BenchmarkContext&) {
+	const uint32_t producerCounts[] = { 1, 2, 4 };
+	for (size_t i = 0; i < sizeof(producerCounts) / sizeof(producerCounts[0]); i++) {
+		out << "FYI: Point ingestion benchmark: ";
+		if (!RunPointIngestionBenchmark(out, 10000, producerCounts[i], 1000)) {
+			return false;
+		}
+	}
+	return true;
+}
+
+static bool RunCache(std::ostream& out, const BenchmarkContext&) {
+	// 1000 points read 10000 times a second. With a TTL of 5 s the
+	// backend has to answer 200 refreshes a second, ~55 at a time.
+	const uint32_t workerCounts[] = { 16, 64, 128 };
+	for (size_t i = 0; i < sizeof(workerCounts) / sizeof(workerCounts[0]); i++) {
+		ValueCacheBenchmarkSettings settings;
+		settings.pointCount = 1000;
+		settings.ttlMilliseconds = 5000;
+		settings.workerCount = workerCounts[i];
+		settings.deadlineMilliseconds = 2000;
+		settings.backendMinimumMilliseconds = 50;
+		settings.backendMaximumMilliseconds = 500;
+		settings.readsPerSecond = 10000;
+		settings.durationMilliseconds = 15000;
+		out << "FYI: Value cache benchmark: ";
+		if (!RunValueCacheBenchmark(out, settings)) {
+			return false;
+		}
+	}
+	return true;
+}
+
+static bool RunJitter(std::ostream& out, const BenchmarkContext& context) {
+	// Twice as many busy processes as CPUs. The profile is the one of the
+	// options, or all of it with the BACnet thread on the last CPU.
+	CRealtimeProfile realtimeProfile = *context.realtimeProfile;
+	if (!realtimeProfile.IsEnabled()) {
+		const int cpuCount = (int)std::thread::hardware_concurrency();
+		realtimeProfile.loopCpus.assign(1, cpuCount > 0 ? cpuCount - 1 : 0);
+		for (int cpu = 0; cpu + 1 < cpuCount; cpu++) {
+			realtimeProfile.helperCpus.push_back(cpu);
+		}
+		realtimeProfile.fifoPriority = REALTIME_PROFILE_DEFAULT_PRIORITY;
+		realtimeProfile.lockMemory = true;
+	}
+	JitterBenchmarkSettings settings;
+	settings.durationMilliseconds = 5000;
+	settings.loadProcesses = 2 * (std::thread::hardware_concurrency() > 0 ? std::thread::hardware_concurrency() : 1);
+	settings.workNanoseconds = 2000;
+	out << "FYI: Jitter benchmark, no profile: ";
+	if (!RunJitterBenchmark(out, settings, NULL)) {
+		return false;
+	}
+	out << "FYI: Jitter benchmark, realtime profile: ";
+	return RunJitterBenchmark(out, settings, &realtimeProfile);
+}
+
+static bool RunWhoHas(std::ostream& out, const BenchmarkContext&) {
+	// 3000 devices of 36 objects each, most names asked for are not there
+	WhoHasBenchmarkSettings settings;
+	settings.devicesPerNetwork = 1000;
+	settings.virtualNetworkCount = 3;
+	settings.objectsPerType = 8;
+	settings.scanRequests = 200;
+	settings.indexedRequests = 1000000;
+	settings.missPercent = 90;
+	out << "FYI: Who-Has benchmark: ";
+	return RunWhoHasBenchmark(out, settings);
+}
+
+static bool RunResponseCache(std::ostream& out, const BenchmarkContext& context) {
+	// 3000 devices, clients polling the present values of a few hundred
+	ResponseCacheBenchmarkSettings settings;
+	settings.devicesPerNetwork = 1000;
+	settings.virtualNetworkCount = 3;
+	settings.objectsPerType = 8;
+	settings.hotObjects = 500;
+	settings.requests = 1000000;
+	settings.writePercent = 2;
+	settings.capacity = 10000;
+	out << "FYI: Response cache benchmark: ";
+	return RunResponseCacheBenchmark(out, settings, *context.database, *context.responseCache, context.callbacks);
+}
+
+static bool RunRpmAll(std::ostream& out, const BenchmarkContext& context) {
+	// 3000 devices of 36 objects each, through the callbacks the stack is given
+	RpmAllBenchmarkSettings settings;
+	settings.devicesPerNetwork = 1000;
+	settings.virtualNetworkCount = 3;
+	settings.objectsPerType = 8;
+	settings.passes = 5;
+	out << "FYI: RPM ALL benchmark: ";
+	return RunRpmAllBenchmark(out, settings, *context.database, context.callbacks);
+}
+
+static bool RunPacketPool(std::ostream& out, const BenchmarkContext&) {
+	PacketPoolBenchmarkSettings settings;
+	settings.durationMilliseconds = 3000;
+	settings.window = 64;
+	settings.threads = 4;
+	settings.batch = 16;
+	settings.port = 47903;
+	out << "FYI: Packet pool benchmark: ";
+	return RunPacketPoolBenchmark(out, settings);
+}
+
+static bool RunShards(std::ostream& out, const BenchmarkContext&) {
+	// Requests spread over 8 virtual networks, each one costs a worker 20 us
+	const uint32_t workerCounts[] = { 1, 2, 4, 8 };
+	for (size_t i = 0; i < sizeof(workerCounts) / sizeof(workerCounts[0]); i++) {
+		ShardBenchmarkSettings settings;
+		settings.workerCount = workerCounts[i];
+		settings.networkCount = 8;
+		settings.window = 64;
+		settings.workMicroseconds = 20;
+		settings.durationMilliseconds = 3000;
+		settings.port = 47901;
+		out << "FYI: Shard benchmark: ";
+		if (!RunShardBenchmark(out, settings)) {
+			return false;
+		}
+	}
+	return true;
+}
+
+static bool RunIngress(std::ostream& out, const BenchmarkContext& context) {
+	// 40 messages a millisecond for a stack that processes 25: a broadcast
+	// storm, then confirmed requests only, most of them to one virtual
+	// network
+	IngressSchedulerBenchmarkSettings settings;
+	settings.capacity = 1024;
+	memcpy(settings.weights, context.ingressWeights, sizeof(settings.weights));
+	settings.arrivalsPerRound[INGRESS_CLASS_CONFIRMED] = 5;
+	settings.arrivalsPerRound[INGRESS_CLASS_UNICAST] = 5;
+	settings.arrivalsPerRound[INGRESS_CLASS_BROADCAST] = 30;
+	settings.servicePerRound = 25;
+	settings.rounds = 10000;
+	settings.timeoutRounds = 3000;
+	settings.hotNetworkPercent = 34;
+	out << "FYI: Ingress scheduler benchmark, broadcast storm: ";
+	if (!RunIngressSchedulerBenchmark(out, settings)) {
+		return false;
+	}
+	settings.arrivalsPerRound[INGRESS_CLASS_CONFIRMED] = 30;
+	settings.arrivalsPerRound[INGRESS_CLASS_UNICAST] = 0;
+	settings.arrivalsPerRound[INGRESS_CLASS_BROADCAST] = 0;
+	settings.servicePerRound = 15;
+	settings.hotNetworkPercent = 80;
+	out << "FYI: Ingress scheduler benchmark, busy virtual network: ";
+	return RunIngressSchedulerBenchmark(out, settings);
+}
+
+static bool RunTrend(std::ostream& out, const BenchmarkContext&) {
+	out << "FYI: Trend log benchmark: ";
+	return RunTrendLogBenchmark(out, 100000, 100000, 100);
+}
+
+static bool RunUDP(std::ostream& out, const BenchmarkContext&) {
+	out << "FYI: UDP loopback benchmark: ";
+	return RunUDPLoopbackBenchmark(out, 100000, 50, 47900);
+}
+
+class Benchmark
+{
+public:
+	const char* option;
+	const char* name;				// For the error message
+	const char* description;
+	bool (*run)(std::ostream& out, const BenchmarkContext& context);
+};
+
+static const Benchmark BENCHMARKS[] = {
+	{ "--benchmark-udp", "UDP loopback", "The IPv4 and IPv6 UDP paths over loopback", RunUDP },
+	{ "--benchmark-trend", "trend log", "The compressed trend log against an uncompressed buffer", RunTrend },
+	{ "--benchmark-ingest", "point ingestion", "The shared memory point ingestion with 1, 2 and 4 producers", RunIngest },
+	{ "--benchmark-cache", "value cache", "The value cache against a backend with 50-500 ms latency", RunCache },
+	{ "--benchmark-ingress", "ingress scheduler", "An overload of the ingress scheduler against a FIFO, uses --ingress-weights", RunIngress },
+	{ "--benchmark-shards", "shard", "A front end routing requests to 1, 2, 4 and 8 workers", RunShards },
+	{ "--benchmark-jitter", "jitter", "The gaps of a loop under load without and with the realtime profile", RunJitter },
+	{ "--benchmark-packet-pool", "packet pool", "The allocations of the receive path under load, and the pool against the heap", RunPacketPool },
+	{ "--benchmark-who-has", "Who-Has", "A Who-Has by name at 100k objects, walking every object and with the name index", RunWhoHas },
+	{ "--benchmark-rpm-all", "RPM ALL", "ReadPropertyMultiple ALL through the property callbacks, without and with the lookup memo", RunRpmAll },
+	{ "--benchmark-response-cache", "response cache", "Polled ReadProperty requests with writes, without and with the response cache", RunResponseCache },
+};
+
+bool RunBenchmark(std::ostream& out, const std::string& option, const BenchmarkContext& context) {
+	for (size_t i = 0; i < sizeof(BENCHMARKS) / sizeof(BENCHMARKS[0]); i++) {
+		if (option != BENCHMARKS[i].option) {
+			continue;
+		}
+		if (!BENCHMARKS[i].run(out, context)) {
+			std::cerr << "Failed to run the " << BENCHMARKS[i].name << " benchmark" << std::endl;
+			return false;
+		}
+		return true;
+	}
+	std::cerr << "Unknown benchmark [" << option << "]" << std::endl;
+	PrintBenchmarks(std::cerr);
+	return false;
+}
+
+void PrintBenchmarks(std::ostream& out) {
+	for (size_t i = 0; i < sizeof(BENCHMARKS) / sizeof(BENCHMARKS[0]); i++) {
+		out << "  " << BENCHMARKS[i].option << ": " << BENCHMARKS[i].description << std::endl;
+	}
+}
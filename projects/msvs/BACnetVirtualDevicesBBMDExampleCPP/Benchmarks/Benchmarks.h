@@ -0,0 +1,54 @@
+/*
+ * BACnet Virtual Devices and BBMD Example C++
+ * ----------------------------------------------------------------------------
+ * Benchmarks.h
+ *
+ * The --benchmark-<name> options. They are only built into the benchmark
+ * project, which defines BACNET_EXAMPLE_BENCHMARKS, so the example itself
+ * does not carry them.
+ */
+
+#ifndef __Benchmarks_h__
+#define __Benchmarks_h__
+
+#include <stdint.h>
+#include <ostream>
+#include <string>
+
+#include "IngressScheduler.h"
+
+class ExampleDatabase;
+class CResponseCache;
+class CRealtimeProfile;
+
+// The property callbacks given to the CAS BACnet Stack
+class BenchmarkPropertyCallbacks
+{
+public:
+	bool (*getCharString)(const uint32_t deviceInstance, const uint16_t objectType, const uint32_t objectInstance, const uint32_t propertyIdentifier, char* value, uint32_t* valueElementCount, const uint32_t maxElementCount, uint8_t* encodingType, const bool useArrayIndex, const uint32_t propertyArrayIndex);
+	bool (*getEnum)(const uint32_t deviceInstance, const uint16_t objectType, const uint32_t objectInstance, const uint32_t propertyIdentifier, uint32_t* value, const bool useArrayIndex, const uint32_t propertyArrayIndex);
+	bool (*getReal)(const uint32_t deviceInstance, const uint16_t objectType, const uint32_t objectInstance, const uint32_t propertyIdentifier, float* value, const bool useArrayIndex, const uint32_t propertyArrayIndex);
+	bool (*getUInt)(const uint32_t deviceInstance, const uint16_t objectType, const uint32_t objectInstance, const uint32_t propertyIdentifier, uint32_t* value, const bool useArrayIndex, const uint32_t propertyArrayIndex);
+	bool (*getBool)(const uint32_t deviceInstance, const uint16_t objectType, const uint32_t objectInstance, const uint32_t propertyIdentifier, bool* value, const bool useArrayIndex, const uint32_t propertyArrayIndex);
+};
+
+// What the benchmarks take from the example: its database and response
+// cache with the callbacks that read them, and the options parsed before
+class BenchmarkContext
+{
+public:
+	ExampleDatabase* database;
+	CResponseCache* responseCache;
+	BenchmarkPropertyCallbacks callbacks;
+	uint32_t ingressWeights[INGRESS_CLASS_COUNT];	// See --ingress-weights
+	const CRealtimeProfile* realtimeProfile;		// See --loop-cpus and the options after it
+};
+
+// Runs the benchmark of a --benchmark-<name> option, writing its results to
+// out. False for an unknown option or when the benchmark failed.
+bool RunBenchmark(std::ostream& out, const std::string& option, const BenchmarkContext& context);
+
+// Writes one line for each --benchmark-<name> option
+void PrintBenchmarks(std::ostream& out);
+
+#endif // __Benchmarks_h__
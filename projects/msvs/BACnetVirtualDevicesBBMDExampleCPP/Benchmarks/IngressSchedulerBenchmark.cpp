@@ -0,0 +1,252 @@
+/*
+ * BACnet Virtual Devices and BBMD Example C++
+ * ----------------------------------------------------------------------------
+ * IngressSchedulerBenchmark.cpp
+ *
+ * Ingress scheduler against a FIFO under overload.
+ */
+
+#include "IngressSchedulerBenchmark.h"
+
+#include <string.h>
+#include <algorithm>
+#include <chrono>
+#include <random>
+#include <vector>
+
+#define INGRESS_BENCHMARK_NETWORKS	3
+
+static const uint16_t INGRESS_BENCHMARK_DNETS[INGRESS_BENCHMARK_NETWORKS] = { 1000, 2000, 3000 };
+
+// What the benchmark knows about each message, by sequence number
+struct IngressBenchmarkArrival
+{
+	uint32_t round;
+	uint8_t ingressClass;
+	uint8_t network;
+};
+
+struct IngressBenchmarkResult
+{
+	uint64_t offered[INGRESS_CLASS_COUNT];
+	uint64_t delivered[INGRESS_CLASS_COUNT];
+	uint64_t inTime[INGRESS_CLASS_COUNT];
+	std::vector<uint32_t> waits[INGRESS_CLASS_COUNT];
+	uint64_t networkOffered[INGRESS_BENCHMARK_NETWORKS];
+	uint64_t networkDelivered[INGRESS_BENCHMARK_NETWORKS];
+	double nanosecondsPerMessage;
+};
+
+// Builds a BACnet/IP message of the class, with the sequence number in the
+// last four bytes
+static uint16_t BuildMessage(uint8_t* buffer, const IngressClass ingressClass, const uint16_t dnet, const uint32_t sequence, const bool forwarded) {
+	uint16_t length = 0;
+	buffer[length++] = 0x81;
+	if (ingressClass == INGRESS_CLASS_CONFIRMED) {
+		// Original-Unicast-NPDU, ReadProperty of a virtual device
+		static const uint8_t body[] = { 0x01, 0x24, 0x00, 0x00, 0x01, 0x01, 0xFF, 0x00, 0x05, 0x01, 0x0C, 0x0C, 0x00, 0x00, 0x00, 0x00, 0x19, 0x55 };
+		buffer[length++] = 0x0A;
+		length += 2;
+		memcpy(buffer + length, body, sizeof(body));
+		buffer[length + 2] = (uint8_t)(dnet >> 8);
+		buffer[length + 3] = (uint8_t)dnet;
+		buffer[length + 9] = (uint8_t)sequence;	// Invoke ID
+		length += sizeof(body);
+	}
+	else if (ingressClass == INGRESS_CLASS_UNICAST) {
+		// Original-Unicast-NPDU, Who-Is
+		static const uint8_t body[] = { 0x01, 0x00, 0x10, 0x08 };
+		buffer[length++] = 0x0A;
+		length += 2;
+		memcpy(buffer + length, body, sizeof(body));
+		length += sizeof(body);
+	}
+	else if (forwarded) {
+		// Forwarded-NPDU, I-Am
+		static const uint8_t body[] = { 192, 168, 1, 20, 0xBA, 0xC0, 0x01, 0x00, 0x10, 0x00, 0xC4, 0x02, 0x00, 0x00, 0x01, 0x22, 0x05, 0xC4, 0x91, 0x00, 0x21, 0x00 };
+		buffer[length++] = 0x04;
+		length += 2;
+		memcpy(buffer + length, body, sizeof(body));
+		length += sizeof(body);
+	}
+	else {
+		// Original-Broadcast-NPDU, global Who-Is
+		static const uint8_t body[] = { 0x01, 0x20, 0xFF, 0xFF, 0x00, 0xFF, 0x10, 0x08 };
+		buffer[length++] = 0x0B;
+		length += 2;
+		memcpy(buffer + length, body, sizeof(body));
+		length += sizeof(body);
+	}
+	memcpy(buffer + length, &sequence, 4);
+	length += 4;
+	buffer[2] = (uint8_t)(length >> 8);
+	buffer[3] = (uint8_t)length;
+	return length;
+}
+
+static uint32_t GetSequence(const uint8_t* buffer, const uint16_t length) {
+	uint32_t sequence;
+	memcpy(&sequence, buffer + length - 4, 4);
+	return sequence;
+}
+
+static void Deliver(IngressBenchmarkResult& result, const std::vector<IngressBenchmarkArrival>& arrivals, const uint32_t sequence, const uint32_t round, const uint32_t timeoutRounds) {
+	const IngressBenchmarkArrival& arrival = arrivals[sequence];
+	const uint32_t wait = round - arrival.round;
+	result.delivered[arrival.ingressClass]++;
+	result.waits[arrival.ingressClass].push_back(wait);
+	if (wait < timeoutRounds) {
+		result.inTime[arrival.ingressClass]++;
+	}
+	if (arrival.ingressClass == INGRESS_CLASS_CONFIRMED) {
+		result.networkDelivered[arrival.network]++;
+	}
+}
+
+// Runs the arrivals through a FIFO with tail drop (useScheduler false) or
+// through the scheduler
+static bool Simulate(const IngressSchedulerBenchmarkSettings& settings, const std::vector<IngressBenchmarkArrival>& arrivals, const bool useScheduler, IngressBenchmarkResult& result) {
+	memset(result.offered, 0, sizeof(result.offered));
+	memset(result.delivered, 0, sizeof(result.delivered));
+	memset(result.inTime, 0, sizeof(result.inTime));
+	memset(result.networkOffered, 0, sizeof(result.networkOffered));
+	memset(result.networkDelivered, 0, sizeof(result.networkDelivered));
+
+	CPacketPool pool;
+	CIngressScheduler scheduler;
+	if (useScheduler && (!pool.Start(settings.capacity + 2, false) || !scheduler.Start(&pool, settings.capacity, settings.weights))) {
+		return false;
+	}
+	std::vector<IngressMessage> fifo(useScheduler ? 0 : settings.capacity);
+	size_t fifoHead = 0;
+	size_t fifoCount = 0;
+
+	std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+	uint32_t sequence = 0;
+	for (uint32_t round = 0; round < settings.rounds; round++) {
+		for (; sequence < arrivals.size() && arrivals[sequence].round == round; sequence++) {
+			const IngressBenchmarkArrival& arrival = arrivals[sequence];
+			result.offered[arrival.ingressClass]++;
+			if (arrival.ingressClass == INGRESS_CLASS_CONFIRMED) {
+				result.networkOffered[arrival.network]++;
+			}
+
+			IngressMessage* message;
+			if (useScheduler) {
+				message = scheduler.GetReceiveMessage();
+			}
+			else {
+				if (fifoCount == fifo.size()) {
+					continue;
+				}
+				message = &fifo[(fifoHead + fifoCount++) % fifo.size()];
+			}
+			message->length = BuildMessage(message->buffer, (IngressClass)arrival.ingressClass, INGRESS_BENCHMARK_DNETS[arrival.network], sequence, (sequence & 1) != 0);
+			if (useScheduler) {
+				scheduler.Enqueue();
+			}
+		}
+
+		for (uint32_t i = 0; i < settings.servicePerRound; i++) {
+			const IngressMessage* message;
+			if (useScheduler) {
+				message = scheduler.Dequeue();
+			}
+			else {
+				message = fifoCount == 0 ? NULL : &fifo[fifoHead];
+				if (message != NULL) {
+					fifoHead = (fifoHead + 1) % fifo.size();
+					fifoCount--;
+				}
+			}
+			if (message == NULL) {
+				break;
+			}
+			Deliver(result, arrivals, GetSequence(message->buffer, message->length), round, settings.timeoutRounds);
+		}
+	}
+	result.nanosecondsPerMessage = std::chrono::duration<double, std::nano>(std::chrono::steady_clock::now() - start).count() / (arrivals.empty() ? 1 : arrivals.size());
+	return true;
+}
+
+static void ReportResult(std::ostream& out, const char* name, IngressBenchmarkResult& result) {
+	out << "\"" << name << "\":{\"nsPerMessage\":" << (uint64_t)result.nanosecondsPerMessage << ",\"classes\":[";
+	for (int i = 0; i < INGRESS_CLASS_COUNT; i++) {
+		std::vector<uint32_t>& waits = result.waits[i];
+		std::sort(waits.begin(), waits.end());
+		uint64_t totalWait = 0;
+		for (size_t w = 0; w < waits.size(); w++) {
+			totalWait += waits[w];
+		}
+		if (i > 0) {
+			out << ",";
+		}
+		out << "{\"name\":\"" << CIngressScheduler::GetClassName((IngressClass)i) << "\""
+			<< ",\"offered\":" << result.offered[i]
+			<< ",\"delivered\":" << result.delivered[i]
+			<< ",\"inTimePercent\":" << (result.offered[i] == 0 ? 0 : result.inTime[i] * 100 / result.offered[i])
+			<< ",\"meanWaitMs\":" << (waits.empty() ? 0 : totalWait / waits.size())
+			<< ",\"p99WaitMs\":" << (waits.empty() ? 0 : waits[waits.size() * 99 / 100]) << "}";
+	}
+	out << "],\"confirmedByNetwork\":[";
+	for (int n = 0; n < INGRESS_BENCHMARK_NETWORKS; n++) {
+		if (n > 0) {
+			out << ",";
+		}
+		out << "{\"dnet\":" << INGRESS_BENCHMARK_DNETS[n] << ",\"offered\":" << result.networkOffered[n]
+			<< ",\"deliveredPercent\":" << (result.networkOffered[n] == 0 ? 0 : result.networkDelivered[n] * 100 / result.networkOffered[n]) << "}";
+	}
+	out << "]}";
+}
+
+bool RunIngressSchedulerBenchmark(std::ostream& out, const IngressSchedulerBenchmarkSettings& settings) {
+	if (settings.capacity == 0 || settings.rounds == 0) {
+		return false;
+	}
+	CLatencyClock::Calibrate();
+
+	// The same arrivals for both runs, shuffled within each round
+	std::mt19937 random(1);
+	std::uniform_int_distribution<uint32_t> percent(0, 99);
+	std::vector<IngressBenchmarkArrival> arrivals;
+	std::vector<IngressBenchmarkArrival> round;
+	uint32_t offeredPerRound = 0;
+	for (int i = 0; i < INGRESS_CLASS_COUNT; i++) {
+		offeredPerRound += settings.arrivalsPerRound[i];
+	}
+	arrivals.reserve((size_t)offeredPerRound * settings.rounds);
+	for (uint32_t r = 0; r < settings.rounds; r++) {
+		round.clear();
+		for (int i = 0; i < INGRESS_CLASS_COUNT; i++) {
+			for (uint32_t a = 0; a < settings.arrivalsPerRound[i]; a++) {
+				IngressBenchmarkArrival arrival;
+				arrival.round = r;
+				arrival.ingressClass = (uint8_t)i;
+				arrival.network = 0;
+				if (i == INGRESS_CLASS_CONFIRMED && percent(random) >= settings.hotNetworkPercent) {
+					arrival.network = (uint8_t)(1 + percent(random) % (INGRESS_BENCHMARK_NETWORKS - 1));
+				}
+				round.push_back(arrival);
+			}
+		}
+		std::shuffle(round.begin(), round.end(), random);
+		arrivals.insert(arrivals.end(), round.begin(), round.end());
+	}
+
+	IngressBenchmarkResult fifo;
+	IngressBenchmarkResult scheduled;
+	if (!Simulate(settings, arrivals, false, fifo) || !Simulate(settings, arrivals, true, scheduled)) {
+		return false;
+	}
+
+	out << "{\"ingressBenchmark\":{\"capacity\":" << settings.capacity
+		<< ",\"weights\":[" << settings.weights[0] << "," << settings.weights[1] << "," << settings.weights[2] << "]"
+		<< ",\"offeredPerMs\":" << offeredPerRound
+		<< ",\"servicePerMs\":" << settings.servicePerRound
+		<< ",\"timeoutMs\":" << settings.timeoutRounds << ",";
+	ReportResult(out, "fifo", fifo);
+	out << ",";
+	ReportResult(out, "scheduler", scheduled);
+	out << "}}" << std::endl;
+	return true;
+}
@@ -0,0 +1,35 @@
+/*
+ * BACnet Virtual Devices and BBMD Example C++
+ * ----------------------------------------------------------------------------
+ * IngressSchedulerBenchmark.h
+ *
+ * Overload simulation of the ingress scheduler against a single FIFO of the
+ * same size: which messages reach the stack, and how long they waited.
+ */
+
+#ifndef __IngressSchedulerBenchmark_h__
+#define __IngressSchedulerBenchmark_h__
+
+#include <stdint.h>
+#include <ostream>
+#include "IngressScheduler.h"
+
+class IngressSchedulerBenchmarkSettings
+{
+public:
+	uint32_t capacity;
+	uint32_t weights[INGRESS_CLASS_COUNT];
+	uint32_t arrivalsPerRound[INGRESS_CLASS_COUNT];
+	uint32_t servicePerRound;			// Messages the stack processes per round
+	uint32_t rounds;					// One round is one millisecond
+	uint32_t timeoutRounds;				// APDU timeout of the clients
+	uint32_t hotNetworkPercent;			// Share of the confirmed requests sent to the first virtual network
+};
+
+// Feeds the same arrivals, confirmed ReadProperty requests to three virtual
+// networks, unicast Who-Is, and broadcast Who-Is and Forwarded-NPDU I-Am,
+// through a FIFO with tail drop and through the scheduler. Writes the
+// results as a JSON object on one line.
+bool RunIngressSchedulerBenchmark(std::ostream& out, const IngressSchedulerBenchmarkSettings& settings);
+
+#endif // __IngressSchedulerBenchmark_h__
@@ -0,0 +1,121 @@
+/*
+ * BACnet Virtual Devices and BBMD Example C++
+ * ----------------------------------------------------------------------------
+ * JitterBenchmark.cpp
+ *
+ * Main loop jitter under background load.
+ */
+
+#include "JitterBenchmark.h"
+#include "LatencyHistogram.h"
+
+#include <chrono>
+#include <string.h>
+#include <thread>
+#include <vector>
+
+#ifdef __linux__
+#include <signal.h>
+#include <sys/prctl.h>
+#include <sys/types.h>
+#include <sys/wait.h>
+#include <unistd.h>
+#endif // __linux__
+
+#define JITTER_BENCHMARK_LOAD_BUFFER	(4 * 1024 * 1024)
+
+#ifdef __linux__
+// Another tenant of the host, CPU and cache bound
+static void RunLoad() {
+	prctl(PR_SET_PDEATHSIG, SIGKILL);
+	std::vector<uint8_t> buffer(JITTER_BENCHMARK_LOAD_BUFFER);
+	for (uint8_t pass = 0;; pass++) {
+		memset(&buffer[0], pass, buffer.size());
+	}
+}
+
+static void RunLoop(std::ostream& out, const JitterBenchmarkSettings& settings, CRealtimeProfile* profile) {
+	if (profile != NULL) {
+		profile->Apply();
+		profile->Report(out);
+	}
+
+	CLatencyHistogram gaps;
+	const uint64_t workTicks = (uint64_t)(settings.workNanoseconds * CLatencyClock::TicksPerNanosecond());
+	const uint64_t over100us = (uint64_t)(100000 * CLatencyClock::TicksPerNanosecond());
+	const uint64_t over1ms = (uint64_t)(1000000 * CLatencyClock::TicksPerNanosecond());
+	uint64_t gapsOver100us = 0;
+	uint64_t gapsOver1ms = 0;
+
+	std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+	std::chrono::steady_clock::time_point end = start + std::chrono::milliseconds(settings.durationMilliseconds);
+	uint64_t previous = CLatencyClock::Now();
+	for (uint32_t iteration = 1;; iteration++) {
+		uint64_t now = CLatencyClock::Now();
+		uint64_t gap = now - previous;
+		previous = now;
+		gaps.Record(gap);
+		gapsOver100us += gap > over100us ? 1 : 0;
+		gapsOver1ms += gap > over1ms ? 1 : 0;
+
+		while (CLatencyClock::Now() - now < workTicks) {
+		}
+		std::this_thread::yield();
+
+		if ((iteration & 0x3F) == 0 && std::chrono::steady_clock::now() >= end) {
+			break;
+		}
+	}
+	double seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+
+	out << "{\"jitter\":{\"profile\":" << (profile != NULL ? "true" : "false");
+	out << ",\"loadProcesses\":" << settings.loadProcesses << ",\"workNs\":" << settings.workNanoseconds;
+	out << ",\"seconds\":" << seconds << ",\"iterationsPerSecond\":" << (uint64_t)(gaps.GetCount() / seconds);
+	out << ",\"gapsOver100us\":" << gapsOver100us << ",\"gapsOver1ms\":" << gapsOver1ms << ",\"gaps\":";
+	gaps.Report(out, "gap");
+	out << "}}" << std::endl;
+}
+#endif // __linux__
+
+bool RunJitterBenchmark(std::ostream& out, const JitterBenchmarkSettings& settings, CRealtimeProfile* profile) {
+#ifdef __linux__
+	CLatencyClock::Calibrate();
+	out.flush();
+
+	std::vector<pid_t> load;
+	for (uint32_t i = 0; i < settings.loadProcesses; i++) {
+		pid_t pid = fork();
+		if (pid == 0) {
+			RunLoad();
+			_exit(0);
+		}
+		if (pid > 0) {
+			load.push_back(pid);
+		}
+	}
+
+	// In a process of its own, the profile can not be undone
+	bool ok = false;
+	pid_t loop = fork();
+	if (loop == 0) {
+		RunLoop(out, settings, profile);
+		out.flush();
+		_exit(0);
+	}
+	if (loop > 0) {
+		int status;
+		ok = waitpid(loop, &status, 0) == loop && WIFEXITED(status) && WEXITSTATUS(status) == 0;
+	}
+
+	for (size_t i = 0; i < load.size(); i++) {
+		kill(load[i], SIGKILL);
+		waitpid(load[i], NULL, 0);
+	}
+	return ok && load.size() == settings.loadProcesses;
+#else
+	(void)out;
+	(void)settings;
+	(void)profile;
+	return false;
+#endif // __linux__
+}
@@ -0,0 +1,32 @@
+/*
+ * BACnet Virtual Devices and BBMD Example C++
+ * ----------------------------------------------------------------------------
+ * JitterBenchmark.h
+ *
+ * Gaps in a loop shaped like the main loop, with and without the realtime
+ * profile, while other processes load every CPU.
+ */
+
+#ifndef __JitterBenchmark_h__
+#define __JitterBenchmark_h__
+
+#include <stdint.h>
+#include <ostream>
+#include "RealtimeProfile.h"
+
+class JitterBenchmarkSettings
+{
+public:
+	uint32_t durationMilliseconds;
+	uint32_t loadProcesses;			// Processes that spin over a 4 MB buffer for the whole run
+	uint32_t workNanoseconds;		// Work of each iteration, like an idle fpTick()
+};
+
+// Runs the loop in a child process, with the profile applied to it when
+// profile is not NULL. Each iteration works for workNanoseconds and yields,
+// like the main loop calls Sleep(0). The time between the starts of two
+// iterations goes into a histogram. Linux only. Writes the results as a JSON
+// object on one line, after the report of the profile when there is one.
+bool RunJitterBenchmark(std::ostream& out, const JitterBenchmarkSettings& settings, CRealtimeProfile* profile);
+
+#endif // __JitterBenchmark_h__
@@ -0,0 +1,319 @@
+/*
+ * BACnet Virtual Devices and BBMD Example C++
+ * ----------------------------------------------------------------------------
+ * PacketPoolBenchmark.cpp
+ *
+ * Allocation counting of the receive path, pool against heap.
+ */
+
+#include "PacketPoolBenchmark.h"
+#include "PacketPool.h"
+#include "IngressScheduler.h"
+#include "AllocationCounter.h"
+#include "SimpleUDP.h"
+
+#include <atomic>
+#include <chrono>
+#include <string.h>
+#include <thread>
+#include <vector>
+
+#ifndef _WIN32
+#include <poll.h>
+#include <signal.h>
+#include <sys/types.h>
+#include <sys/wait.h>
+#include <unistd.h>
+#ifdef __linux__
+#include <sys/prctl.h>
+#endif // __linux__
+#endif // _WIN32
+
+#define PACKET_POOL_BENCHMARK_WARMUP_MILLISECONDS	300
+#define PACKET_POOL_BENCHMARK_POLL_MILLISECONDS		100
+#define PACKET_POOL_BENCHMARK_QUEUE					256
+
+#ifndef _WIN32
+// Keeps window ReadProperty requests in flight, each one followed by a
+// Who-Is broadcast that is never answered
+static void RunClient(const PacketPoolBenchmarkSettings& settings) {
+#ifdef __linux__
+	prctl(PR_SET_PDEATHSIG, SIGTERM);
+#endif // __linux__
+	CSimpleUDP udp;
+	if (!udp.Connect(settings.port + 1, true, "127.0.0.1")) {
+		_exit(1);
+	}
+	const unsigned char receiver[4] = { 127, 0, 0, 1 };
+
+	// Original-Unicast-NPDU, NPDU to DNET 1000 expecting a reply, then a
+	// confirmed ReadProperty of the present value of analog-input 1
+	unsigned char request[] = {
+		0x81, 0x0A, 0x00, 0x15,
+		0x01, 0x24, 0x03, 0xE8, 0x00, 0xFF,
+		0x00, 0x05, 0x00, 0x0C,
+		0x0C, 0x00, 0x00, 0x00, 0x01,
+		0x19, 0x55 };
+	// Original-Broadcast-NPDU, global Who-Is
+	const unsigned char whoIs[] = {
+		0x81, 0x0B, 0x00, 0x0C,
+		0x01, 0x20, 0xFF, 0xFF, 0x00, 0xFF,
+		0x10, 0x08 };
+
+	struct pollfd readable;
+	readable.fd = udp.GetSocket();
+	readable.events = POLLIN;
+	unsigned char reply[PACKET_POOL_MAX_MESSAGE_LENGTH];
+	for (uint32_t sent = 0, next = 0;;) {
+		for (; sent < settings.window; sent++, next++) {
+			request[12] = (unsigned char)next;
+			udp.SendTo(receiver, settings.port, request, sizeof(request));
+			udp.SendTo(receiver, settings.port, whoIs, sizeof(whoIs));
+		}
+		readable.revents = 0;
+		if (poll(&readable, 1, PACKET_POOL_BENCHMARK_POLL_MILLISECONDS) <= 0) {
+			sent = 0;
+			continue;
+		}
+		unsigned char address[4];
+		unsigned short port;
+		while (sent > 0 && udp.ReceiveFrom(reply, sizeof(reply), address, &port) > 0) {
+			sent--;
+		}
+	}
+}
+
+// The receive callback with --ingress-queue, and a ComplexAck for each
+// confirmed request in place of the stack
+static bool RunReceivePath(std::ostream& out, const PacketPoolBenchmarkSettings& settings) {
+	CSimpleUDP udp;
+	if (!udp.Connect(settings.port, true, "127.0.0.1")) {
+		return false;
+	}
+	CPacketPool pool;
+	CIngressScheduler scheduler;
+	const uint32_t weights[INGRESS_CLASS_COUNT] = { 8, 2, 1 };
+	if (!pool.Start(PACKET_POOL_BENCHMARK_QUEUE + 2, false) || !scheduler.Start(&pool, PACKET_POOL_BENCHMARK_QUEUE, weights)) {
+		return false;
+	}
+	out.flush();
+
+	pid_t client = fork();
+	if (client == 0) {
+		RunClient(settings);
+		_exit(0);
+	}
+	if (client < 0) {
+		return false;
+	}
+
+	struct pollfd readable;
+	readable.fd = udp.GetSocket();
+	readable.events = POLLIN;
+	uint8_t stackBuffer[PACKET_POOL_MAX_MESSAGE_LENGTH];
+	uint64_t received = 0;
+	uint64_t replies = 0;
+	uint64_t allocations = 0;
+	uint64_t allocatedBytes = 0;
+	bool measuring = false;
+	std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now() + std::chrono::milliseconds(PACKET_POOL_BENCHMARK_WARMUP_MILLISECONDS);
+	std::chrono::steady_clock::time_point end = start + std::chrono::milliseconds(settings.durationMilliseconds);
+	std::chrono::steady_clock::time_point now;
+	while ((now = std::chrono::steady_clock::now()) < end) {
+		if (!measuring && now >= start) {
+			measuring = true;
+			received = 0;
+			replies = 0;
+			allocations = CAllocationCounter::GetCount();
+			allocatedBytes = CAllocationCounter::GetBytes();
+		}
+
+		// Drain the socket into the scheduler
+		for (int i = 0; i < INGRESS_SCHEDULER_DRAIN_BATCH; i++) {
+			IngressMessage* message = scheduler.GetReceiveMessage();
+			if (message == NULL) {
+				break;
+			}
+			unsigned short port;
+			int length = udp.ReceiveFrom(message->buffer, sizeof(message->buffer), message->sourceConnectionString, &port);
+			if (length <= 0) {
+				break;
+			}
+			message->length = (uint16_t)length;
+			message->sourceConnectionString[4] = (uint8_t)(port / 256);
+			message->sourceConnectionString[5] = (uint8_t)(port % 256);
+			message->sourceConnectionStringLength = 6;
+			message->destinationConnectionStringLength = 0;
+			message->networkType = 0;
+			scheduler.Enqueue();
+			received++;
+		}
+
+		// Hand one message to the stack
+		const IngressMessage* next = scheduler.Dequeue();
+		if (next == NULL) {
+			readable.revents = 0;
+			poll(&readable, 1, PACKET_POOL_BENCHMARK_POLL_MILLISECONDS);
+			continue;
+		}
+		memcpy(stackBuffer, next->buffer, next->length);
+		if (next->ingressClass == INGRESS_CLASS_CONFIRMED && next->length >= 13) {
+			// BVLC, NPDU from SNET, ComplexAck of the present value, 0.0
+			uint8_t reply[] = {
+				0x81, 0x0A, 0x00, 0x00,
+				0x01, 0x08, stackBuffer[6], stackBuffer[7], 0x01, 0x01,
+				0x30, stackBuffer[12], 0x0C,
+				0x0C, 0x00, 0x00, 0x00, 0x01,
+				0x19, 0x55,
+				0x3E, 0x44, 0x00, 0x00, 0x00, 0x00, 0x3F };
+			reply[3] = sizeof(reply);
+			const uint8_t* address = next->sourceConnectionString;
+			udp.SendTo(address, (unsigned short)(address[4] * 256 + address[5]), reply, sizeof(reply));
+			replies++;
+		}
+	}
+	allocations = CAllocationCounter::GetCount() - allocations;
+	allocatedBytes = CAllocationCounter::GetBytes() - allocatedBytes;
+	double seconds = std::chrono::duration<double>(now - start).count();
+
+	kill(client, SIGTERM);
+	waitpid(client, NULL, 0);
+
+	out << "\"receivePath\":{\"seconds\":" << seconds << ",\"received\":" << received << ",\"replies\":" << replies;
+	out << ",\"packetsPerSecond\":" << (uint64_t)(received / seconds);
+	out << ",\"allocations\":" << allocations << ",\"allocatedBytes\":" << allocatedBytes;
+	out << ",\"confirmedDropped\":" << scheduler.GetDroppedCount(INGRESS_CLASS_CONFIRMED) << ",\"broadcastDropped\":" << scheduler.GetDroppedCount(INGRESS_CLASS_BROADCAST);
+	out << ",\"poolMaxInUse\":" << pool.GetMaxInUseCount() << ",\"poolExhausted\":" << pool.GetExhaustedCount() << "}";
+	return received > 0;
+}
+#endif // _WIN32
+
+struct ChurnResult
+{
+	uint64_t operations;
+	uint64_t allocations;
+	uint64_t exhausted;
+	uint64_t collisions;		// Buffers handed to two threads at once
+	double nanosecondsPerOperation;
+};
+
+// Each thread takes batch buffers, stamps each one with its thread and a
+// sequence number, checks the stamps and frees them. pool is NULL for the
+// heap.
+static void Churn(const PacketPoolBenchmarkSettings& settings, CPacketPool* pool, ChurnResult& result) {
+	std::atomic<bool> go(false);
+	std::atomic<bool> stop(false);
+	std::atomic<uint32_t> done(0);
+	std::vector<uint64_t> operations(settings.threads, 0);
+	std::vector<uint64_t> exhausted(settings.threads, 0);
+	std::vector<uint64_t> collisions(settings.threads, 0);
+	std::vector<std::thread> threads;
+	for (uint32_t index = 0; index < settings.threads; index++) {
+		threads.push_back(std::thread([&, index]() {
+			std::vector<uint32_t> handles(settings.batch);
+			std::vector<uint8_t*> blocks(settings.batch);
+			while (!go.load()) {
+				std::this_thread::yield();
+			}
+			uint64_t sequence = 0;
+			while (!stop.load(std::memory_order_relaxed)) {
+				for (uint32_t i = 0; i < settings.batch; i++) {
+					uint8_t* block;
+					if (pool != NULL) {
+						handles[i] = pool->Allocate();
+						if (handles[i] == PACKET_POOL_NONE) {
+							exhausted[index]++;
+							blocks[i] = NULL;
+							continue;
+						}
+						block = pool->Get(handles[i])->buffer;
+					}
+					else {
+						block = new uint8_t[PACKET_POOL_STRIDE];
+					}
+					uint64_t stamp = (uint64_t)index << 48 | (sequence + i);
+					memcpy(block, &stamp, sizeof(stamp));
+					blocks[i] = block;
+				}
+				for (uint32_t i = 0; i < settings.batch; i++) {
+					if (blocks[i] == NULL) {
+						continue;
+					}
+					uint64_t stamp;
+					memcpy(&stamp, blocks[i], sizeof(stamp));
+					if (stamp != ((uint64_t)index << 48 | (sequence + i))) {
+						collisions[index]++;
+					}
+					if (pool != NULL) {
+						pool->Free(handles[i]);
+					}
+					else {
+						delete[] blocks[i];
+					}
+					operations[index]++;
+				}
+				sequence += settings.batch;
+			}
+			done.fetch_add(1);
+		}));
+	}
+
+	// Counted once every thread is running
+	std::this_thread::sleep_for(std::chrono::milliseconds(PACKET_POOL_BENCHMARK_WARMUP_MILLISECONDS));
+	uint64_t allocations = CAllocationCounter::GetCount();
+	std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+	go = true;
+	std::this_thread::sleep_for(std::chrono::milliseconds(settings.durationMilliseconds));
+	stop = true;
+	while (done.load() < settings.threads) {
+		std::this_thread::yield();
+	}
+	double seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+	result.allocations = CAllocationCounter::GetCount() - allocations;
+	for (size_t i = 0; i < threads.size(); i++) {
+		threads[i].join();
+	}
+
+	result.operations = 0;
+	result.exhausted = 0;
+	result.collisions = 0;
+	for (uint32_t i = 0; i < settings.threads; i++) {
+		result.operations += operations[i];
+		result.exhausted += exhausted[i];
+		result.collisions += collisions[i];
+	}
+	result.nanosecondsPerOperation = result.operations > 0 ? seconds * 1e9 / result.operations : 0;
+}
+
+static void ReportChurn(std::ostream& out, const char* name, const ChurnResult& result) {
+	out << "\"" << name << "\":{\"operations\":" << result.operations << ",\"nsPerAllocateAndFree\":" << result.nanosecondsPerOperation;
+	out << ",\"allocations\":" << result.allocations << ",\"exhausted\":" << result.exhausted << ",\"collisions\":" << result.collisions << "}";
+}
+
+bool RunPacketPoolBenchmark(std::ostream& out, const PacketPoolBenchmarkSettings& settings) {
+	if (settings.threads == 0 || settings.batch == 0 || settings.window == 0) {
+		return false;
+	}
+	out << "{\"packetPoolBenchmark\":{";
+#ifndef _WIN32
+	if (!RunReceivePath(out, settings)) {
+		return false;
+	}
+	out << ",";
+#endif // _WIN32
+
+	CPacketPool pool;
+	if (!pool.Start(settings.threads * settings.batch, false)) {
+		return false;
+	}
+	ChurnResult pooled;
+	ChurnResult heap;
+	Churn(settings, &pool, pooled);
+	Churn(settings, NULL, heap);
+	out << "\"threads\":" << settings.threads << ",\"batch\":" << settings.batch << ",";
+	ReportChurn(out, "pool", pooled);
+	out << ",";
+	ReportChurn(out, "heap", heap);
+	out << "}}" << std::endl;
+	return pooled.collisions == 0 && pooled.exhausted == 0 && pooled.allocations == 0;
+}
@@ -0,0 +1,40 @@
+/*
+ * BACnet Virtual Devices and BBMD Example C++
+ * ----------------------------------------------------------------------------
+ * PacketPoolBenchmark.h
+ *
+ * Heap allocations of the receive path under load, and the packet pool
+ * against the heap when several threads allocate and free packets.
+ */
+
+#ifndef __PacketPoolBenchmark_h__
+#define __PacketPoolBenchmark_h__
+
+#include <stdint.h>
+#include <ostream>
+
+class PacketPoolBenchmarkSettings
+{
+public:
+	uint32_t durationMilliseconds;	// Of each part, after a warm up
+	uint32_t window;				// Confirmed requests the client keeps in flight
+	uint32_t threads;				// Threads that allocate and free packets
+	uint32_t batch;					// Packets each thread holds at once
+	uint16_t port;					// Loopback port of the receive path, and the next one
+};
+
+// Two parts:
+//   - a client process floods the loopback port with ReadProperty requests
+//     and Who-Is broadcasts. Each datagram is received into a pool buffer,
+//     classified and queued by the ingress scheduler, copied out to the
+//     buffer of the stack, and the requests are answered, like the receive
+//     callback does with --ingress-queue. The operator new calls made after
+//     the warm up are counted, there should be none.
+//   - threads allocate batch packets, stamp them, check that no other
+//     thread was handed the same buffer, and free them, from the pool and
+//     then with new and delete.
+// Writes the results as a JSON object on one line. The first part is POSIX
+// only.
+bool RunPacketPoolBenchmark(std::ostream& out, const PacketPoolBenchmarkSettings& settings);
+
+#endif // __PacketPoolBenchmark_h__
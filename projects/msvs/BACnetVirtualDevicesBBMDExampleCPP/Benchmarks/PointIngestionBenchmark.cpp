@@ -0,0 +1,178 @@
+/*
+ * BACnet Virtual Devices and BBMD Example C++
+ * ----------------------------------------------------------------------------
+ * PointIngestionBenchmark.cpp
+ *
+ * Shared memory point ingestion throughput.
+ */
+
+#include "PointIngestionBenchmark.h"
+#include "PointIngestion.h"
+
+#include <chrono>
+#include <string>
+#include <vector>
+
+#include <thread>
+
+#ifndef _WIN32
+#include <sys/types.h>
+#include <sys/wait.h>
+#include <unistd.h>
+#endif // _WIN32
+
+#define POINT_INGESTION_BENCHMARK_DEVICE_BASE	389000
+
+// Publishes the points [first, last) in turn until the time is up. The value
+// of a point is the number of the pass, so the consumer can check that the
+// values it sees never go backwards.
+static bool RunProducer(const char* name, const uint32_t first, const uint32_t last, const uint32_t durationMilliseconds) {
+	CPointIngestionWriter writer;
+	if (!writer.Open(name)) {
+		return false;
+	}
+
+	std::vector<uint32_t> indexes;
+	for (uint32_t point = first; point < last; point++) {
+		uint32_t index;
+		if (!writer.FindPoint(POINT_INGESTION_BENCHMARK_DEVICE_BASE + point, 0, &index)) {
+			return false;
+		}
+		indexes.push_back(index);
+	}
+
+	std::chrono::steady_clock::time_point end = std::chrono::steady_clock::now() + std::chrono::milliseconds(durationMilliseconds);
+	uint64_t published = 0;
+	for (uint32_t pass = 1; std::chrono::steady_clock::now() < end; pass++) {
+		for (size_t i = 0; i < indexes.size(); i++) {
+			writer.Publish(indexes[i], (float)pass, 0);
+		}
+		published += indexes.size();
+	}
+	writer.AddPublishCount(published);
+	return true;
+}
+
+bool RunPointIngestionBenchmark(std::ostream& out, const uint32_t pointCount, const uint32_t producerCount, const uint32_t durationMilliseconds) {
+	if (pointCount == 0 || producerCount == 0 || producerCount > pointCount) {
+		return false;
+	}
+
+#ifdef _WIN32
+	std::string name = "Local\\BACnetPointIngestionBenchmark";
+#else
+	std::string name = "/bacnet-point-ingestion-benchmark-" + std::to_string((long)getpid());
+#endif // _WIN32
+
+	std::vector<PointIngestionPointKey> keys(pointCount);
+	for (uint32_t point = 0; point < pointCount; point++) {
+		keys[point].deviceInstance = POINT_INGESTION_BENCHMARK_DEVICE_BASE + point;
+		keys[point].objectInstance = 0;
+	}
+	CPointIngestionServer server;
+	if (!server.Create(name.c_str(), keys)) {
+		return false;
+	}
+
+	// Stands in for the analog input table of the database
+	std::vector<float> table(pointCount, 0.0f);
+	uint64_t consumed = 0;
+	uint64_t consumeCalls = 0;
+	uint64_t outOfOrder = 0;
+	auto apply = [&](const PointIngestionPoint& point, const float value, const uint64_t) {
+		float& current = table[point.deviceInstance - POINT_INGESTION_BENCHMARK_DEVICE_BASE];
+		if (value < current) {
+			outOfOrder++;
+		}
+		current = value;
+	};
+
+	// Give the producers the processor when nothing changed, as the main loop
+	// does between ticks. The time spent applying changes is the cost of the
+	// ingestion on the main loop.
+	double consumeSeconds = 0;
+	auto consume = [&]() {
+		std::chrono::steady_clock::time_point consumeStart = std::chrono::steady_clock::now();
+		uint32_t count = server.Consume(apply);
+		if (count == 0) {
+			std::this_thread::yield();
+		}
+		else {
+			consumeSeconds += std::chrono::duration<double>(std::chrono::steady_clock::now() - consumeStart).count();
+		}
+		consumed += count;
+		consumeCalls++;
+	};
+
+	std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+	bool producersOk = true;
+#ifdef _WIN32
+	std::vector<std::thread> producers;
+	std::atomic<uint32_t> running(producerCount);
+	for (uint32_t producer = 0; producer < producerCount; producer++) {
+		uint32_t first = (uint32_t)((uint64_t)pointCount * producer / producerCount);
+		uint32_t last = (uint32_t)((uint64_t)pointCount * (producer + 1) / producerCount);
+		producers.push_back(std::thread([&, first, last]() {
+			if (!RunProducer(name.c_str(), first, last, durationMilliseconds)) {
+				producersOk = false;
+			}
+			running--;
+		}));
+	}
+	while (running.load() != 0) {
+		consume();
+	}
+	for (size_t i = 0; i < producers.size(); i++) {
+		producers[i].join();
+	}
+#else
+	std::vector<pid_t> producers;
+	for (uint32_t producer = 0; producer < producerCount; producer++) {
+		uint32_t first = (uint32_t)((uint64_t)pointCount * producer / producerCount);
+		uint32_t last = (uint32_t)((uint64_t)pointCount * (producer + 1) / producerCount);
+		pid_t pid = fork();
+		if (pid == 0) {
+			_exit(RunProducer(name.c_str(), first, last, durationMilliseconds) ? 0 : 1);
+		}
+		if (pid < 0) {
+			producersOk = false;
+			break;
+		}
+		producers.push_back(pid);
+	}
+	size_t running = producers.size();
+	while (running > 0) {
+		consume();
+		// Reap the producers now and then, not on every pass
+		if ((consumeCalls & 0x3FF) == 0) {
+			int status;
+			pid_t pid;
+			while ((pid = waitpid(-1, &status, WNOHANG)) > 0) {
+				if (!WIFEXITED(status) || WEXITSTATUS(status) != 0) {
+					producersOk = false;
+				}
+				running--;
+			}
+		}
+	}
+#endif // _WIN32
+	// Pick up what was published after the last pass
+	consumed += server.Consume(apply);
+	consumeCalls++;
+	double seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+
+	uint64_t published = server.GetPublishCount();
+	server.Close();
+	if (!producersOk || outOfOrder != 0) {
+		return false;
+	}
+
+	out << "{\"pointIngestion\":{\"points\":" << pointCount << ",\"producers\":" << producerCount;
+	out << ",\"seconds\":" << seconds;
+	out << ",\"published\":" << published << ",\"publishedPerSecond\":" << (uint64_t)(published / seconds);
+	out << ",\"consumed\":" << consumed << ",\"consumedPerSecond\":" << (uint64_t)(consumed / seconds);
+	out << ",\"consumeCalls\":" << consumeCalls << ",\"pointsPerConsume\":" << (double)consumed / consumeCalls;
+	out << ",\"consumeNsPerPoint\":" << (consumed > 0 ? consumeSeconds * 1e9 / consumed : 0);
+	out << "}}" << std::endl;
+	return true;
+}
@@ -0,0 +1,24 @@
+/*
+ * BACnet Virtual Devices and BBMD Example C++
+ * ----------------------------------------------------------------------------
+ * PointIngestionBenchmark.h
+ *
+ * Throughput of the shared memory point ingestion: points per second
+ * published by one or more producer processes and points per second applied
+ * by the consumer.
+ */
+
+#ifndef __PointIngestionBenchmark_h__
+#define __PointIngestionBenchmark_h__
+
+#include <stdint.h>
+#include <ostream>
+
+// Creates a segment of pointCount points and starts producerCount producers,
+// each publishing its share of the points as fast as it can for
+// durationMilliseconds. Producers are processes where fork() is available and
+// threads otherwise. The consumer applies the changes in a loop, like Loop()
+// does. Writes the results as a single JSON object on one line.
+bool RunPointIngestionBenchmark(std::ostream& out, const uint32_t pointCount, const uint32_t producerCount, const uint32_t durationMilliseconds);
+
+#endif // __PointIngestionBenchmark_h__
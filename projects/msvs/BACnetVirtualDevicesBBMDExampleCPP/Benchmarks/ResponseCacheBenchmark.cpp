@@ -0,0 +1,384 @@
+/*
+ * BACnet Virtual Devices and BBMD Example C++
+ * ----------------------------------------------------------------------------
+ * ResponseCacheBenchmark.cpp
+ *
+ * Polled ReadProperty requests, without and with the response cache.
+ */
+
+#include "ResponseCacheBenchmark.h"
+#include "ResponseCache.h"
+#include "ExampleDatabase.h"
+
+#include <algorithm>
+#include <chrono>
+#include <string.h>
+#include <unordered_map>
+#include <vector>
+
+#define RESPONSE_CACHE_BENCHMARK_CLIENTS			4
+#define RESPONSE_CACHE_BENCHMARK_ADDRESS_LENGTH		4	// The device instance as its MAC address
+#define RESPONSE_CACHE_BENCHMARK_MAX_MESSAGE		RESPONSE_CACHE_MAX_RESPONSE_LENGTH
+
+enum ResponseCacheValueKind
+{
+	RESPONSE_CACHE_CHARACTER_STRING,
+	RESPONSE_CACHE_ENUMERATED,
+	RESPONSE_CACHE_REAL,
+	RESPONSE_CACHE_UNSIGNED
+};
+
+// A property the clients poll
+class ResponseCachePoll
+{
+public:
+	uint16_t network;
+	ExampleDatabaseObjectReference object;
+	uint32_t propertyIdentifier;
+	ResponseCacheValueKind kind;
+};
+
+class ResponseCacheRun
+{
+public:
+	double seconds;
+	uint64_t hits;
+	uint64_t misses;
+	uint64_t checked;			// Hits compared with the answer of the stand in
+	uint64_t mismatches;
+	uint64_t checksum;			// Of every answer sent, when checked
+};
+
+// FNV-1a over the answers, the checked runs have to send the same ones
+static void Fold(uint64_t* checksum, const uint8_t* bytes, const size_t length) {
+	for (size_t i = 0; i < length; i++) {
+		*checksum ^= bytes[i];
+		*checksum *= 1099511628211ull;
+	}
+}
+
+static void PutUInt16(uint8_t* buffer, const uint16_t value) {
+	buffer[0] = (uint8_t)(value >> 8);
+	buffer[1] = (uint8_t)value;
+}
+
+static void PutUInt32(uint8_t* buffer, const uint32_t value) {
+	buffer[0] = (uint8_t)(value >> 24);
+	buffer[1] = (uint8_t)(value >> 16);
+	buffer[2] = (uint8_t)(value >> 8);
+	buffer[3] = (uint8_t)value;
+}
+
+static uint32_t GetUInt32(const uint8_t* buffer) {
+	return (uint32_t)buffer[0] << 24 | (uint32_t)buffer[1] << 16 | (uint32_t)buffer[2] << 8 | buffer[3];
+}
+
+// An unsigned value of the smallest length under the tag
+static uint16_t EncodeUnsigned(uint8_t* buffer, const uint8_t tag, const uint32_t value) {
+	uint8_t length = value <= 0xFF ? 1 : value <= 0xFFFF ? 2 : value <= 0xFFFFFF ? 3 : 4;
+	buffer[0] = (uint8_t)(tag | length);
+	for (uint8_t i = 0; i < length; i++) {
+		buffer[1 + i] = (uint8_t)(value >> (8 * (length - 1 - i)));
+	}
+	return (uint16_t)(1 + length);
+}
+
+// ReadProperty to a virtual device, through its network
+static uint16_t EncodeRequest(uint8_t* buffer, const ResponseCachePoll& poll, const uint8_t invokeId) {
+	uint16_t offset = 4;
+	buffer[0] = 0x81;	// BACnet/IP
+	buffer[1] = 0x0A;	// Original-Unicast-NPDU
+	buffer[offset++] = 0x01;
+	buffer[offset++] = 0x24;	// DNET, expecting reply
+	PutUInt16(buffer + offset, poll.network);
+	offset += 2;
+	buffer[offset++] = RESPONSE_CACHE_BENCHMARK_ADDRESS_LENGTH;
+	PutUInt32(buffer + offset, poll.object.deviceInstance);
+	offset += RESPONSE_CACHE_BENCHMARK_ADDRESS_LENGTH;
+	buffer[offset++] = 0xFF;	// Hop count
+	buffer[offset++] = 0x00;	// Confirmed request
+	buffer[offset++] = 0x05;	// 1476 bytes
+	buffer[offset++] = invokeId;
+	buffer[offset++] = 12;		// ReadProperty
+	buffer[offset++] = 0x0C;
+	PutUInt32(buffer + offset, (uint32_t)poll.object.objectType << 22 | poll.object.objectInstance);
+	offset += 4;
+	offset += EncodeUnsigned(buffer + offset, 0x18, poll.propertyIdentifier);
+	PutUInt16(buffer + 2, offset);
+	return offset;
+}
+
+// Stands in for the stack: decodes the request made by EncodeRequest(), reads
+// the property through the callbacks and encodes the Complex-ACK, or an Error
+// when it is not answered.
+static uint16_t Answer(const BenchmarkPropertyCallbacks& callbacks, const ResponseCacheValueKind kind, const uint8_t* request, uint8_t* response) {
+	const uint16_t network = (uint16_t)(request[6] << 8 | request[7]);
+	const uint32_t deviceInstance = GetUInt32(request + 9);
+	const uint8_t* apdu = request + 14;
+	const uint8_t invokeId = apdu[2];
+	const uint32_t objectIdentifier = GetUInt32(apdu + 5);
+	const uint16_t objectType = (uint16_t)(objectIdentifier >> 22);
+	const uint32_t objectInstance = objectIdentifier & 0x3FFFFF;
+	uint32_t propertyIdentifier = 0;
+	for (uint8_t i = 0; i < (apdu[9] & 0x07); i++) {
+		propertyIdentifier = propertyIdentifier << 8 | apdu[10 + i];
+	}
+
+	uint16_t offset = 4;
+	response[0] = 0x81;
+	response[1] = 0x0A;
+	response[offset++] = 0x01;
+	response[offset++] = 0x08;	// SNET
+	PutUInt16(response + offset, network);
+	offset += 2;
+	response[offset++] = RESPONSE_CACHE_BENCHMARK_ADDRESS_LENGTH;
+	PutUInt32(response + offset, deviceInstance);
+	offset += RESPONSE_CACHE_BENCHMARK_ADDRESS_LENGTH;
+
+	uint8_t value[RESPONSE_CACHE_BENCHMARK_MAX_MESSAGE];
+	uint16_t valueLength = 0;
+	bool answered = false;
+	switch (kind) {
+	case RESPONSE_CACHE_CHARACTER_STRING: {
+		char name[256];
+		uint32_t length = 0;
+		uint8_t encodingType = 0;
+		answered = callbacks.getCharString(deviceInstance, objectType, objectInstance, propertyIdentifier, name, &length, sizeof(name) - 1, &encodingType, false, 0);
+		if (answered) {
+			value[valueLength++] = 0x75;	// Character String, extended length
+			value[valueLength++] = (uint8_t)(length + 1);
+			value[valueLength++] = encodingType;
+			memcpy(value + valueLength, name, length);
+			valueLength += (uint16_t)length;
+		}
+		break;
+	}
+	case RESPONSE_CACHE_ENUMERATED:
+	case RESPONSE_CACHE_UNSIGNED: {
+		uint32_t number = 0;
+		answered = kind == RESPONSE_CACHE_ENUMERATED ?
+			callbacks.getEnum(deviceInstance, objectType, objectInstance, propertyIdentifier, &number, false, 0) :
+			callbacks.getUInt(deviceInstance, objectType, objectInstance, propertyIdentifier, &number, false, 0);
+		if (answered) {
+			valueLength = EncodeUnsigned(value, kind == RESPONSE_CACHE_ENUMERATED ? 0x90 : 0x20, number);
+		}
+		break;
+	}
+	case RESPONSE_CACHE_REAL: {
+		float real = 0.0f;
+		answered = callbacks.getReal(deviceInstance, objectType, objectInstance, propertyIdentifier, &real, false, 0);
+		if (answered) {
+			uint32_t bits;
+			memcpy(&bits, &real, sizeof(bits));
+			value[valueLength++] = 0x44;
+			PutUInt32(value + valueLength, bits);
+			valueLength += 4;
+		}
+		break;
+	}
+	}
+
+	if (!answered) {
+		// Error, property / unknown-property
+		const uint8_t error[] = { 0x50, invokeId, 12, 0x91, 0x02, 0x91, 0x20 };
+		memcpy(response + offset, error, sizeof(error));
+		offset += sizeof(error);
+	}
+	else {
+		response[offset++] = 0x30;	// Complex-ACK
+		response[offset++] = invokeId;
+		response[offset++] = 12;
+		response[offset++] = 0x0C;
+		PutUInt32(response + offset, objectIdentifier);
+		offset += 4;
+		offset += EncodeUnsigned(response + offset, 0x18, propertyIdentifier);
+		response[offset++] = 0x3E;
+		memcpy(response + offset, value, valueLength);
+		offset += valueLength;
+		response[offset++] = 0x3F;
+	}
+	PutUInt16(response + 2, offset);
+	return offset;
+}
+
+template <typename Record>
+static void ListStoredObjects(const ExampleDatabaseObjectStore<Record>& store, std::vector<ExampleDatabaseObjectReference>& objects) {
+	ExampleDatabaseObjectReference object;
+	object.objectType = store.GetObjectType();
+	for (size_t i = 0; i < store.Size(); i++) {
+		object.deviceInstance = store.At(i).deviceInstance;
+		object.objectInstance = store.At(i).instance;
+		objects.push_back(object);
+	}
+}
+
+static ResponseCacheValueKind GetPresentValueKind(const uint16_t objectType) {
+	switch (objectType) {
+	case ExampleConstants::OBJECT_TYPE_BINARY_INPUT:
+	case ExampleConstants::OBJECT_TYPE_BINARY_OUTPUT:
+	case ExampleConstants::OBJECT_TYPE_BINARY_VALUE:
+		return RESPONSE_CACHE_ENUMERATED;
+	case ExampleConstants::OBJECT_TYPE_MULTI_STATE_VALUE:
+		return RESPONSE_CACHE_UNSIGNED;
+	default:
+		return RESPONSE_CACHE_REAL;
+	}
+}
+
+// A value for the nth request. A supervisor writes the analog outputs at
+// priority 16, the analog inputs come from the field.
+static void Write(ExampleDatabase& database, const ExampleDatabaseObjectReference& object, const float value) {
+	if (object.objectType == ExampleConstants::OBJECT_TYPE_ANALOG_INPUT) {
+		database.SetAnalogInputPresentValue(object.deviceInstance, object.objectInstance, value);
+		return;
+	}
+	ExampleDatabaseAnalogOutput* analogOutput = database.FindAnalogOutput(object.deviceInstance, object.objectInstance);
+	if (analogOutput != NULL) {
+		analogOutput->priorityArray.Set(ExampleDatabaseBaseObject::PRIORITY_ARRAY_LENGTH, value);
+		database.ObjectChanged(object.deviceInstance, object.objectType, object.objectInstance);
+	}
+}
+
+static void Run(ExampleDatabase& database, CResponseCache& cache, const BenchmarkPropertyCallbacks& callbacks, const ResponseCacheBenchmarkSettings& settings, const std::vector<ResponseCachePoll>& polls, const std::vector<ExampleDatabaseObjectReference>& written, const bool check, ResponseCacheRun* run) {
+	// Every run starts from the same values
+	for (size_t i = 0; i < written.size(); i++) {
+		Write(database, written[i], 0.0f);
+	}
+	const uint64_t hits = cache.GetHits();
+	const uint64_t misses = cache.GetMisses();
+	run->checked = 0;
+	run->mismatches = 0;
+	run->checksum = 14695981039346656037ull;
+
+	uint8_t connectionStrings[RESPONSE_CACHE_BENCHMARK_CLIENTS][6];
+	uint8_t invokeIds[RESPONSE_CACHE_BENCHMARK_CLIENTS];
+	for (uint8_t client = 0; client < RESPONSE_CACHE_BENCHMARK_CLIENTS; client++) {
+		const uint8_t connectionString[6] = { 192, 168, 1, (uint8_t)(10 + client), 0xBA, 0xC0 };
+		memcpy(connectionStrings[client], connectionString, sizeof(connectionString));
+		invokeIds[client] = 0;
+	}
+	uint8_t request[RESPONSE_CACHE_BENCHMARK_MAX_MESSAGE];
+	uint8_t response[RESPONSE_CACHE_BENCHMARK_MAX_MESSAGE];
+	uint8_t fresh[RESPONSE_CACHE_BENCHMARK_MAX_MESSAGE];
+	uint32_t seed = 12345;
+	std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+	for (uint32_t i = 0; i < settings.requests; i++) {
+		seed = seed * 1103515245 + 12345;
+		const ResponseCachePoll& poll = polls[(seed >> 8) % polls.size()];
+		const uint32_t client = i % RESPONSE_CACHE_BENCHMARK_CLIENTS;
+		const uint16_t requestLength = EncodeRequest(request, poll, invokeIds[client]++);
+		uint16_t responseLength;
+		if (cache.Request(request, requestLength, connectionStrings[client], 6, response, &responseLength, sizeof(response))) {
+			if (check) {
+				const uint16_t freshLength = Answer(callbacks, poll.kind, request, fresh);
+				run->checked++;
+				if (freshLength != responseLength || memcmp(fresh, response, responseLength) != 0) {
+					run->mismatches++;
+				}
+			}
+		}
+		else {
+			responseLength = Answer(callbacks, poll.kind, request, response);
+			cache.Response(response, responseLength, connectionStrings[client], 6);
+		}
+		if (check) {
+			Fold(&run->checksum, response, responseLength);
+		}
+
+		seed = seed * 1103515245 + 12345;
+		if (!written.empty() && (seed >> 8) % 100 < settings.writePercent) {
+			Write(database, written[(seed >> 8) % written.size()], (float)(i % 1000) / 10.0f);
+		}
+	}
+	run->seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+	run->hits = cache.GetHits() - hits;
+	run->misses = cache.GetMisses() - misses;
+}
+
+bool RunResponseCacheBenchmark(std::ostream& out, const ResponseCacheBenchmarkSettings& settings, ExampleDatabase& database, CResponseCache& cache, const BenchmarkPropertyCallbacks& callbacks) {
+	database.devicesPerNetwork = settings.devicesPerNetwork;
+	database.virtualNetworkCount = settings.virtualNetworkCount;
+	database.objectsPerType = settings.objectsPerType;
+	database.trendLogIntervalSeconds = 0;
+	database.changeListener = NULL;
+	database.Setup();
+
+	// The network of each virtual device
+	std::unordered_map<uint32_t, uint16_t> networks;
+	std::vector<ExampleDatabaseVirtualDeviceEntry> entries;
+	database.GetVirtualDeviceList(entries);
+	for (size_t i = 0; i < entries.size(); i++) {
+		networks[entries[i].deviceInstance] = entries[i].network;
+	}
+
+	// The hot objects, a random few of the stored ones. Their present value
+	// and name are polled, the analog ones are written.
+	std::vector<ExampleDatabaseObjectReference> objects;
+	ListStoredObjects(database.analogInputs, objects);
+	ListStoredObjects(database.analogOutputs, objects);
+	ListStoredObjects(database.binaryOutputs, objects);
+	ListStoredObjects(database.binaryInputs, objects);
+	ListStoredObjects(database.binaryValues, objects);
+	ListStoredObjects(database.multiStateValues, objects);
+	ListStoredObjects(database.analogValues, objects);
+	if (objects.empty() || settings.hotObjects == 0 || settings.requests == 0) {
+		return false;
+	}
+	uint32_t seed = 54321;
+	for (size_t i = objects.size() - 1; i > 0; i--) {
+		seed = seed * 1103515245 + 12345;
+		std::swap(objects[i], objects[(seed >> 8) % (i + 1)]);
+	}
+	objects.resize(std::min<size_t>(objects.size(), settings.hotObjects));
+	std::vector<ResponseCachePoll> polls;
+	std::vector<ExampleDatabaseObjectReference> written;
+	ResponseCachePoll poll;
+	for (size_t i = 0; i < objects.size(); i++) {
+		poll.network = networks[objects[i].deviceInstance];
+		poll.object = objects[i];
+		poll.propertyIdentifier = ExampleConstants::PROPERTY_IDENTIFIER_PRESENT_VALUE;
+		poll.kind = GetPresentValueKind(objects[i].objectType);
+		polls.push_back(poll);
+		polls.push_back(poll);
+		polls.push_back(poll);
+		poll.propertyIdentifier = ExampleConstants::PROPERTY_IDENTIFIER_OBJECT_NAME;
+		poll.kind = RESPONSE_CACHE_CHARACTER_STRING;
+		polls.push_back(poll);
+		if (objects[i].objectType == ExampleConstants::OBJECT_TYPE_ANALOG_INPUT || objects[i].objectType == ExampleConstants::OBJECT_TYPE_ANALOG_OUTPUT) {
+			written.push_back(objects[i]);
+		}
+	}
+
+	// The stand in alone, then with the cache in front of it. Both again,
+	// untimed, with every answer checked.
+	ResponseCacheRun uncached;
+	cache.SetCapacity(0);
+	Run(database, cache, callbacks, settings, polls, written, false, &uncached);
+	ResponseCacheRun uncachedChecked;
+	Run(database, cache, callbacks, settings, polls, written, true, &uncachedChecked);
+
+	ResponseCacheRun cached;
+	cache.SetVerify(false);
+	cache.SetCapacity(settings.capacity);
+	database.changeListener = &cache;
+	Run(database, cache, callbacks, settings, polls, written, false, &cached);
+	const size_t cachedEntries = cache.GetSize();
+
+	ResponseCacheRun checked;
+	cache.SetCapacity(settings.capacity);
+	Run(database, cache, callbacks, settings, polls, written, true, &checked);
+
+	database.changeListener = NULL;
+	cache.SetCapacity(0);
+
+	const bool agree = checked.mismatches == 0 && uncachedChecked.checksum == checked.checksum;
+	const uint64_t requests = cached.hits + cached.misses;
+	out << "{\"responseCache\":{\"hotObjects\":" << objects.size() << ",\"polledProperties\":" << objects.size() * 2;
+	out << ",\"requests\":" << settings.requests << ",\"writePercent\":" << settings.writePercent;
+	out << ",\"uncached\":{\"requestsPerSecond\":" << (uint64_t)(settings.requests / uncached.seconds) << ",\"nsPerRequest\":" << uncached.seconds * 1e9 / settings.requests << "}";
+	out << ",\"cached\":{\"requestsPerSecond\":" << (uint64_t)(settings.requests / cached.seconds) << ",\"nsPerRequest\":" << cached.seconds * 1e9 / settings.requests;
+	out << ",\"hits\":" << cached.hits << ",\"misses\":" << cached.misses << ",\"hitRate\":" << (requests != 0 ? (double)cached.hits / requests : 0.0) << ",\"entries\":" << cachedEntries << "}";
+	out << ",\"speedup\":" << (cached.seconds > 0 ? uncached.seconds / cached.seconds : 0);
+	out << ",\"checked\":" << checked.checked << ",\"mismatches\":" << checked.mismatches << ",\"agree\":" << (agree ? "true" : "false") << "}}" << std::endl;
+	return agree;
+}
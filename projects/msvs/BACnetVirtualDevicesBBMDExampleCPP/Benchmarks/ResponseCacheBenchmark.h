@@ -0,0 +1,42 @@
+/*
+ * BACnet Virtual Devices and BBMD Example C++
+ * ----------------------------------------------------------------------------
+ * ResponseCacheBenchmark.h
+ *
+ * Clients polling ReadProperty requests of a hot set of objects while their
+ * values are written, answered by a stand in for the stack through the
+ * property callbacks, without and with the response cache.
+ */
+
+#ifndef __ResponseCacheBenchmark_h__
+#define __ResponseCacheBenchmark_h__
+
+#include <stdint.h>
+#include <ostream>
+
+#include "Benchmarks.h"
+
+class ExampleDatabase;
+class CResponseCache;
+
+class ResponseCacheBenchmarkSettings
+{
+public:
+	uint32_t devicesPerNetwork;
+	uint32_t virtualNetworkCount;
+	uint32_t objectsPerType;		// Of each stored object type, see ExampleDatabase
+	uint32_t hotObjects;			// Objects the clients poll
+	uint32_t requests;
+	uint32_t writePercent;			// Of the requests, followed by a write to a polled object
+	uint32_t capacity;				// Entries of the cache
+};
+
+// Sets up the database, then sends the same requests and writes through the
+// stand in without the cache and with it. Both are run again untimed, they
+// have to send the same answers, and every hit is compared with the answer
+// the stand in gives for it. Its decoding and encoding is far cheaper than
+// the stack's, so the gain is understated. The cache is left disabled and
+// without a change listener. Writes the results as a JSON object on one line.
+bool RunResponseCacheBenchmark(std::ostream& out, const ResponseCacheBenchmarkSettings& settings, ExampleDatabase& database, CResponseCache& cache, const BenchmarkPropertyCallbacks& callbacks);
+
+#endif // __ResponseCacheBenchmark_h__
@@ -0,0 +1,286 @@
+/*
+ * BACnet Virtual Devices and BBMD Example C++
+ * ----------------------------------------------------------------------------
+ * RpmAllBenchmark.cpp
+ *
+ * ReadPropertyMultiple ALL through the property callbacks.
+ */
+
+#include "RpmAllBenchmark.h"
+#include "ExampleDatabase.h"
+
+#include <algorithm>
+#include <chrono>
+#include <string.h>
+#include <vector>
+
+enum RpmAllValueKind
+{
+	RPM_ALL_CHARACTER_STRING,
+	RPM_ALL_ENUMERATED,
+	RPM_ALL_REAL,
+	RPM_ALL_UNSIGNED,
+	RPM_ALL_BOOLEAN
+};
+
+class RpmAllProperty
+{
+public:
+	uint32_t propertyIdentifier;
+	RpmAllValueKind kind;
+	bool isPriorityArray;	// Its size, then each of the 16 slots
+};
+
+// The properties of each object type that the stack asks the callbacks for.
+// The others (Status Flags, Event State, ...) it answers itself.
+static const RpmAllProperty DEVICE_PROPERTIES[] = {
+	{ ExampleConstants::PROPERTY_IDENTIFIER_OBJECT_NAME, RPM_ALL_CHARACTER_STRING, false },
+	{ ExampleConstants::PROPERTY_IDENTIFIER_DESCRIPTION, RPM_ALL_CHARACTER_STRING, false },
+	{ ExampleConstants::PROPERTY_IDENTIFIER_SYSTEM_STATUS, RPM_ALL_ENUMERATED, false }
+};
+static const RpmAllProperty ANALOG_PROPERTIES[] = {
+	{ ExampleConstants::PROPERTY_IDENTIFIER_OBJECT_NAME, RPM_ALL_CHARACTER_STRING, false },
+	{ ExampleConstants::PROPERTY_IDENTIFIER_DESCRIPTION, RPM_ALL_CHARACTER_STRING, false },
+	{ ExampleConstants::PROPERTY_IDENTIFIER_PRESENT_VALUE, RPM_ALL_REAL, false },
+	{ ExampleConstants::PROPERTY_IDENTIFIER_RELIABILITY, RPM_ALL_ENUMERATED, false },
+	{ ExampleConstants::PROPERTY_IDENTIFIER_OUT_OF_SERVICE, RPM_ALL_BOOLEAN, false },
+	{ ExampleConstants::PROPERTY_IDENTIFIER_UNITS, RPM_ALL_ENUMERATED, false }
+};
+static const RpmAllProperty ANALOG_OUTPUT_PROPERTIES[] = {
+	{ ExampleConstants::PROPERTY_IDENTIFIER_OBJECT_NAME, RPM_ALL_CHARACTER_STRING, false },
+	{ ExampleConstants::PROPERTY_IDENTIFIER_DESCRIPTION, RPM_ALL_CHARACTER_STRING, false },
+	{ ExampleConstants::PROPERTY_IDENTIFIER_PRESENT_VALUE, RPM_ALL_REAL, false },
+	{ ExampleConstants::PROPERTY_IDENTIFIER_RELIABILITY, RPM_ALL_ENUMERATED, false },
+	{ ExampleConstants::PROPERTY_IDENTIFIER_OUT_OF_SERVICE, RPM_ALL_BOOLEAN, false },
+	{ ExampleConstants::PROPERTY_IDENTIFIER_UNITS, RPM_ALL_ENUMERATED, false },
+	{ ExampleConstants::PROPERTY_IDENTIFIER_PRIORITY_ARRAY, RPM_ALL_REAL, true },
+	{ ExampleConstants::PROPERTY_IDENTIFIER_RELINQUISH_DEFAULT, RPM_ALL_REAL, false }
+};
+static const RpmAllProperty BINARY_PROPERTIES[] = {
+	{ ExampleConstants::PROPERTY_IDENTIFIER_OBJECT_NAME, RPM_ALL_CHARACTER_STRING, false },
+	{ ExampleConstants::PROPERTY_IDENTIFIER_DESCRIPTION, RPM_ALL_CHARACTER_STRING, false },
+	{ ExampleConstants::PROPERTY_IDENTIFIER_PRESENT_VALUE, RPM_ALL_ENUMERATED, false },
+	{ ExampleConstants::PROPERTY_IDENTIFIER_RELIABILITY, RPM_ALL_ENUMERATED, false },
+	{ ExampleConstants::PROPERTY_IDENTIFIER_OUT_OF_SERVICE, RPM_ALL_BOOLEAN, false }
+};
+static const RpmAllProperty BINARY_OUTPUT_PROPERTIES[] = {
+	{ ExampleConstants::PROPERTY_IDENTIFIER_OBJECT_NAME, RPM_ALL_CHARACTER_STRING, false },
+	{ ExampleConstants::PROPERTY_IDENTIFIER_DESCRIPTION, RPM_ALL_CHARACTER_STRING, false },
+	{ ExampleConstants::PROPERTY_IDENTIFIER_PRESENT_VALUE, RPM_ALL_ENUMERATED, false },
+	{ ExampleConstants::PROPERTY_IDENTIFIER_RELIABILITY, RPM_ALL_ENUMERATED, false },
+	{ ExampleConstants::PROPERTY_IDENTIFIER_OUT_OF_SERVICE, RPM_ALL_BOOLEAN, false },
+	{ ExampleConstants::PROPERTY_IDENTIFIER_PRIORITY_ARRAY, RPM_ALL_ENUMERATED, true },
+	{ ExampleConstants::PROPERTY_IDENTIFIER_RELINQUISH_DEFAULT, RPM_ALL_ENUMERATED, false }
+};
+static const RpmAllProperty MULTI_STATE_PROPERTIES[] = {
+	{ ExampleConstants::PROPERTY_IDENTIFIER_OBJECT_NAME, RPM_ALL_CHARACTER_STRING, false },
+	{ ExampleConstants::PROPERTY_IDENTIFIER_DESCRIPTION, RPM_ALL_CHARACTER_STRING, false },
+	{ ExampleConstants::PROPERTY_IDENTIFIER_PRESENT_VALUE, RPM_ALL_UNSIGNED, false },
+	{ ExampleConstants::PROPERTY_IDENTIFIER_NUMBER_OF_STATES, RPM_ALL_UNSIGNED, false },
+	{ ExampleConstants::PROPERTY_IDENTIFIER_RELIABILITY, RPM_ALL_ENUMERATED, false },
+	{ ExampleConstants::PROPERTY_IDENTIFIER_OUT_OF_SERVICE, RPM_ALL_BOOLEAN, false }
+};
+
+#define RPM_ALL_COUNT(properties) (sizeof(properties) / sizeof(properties[0]))
+
+static void GetProperties(const uint16_t objectType, const RpmAllProperty** properties, size_t* count) {
+	switch (objectType) {
+	case ExampleConstants::OBJECT_TYPE_DEVICE:
+		*properties = DEVICE_PROPERTIES;
+		*count = RPM_ALL_COUNT(DEVICE_PROPERTIES);
+		break;
+	case ExampleConstants::OBJECT_TYPE_ANALOG_OUTPUT:
+		*properties = ANALOG_OUTPUT_PROPERTIES;
+		*count = RPM_ALL_COUNT(ANALOG_OUTPUT_PROPERTIES);
+		break;
+	case ExampleConstants::OBJECT_TYPE_BINARY_INPUT:
+	case ExampleConstants::OBJECT_TYPE_BINARY_VALUE:
+		*properties = BINARY_PROPERTIES;
+		*count = RPM_ALL_COUNT(BINARY_PROPERTIES);
+		break;
+	case ExampleConstants::OBJECT_TYPE_BINARY_OUTPUT:
+		*properties = BINARY_OUTPUT_PROPERTIES;
+		*count = RPM_ALL_COUNT(BINARY_OUTPUT_PROPERTIES);
+		break;
+	case ExampleConstants::OBJECT_TYPE_MULTI_STATE_VALUE:
+		*properties = MULTI_STATE_PROPERTIES;
+		*count = RPM_ALL_COUNT(MULTI_STATE_PROPERTIES);
+		break;
+	default:
+		*properties = ANALOG_PROPERTIES;
+		*count = RPM_ALL_COUNT(ANALOG_PROPERTIES);
+		break;
+	}
+}
+
+template <typename Record>
+static void ListStoredObjects(const ExampleDatabaseObjectStore<Record>& store, std::vector<ExampleDatabaseObjectReference>& objects) {
+	ExampleDatabaseObjectReference object;
+	object.objectType = store.GetObjectType();
+	for (size_t i = 0; i < store.Size(); i++) {
+		object.deviceInstance = store.At(i).deviceInstance;
+		object.objectInstance = store.At(i).instance;
+		objects.push_back(object);
+	}
+}
+
+// FNV-1a over what was read, to compare the two runs
+static void Fold(uint64_t* checksum, const void* data, const size_t length) {
+	const uint8_t* bytes = (const uint8_t*)data;
+	for (size_t i = 0; i < length; i++) {
+		*checksum ^= bytes[i];
+		*checksum *= 1099511628211ull;
+	}
+}
+
+// One property, or one slot of a priority array. Returns whether it was answered.
+static bool ReadProperty(const BenchmarkPropertyCallbacks& callbacks, const ExampleDatabaseObjectReference& object, const uint32_t propertyIdentifier, const RpmAllValueKind kind, const bool useArrayIndex, const uint32_t propertyArrayIndex, uint64_t* checksum) {
+	bool answered = false;
+	switch (kind) {
+	case RPM_ALL_CHARACTER_STRING: {
+		char value[256];
+		uint32_t length = 0;
+		uint8_t encodingType = 0;
+		answered = callbacks.getCharString(object.deviceInstance, object.objectType, object.objectInstance, propertyIdentifier, value, &length, sizeof(value), &encodingType, useArrayIndex, propertyArrayIndex);
+		if (answered) {
+			Fold(checksum, value, length);
+		}
+		break;
+	}
+	case RPM_ALL_ENUMERATED:
+	case RPM_ALL_UNSIGNED: {
+		uint32_t value = 0;
+		answered = kind == RPM_ALL_ENUMERATED ?
+			callbacks.getEnum(object.deviceInstance, object.objectType, object.objectInstance, propertyIdentifier, &value, useArrayIndex, propertyArrayIndex) :
+			callbacks.getUInt(object.deviceInstance, object.objectType, object.objectInstance, propertyIdentifier, &value, useArrayIndex, propertyArrayIndex);
+		if (answered) {
+			Fold(checksum, &value, sizeof(value));
+		}
+		break;
+	}
+	case RPM_ALL_REAL: {
+		float value = 0.0f;
+		answered = callbacks.getReal(object.deviceInstance, object.objectType, object.objectInstance, propertyIdentifier, &value, useArrayIndex, propertyArrayIndex);
+		if (answered) {
+			Fold(checksum, &value, sizeof(value));
+		}
+		break;
+	}
+	case RPM_ALL_BOOLEAN: {
+		bool value = false;
+		answered = callbacks.getBool(object.deviceInstance, object.objectType, object.objectInstance, propertyIdentifier, &value, useArrayIndex, propertyArrayIndex);
+		if (answered) {
+			Fold(checksum, &value, sizeof(value));
+		}
+		break;
+	}
+	}
+	Fold(checksum, &answered, sizeof(answered));
+	return answered;
+}
+
+// One ReadPropertyMultiple ALL in its own tick. Returns the number of
+// callbacks made.
+static uint64_t ReadAll(ExampleDatabase& database, const BenchmarkPropertyCallbacks& callbacks, const ExampleDatabaseObjectReference& object, uint64_t* answered, uint64_t* checksum) {
+	const RpmAllProperty* properties;
+	size_t count;
+	GetProperties(object.objectType, &properties, &count);
+	uint64_t calls = 0;
+	database.lookupMemo.Begin();
+	for (size_t i = 0; i < count; i++) {
+		const RpmAllProperty& property = properties[i];
+		if (!property.isPriorityArray) {
+			*answered += ReadProperty(callbacks, object, property.propertyIdentifier, property.kind, false, 0, checksum) ? 1 : 0;
+			calls++;
+			continue;
+		}
+		*answered += ReadProperty(callbacks, object, property.propertyIdentifier, RPM_ALL_UNSIGNED, true, 0, checksum) ? 1 : 0;
+		for (uint32_t slot = 1; slot <= ExampleDatabaseBaseObject::PRIORITY_ARRAY_LENGTH; slot++) {
+			*answered += ReadProperty(callbacks, object, property.propertyIdentifier, property.kind, true, slot, checksum) ? 1 : 0;
+		}
+		calls += 1 + ExampleDatabaseBaseObject::PRIORITY_ARRAY_LENGTH;
+	}
+	database.lookupMemo.End();
+	return calls;
+}
+
+class RpmAllRun
+{
+public:
+	double seconds;
+	uint64_t calls;
+	uint64_t answered;
+	uint64_t checksum;
+};
+
+static void Run(ExampleDatabase& database, const BenchmarkPropertyCallbacks& callbacks, const std::vector<ExampleDatabaseObjectReference>& objects, const uint32_t passes, RpmAllRun* run) {
+	run->calls = 0;
+	run->answered = 0;
+	run->checksum = 14695981039346656037ull;
+	std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+	for (uint32_t pass = 0; pass < passes; pass++) {
+		for (size_t i = 0; i < objects.size(); i++) {
+			run->calls += ReadAll(database, callbacks, objects[i], &run->answered, &run->checksum);
+		}
+	}
+	run->seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+}
+
+bool RunRpmAllBenchmark(std::ostream& out, const RpmAllBenchmarkSettings& settings, ExampleDatabase& database, const BenchmarkPropertyCallbacks& callbacks) {
+	database.devicesPerNetwork = settings.devicesPerNetwork;
+	database.virtualNetworkCount = settings.virtualNetworkCount;
+	database.objectsPerType = settings.objectsPerType;
+	database.trendLogIntervalSeconds = 0;
+	database.Setup();
+
+	// The virtual devices and all of their objects, read in a random order
+	std::vector<ExampleDatabaseObjectReference> objects;
+	std::vector<ExampleDatabaseVirtualDeviceEntry> entries;
+	database.GetVirtualDeviceList(entries);
+	ExampleDatabaseObjectReference object;
+	object.objectType = ExampleConstants::OBJECT_TYPE_DEVICE;
+	for (size_t i = 0; i < entries.size(); i++) {
+		object.deviceInstance = entries[i].deviceInstance;
+		object.objectInstance = entries[i].deviceInstance;
+		objects.push_back(object);
+	}
+	ListStoredObjects(database.analogInputs, objects);
+	ListStoredObjects(database.analogOutputs, objects);
+	ListStoredObjects(database.binaryOutputs, objects);
+	ListStoredObjects(database.binaryInputs, objects);
+	ListStoredObjects(database.binaryValues, objects);
+	ListStoredObjects(database.multiStateValues, objects);
+	ListStoredObjects(database.analogValues, objects);
+	if (objects.empty() || settings.passes == 0) {
+		return false;
+	}
+	uint32_t seed = 12345;
+	for (size_t i = objects.size() - 1; i > 0; i--) {
+		seed = seed * 1103515245 + 12345;
+		std::swap(objects[i], objects[(seed >> 8) % (i + 1)]);
+	}
+
+	const bool wasEnabled = database.lookupMemo.IsEnabled();
+	RpmAllRun lookups;
+	database.lookupMemo.SetEnabled(false);
+	Run(database, callbacks, objects, settings.passes, &lookups);
+
+	RpmAllRun memo;
+	database.lookupMemo.SetEnabled(true);
+	const uint64_t hits = database.lookupMemo.GetHits();
+	const uint64_t misses = database.lookupMemo.GetMisses();
+	Run(database, callbacks, objects, settings.passes, &memo);
+	const uint64_t memoHits = database.lookupMemo.GetHits() - hits;
+	const uint64_t memoMisses = database.lookupMemo.GetMisses() - misses;
+	database.lookupMemo.SetEnabled(wasEnabled);
+
+	const bool agree = lookups.calls == memo.calls && lookups.answered == memo.answered && lookups.checksum == memo.checksum;
+	const double rpmCount = (double)objects.size() * settings.passes;
+	out << "{\"rpmAll\":{\"objects\":" << objects.size() << ",\"passes\":" << settings.passes;
+	out << ",\"callbacksPerObject\":" << lookups.calls / rpmCount << ",\"answeredPerObject\":" << lookups.answered / rpmCount;
+	out << ",\"lookups\":{\"objectsPerSecond\":" << (uint64_t)(rpmCount / lookups.seconds) << ",\"nsPerCallback\":" << lookups.seconds * 1e9 / lookups.calls << "}";
+	out << ",\"memo\":{\"objectsPerSecond\":" << (uint64_t)(rpmCount / memo.seconds) << ",\"nsPerCallback\":" << memo.seconds * 1e9 / memo.calls;
+	out << ",\"hits\":" << memoHits << ",\"misses\":" << memoMisses << "}";
+	out << ",\"speedup\":" << (memo.seconds > 0 ? lookups.seconds / memo.seconds : 0) << ",\"agree\":" << (agree ? "true" : "false") << "}}" << std::endl;
+	return agree;
+}
@@ -0,0 +1,36 @@
+/*
+ * BACnet Virtual Devices and BBMD Example C++
+ * ----------------------------------------------------------------------------
+ * RpmAllBenchmark.h
+ *
+ * ReadPropertyMultiple for ALL the properties of an object, through the
+ * property callbacks, with and without the lookup memo of the database.
+ */
+
+#ifndef __RpmAllBenchmark_h__
+#define __RpmAllBenchmark_h__
+
+#include <stdint.h>
+#include <ostream>
+
+#include "Benchmarks.h"
+
+class ExampleDatabase;
+
+class RpmAllBenchmarkSettings
+{
+public:
+	uint32_t devicesPerNetwork;
+	uint32_t virtualNetworkCount;
+	uint32_t objectsPerType;		// Of each stored object type, see ExampleDatabase
+	uint32_t passes;				// Over every object of the database
+};
+
+// Sets up the database the callbacks read from, then reads every property
+// the stack asks the callbacks for in a ReadPropertyMultiple ALL, one object
+// per tick in a random order: passes times over every object with the memo
+// off, then on. Both have to read the same values. Writes the results as a
+// JSON object on one line.
+bool RunRpmAllBenchmark(std::ostream& out, const RpmAllBenchmarkSettings& settings, ExampleDatabase& database, const BenchmarkPropertyCallbacks& callbacks);
+
+#endif // __RpmAllBenchmark_h__
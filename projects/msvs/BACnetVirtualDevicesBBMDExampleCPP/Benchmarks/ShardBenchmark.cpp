@@ -0,0 +1,232 @@
+/*
+ * BACnet Virtual Devices and BBMD Example C++
+ * ----------------------------------------------------------------------------
+ * ShardBenchmark.cpp
+ *
+ * Requests per second of a sharded front end and its workers.
+ */
+
+#include "ShardBenchmark.h"
+#include "ShardRouter.h"
+#include "SimpleUDP.h"
+#include "ExampleDatabase.h"
+
+#include <chrono>
+#include <string.h>
+#include <vector>
+
+#ifndef _WIN32
+#include <poll.h>
+#include <signal.h>
+#include <sys/types.h>
+#include <sys/wait.h>
+#include <unistd.h>
+#ifdef __linux__
+#include <sys/prctl.h>
+#endif // __linux__
+#endif // _WIN32
+
+#define SHARD_BENCHMARK_WARMUP_MILLISECONDS		300
+#define SHARD_BENCHMARK_POLL_MILLISECONDS		100
+
+#ifndef _WIN32
+// Keeps window ReadProperty requests in flight, to the virtual networks in
+// turn. Lost requests are replaced when nothing has come back for a while.
+static void RunClient(const ShardBenchmarkSettings& settings) {
+#ifdef __linux__
+	prctl(PR_SET_PDEATHSIG, SIGTERM);
+#endif // __linux__
+	CSimpleUDP udp;
+	if (!udp.Connect(settings.port + 1, true, "127.0.0.1")) {
+		_exit(1);
+	}
+	const unsigned char frontEnd[4] = { 127, 0, 0, 1 };
+
+	// BVLC Original-Unicast-NPDU, NPDU to DNET expecting a reply, then a
+	// confirmed ReadProperty of the present value of analog-input 1
+	unsigned char request[] = {
+		0x81, 0x0A, 0x00, 0x00,
+		0x01, 0x24, 0x00, 0x00, 0x00, 0xFF,
+		0x00, 0x05, 0x00, 0x0C,
+		0x0C, 0x00, 0x00, 0x00, 0x01,
+		0x19, 0x55 };
+	request[3] = sizeof(request);
+	uint32_t next = 0;
+
+	struct pollfd readable;
+	readable.fd = udp.GetSocket();
+	readable.events = POLLIN;
+	unsigned char reply[SHARD_ROUTER_MAX_MESSAGE_LENGTH];
+	for (uint32_t sent = 0;;) {
+		// Fill the window, all of it after a timeout
+		for (; sent < settings.window; sent++, next++) {
+			uint16_t network = (uint16_t)(STARTING_VIRTUAL_NETWORK + (next % settings.networkCount) * VIRTUAL_NETWORK_OFFSET);
+			request[6] = (unsigned char)(network >> 8);
+			request[7] = (unsigned char)(network & 0xFF);
+			request[12] = (unsigned char)next;
+			udp.SendTo(frontEnd, settings.port, request, sizeof(request));
+		}
+		readable.revents = 0;
+		if (poll(&readable, 1, SHARD_BENCHMARK_POLL_MILLISECONDS) <= 0) {
+			sent = 0;
+			continue;
+		}
+		unsigned char address[4];
+		unsigned short port;
+		while (sent > 0 && udp.ReceiveFrom(reply, sizeof(reply), address, &port) > 0) {
+			sent--;
+		}
+	}
+}
+
+// Answers each request from the virtual network it was sent to, after
+// spinning for workMicroseconds like the stack would while it decodes the
+// request, reads the property and encodes the answer
+static void RunWorker(CShardWorker& worker, const ShardBenchmarkSettings& settings) {
+	uint8_t message[SHARD_ROUTER_MAX_MESSAGE_LENGTH];
+	struct pollfd readable;
+	readable.fd = worker.GetSocket();
+	readable.events = POLLIN;
+	for (;;) {
+		ShardMessageHeader header;
+		int length = worker.Receive(message, sizeof(message), &header);
+		if (length < 0) {
+			return;
+		}
+		if (length == 0) {
+			readable.revents = 0;
+			poll(&readable, 1, SHARD_BENCHMARK_POLL_MILLISECONDS);
+			continue;
+		}
+		if (length < 13) {
+			continue;
+		}
+
+		std::chrono::steady_clock::time_point done = std::chrono::steady_clock::now() + std::chrono::microseconds(settings.workMicroseconds);
+		while (std::chrono::steady_clock::now() < done) {
+		}
+
+		// BVLC, NPDU from SNET, ComplexAck of the present value, 0.0
+		uint8_t reply[] = {
+			0x81, 0x0A, 0x00, 0x00,
+			0x01, 0x08, message[6], message[7], 0x01, 0x01,
+			0x30, message[12], 0x0C,
+			0x0C, 0x00, 0x00, 0x00, 0x01,
+			0x19, 0x55,
+			0x3E, 0x44, 0x00, 0x00, 0x00, 0x00, 0x3F };
+		reply[3] = sizeof(reply);
+		header.broadcast = 0;
+		header.destinationConnectionStringLength = 0;
+		if (!worker.Send(reply, sizeof(reply), header)) {
+			return;
+		}
+	}
+}
+#endif // _WIN32
+
+bool RunShardBenchmark(std::ostream& out, const ShardBenchmarkSettings& settings) {
+#ifndef _WIN32
+	if (settings.workerCount == 0 || settings.networkCount == 0 || settings.window == 0) {
+		return false;
+	}
+	CSimpleUDP udp;
+	if (!udp.Connect(settings.port, true, "127.0.0.1")) {
+		return false;
+	}
+	out.flush();
+
+	pid_t client = fork();
+	if (client == 0) {
+		RunClient(settings);
+		_exit(0);
+	}
+	if (client < 0) {
+		return false;
+	}
+
+	CShardFrontEnd frontEnd;
+	CShardWorker worker;
+	int shardIndex = frontEnd.Start(settings.workerCount, &worker);
+	if (worker.IsOpen()) {
+		RunWorker(worker, settings);
+		_exit(0);
+	}
+	if (shardIndex < 0) {
+		kill(client, SIGTERM);
+		waitpid(client, NULL, 0);
+		return false;
+	}
+
+	std::vector<struct pollfd> readable(settings.workerCount + 1);
+	readable[0].fd = udp.GetSocket();
+	for (uint32_t index = 0; index < settings.workerCount; index++) {
+		readable[index + 1].fd = frontEnd.GetSocket(index);
+	}
+	for (size_t index = 0; index < readable.size(); index++) {
+		readable[index].events = POLLIN;
+	}
+
+	uint8_t message[SHARD_ROUTER_MAX_MESSAGE_LENGTH];
+	uint64_t requests = 0;
+	uint64_t replies = 0;
+	bool measuring = false;
+	std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now() + std::chrono::milliseconds(SHARD_BENCHMARK_WARMUP_MILLISECONDS);
+	std::chrono::steady_clock::time_point end = start + std::chrono::milliseconds(settings.durationMilliseconds);
+	std::chrono::steady_clock::time_point now;
+	while ((now = std::chrono::steady_clock::now()) < end) {
+		if (!measuring && now >= start) {
+			measuring = true;
+			requests = 0;
+			replies = 0;
+		}
+		poll(&readable[0], (nfds_t)readable.size(), SHARD_BENCHMARK_POLL_MILLISECONDS);
+
+		// From the network to the workers
+		for (int i = 0; i < SHARD_ROUTER_FORWARD_BATCH; i++) {
+			ShardMessageHeader header;
+			unsigned short port;
+			int length = udp.ReceiveFrom(message, sizeof(message), header.connectionString, &port);
+			if (length <= 0) {
+				break;
+			}
+			header.networkType = 0;
+			header.broadcast = 0;
+			header.connectionStringLength = 6;
+			header.connectionString[4] = (uint8_t)(port / 256);
+			header.connectionString[5] = (uint8_t)(port % 256);
+			header.destinationConnectionStringLength = 0;
+			frontEnd.Forward(message, (uint16_t)length, header);
+			requests++;
+		}
+
+		// From the workers to the network
+		for (int i = 0; i < SHARD_ROUTER_FORWARD_BATCH; i++) {
+			ShardMessageHeader header;
+			int length = frontEnd.Receive(message, sizeof(message), &header);
+			if (length <= 0) {
+				break;
+			}
+			udp.SendTo(header.connectionString, (unsigned short)(header.connectionString[4] * 256 + header.connectionString[5]), message, (unsigned short)length);
+			replies++;
+		}
+	}
+	double seconds = std::chrono::duration<double>(now - start).count();
+
+	kill(client, SIGTERM);
+	waitpid(client, NULL, 0);
+
+	out << "{\"shardBenchmark\":{\"workers\":" << settings.workerCount << ",\"networks\":" << settings.networkCount;
+	out << ",\"window\":" << settings.window << ",\"workUs\":" << settings.workMicroseconds;
+	out << ",\"seconds\":" << seconds << ",\"requests\":" << requests << ",\"replies\":" << replies;
+	out << ",\"repliesPerSecond\":" << (uint64_t)(replies / seconds);
+	out << ",\"meanLatencyUs\":" << (replies > 0 ? settings.window * seconds * 1e6 / replies : 0);
+	out << "}}" << std::endl;
+	frontEnd.Report(out);
+	frontEnd.Stop();
+	return replies > 0;
+#else
+	(void)out;
+	(void)settings;
+	return false;
+#endif // _WIN32
+}
@@ -0,0 +1,36 @@
+/*
+ * BACnet Virtual Devices and BBMD Example C++
+ * ----------------------------------------------------------------------------
+ * ShardBenchmark.h
+ *
+ * Throughput of the sharded deployment: confirmed requests per second that a
+ * front end routes by DNET to its workers and answers, for a number of
+ * workers.
+ */
+
+#ifndef __ShardBenchmark_h__
+#define __ShardBenchmark_h__
+
+#include <stdint.h>
+#include <ostream>
+
+class ShardBenchmarkSettings
+{
+public:
+	uint32_t workerCount;
+	uint32_t networkCount;			// Virtual networks 1000, 2000, ... the requests go to in turn
+	uint32_t window;				// Requests the client keeps in flight
+	uint32_t workMicroseconds;		// Time a worker spends on each request, in place of the stack
+	uint32_t durationMilliseconds;
+	uint16_t port;					// UDP port of the front end on 127.0.0.1, the client uses the next one
+};
+
+// Forks a client process and the workers. The client sends ReadProperty
+// requests to the front end over UDP loopback and sends a new one for each
+// answer. The front end routes them with CShardFrontEnd, each worker spins
+// for workMicroseconds and answers from its virtual network. Linux only.
+// Writes the results as a JSON object on one line, followed by the report
+// of the front end on the next line.
+bool RunShardBenchmark(std::ostream& out, const ShardBenchmarkSettings& settings);
+
+#endif // __ShardBenchmark_h__
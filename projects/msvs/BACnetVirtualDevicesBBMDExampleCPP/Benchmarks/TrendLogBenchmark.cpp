@@ -0,0 +1,166 @@
+/*
+ * BACnet Virtual Devices and BBMD Example C++
+ * ----------------------------------------------------------------------------
+ * TrendLogBenchmark.cpp
+ *
+ * Compressed trend log against an uncompressed ring of records.
+ */
+
+#include "TrendLogBenchmark.h"
+#include "TrendLog.h"
+
+#include <chrono>
+#include <math.h>
+#include <vector>
+
+// Record of the uncompressed ring, the way a log buffer is usually kept
+class TrendLogBenchmarkRecord
+{
+public:
+	uint64_t timestamp;
+	float value;
+	uint32_t statusFlags;
+};
+
+// Uncompressed ring of records. The sequence number of a record follows from
+// its position.
+class CTrendLogBenchmarkRing
+{
+public:
+	CTrendLogBenchmarkRing(const size_t capacity) {
+		this->m_records.resize(capacity);
+		this->m_count = 0;
+		this->m_total = 0;
+	}
+
+	void Add(const uint64_t timestamp, const float value) {
+		TrendLogBenchmarkRecord& record = this->m_records[this->m_total % this->m_records.size()];
+		record.timestamp = timestamp;
+		record.value = value;
+		record.statusFlags = 0;
+		this->m_total++;
+		if (this->m_count < this->m_records.size()) {
+			this->m_count++;
+		}
+	}
+
+	uint32_t ReadBySequenceNumber(const uint64_t firstSequenceNumber, const uint32_t count, TrendLogRecord* records) const {
+		uint64_t oldest = this->m_total - this->m_count + 1;
+		uint64_t sequenceNumber = firstSequenceNumber < oldest ? oldest : firstSequenceNumber;
+		uint32_t read = 0;
+		for (; sequenceNumber <= this->m_total && read < count; sequenceNumber++) {
+			const TrendLogBenchmarkRecord& record = this->m_records[(sequenceNumber - 1) % this->m_records.size()];
+			records[read].sequenceNumber = sequenceNumber;
+			records[read].timestamp = record.timestamp;
+			records[read].value = record.value;
+			read++;
+		}
+		return read;
+	}
+
+	uint32_t ReadByTime(const uint64_t timestamp, const uint32_t count, TrendLogRecord* records) const {
+		uint64_t low = this->m_total - this->m_count + 1;
+		uint64_t high = this->m_total + 1;
+		while (low < high) {
+			uint64_t middle = low + (high - low) / 2;
+			if (this->m_records[(middle - 1) % this->m_records.size()].timestamp < timestamp) {
+				low = middle + 1;
+			}
+			else {
+				high = middle;
+			}
+		}
+		return this->ReadBySequenceNumber(low, count, records);
+	}
+
+	size_t GetMemoryUsage() const {
+		return sizeof(CTrendLogBenchmarkRing) + this->m_records.capacity() * sizeof(TrendLogBenchmarkRecord);
+	}
+
+private:
+	std::vector<TrendLogBenchmarkRecord> m_records;
+	size_t m_count;
+	uint64_t m_total;
+};
+
+// Small deterministic generator so that every run logs the same samples
+static uint32_t TrendLogBenchmarkRandom(uint32_t* state) {
+	*state = *state * 1664525 + 1013904223;
+	return *state >> 8;
+}
+
+template <typename Log>
+static uint64_t TrendLogBenchmarkRead(const Log& log, const bool byTime, const uint64_t firstTimestamp, const uint32_t sampleCount, const uint32_t readCount, const uint32_t windowLength, uint64_t* checksum) {
+	std::vector<TrendLogRecord> records(windowLength);
+	uint32_t state = 7;
+	std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+	for (uint32_t i = 0; i < readCount; i++) {
+		uint32_t position = TrendLogBenchmarkRandom(&state) % (sampleCount - windowLength);
+		uint32_t read;
+		if (byTime) {
+			read = log.ReadByTime(firstTimestamp + (uint64_t)position * 60000, windowLength, records.data());
+		}
+		else {
+			read = log.ReadBySequenceNumber(position + 1, windowLength, records.data());
+		}
+		*checksum += read + records[0].sequenceNumber;
+	}
+	return (uint64_t)std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::steady_clock::now() - start).count();
+}
+
+bool RunTrendLogBenchmark(std::ostream& out, const uint32_t sampleCount, const uint32_t readCount, const uint32_t windowLength)
+{
+	if (windowLength == 0 || sampleCount <= windowLength || readCount == 0) {
+		return false;
+	}
+
+	// Sized so that neither log drops samples
+	CTrendLog trendLog;
+	trendLog.SetCapacity((size_t)sampleCount * sizeof(TrendLogBenchmarkRecord));
+	CTrendLogBenchmarkRing ring(sampleCount);
+
+	// A room temperature with a daily swing and sensor noise, read with a
+	// resolution of 0.1. The log interval is one minute with a little
+	// scheduling jitter on some of the samples.
+	const uint64_t firstTimestamp = 1700000000000ULL;
+	uint32_t state = 1;
+	for (uint32_t i = 0; i < sampleCount; i++) {
+		uint64_t timestamp = firstTimestamp + (uint64_t)i * 60000;
+		if (TrendLogBenchmarkRandom(&state) % 10 == 0) {
+			timestamp += TrendLogBenchmarkRandom(&state) % 50;
+		}
+		double temperature = 21.0 + 2.0 * sin(i * 2.0 * 3.14159265 / 1440) + (double)(TrendLogBenchmarkRandom(&state) % 5) / 10.0;
+		float value = (float)(floor(temperature * 10.0 + 0.5) / 10.0);
+		trendLog.Add(timestamp, value);
+		ring.Add(timestamp, value);
+	}
+
+	// Check that the compressed log decodes to the same records
+	std::vector<TrendLogRecord> expected(windowLength);
+	std::vector<TrendLogRecord> actual(windowLength);
+	for (uint32_t position = 0; position + windowLength <= sampleCount; position += windowLength) {
+		ring.ReadBySequenceNumber(position + 1, windowLength, expected.data());
+		if (trendLog.ReadBySequenceNumber(position + 1, windowLength, actual.data()) != windowLength) {
+			return false;
+		}
+		for (uint32_t i = 0; i < windowLength; i++) {
+			if (actual[i].sequenceNumber != expected[i].sequenceNumber || actual[i].timestamp != expected[i].timestamp || actual[i].value != expected[i].value) {
+				return false;
+			}
+		}
+	}
+
+	uint64_t checksum = 0;
+	uint64_t compressedSequenceNanoseconds = TrendLogBenchmarkRead(trendLog, false, firstTimestamp, sampleCount, readCount, windowLength, &checksum);
+	uint64_t compressedTimeNanoseconds = TrendLogBenchmarkRead(trendLog, true, firstTimestamp, sampleCount, readCount, windowLength, &checksum);
+	uint64_t ringSequenceNanoseconds = TrendLogBenchmarkRead(ring, false, firstTimestamp, sampleCount, readCount, windowLength, &checksum);
+	uint64_t ringTimeNanoseconds = TrendLogBenchmarkRead(ring, true, firstTimestamp, sampleCount, readCount, windowLength, &checksum);
+
+	out << "{\"trendLog\":{\"samples\":" << sampleCount << ",\"window\":" << windowLength << ",\"reads\":" << readCount << ",\"checksum\":" << checksum << ",\"results\":[";
+	out << "{\"storage\":\"compressed\",\"bytesPer1000Samples\":" << (uint64_t)trendLog.GetMemoryUsage() * 1000 / sampleCount
+		<< ",\"readBySequenceNs\":" << compressedSequenceNanoseconds / readCount << ",\"readByTimeNs\":" << compressedTimeNanoseconds / readCount << "},";
+	out << "{\"storage\":\"uncompressed\",\"bytesPer1000Samples\":" << (uint64_t)ring.GetMemoryUsage() * 1000 / sampleCount
+		<< ",\"readBySequenceNs\":" << ringSequenceNanoseconds / readCount << ",\"readByTimeNs\":" << ringTimeNanoseconds / readCount << "}";
+	out << "]}}" << std::endl;
+	return true;
+}
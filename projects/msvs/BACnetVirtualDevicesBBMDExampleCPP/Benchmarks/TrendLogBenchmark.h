@@ -0,0 +1,22 @@
+/*
+ * BACnet Virtual Devices and BBMD Example C++
+ * ----------------------------------------------------------------------------
+ * TrendLogBenchmark.h
+ *
+ * Compares the compressed trend log against an uncompressed ring of records:
+ * memory per 1000 samples and the latency of a ReadRange by sequence number
+ * and by time.
+ */
+
+#ifndef __TrendLogBenchmark_h__
+#define __TrendLogBenchmark_h__
+
+#include <stdint.h>
+#include <ostream>
+
+// Logs sampleCount samples of a simulated temperature, one per minute, then
+// runs readCount ReadRange requests of windowLength records at random
+// positions. Writes the results as a single JSON object on one line.
+bool RunTrendLogBenchmark(std::ostream& out, const uint32_t sampleCount, const uint32_t readCount, const uint32_t windowLength);
+
+#endif // __TrendLogBenchmark_h__
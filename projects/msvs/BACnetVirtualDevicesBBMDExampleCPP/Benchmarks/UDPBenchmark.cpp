@@ -0,0 +1,128 @@
+/*
+ * BACnet Virtual Devices and BBMD Example C++
+ * ----------------------------------------------------------------------------
+ * UDPBenchmark.cpp
+ *
+ * Loopback benchmark of the IPv4 and IPv6 UDP paths.
+ */
+
+#include "UDPBenchmark.h"
+#include "SimpleUDP.h"
+
+#include <chrono>
+
+// Result of one transport and mode
+class UDPBenchmarkResult
+{
+public:
+	const char* transport;
+	const char* mode;
+	uint32_t messages;
+	uint64_t durationNanoseconds;
+};
+
+// Sends messageCount datagrams to the socket itself and reads them back. At
+// most one batch is in flight at a time so that the socket buffer never drops.
+static bool RunUDPLoopbackBenchmarkCase(CSimpleUDP& udp, const unsigned char* address, const uint16_t port, const uint32_t messageCount, const uint16_t messageLength, const int batchSize, UDPBenchmarkResult* result)
+{
+	static unsigned char sendBuffers[SIMPLE_UDP_MAX_BATCH][1500];
+	static unsigned char receiveBuffers[SIMPLE_UDP_MAX_BATCH][1500];
+	SimpleUDPDatagram sendDatagrams[SIMPLE_UDP_MAX_BATCH];
+	SimpleUDPDatagram receiveDatagrams[SIMPLE_UDP_MAX_BATCH];
+	for (int i = 0; i < SIMPLE_UDP_MAX_BATCH; i++) {
+		memset(sendBuffers[i], i, messageLength);
+		sendDatagrams[i].buffer = sendBuffers[i];
+		sendDatagrams[i].maxLength = sizeof(sendBuffers[i]);
+		sendDatagrams[i].length = messageLength;
+		memcpy(sendDatagrams[i].address, address, udp.GetAddressLength());
+		sendDatagrams[i].port = port;
+		receiveDatagrams[i].buffer = receiveBuffers[i];
+		receiveDatagrams[i].maxLength = sizeof(receiveBuffers[i]);
+	}
+
+	unsigned char fromAddress[SIMPLE_UDP_MAX_ADDRESS_LENGTH];
+	unsigned short fromPort;
+	uint32_t received = 0;
+	std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+	while (received < messageCount) {
+		int inFlight = (int)(messageCount - received < (uint32_t)batchSize ? messageCount - received : (uint32_t)batchSize);
+		if (batchSize == 1) {
+			if (!udp.SendTo(address, port, sendBuffers[0], messageLength)) {
+				return false;
+			}
+		}
+		else if (udp.SendBatch(sendDatagrams, inFlight) != inFlight) {
+			return false;
+		}
+
+		// Busy poll until the whole batch is back
+		int pending = inFlight;
+		while (pending > 0) {
+			int count;
+			if (batchSize == 1) {
+				count = udp.ReceiveFrom(receiveBuffers[0], sizeof(receiveBuffers[0]), fromAddress, &fromPort) > 0 ? 1 : 0;
+			}
+			else {
+				count = udp.ReceiveBatch(receiveDatagrams, pending);
+			}
+			if (count < 0) {
+				return false;
+			}
+			pending -= count;
+		}
+		received += inFlight;
+	}
+	result->messages = received;
+	result->durationNanoseconds = (uint64_t)std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::steady_clock::now() - start).count();
+	return true;
+}
+
+bool RunUDPLoopbackBenchmark(std::ostream& out, const uint32_t messageCount, const uint16_t messageLength, const uint16_t port)
+{
+	static const unsigned char loopbackIPv4[4] = { 127, 0, 0, 1 };
+	static const unsigned char loopbackIPv6[16] = { 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 1 };
+	if (messageLength == 0 || messageLength > 1500) {
+		return false;
+	}
+
+	UDPBenchmarkResult results[4];
+	size_t resultCount = 0;
+	for (int transport = 0; transport < 2; transport++) {
+		CSimpleUDP udp;
+		const unsigned char* address;
+		if (transport == 0) {
+			if (!udp.Connect(port, true, "127.0.0.1")) {
+				return false;
+			}
+			address = loopbackIPv4;
+		}
+		else {
+			if (!udp.ConnectIPv6(port)) {
+				return false;
+			}
+			address = loopbackIPv6;
+		}
+
+		for (int mode = 0; mode < 2; mode++) {
+			UDPBenchmarkResult& result = results[resultCount++];
+			result.transport = transport == 0 ? "ipv4" : "ipv6";
+			result.mode = mode == 0 ? "single" : "batch";
+			if (!RunUDPLoopbackBenchmarkCase(udp, address, port, messageCount, messageLength, mode == 0 ? 1 : SIMPLE_UDP_MAX_BATCH, &result)) {
+				return false;
+			}
+		}
+	}
+
+	out << "{\"udpBenchmark\":{\"messages\":" << messageCount << ",\"length\":" << messageLength << ",\"batch\":" << SIMPLE_UDP_MAX_BATCH << ",\"results\":[";
+	for (size_t i = 0; i < resultCount; i++) {
+		const UDPBenchmarkResult& result = results[i];
+		uint64_t nanosecondsPerMessage = result.messages > 0 ? result.durationNanoseconds / result.messages : 0;
+		uint64_t messagesPerSecond = result.durationNanoseconds > 0 ? (uint64_t)result.messages * 1000000000ull / result.durationNanoseconds : 0;
+		if (i > 0) {
+			out << ",";
+		}
+		out << "{\"transport\":\"" << result.transport << "\",\"mode\":\"" << result.mode << "\",\"nsPerMessage\":" << nanosecondsPerMessage << ",\"messagesPerSecond\":" << messagesPerSecond << "}";
+	}
+	out << "]}}" << std::endl;
+	return true;
+}
@@ -0,0 +1,21 @@
+/*
+ * BACnet Virtual Devices and BBMD Example C++
+ * ----------------------------------------------------------------------------
+ * UDPBenchmark.h
+ *
+ * Loopback benchmark of the IPv4 and IPv6 UDP paths of CSimpleUDP. Each
+ * transport is measured with one datagram per system call and with batches
+ * of SIMPLE_UDP_MAX_BATCH datagrams.
+ */
+
+#ifndef __UDPBenchmark_h__
+#define __UDPBenchmark_h__
+
+#include <stdint.h>
+#include <ostream>
+
+// Runs the benchmark and writes the results as a single JSON object on one
+// line. Returns false if a socket could not be opened.
+bool RunUDPLoopbackBenchmark(std::ostream& out, const uint32_t messageCount, const uint16_t messageLength, const uint16_t port);
+
+#endif // __UDPBenchmark_h__
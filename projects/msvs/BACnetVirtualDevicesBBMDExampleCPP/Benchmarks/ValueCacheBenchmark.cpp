@@ -0,0 +1,94 @@
+/*
+ * BACnet Virtual Devices and BBMD Example C++
+ * ----------------------------------------------------------------------------
+ * ValueCacheBenchmark.cpp
+ *
+ * Stale-while-revalidate value cache against a simulated slow backend.
+ */
+
+#include "ValueCacheBenchmark.h"
+#include "ValueCache.h"
+#include "LatencyHistogram.h"
+
+#include <random>
+#include <thread>
+
+#define VALUE_CACHE_BENCHMARK_DEVICE_BASE	389000
+#define VALUE_CACHE_BENCHMARK_ANALOG_INPUT	0
+#define VALUE_CACHE_BENCHMARK_BATCH			100		// Reads between two sleeps
+
+bool RunValueCacheBenchmark(std::ostream& out, const ValueCacheBenchmarkSettings& settings) {
+	if (settings.pointCount == 0 || settings.readsPerSecond == 0) {
+		return false;
+	}
+	CLatencyClock::Calibrate();
+
+	CSimulatedValueCacheBackend backend(settings.backendMinimumMilliseconds, settings.backendMaximumMilliseconds);
+	CValueCache cache;
+	for (uint32_t point = 0; point < settings.pointCount; point++) {
+		cache.Add(VALUE_CACHE_BENCHMARK_DEVICE_BASE + point, VALUE_CACHE_BENCHMARK_ANALOG_INPUT, 0, 0.0f);
+	}
+	if (!cache.Start(&backend, settings.ttlMilliseconds, settings.workerCount, settings.deadlineMilliseconds)) {
+		return false;
+	}
+
+	// What a read would cost without the cache, one backend round trip
+	std::chrono::steady_clock::time_point directStart = std::chrono::steady_clock::now();
+	const uint32_t directReads = 10;
+	for (uint32_t i = 0; i < directReads; i++) {
+		float value;
+		backend.Read(VALUE_CACHE_BENCHMARK_DEVICE_BASE, VALUE_CACHE_BENCHMARK_ANALOG_INPUT, 0, std::chrono::steady_clock::time_point::max(), &value);
+	}
+	double directMilliseconds = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - directStart).count() / directReads;
+
+	std::mt19937 random(1);
+	std::uniform_int_distribution<uint32_t> pointDistribution(0, settings.pointCount - 1);
+	CLatencyHistogram readLatency;
+	uint64_t reads = 0;
+	uint64_t freshReads = 0;
+	uint64_t totalAgeMilliseconds = 0;
+	uint64_t maxAgeMilliseconds = 0;
+
+	std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+	std::chrono::steady_clock::time_point end = start + std::chrono::milliseconds(settings.durationMilliseconds);
+	std::chrono::nanoseconds batchInterval((uint64_t)1000000000 * VALUE_CACHE_BENCHMARK_BATCH / settings.readsPerSecond);
+	std::chrono::steady_clock::time_point nextBatch = start;
+	while (std::chrono::steady_clock::now() < end) {
+		for (uint32_t i = 0; i < VALUE_CACHE_BENCHMARK_BATCH; i++) {
+			float value;
+			uint64_t ageMilliseconds;
+			uint64_t readStart = CLatencyClock::Now();
+			if (!cache.Get(VALUE_CACHE_BENCHMARK_DEVICE_BASE + pointDistribution(random), VALUE_CACHE_BENCHMARK_ANALOG_INPUT, 0, &value, &ageMilliseconds)) {
+				cache.Stop();
+				return false;
+			}
+			readLatency.Record(CLatencyClock::Now() - readStart);
+			reads++;
+			if (ageMilliseconds <= settings.ttlMilliseconds) {
+				freshReads++;
+			}
+			totalAgeMilliseconds += ageMilliseconds;
+			if (ageMilliseconds > maxAgeMilliseconds) {
+				maxAgeMilliseconds = ageMilliseconds;
+			}
+		}
+		nextBatch += batchInterval;
+		std::this_thread::sleep_until(nextBatch);
+	}
+	double seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+
+	out << "{\"valueCacheBenchmark\":{\"points\":" << settings.pointCount << ",\"workers\":" << settings.workerCount;
+	out << ",\"ttlMs\":" << settings.ttlMilliseconds << ",\"deadlineMs\":" << settings.deadlineMilliseconds;
+	out << ",\"backendMs\":[" << settings.backendMinimumMilliseconds << "," << settings.backendMaximumMilliseconds << "]";
+	out << ",\"directReadMeanMs\":" << directMilliseconds;
+	out << ",\"reads\":" << reads << ",\"readsPerSecond\":" << (uint64_t)(reads / seconds);
+	out << ",\"readP50Ns\":" << readLatency.GetPercentileNanoseconds(50) << ",\"readP99Ns\":" << readLatency.GetPercentileNanoseconds(99) << ",\"readMaxNs\":" << readLatency.GetMaxNanoseconds();
+	out << ",\"freshPercent\":" << (reads > 0 ? 100.0 * freshReads / reads : 0);
+	out << ",\"meanAgeMs\":" << (reads > 0 ? totalAgeMilliseconds / reads : 0) << ",\"maxAgeMs\":" << maxAgeMilliseconds;
+	out << ",\"backendReads\":" << backend.GetReadCount();
+	out << "}}" << std::endl;
+	// Followed by the statistics of the cache itself
+	cache.Report(out);
+	cache.Stop();
+	return true;
+}
@@ -0,0 +1,35 @@
+/*
+ * BACnet Virtual Devices and BBMD Example C++
+ * ----------------------------------------------------------------------------
+ * ValueCacheBenchmark.h
+ *
+ * Property reads served by the stale-while-revalidate value cache from a
+ * simulated slow backend: read latency, age of the values served and what
+ * happened to the refreshes.
+ */
+
+#ifndef __ValueCacheBenchmark_h__
+#define __ValueCacheBenchmark_h__
+
+#include <stdint.h>
+#include <ostream>
+
+class ValueCacheBenchmarkSettings
+{
+public:
+	uint32_t pointCount;
+	uint32_t ttlMilliseconds;
+	uint32_t workerCount;
+	uint32_t deadlineMilliseconds;
+	uint32_t backendMinimumMilliseconds;
+	uint32_t backendMaximumMilliseconds;
+	uint32_t readsPerSecond;			// Spread evenly over the points
+	uint32_t durationMilliseconds;
+};
+
+// Reads random points through the cache for the duration, the way the
+// property callbacks would. Writes the results as a JSON object on one line,
+// followed by the report of the cache on the next line.
+bool RunValueCacheBenchmark(std::ostream& out, const ValueCacheBenchmarkSettings& settings);
+
+#endif // __ValueCacheBenchmark_h__
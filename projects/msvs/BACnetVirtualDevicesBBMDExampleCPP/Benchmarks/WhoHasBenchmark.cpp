@@ -0,0 +1,163 @@
+/*
+ * BACnet Virtual Devices and BBMD Example C++
+ * ----------------------------------------------------------------------------
+ * WhoHasBenchmark.cpp
+ *
+ * Who-Has by object name, walking every object against the name index.
+ */
+
+#include "WhoHasBenchmark.h"
+#include "WhoHasFilter.h"
+#include "ExampleDatabase.h"
+
+#include <chrono>
+#include <string.h>
+#include <string>
+#include <vector>
+
+// Every object of the database, as the stack lists them
+template <typename Record>
+static void ListStoredObjects(const ExampleDatabaseObjectStore<Record>& store, std::vector<ExampleDatabaseObjectReference>& objects) {
+	ExampleDatabaseObjectReference object;
+	object.objectType = store.GetObjectType();
+	for (size_t i = 0; i < store.Size(); i++) {
+		object.deviceInstance = store.At(i).deviceInstance;
+		object.objectInstance = store.At(i).instance;
+		objects.push_back(object);
+	}
+}
+
+static void ListObjects(ExampleDatabase& database, std::vector<ExampleDatabaseObjectReference>& objects) {
+	ExampleDatabaseObjectReference object;
+	object.deviceInstance = database.mainDevice.instance;
+	object.objectType = ExampleConstants::OBJECT_TYPE_DEVICE;
+	object.objectInstance = database.mainDevice.instance;
+	objects.push_back(object);
+	object.objectType = ExampleConstants::OBJECT_TYPE_NETWORK_PORT;
+	for (size_t i = 0; i < database.networkPorts.size(); i++) {
+		object.objectInstance = database.networkPorts[i].instance;
+		objects.push_back(object);
+	}
+
+	std::vector<ExampleDatabaseVirtualDeviceEntry> entries;
+	database.GetVirtualDeviceList(entries);
+	object.objectType = ExampleConstants::OBJECT_TYPE_DEVICE;
+	for (size_t i = 0; i < entries.size(); i++) {
+		object.deviceInstance = entries[i].deviceInstance;
+		object.objectInstance = entries[i].deviceInstance;
+		objects.push_back(object);
+	}
+	ListStoredObjects(database.analogInputs, objects);
+	ListStoredObjects(database.analogOutputs, objects);
+	ListStoredObjects(database.binaryOutputs, objects);
+	ListStoredObjects(database.binaryInputs, objects);
+	ListStoredObjects(database.binaryValues, objects);
+	ListStoredObjects(database.multiStateValues, objects);
+	ListStoredObjects(database.analogValues, objects);
+}
+
+// Original-Unicast-NPDU, global broadcast NPDU, Who-Has by UTF-8 name
+static std::vector<uint8_t> MakeWhoHas(const std::string& name) {
+	std::vector<uint8_t> message = { 0x81, 0x0A, 0x00, 0x00, 0x01, 0x20, 0xFF, 0xFF, 0x00, 0xFF, 0x10, 0x07 };
+	const size_t contentLength = name.size() + 1;
+	if (contentLength <= 4) {
+		message.push_back((uint8_t)(0x38 | contentLength));
+	}
+	else {
+		message.push_back(0x3D);
+		message.push_back((uint8_t)contentLength);
+	}
+	message.push_back(0x00);
+	message.insert(message.end(), name.begin(), name.end());
+	message[2] = (uint8_t)(message.size() >> 8);
+	message[3] = (uint8_t)message.size();
+	return message;
+}
+
+bool RunWhoHasBenchmark(std::ostream& out, const WhoHasBenchmarkSettings& settings) {
+	ExampleDatabase database;
+	database.devicesPerNetwork = settings.devicesPerNetwork;
+	database.virtualNetworkCount = settings.virtualNetworkCount;
+	database.objectsPerType = settings.objectsPerType;
+	database.trendLogIntervalSeconds = 0;
+	database.Setup();
+
+	std::vector<ExampleDatabaseObjectReference> objects;
+	ListObjects(database, objects);
+	if (objects.empty() || settings.scanRequests == 0 || settings.indexedRequests == 0) {
+		return false;
+	}
+
+	std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+	database.BuildNameIndex();
+	double buildMilliseconds = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count();
+
+	// The names of objects picked across the database, and names no object has
+	std::vector<std::vector<uint8_t> > requests;
+	uint32_t seed = 12345;
+	for (uint32_t i = 0; i < settings.scanRequests; i++) {
+		seed = seed * 1103515245 + 12345;
+		if ((seed >> 16) % 100 < settings.missPercent) {
+			requests.push_back(MakeWhoHas("Supply Air Temperature " + std::to_string(i)));
+			continue;
+		}
+		const ExampleDatabaseObjectReference& object = objects[(seed >> 8) % objects.size()];
+		const char* name;
+		size_t length;
+		database.GetObjectName(object.deviceInstance, object.objectType, object.objectInstance, &name, &length);
+		requests.push_back(MakeWhoHas(std::string(name, length)));
+	}
+
+	// Walking every object, as the stack does through the callbacks
+	std::vector<bool> answered(requests.size(), false);
+	uint64_t matches = 0;
+	start = std::chrono::steady_clock::now();
+	for (size_t r = 0; r < requests.size(); r++) {
+		uint32_t lowDeviceInstance, highDeviceInstance;
+		uint8_t characterSet;
+		const char* wanted;
+		size_t wantedLength;
+		const uint8_t* apdu = &requests[r][10];
+		if (!CWhoHasFilter::ParseWhoHas(apdu, (uint16_t)(requests[r].size() - 10), &lowDeviceInstance, &highDeviceInstance, &characterSet, &wanted, &wantedLength)) {
+			return false;
+		}
+		for (size_t i = 0; i < objects.size(); i++) {
+			const ExampleDatabaseObjectReference& object = objects[i];
+			if (object.deviceInstance < lowDeviceInstance || object.deviceInstance > highDeviceInstance) {
+				continue;
+			}
+			const char* name;
+			size_t length;
+			if (database.GetObjectName(object.deviceInstance, object.objectType, object.objectInstance, &name, &length) && length == wantedLength && memcmp(name, wanted, length) == 0) {
+				answered[r] = true;
+				matches++;
+			}
+		}
+	}
+	double scanSeconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+
+	// The filter, over the same requests again and again
+	CWhoHasFilter filter;
+	filter.SetEnabled(true);
+	bool agree = true;
+	uint64_t dropped = 0;
+	start = std::chrono::steady_clock::now();
+	for (uint32_t i = 0; i < settings.indexedRequests; i++) {
+		const size_t r = i % requests.size();
+		const bool drop = filter.Filter(&requests[r][0], (uint16_t)requests[r].size(), database);
+		dropped += drop ? 1 : 0;
+		agree = agree && drop != answered[r];
+	}
+	double indexedSeconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+
+	ExampleDatabaseMemoryUsage usage;
+	database.GetMemoryUsage(&usage);
+	double scanNanoseconds = scanSeconds * 1e9 / requests.size();
+	double indexedNanoseconds = indexedSeconds * 1e9 / settings.indexedRequests;
+	out << "{\"whoHas\":{\"objects\":" << objects.size() << ",\"devices\":" << database.GetVirtualDeviceCount();
+	out << ",\"nameIndexKb\":" << usage.nameIndexBytes / 1024 << ",\"buildMs\":" << buildMilliseconds << ",\"missPercent\":" << settings.missPercent;
+	out << ",\"scan\":{\"requests\":" << requests.size() << ",\"matches\":" << matches << ",\"usPerRequest\":" << scanNanoseconds / 1000 << "}";
+	out << ",\"indexed\":{\"requests\":" << settings.indexedRequests << ",\"dropped\":" << dropped << ",\"nsPerRequest\":" << indexedNanoseconds << "}";
+	out << ",\"speedup\":" << (indexedNanoseconds > 0 ? scanNanoseconds / indexedNanoseconds : 0) << ",\"agree\":" << (agree ? "true" : "false") << "}}" << std::endl;
+	return agree;
+}
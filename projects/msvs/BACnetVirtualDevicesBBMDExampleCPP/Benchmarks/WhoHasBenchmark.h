@@ -0,0 +1,36 @@
+/*
+ * BACnet Virtual Devices and BBMD Example C++
+ * ----------------------------------------------------------------------------
+ * WhoHasBenchmark.h
+ *
+ * Cost of a Who-Has by object name against a large database, with and
+ * without the name index.
+ */
+
+#ifndef __WhoHasBenchmark_h__
+#define __WhoHasBenchmark_h__
+
+#include <stdint.h>
+#include <ostream>
+
+class WhoHasBenchmarkSettings
+{
+public:
+	uint32_t devicesPerNetwork;
+	uint32_t virtualNetworkCount;
+	uint32_t objectsPerType;		// Of each stored object type, see ExampleDatabase
+	uint32_t scanRequests;			// Who-Has answered by walking every object
+	uint32_t indexedRequests;		// Who-Has answered by CWhoHasFilter
+	uint32_t missPercent;			// Requests for names no object has
+};
+
+// Sets up a database, then answers the same global Who-Has requests twice:
+//   - the way the stack does, every object of every device in the range is
+//     visited and its name read through ExampleDatabase::GetObjectName().
+//   - with CWhoHasFilter, parsing the message and looking the name up in
+//     the name index.
+// Both have to agree on which requests some object answers. Writes the
+// results as a JSON object on one line.
+bool RunWhoHasBenchmark(std::ostream& out, const WhoHasBenchmarkSettings& settings);
+
+#endif // __WhoHasBenchmark_h__
@@ -0,0 +1,297 @@
+/*
+ * BACnet Virtual Devices and BBMD Example C++
+ * ----------------------------------------------------------------------------
+ * ControlPlane.cpp
+ *
+ * Commands from a UNIX domain socket and from the keyboard, run on the
+ * BACnet thread.
+ */
+
+#include "ControlPlane.h"
+
+#include "CASBACnetStackAdapter.h"
+// !!!!!! This file is part of the CAS BACnet Stack. Please contact Chipkin for more information.
+// It provides _kbhit() on every platform.
+
+#include <string.h>
+#include <stdio.h>
+#include <chrono>
+#include <iostream>
+#include <sstream>
+
+#ifdef _MSC_VER
+#include <winsock2.h>
+#include <afunix.h>
+#include <io.h>
+#pragma comment(lib,"Ws2_32.lib")
+#define CONTROL_PLANE_INVALID_SOCKET	INVALID_SOCKET
+#define ControlPlaneCloseSocket			closesocket
+#define ControlPlaneUnlink				_unlink
+#else
+#include <sys/socket.h>
+#include <sys/select.h>
+#include <sys/stat.h>
+#include <sys/un.h>
+#include <unistd.h>
+#define CONTROL_PLANE_INVALID_SOCKET	-1
+#define ControlPlaneCloseSocket			close
+#define ControlPlaneUnlink				unlink
+#endif
+
+// A client that hangs up early must not raise SIGPIPE
+#ifdef MSG_NOSIGNAL
+#define CONTROL_PLANE_SEND_FLAGS		MSG_NOSIGNAL
+#else
+#define CONTROL_PLANE_SEND_FLAGS		0
+#endif
+
+#define CONTROL_PLANE_POLL_MILLISECONDS	200		// How often the threads notice Stop()
+
+CControlPlane::CControlPlane() {
+	this->m_running = false;
+	this->m_pendingCount = 0;
+	this->m_commandCount = 0;
+	this->m_socket = CONTROL_PLANE_INVALID_SOCKET;
+}
+
+CControlPlane::~CControlPlane() {
+	this->Stop();
+}
+
+bool CControlPlane::StartSocket(const char* path) {
+	struct sockaddr_un address;
+	memset(&address, 0, sizeof(address));
+	if (path == NULL || strlen(path) == 0 || strlen(path) >= sizeof(address.sun_path)) {
+		return false;
+	}
+	address.sun_family = AF_UNIX;
+	strcpy(address.sun_path, path);
+
+#ifdef _MSC_VER
+	WSADATA wsaData;
+	if (WSAStartup(MAKEWORD(2, 2), &wsaData) != NO_ERROR) {
+		return false;
+	}
+#endif
+
+	this->m_socket = socket(AF_UNIX, SOCK_STREAM, 0);
+	if (this->m_socket == (ControlPlaneSocket)CONTROL_PLANE_INVALID_SOCKET) {
+		return false;
+	}
+
+	// Left behind by a previous run that did not exit cleanly
+	ControlPlaneUnlink(path);
+	if (bind(this->m_socket, (struct sockaddr*)&address, sizeof(address)) != 0 ||
+		listen(this->m_socket, 4) != 0) {
+		ControlPlaneCloseSocket(this->m_socket);
+		this->m_socket = CONTROL_PLANE_INVALID_SOCKET;
+		return false;
+	}
+#ifndef _MSC_VER
+	// The owner and its group only, the commands can stop the application
+	chmod(path, 0660);
+#endif
+	this->m_socketPath = path;
+
+	this->m_running = true;
+	this->m_socketThread = std::thread(&CControlPlane::RunSocket, this);
+	return true;
+}
+
+bool CControlPlane::StartKeyboard() {
+	this->m_running = true;
+	this->m_keyboardThread = std::thread(&CControlPlane::RunKeyboard, this);
+	return true;
+}
+
+void CControlPlane::Stop() {
+	if (!this->m_running) {
+		return;
+	}
+	this->m_running = false;
+	this->m_done.notify_all();
+	if (this->m_socketThread.joinable()) {
+		this->m_socketThread.join();
+	}
+	if (this->m_keyboardThread.joinable()) {
+		this->m_keyboardThread.join();
+	}
+	if (this->m_socket != (ControlPlaneSocket)CONTROL_PLANE_INVALID_SOCKET) {
+		ControlPlaneCloseSocket(this->m_socket);
+		this->m_socket = CONTROL_PLANE_INVALID_SOCKET;
+		ControlPlaneUnlink(this->m_socketPath.c_str());
+	}
+
+	// Keys that were never serviced
+	std::lock_guard<std::mutex> lock(this->m_mutex);
+	while (!this->m_requests.empty()) {
+		delete this->m_requests.front();
+		this->m_requests.pop_front();
+	}
+	this->m_pendingCount = 0;
+}
+
+bool CControlPlane::Service(ControlPlaneHandler handler) {
+	std::deque<Request*> requests;
+	{
+		std::lock_guard<std::mutex> lock(this->m_mutex);
+		requests.swap(this->m_requests);
+		this->m_pendingCount = 0;
+	}
+
+	bool keepRunning = true;
+	while (!requests.empty()) {
+		Request* request = requests.front();
+		requests.pop_front();
+
+		// Commands queued after a quit are answered, but not run
+		std::ostringstream reply;
+		if (keepRunning) {
+			keepRunning = handler(request->command, reply);
+			this->m_commandCount++;
+		}
+		else {
+			reply << "ERROR: Stopping" << std::endl;
+		}
+
+		if (!request->fromSocket) {
+			std::cout << reply.str() << std::flush;
+			delete request;
+			continue;
+		}
+		std::lock_guard<std::mutex> lock(this->m_mutex);
+		request->reply = reply.str();
+		request->done = true;
+	}
+	this->m_done.notify_all();
+	return keepRunning;
+}
+
+void CControlPlane::Submit(Request* request) {
+	std::lock_guard<std::mutex> lock(this->m_mutex);
+	this->m_requests.push_back(request);
+	this->m_pendingCount.fetch_add(1, std::memory_order_release);
+}
+
+bool CControlPlane::WaitForReply(Request* request) {
+	std::unique_lock<std::mutex> lock(this->m_mutex);
+	while (!request->done) {
+		if (!this->m_running) {
+			// Still queued, Stop() deletes it. Service() and Stop() both run
+			// on the BACnet thread, so a request it took is already done.
+			return false;
+		}
+		this->m_done.wait_for(lock, std::chrono::milliseconds(CONTROL_PLANE_POLL_MILLISECONDS));
+	}
+	return true;
+}
+
+void CControlPlane::RunSocket() {
+	while (this->m_running) {
+		fd_set readSet;
+		FD_ZERO(&readSet);
+		FD_SET(this->m_socket, &readSet);
+		struct timeval timeout;
+		timeout.tv_sec = 0;
+		timeout.tv_usec = CONTROL_PLANE_POLL_MILLISECONDS * 1000;
+		if (select((int)this->m_socket + 1, &readSet, NULL, NULL, &timeout) <= 0) {
+			continue;
+		}
+
+		ControlPlaneSocket client = accept(this->m_socket, NULL, NULL);
+		if (client == (ControlPlaneSocket)CONTROL_PLANE_INVALID_SOCKET) {
+			continue;
+		}
+		this->ServeClient(client);
+		ControlPlaneCloseSocket(client);
+	}
+}
+
+void CControlPlane::ServeClient(const ControlPlaneSocket client) {
+	std::string line;
+	uint32_t idleMilliseconds = 0;
+	while (this->m_running && idleMilliseconds < CONTROL_PLANE_IDLE_TIMEOUT_SECONDS * 1000) {
+		fd_set readSet;
+		FD_ZERO(&readSet);
+		FD_SET(client, &readSet);
+		struct timeval timeout;
+		timeout.tv_sec = 0;
+		timeout.tv_usec = CONTROL_PLANE_POLL_MILLISECONDS * 1000;
+		int ready = select((int)client + 1, &readSet, NULL, NULL, &timeout);
+		if (ready < 0) {
+			return;
+		}
+		if (ready == 0) {
+			idleMilliseconds += CONTROL_PLANE_POLL_MILLISECONDS;
+			continue;
+		}
+		idleMilliseconds = 0;
+
+		char buffer[CONTROL_PLANE_MAX_COMMAND_LENGTH];
+		int length = (int)recv(client, buffer, sizeof(buffer), 0);
+		if (length <= 0) {
+			return;
+		}
+
+		for (int i = 0; i < length; i++) {
+			if (buffer[i] != '\n') {
+				if (buffer[i] != '\r') {
+					line += buffer[i];
+				}
+				if (line.size() > CONTROL_PLANE_MAX_COMMAND_LENGTH) {
+					const char* error = "ERROR: Command too long\n\n";
+					send(client, error, (int)strlen(error), CONTROL_PLANE_SEND_FLAGS);
+					return;
+				}
+				continue;
+			}
+			if (line.empty()) {
+				continue;
+			}
+
+			// Deleted here once answered, or by Stop() if it never was
+			Request* request = new Request();
+			request->command = line;
+			request->fromSocket = true;
+			request->done = false;
+			line.clear();
+			this->Submit(request);
+			if (!this->WaitForReply(request)) {
+				return;
+			}
+			std::string reply = request->reply + "\n";
+			delete request;
+
+			size_t sent = 0;
+			while (sent < reply.size()) {
+				int result = (int)send(client, reply.c_str() + sent, (int)(reply.size() - sent), CONTROL_PLANE_SEND_FLAGS);
+				if (result <= 0) {
+					return;
+				}
+				sent += (size_t)result;
+			}
+		}
+	}
+}
+
+void CControlPlane::RunKeyboard() {
+	while (this->m_running) {
+		if (!_kbhit()) {
+			std::this_thread::sleep_for(std::chrono::milliseconds(50));
+			continue;
+		}
+		int key = getchar();
+		if (key == EOF) {
+			// stdin was closed, as under a service manager
+			return;
+		}
+		if (key == '\n' || key == '\r') {
+			continue;
+		}
+		Request* request = new Request();
+		request->command = std::string(1, (char)key);
+		request->fromSocket = false;
+		request->done = false;
+		this->Submit(request);
+	}
+}
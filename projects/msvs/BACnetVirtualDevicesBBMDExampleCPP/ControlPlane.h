@@ -0,0 +1,98 @@
+/*
+ * BACnet Virtual Devices and BBMD Example C++
+ * ----------------------------------------------------------------------------
+ * ControlPlane.h
+ *
+ * Commands for the running application, from a UNIX domain socket and from
+ * the keyboard, without polling either of them from the main loop.
+ *
+ * A listener thread accepts one connection at a time on the socket and reads
+ * one command per line. The keyboard thread turns each key into a command.
+ * Both queue the commands; the main loop only checks an atomic counter and
+ * runs them on the BACnet thread with Service(), so the commands can call the
+ * CAS BACnet Stack and change the database like the callbacks do.
+ *
+ * The reply of each socket command is written back to the client and ends
+ * with an empty line:
+ *   $ echo stats | socat - UNIX-CONNECT:/run/bacnet-bbmd.sock
+ * The reply of a key is written to std::cout.
+ */
+
+#ifndef __ControlPlane_h__
+#define __ControlPlane_h__
+
+#include <stdint.h>
+#include <atomic>
+#include <condition_variable>
+#include <deque>
+#include <mutex>
+#include <ostream>
+#include <string>
+#include <thread>
+
+// Constants
+#define CONTROL_PLANE_MAX_COMMAND_LENGTH		256
+#define CONTROL_PLANE_IDLE_TIMEOUT_SECONDS		60		// A client that says nothing for this long is disconnected
+
+#ifdef _MSC_VER
+typedef uintptr_t ControlPlaneSocket;	// SOCKET
+#else
+typedef int ControlPlaneSocket;
+#endif
+
+// Runs one command on the BACnet thread and writes its reply. Returns false
+// to stop the application.
+typedef bool (*ControlPlaneHandler)(const std::string& command, std::ostream& out);
+
+class CControlPlane
+{
+public:
+	CControlPlane();
+	~CControlPlane();
+
+	// Listens on a UNIX domain socket at path. A stale socket file is replaced.
+	bool StartSocket(const char* path);
+	// Reads keys from the console, each one is queued as a one letter command
+	bool StartKeyboard();
+	void Stop();
+
+	// True when commands are waiting for Service(). Cheap enough to check on
+	// every iteration of the main loop.
+	bool HasCommands() const { return this->m_pendingCount.load(std::memory_order_acquire) != 0; }
+
+	// Runs the queued commands. Returns false as soon as a handler does.
+	bool Service(ControlPlaneHandler handler);
+
+	uint64_t GetCommandCount() const { return this->m_commandCount; }
+	uint32_t GetPendingCount() const { return this->m_pendingCount.load(std::memory_order_relaxed); }
+
+private:
+	struct Request
+	{
+		std::string command;
+		bool fromSocket;
+		bool done;
+		std::string reply;
+	};
+
+	std::atomic<bool> m_running;
+	std::atomic<uint32_t> m_pendingCount;
+	std::mutex m_mutex;
+	std::condition_variable m_done;
+	std::deque<Request*> m_requests;
+	uint64_t m_commandCount;
+
+	std::string m_socketPath;
+	ControlPlaneSocket m_socket;
+	std::thread m_socketThread;
+	std::thread m_keyboardThread;
+
+	void Submit(Request* request);
+	bool WaitForReply(Request* request);
+
+	void RunSocket();
+	void ServeClient(const ControlPlaneSocket client);
+	void RunKeyboard();
+};
+
+#endif // __ControlPlane_h__
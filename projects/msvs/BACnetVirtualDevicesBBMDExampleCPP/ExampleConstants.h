@@ -21,6 +21,11 @@ public:
 	// CAS BACnet Stack network type
 	static const uint8_t NETWORK_TYPE_IP = 0;
 	static const uint8_t NETWORK_TYPE_MSTP = 1;
+	static const uint8_t NETWORK_TYPE_BACNET_IPV6 = 2;
+
+	// Connection string lengths, address followed by the UDP port
+	static const uint8_t CONNECTION_STRING_LENGTH_IP = 6;
+	static const uint8_t CONNECTION_STRING_LENGTH_IPV6 = 18;
 
 
 	// General Constants
@@ -167,6 +172,7 @@ public:
 	// Network Type
 	static const uint8_t NETWORK_TYPE_BACNET_IP = 0;
 	static const uint8_t NETWORK_TYPE_IPV4 = 5;
+	static const uint8_t NETWORK_TYPE_IPV6 = 9;
 
 	// Protocol Level
 	static const uint8_t PROTOCOL_LEVEL_BACNET_APPLICATION = 2;
@@ -200,6 +206,27 @@ public:
 	// Debug Message Type
 	static const uint8_t BACNET_DEBUG_LOG_TYPE_ERROR = 0;
 	static const uint8_t BACNET_DEBUG_LOG_TYPE_INFO = 1;
+
+	// BVLC types and functions, Annex J and Annex U
+	static const uint8_t BVLC_TYPE_BACNET_IP = 0x81;
+	static const uint8_t BVLC_TYPE_BACNET_IPV6 = 0x82;
+	static const uint8_t BVLC_FUNCTION_FORWARDED_NPDU = 0x04;
+	static const uint8_t BVLC_FUNCTION_DISTRIBUTE_BROADCAST_TO_NETWORK = 0x09;
+	static const uint8_t BVLC_FUNCTION_ORIGINAL_UNICAST_NPDU = 0x0A;
+	static const uint8_t BVLC_FUNCTION_ORIGINAL_BROADCAST_NPDU = 0x0B;
+	static const uint8_t BVLC6_FUNCTION_ORIGINAL_UNICAST_NPDU = 0x01;
+	static const uint8_t BVLC6_FUNCTION_ORIGINAL_BROADCAST_NPDU = 0x02;
+	static const uint8_t BVLC6_FUNCTION_FORWARDED_NPDU = 0x08;
+	static const uint8_t BVLC6_FUNCTION_DISTRIBUTE_BROADCAST_TO_NETWORK = 0x09;
+	static const uint16_t BVLC_HEADER_LENGTH = 4;
+
+	// NPDU version and control bits
+	static const uint8_t NPDU_VERSION = 0x01;
+	static const uint8_t NPDU_CONTROL_NETWORK_LAYER_MESSAGE = 0x80;
+	static const uint8_t NPDU_CONTROL_DESTINATION = 0x20;
+	static const uint8_t NPDU_CONTROL_SOURCE = 0x08;
+	static const uint8_t NPDU_CONTROL_PRIORITY = 0x03;
+	static const uint16_t NPDU_GLOBAL_BROADCAST = 0xFFFF;
 };
 
 #endif // __ExampleConstants_h__
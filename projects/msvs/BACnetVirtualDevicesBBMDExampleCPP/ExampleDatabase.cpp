@@ -19,13 +19,47 @@
 #define MALLOC(x) HeapAlloc(GetProcessHeap(), 0, (x))
 #define FREE(x) HeapFree(GetProcessHeap(), 0, (x))
 #endif // _WIN32 
+#include <string.h>
+#include <algorithm>
+
+// Whether Setup(), at the largest devicesPerNetwork for this number of
+// networks, gives every virtual device an instance of its own that is
+// inside the block of its network and not reserved
+static constexpr bool AreDeviceInstancesUnique(const uint32_t virtualNetworkCount) {
+	const uint32_t devicesPerNetwork = ExampleDatabase::GetMaxDevicesPerNetwork(virtualNetworkCount);
+	for (uint32_t networkIndex = 0; networkIndex < virtualNetworkCount; networkIndex++) {
+		const uint32_t firstInstance = STARTING_DEVICE_INSTANCE + (networkIndex * STARTING_DEVICE_INSTANCE);
+		const uint32_t lastInstance = firstInstance + devicesPerNetwork - 1;
+		if (devicesPerNetwork == 0 || devicesPerNetwork > STARTING_DEVICE_INSTANCE || lastInstance > LAST_DEVICE_INSTANCE) {
+			return false;
+		}
+		if (firstInstance < MAIN_DEVICE_INSTANCE + RESERVED_DEVICE_INSTANCES && lastInstance >= MAIN_DEVICE_INSTANCE) {
+			return false;
+		}
+	}
+	return true;
+}
+static_assert(AreDeviceInstancesUnique(1), "The device instances of one virtual network overlap");
+static_assert(AreDeviceInstancesUnique(NUMBER_OF_VIRTUAL_NETWORKS), "The device instances of the default virtual networks overlap");
+static_assert(AreDeviceInstancesUnique(MAX_VIRTUAL_NETWORKS), "The device instances of the largest number of virtual networks overlap");
 
 ExampleDatabase::ExampleDatabase() {
-	this->Setup();
+	// Populated by either Setup() or LoadImage()
+	this->mainDevice.instance = 0;
+	this->mainDevice.systemStatus = 0;
+	this->networkPortsRevision = 0;
+	this->objectsPerType = 1;
+	this->devicesPerNetwork = NUMBER_OF_DEVICES_PER_NETWORK;
+	this->virtualNetworkCount = NUMBER_OF_VIRTUAL_NETWORKS;
+	this->trendLogIntervalSeconds = 60;
+	this->trendLogCapacity = 16 * 1024;
+	this->pointIngestionCount = 0;
+	this->nextTrendLogTime = std::chrono::steady_clock::now();
+	this->nameIndexBuilt = false;
+	this->changeListener = NULL;
 }
 
 ExampleDatabase::~ExampleDatabase() {
-	this->Setup();
 }
 
 const std::string ExampleDatabase::GetColorName() {
@@ -41,49 +75,1010 @@ const std::string ExampleDatabase::GetColorName() {
 }
 
 void ExampleDatabase::Setup() {
-	this->mainDevice.instance = 389999;
-	this->mainDevice.objectName = "Virtual Devices Container";
-	this->mainDevice.description = "Chipkin test BACnet IP Virtual Devices Server device";
+	this->mainDevice.instance = MAIN_DEVICE_INSTANCE;
+	this->mainDevice.objectName = this->strings.Intern("Virtual Devices Container");
+	this->mainDevice.description = this->strings.Intern("Chipkin test BACnet IP Virtual Devices Server device");
 	this->mainDevice.systemStatus = 0;	// operational (0), non-operational (4)
 
-	for (size_t networkIndex = 0; networkIndex < NUMBER_OF_VIRTUAL_NETWORKS; networkIndex++) {
-		for (size_t deviceIndex = 0; deviceIndex < NUMBER_OF_DEVICES_PER_NETWORK; deviceIndex++) {
-			ExampleDatabaseDevice device;
-			device.instance = STARTING_DEVICE_INSTANCE + (networkIndex * STARTING_DEVICE_INSTANCE) + deviceIndex;
-			std::string color = ExampleDatabase::GetColorName();
-			device.objectName = "Virtual Device " + color;
-			device.description = "Example virtual device";
-			device.systemStatus = 0;	// operational (0), non-operational (4)
-
-			// Create the object
-			ExampleDatabaseAnalogInput analogInput;
-			analogInput.instance = 1;
-			analogInput.presentValue = (networkIndex * 100) + deviceIndex + 1;
-			analogInput.objectName = "Analog Input " + color;
-			analogInput.reliability = 0;  // no-fault-detected (0), unreliable-other (7)
-			this->analogInputs[device.instance] = analogInput;
-
-			// Add the device
+	// The virtual networks of this shard
+	std::vector<size_t> networkIndexes;
+	for (size_t networkIndex = 0; networkIndex < this->virtualNetworkCount && networkIndex < MAX_VIRTUAL_NETWORKS; networkIndex++) {
+		uint16_t network = STARTING_VIRTUAL_NETWORK + (networkIndex * VIRTUAL_NETWORK_OFFSET);
+		if (!this->hostsNetwork || this->hostsNetwork(network)) {
+			networkIndexes.push_back(networkIndex);
+		}
+	}
+
+	// Allocate the records once instead of letting every array double its way up
+	this->ReserveObjects(networkIndexes.size() * this->devicesPerNetwork);
+	for (size_t i = 0; i < networkIndexes.size(); i++) {
+		uint16_t network = STARTING_VIRTUAL_NETWORK + (networkIndexes[i] * VIRTUAL_NETWORK_OFFSET);
+		this->virtualDevices[network].reserve(this->devicesPerNetwork);
+	}
+
+	for (size_t i = 0; i < networkIndexes.size(); i++) {
+		const size_t networkIndex = networkIndexes[i];
+		for (size_t deviceIndex = 0; deviceIndex < this->devicesPerNetwork; deviceIndex++) {
+			// Add the device, the instances of a network are in order
 			uint16_t network = STARTING_VIRTUAL_NETWORK + (networkIndex * VIRTUAL_NETWORK_OFFSET);
-			this->virtualDevices[network].push_back(device);
+			uint32_t deviceInstance = STARTING_DEVICE_INSTANCE + (networkIndex * STARTING_DEVICE_INSTANCE) + deviceIndex;
+			this->virtualDevices[network].push_back(this->SetupVirtualDevice(deviceInstance, (float)((networkIndex * 100) + deviceIndex + 1)));
 		}
 	}
 
-	this->networkPort.instance = 1;
-	this->networkPort.objectName = "Network Port for Ipv4";
+	this->SetupNetworkPorts();
+	this->SetupTrendLogs();
+	this->nameIndex.Clear();
+	this->nameIndexBuilt = false;
+	this->lookupMemo.Clear();
+	if (this->changeListener != NULL) {
+		this->changeListener->DatabaseChanged();
+	}
+}
+
+ExampleDatabaseDevice ExampleDatabase::SetupVirtualDevice(const uint32_t deviceInstance, const float presentValue) {
+	ExampleDatabaseDevice device;
+	device.instance = deviceInstance;
+	std::string color = ExampleDatabase::GetColorName();
+	device.objectName = this->strings.Intern("Virtual Device " + color);
+	device.description = this->strings.Intern("Example virtual device");
+	device.systemStatus = 0;	// operational (0), non-operational (4)
+
+	// Create the object
+	ExampleDatabaseAnalogInput& analogInput = this->analogInputs.Add(device.instance, 1);
+	analogInput.presentValue = presentValue;
+	analogInput.objectName = this->strings.Intern("Analog Input " + color);
+	analogInput.reliability = 0;  // no-fault-detected (0), unreliable-other (7)
+	this->SetupOutputs(device.instance, color);
+	this->SetupStoredObjects(device.instance, color);
+	return device;
+}
+
+void ExampleDatabase::ReserveObjects(const size_t deviceCount) {
+	this->analogInputs.Reserve(deviceCount);
+	this->analogOutputs.Reserve(deviceCount);
+	this->binaryOutputs.Reserve(deviceCount);
+	this->binaryInputs.Reserve(deviceCount * this->objectsPerType);
+	this->binaryValues.Reserve(deviceCount * this->objectsPerType);
+	this->multiStateValues.Reserve(deviceCount * this->objectsPerType);
+	this->analogValues.Reserve(deviceCount * this->objectsPerType);
+}
+
+void ExampleDatabase::SetupOutputs(const uint32_t deviceInstance, const std::string& nameSuffix) {
+	ExampleDatabaseAnalogOutput& analogOutput = this->analogOutputs.Add(deviceInstance, 1);
+	analogOutput.objectName = this->strings.Intern("Analog Output " + nameSuffix);
+	analogOutput.priorityArray.SetRelinquishDefault(0.0f);
+
+	ExampleDatabaseBinaryOutput& binaryOutput = this->binaryOutputs.Add(deviceInstance, 1);
+	binaryOutput.objectName = this->strings.Intern("Binary Output " + nameSuffix);
+	binaryOutput.priorityArray.SetRelinquishDefault(0);	// inactive
+}
+
+void ExampleDatabase::SetupStoredObjects(const uint32_t deviceInstance, const std::string& nameSuffix) {
+	for (uint32_t offset = 0; offset < this->objectsPerType; offset++) {
+		const uint32_t instance = offset + 1;
+		const std::string suffix = this->objectsPerType > 1 ? nameSuffix + " " + std::to_string(instance) : nameSuffix;
+		this->SetupStoredObject(ExampleConstants::OBJECT_TYPE_BINARY_INPUT, deviceInstance, instance, suffix);
+		this->SetupStoredObject(ExampleConstants::OBJECT_TYPE_BINARY_VALUE, deviceInstance, instance, suffix);
+		this->SetupStoredObject(ExampleConstants::OBJECT_TYPE_MULTI_STATE_VALUE, deviceInstance, instance, suffix);
+		this->SetupStoredObject(ExampleConstants::OBJECT_TYPE_ANALOG_VALUE, deviceInstance, instance, suffix);
+	}
+}
+
+bool ExampleDatabase::SetupStoredObject(const uint16_t objectType, const uint32_t deviceInstance, const uint32_t instance, const std::string& nameSuffix) {
+	switch (objectType) {
+	case ExampleConstants::OBJECT_TYPE_BINARY_INPUT: {
+		ExampleDatabaseBinaryInput& binaryInput = this->binaryInputs.Add(deviceInstance, instance);
+		binaryInput.objectName = this->strings.Intern("Binary Input " + nameSuffix);
+		binaryInput.presentValue = instance % 2;	// inactive (0), active (1)
+		binaryInput.reliability = 0;	// no-fault-detected (0)
+		binaryInput.outOfService = false;
+		return true;
+	}
+	case ExampleConstants::OBJECT_TYPE_BINARY_VALUE: {
+		ExampleDatabaseBinaryValue& binaryValue = this->binaryValues.Add(deviceInstance, instance);
+		binaryValue.objectName = this->strings.Intern("Binary Value " + nameSuffix);
+		binaryValue.presentValue = 0;
+		binaryValue.outOfService = false;
+		return true;
+	}
+	case ExampleConstants::OBJECT_TYPE_MULTI_STATE_VALUE: {
+		ExampleDatabaseMultiStateValue& multiStateValue = this->multiStateValues.Add(deviceInstance, instance);
+		multiStateValue.objectName = this->strings.Intern("Multi-State Value " + nameSuffix);
+		multiStateValue.numberOfStates = 3;
+		multiStateValue.presentValue = 1;
+		multiStateValue.outOfService = false;
+		return true;
+	}
+	case ExampleConstants::OBJECT_TYPE_ANALOG_VALUE: {
+		ExampleDatabaseAnalogValue& analogValue = this->analogValues.Add(deviceInstance, instance);
+		analogValue.objectName = this->strings.Intern("Analog Value " + nameSuffix);
+		analogValue.presentValue = 0.0f;
+		analogValue.reliability = 0;	// no-fault-detected (0)
+		analogValue.outOfService = false;
+		return true;
+	}
+	default:
+		return false;
+	}
+}
+
+void ExampleDatabase::SetupTrendLogs() {
+	this->trendLogs.clear();
+	if (this->trendLogIntervalSeconds == 0) {
+		return;
+	}
+	std::vector<ExampleDatabaseVirtualDeviceEntry> entries;
+	this->GetVirtualDeviceList(entries);
+	for (size_t i = 0; i < entries.size(); i++) {
+		this->SetupTrendLog(entries[i]);
+	}
+}
+
+// Logs the first analog input of the device, if it has one. Also used for
+// the devices added while running, so they log the same point.
+void ExampleDatabase::SetupTrendLog(const ExampleDatabaseVirtualDeviceEntry& entry) {
+	if (entry.hasAnalogInput) {
+		ExampleDatabaseTrendLog& trendLog = this->trendLogs[entry.deviceInstance];
+		trendLog.analogInputInstance = entry.analogInputInstance;
+		trendLog.log.SetCapacity(this->trendLogCapacity);
+	}
+}
+
+void ExampleDatabase::LogTrends(const uint64_t timestamp) {
+	std::map<uint32_t, ExampleDatabaseTrendLog>::iterator it;
+	for (it = this->trendLogs.begin(); it != this->trendLogs.end(); ++it) {
+		float presentValue;
+		if (this->GetAnalogInputPresentValue(it->first, it->second.analogInputInstance, &presentValue)) {
+			it->second.log.Add(timestamp, presentValue);
+		}
+	}
+}
+
+const CTrendLog* ExampleDatabase::FindTrendLog(const uint32_t deviceInstance, const uint32_t analogInputInstance) {
+	std::map<uint32_t, ExampleDatabaseTrendLog>::const_iterator it = this->trendLogs.find(deviceInstance);
+	if (it == this->trendLogs.end() || it->second.analogInputInstance != analogInputInstance) {
+		return NULL;
+	}
+	return &it->second.log;
+}
+
+void ExampleDatabase::GetTrendLogMemoryUsage(size_t* bytes, uint64_t* records, size_t* points) {
+	*bytes = 0;
+	*records = 0;
+	*points = this->trendLogs.size();
+	std::map<uint32_t, ExampleDatabaseTrendLog>::const_iterator it;
+	for (it = this->trendLogs.begin(); it != this->trendLogs.end(); ++it) {
+		*bytes += it->second.log.GetMemoryUsage();
+		*records += it->second.log.GetRecordCount();
+	}
+}
+
+void ExampleDatabase::AddNetworkInterface(const std::string& interfaceName) {
+	this->networkInterfaceNames.push_back(interfaceName);
+}
+
+void ExampleDatabase::SetupNetworkPorts() {
+	// One Network Port object per configured interface. Without any configured
+	// interfaces a single port on the first usable interface is created.
+	this->networkPorts.clear();
+	size_t count = this->networkInterfaceNames.empty() ? 1 : this->networkInterfaceNames.size();
+	for (size_t portIndex = 0; portIndex < count; portIndex++) {
+		ExampleDatabaseNetworkPort port;
+		port.instance = (uint32_t)portIndex + 1;
+		std::string name = "Network Port for Ipv4";
+		if (!this->networkInterfaceNames.empty()) {
+			port.interfaceName = this->networkInterfaceNames[portIndex];
+			name += " " + port.interfaceName;
+		}
+		port.objectName = this->strings.Intern(name);
+		port.BACnetIPUDPPort = 47808;
+		memset(port.IPAddress, 0, sizeof(port.IPAddress));
+		port.IPAddressLength = 0;
+		memset(port.IPDefaultGateway, 0, sizeof(port.IPDefaultGateway));
+		port.IPDefaultGatewayLength = 0;
+		memset(port.IPSubnetMask, 0, sizeof(port.IPSubnetMask));
+		port.IPSubnetMaskLength = 0;
+		port.IPDNSServerLength = 0;
+		memset(port.BroadcastIPAddress, 0, sizeof(port.BroadcastIPAddress));
+		this->networkPorts.push_back(port);
+	}
 	this->LoadNetworkPortProperties();
 }
 
+ExampleDatabaseNetworkPort* ExampleDatabase::FindNetworkPort(const uint32_t objectInstance) {
+	for (size_t i = 0; i < this->networkPorts.size(); i++) {
+		if (this->networkPorts[i].instance == objectInstance) {
+			return &this->networkPorts[i];
+		}
+	}
+	return NULL;
+}
+
+bool ExampleDatabase::LoadImage(const char* path) {
+	if (!this->image.Open(path)) {
+		return false;
+	}
+
+	const ExampleDatabaseImageHeader* header = this->image.GetHeader();
+	size_t length = 0;
+	const char* value = NULL;
+
+	this->mainDevice.instance = header->mainDeviceInstance;
+	this->mainDevice.systemStatus = header->mainDeviceSystemStatus;
+	this->strings.Clear();
+	value = this->image.GetString(header->mainDeviceName, &length);
+	this->mainDevice.objectName = this->strings.Intern(value, length);
+	value = this->image.GetString(header->mainDeviceDescription, &length);
+	this->mainDevice.description = this->strings.Intern(value, length);
+
+	this->virtualDevices.clear();
+	this->analogInputs.Clear();
+	this->analogOutputs.Clear();
+	this->binaryOutputs.Clear();
+	this->binaryInputs.Clear();
+	this->binaryValues.Clear();
+	this->multiStateValues.Clear();
+	this->analogValues.Clear();
+
+	// The outputs and the stored objects are not part of the image
+	this->ReserveObjects(this->image.GetDeviceCount());
+	for (uint32_t i = 0; i < this->image.GetDeviceCount(); i++) {
+		uint32_t deviceInstance = this->image.GetDevice(i).instance;
+		this->SetupOutputs(deviceInstance, std::to_string(deviceInstance));
+		this->SetupStoredObjects(deviceInstance, std::to_string(deviceInstance));
+	}
+
+	// The image only records the primary network port
+	this->SetupNetworkPorts();
+	this->networkPorts[0].instance = header->networkPortInstance;
+	value = this->image.GetString(header->networkPortName, &length);
+	this->networkPorts[0].objectName = this->strings.Intern(value, length);
+
+	// History is not kept in the image either
+	this->SetupTrendLogs();
+	this->nameIndex.Clear();
+	this->nameIndexBuilt = false;
+	this->lookupMemo.Clear();
+	if (this->changeListener != NULL) {
+		this->changeListener->DatabaseChanged();
+	}
+	return true;
+}
+
+bool ExampleDatabase::SaveImage(const char* path) {
+	return ExampleDatabaseImage::Write(path, *this);
+}
+
+static bool DeviceInstanceLess(const ExampleDatabaseDevice& device, const uint32_t deviceInstance) {
+	return device.instance < deviceInstance;
+}
+
+ExampleDatabaseDevice* ExampleDatabase::FindVirtualDevice(const uint32_t deviceInstance, uint16_t* network /* = NULL */) {
+	// The network is not kept in the memo
+	void* memoized;
+	uint32_t index;
+	if (network == NULL && this->lookupMemo.Find(ExampleConstants::OBJECT_TYPE_DEVICE, deviceInstance, deviceInstance, &memoized, &index)) {
+		return (ExampleDatabaseDevice*)memoized;
+	}
+
+	// The devices of each network are sorted by instance
+	std::map<uint16_t, std::vector<ExampleDatabaseDevice> >::iterator it;
+	for (it = this->virtualDevices.begin(); it != this->virtualDevices.end(); ++it) {
+		std::vector<ExampleDatabaseDevice>::iterator devIt = std::lower_bound(it->second.begin(), it->second.end(), deviceInstance, DeviceInstanceLess);
+		if (devIt != it->second.end() && devIt->instance == deviceInstance) {
+			if (network != NULL) {
+				*network = it->first;
+			}
+			this->lookupMemo.Add(ExampleConstants::OBJECT_TYPE_DEVICE, deviceInstance, deviceInstance, &(*devIt), 0);
+			return &(*devIt);
+		}
+	}
+	return NULL;
+}
+
+bool ExampleDatabase::AddVirtualNetwork(const uint16_t network) {
+	if (this->image.IsOpen() || this->virtualDevices.find(network) != this->virtualDevices.end()) {
+		return false;
+	}
+	this->virtualDevices[network];
+	return true;
+}
+
+bool ExampleDatabase::RemoveVirtualNetwork(const uint16_t network) {
+	std::map<uint16_t, std::vector<ExampleDatabaseDevice> >::iterator it = this->virtualDevices.find(network);
+	if (this->image.IsOpen() || it == this->virtualDevices.end() || !it->second.empty()) {
+		return false;
+	}
+	this->virtualDevices.erase(it);
+	return true;
+}
+
+bool ExampleDatabase::AddVirtualDevice(const uint16_t network, const uint32_t deviceInstance) {
+	std::map<uint16_t, std::vector<ExampleDatabaseDevice> >::iterator it = this->virtualDevices.find(network);
+	if (this->image.IsOpen() || it == this->virtualDevices.end() || IsReservedDeviceInstance(deviceInstance) || this->FindVirtualDevice(deviceInstance) != NULL) {
+		return false;
+	}
+
+	// The records move
+	this->lookupMemo.Clear();
+	std::vector<ExampleDatabaseDevice>& devices = it->second;
+	ExampleDatabaseDevice device = this->SetupVirtualDevice(deviceInstance, 0.0f);
+	devices.insert(std::lower_bound(devices.begin(), devices.end(), deviceInstance, DeviceInstanceLess), device);
+	if (this->nameIndexBuilt) {
+		this->IndexDevice(deviceInstance);
+	}
+
+	ExampleDatabaseVirtualDeviceEntry entry;
+	if (this->trendLogIntervalSeconds != 0 && this->GetVirtualDeviceEntry(deviceInstance, &entry)) {
+		this->SetupTrendLog(entry);
+	}
+	return true;
+}
+
+bool ExampleDatabase::RemoveVirtualDevice(const uint32_t deviceInstance) {
+	uint16_t network;
+	ExampleDatabaseDevice* device = this->FindVirtualDevice(deviceInstance, &network);
+	if (this->image.IsOpen() || device == NULL) {
+		return false;
+	}
+	this->lookupMemo.Clear();
+	std::vector<ExampleDatabaseDevice>& devices = this->virtualDevices[network];
+	devices.erase(devices.begin() + (device - devices.data()));
+
+	// A device added again with the same instance is served from its new
+	// object, not from the value cached for this one
+	const ExampleDatabaseAnalogInput* analogInput = this->analogInputs.FindFirst(deviceInstance);
+	if (analogInput != NULL) {
+		this->valueCache.Remove(deviceInstance, ExampleConstants::OBJECT_TYPE_ANALOG_INPUT, analogInput->instance);
+	}
+
+	// The names stay in the string pool, other devices share them
+	this->analogInputs.RemoveDevice(deviceInstance);
+	this->analogOutputs.RemoveDevice(deviceInstance);
+	this->binaryOutputs.RemoveDevice(deviceInstance);
+	this->binaryInputs.RemoveDevice(deviceInstance);
+	this->binaryValues.RemoveDevice(deviceInstance);
+	this->multiStateValues.RemoveDevice(deviceInstance);
+	this->analogValues.RemoveDevice(deviceInstance);
+	this->nameIndex.RemoveDevice(deviceInstance);
+	this->trendLogs.erase(deviceInstance);
+	if (this->changeListener != NULL) {
+		this->changeListener->DeviceChanged(deviceInstance);
+	}
+	return true;
+}
+
+bool ExampleDatabase::AddStoredObject(const uint32_t deviceInstance, const uint16_t objectType, const uint32_t objectInstance) {
+	const char* name;
+	size_t length;
+	if (this->image.IsOpen() || this->FindVirtualDevice(deviceInstance) == NULL || this->GetObjectName(deviceInstance, objectType, objectInstance, &name, &length)) {
+		return false;
+	}
+	this->lookupMemo.Clear();
+	if (!this->SetupStoredObject(objectType, deviceInstance, objectInstance, std::to_string(deviceInstance) + " " + std::to_string(objectInstance))) {
+		return false;
+	}
+	if (this->nameIndexBuilt) {
+		this->IndexObject(deviceInstance, objectType, objectInstance);
+	}
+	return true;
+}
+
+bool ExampleDatabase::RemoveStoredObject(const uint32_t deviceInstance, const uint16_t objectType, const uint32_t objectInstance) {
+	const char* name;
+	size_t length;
+	if (this->image.IsOpen() || !this->GetObjectName(deviceInstance, objectType, objectInstance, &name, &length)) {
+		return false;
+	}
+	this->lookupMemo.Clear();
+	bool removed;
+	switch (objectType) {
+	case ExampleConstants::OBJECT_TYPE_BINARY_INPUT:
+		removed = this->binaryInputs.Remove(deviceInstance, objectInstance);
+		break;
+	case ExampleConstants::OBJECT_TYPE_BINARY_VALUE:
+		removed = this->binaryValues.Remove(deviceInstance, objectInstance);
+		break;
+	case ExampleConstants::OBJECT_TYPE_MULTI_STATE_VALUE:
+		removed = this->multiStateValues.Remove(deviceInstance, objectInstance);
+		break;
+	case ExampleConstants::OBJECT_TYPE_ANALOG_VALUE:
+		removed = this->analogValues.Remove(deviceInstance, objectInstance);
+		break;
+	default:
+		return false;
+	}
+	// The name stays in the string pool, so it is still valid here
+	if (removed) {
+		this->nameIndex.Remove(name, length, deviceInstance, objectType, objectInstance);
+		this->ObjectChanged(deviceInstance, objectType, objectInstance);
+	}
+	return removed;
+}
+
+size_t ExampleDatabase::GetVirtualDeviceCount() const {
+	if (this->image.IsOpen()) {
+		return this->image.GetDeviceCount();
+	}
+	size_t count = 0;
+	std::map<uint16_t, std::vector<ExampleDatabaseDevice> >::const_iterator it;
+	for (it = this->virtualDevices.begin(); it != this->virtualDevices.end(); ++it) {
+		count += it->second.size();
+	}
+	return count;
+}
+
+bool ExampleDatabase::GetVirtualDeviceEntry(const uint32_t deviceInstance, ExampleDatabaseVirtualDeviceEntry* entry) {
+	uint16_t network;
+	if (this->image.IsOpen() || this->FindVirtualDevice(deviceInstance, &network) == NULL) {
+		return false;
+	}
+	entry->network = network;
+	entry->deviceInstance = deviceInstance;
+	const ExampleDatabaseAnalogInput* analogInput = this->analogInputs.FindFirst(deviceInstance);
+	entry->hasAnalogInput = analogInput != NULL;
+	entry->analogInputInstance = entry->hasAnalogInput ? analogInput->instance : 0;
+	this->GetOutputEntry(*entry);
+	return true;
+}
+
+ExampleDatabaseAnalogOutput* ExampleDatabase::FindAnalogOutput(const uint32_t deviceInstance, const uint32_t objectInstance) {
+	return this->FindRecord(this->analogOutputs, deviceInstance, objectInstance);
+}
+
+ExampleDatabaseBinaryOutput* ExampleDatabase::FindBinaryOutput(const uint32_t deviceInstance, const uint32_t objectInstance) {
+	return this->FindRecord(this->binaryOutputs, deviceInstance, objectInstance);
+}
+
+template <typename Value>
+bool ExampleDatabase::GetStoredObjectProperty(const uint32_t deviceInstance, const uint16_t objectType, const uint32_t objectInstance, const uint32_t propertyIdentifier, const ExampleDatabasePropertyKind kind, Value* value) {
+	switch (objectType) {
+	case ExampleConstants::OBJECT_TYPE_BINARY_INPUT:
+		return this->GetRecordProperty(this->binaryInputs, deviceInstance, objectInstance, propertyIdentifier, kind, value);
+	case ExampleConstants::OBJECT_TYPE_BINARY_VALUE:
+		return this->GetRecordProperty(this->binaryValues, deviceInstance, objectInstance, propertyIdentifier, kind, value);
+	case ExampleConstants::OBJECT_TYPE_MULTI_STATE_VALUE:
+		return this->GetRecordProperty(this->multiStateValues, deviceInstance, objectInstance, propertyIdentifier, kind, value);
+	case ExampleConstants::OBJECT_TYPE_ANALOG_VALUE:
+		return this->GetRecordProperty(this->analogValues, deviceInstance, objectInstance, propertyIdentifier, kind, value);
+	default:
+		return false;
+	}
+}
+
+template <typename Value>
+bool ExampleDatabase::SetStoredObjectProperty(const uint32_t deviceInstance, const uint16_t objectType, const uint32_t objectInstance, const uint32_t propertyIdentifier, const ExampleDatabasePropertyKind kind, const Value value, bool* valueIsValid) {
+	*valueIsValid = true;
+	bool set;
+	switch (objectType) {
+	case ExampleConstants::OBJECT_TYPE_BINARY_INPUT:
+		set = this->SetRecordProperty(this->binaryInputs, deviceInstance, objectInstance, propertyIdentifier, kind, value, valueIsValid);
+		break;
+	case ExampleConstants::OBJECT_TYPE_BINARY_VALUE:
+		set = this->SetRecordProperty(this->binaryValues, deviceInstance, objectInstance, propertyIdentifier, kind, value, valueIsValid);
+		break;
+	case ExampleConstants::OBJECT_TYPE_MULTI_STATE_VALUE:
+		set = this->SetRecordProperty(this->multiStateValues, deviceInstance, objectInstance, propertyIdentifier, kind, value, valueIsValid);
+		break;
+	case ExampleConstants::OBJECT_TYPE_ANALOG_VALUE:
+		set = this->SetRecordProperty(this->analogValues, deviceInstance, objectInstance, propertyIdentifier, kind, value, valueIsValid);
+		break;
+	default:
+		return false;
+	}
+	if (set) {
+		this->ObjectChanged(deviceInstance, objectType, objectInstance);
+	}
+	return set;
+}
+
+bool ExampleDatabase::GetObjectPropertyReal(const uint32_t deviceInstance, const uint16_t objectType, const uint32_t objectInstance, const uint32_t propertyIdentifier, float* value) {
+	return this->GetStoredObjectProperty(deviceInstance, objectType, objectInstance, propertyIdentifier, PROPERTY_KIND_REAL, value);
+}
+
+bool ExampleDatabase::GetObjectPropertyEnum(const uint32_t deviceInstance, const uint16_t objectType, const uint32_t objectInstance, const uint32_t propertyIdentifier, uint32_t* value) {
+	return this->GetStoredObjectProperty(deviceInstance, objectType, objectInstance, propertyIdentifier, PROPERTY_KIND_ENUMERATED, value);
+}
+
+bool ExampleDatabase::GetObjectPropertyUInt(const uint32_t deviceInstance, const uint16_t objectType, const uint32_t objectInstance, const uint32_t propertyIdentifier, uint32_t* value) {
+	return this->GetStoredObjectProperty(deviceInstance, objectType, objectInstance, propertyIdentifier, PROPERTY_KIND_UNSIGNED, value);
+}
+
+bool ExampleDatabase::GetObjectPropertyBool(const uint32_t deviceInstance, const uint16_t objectType, const uint32_t objectInstance, const uint32_t propertyIdentifier, bool* value) {
+	return this->GetStoredObjectProperty(deviceInstance, objectType, objectInstance, propertyIdentifier, PROPERTY_KIND_BOOLEAN, value);
+}
+
+bool ExampleDatabase::SetObjectPropertyReal(const uint32_t deviceInstance, const uint16_t objectType, const uint32_t objectInstance, const uint32_t propertyIdentifier, const float value, bool* valueIsValid) {
+	return this->SetStoredObjectProperty(deviceInstance, objectType, objectInstance, propertyIdentifier, PROPERTY_KIND_REAL, value, valueIsValid);
+}
+
+bool ExampleDatabase::SetObjectPropertyEnum(const uint32_t deviceInstance, const uint16_t objectType, const uint32_t objectInstance, const uint32_t propertyIdentifier, const uint32_t value, bool* valueIsValid) {
+	return this->SetStoredObjectProperty(deviceInstance, objectType, objectInstance, propertyIdentifier, PROPERTY_KIND_ENUMERATED, value, valueIsValid);
+}
+
+bool ExampleDatabase::SetObjectPropertyUInt(const uint32_t deviceInstance, const uint16_t objectType, const uint32_t objectInstance, const uint32_t propertyIdentifier, const uint32_t value, bool* valueIsValid) {
+	return this->SetStoredObjectProperty(deviceInstance, objectType, objectInstance, propertyIdentifier, PROPERTY_KIND_UNSIGNED, value, valueIsValid);
+}
+
+bool ExampleDatabase::GetObjectName(const uint32_t deviceInstance, const uint16_t objectType, const uint32_t objectInstance, const char** name, size_t* length) {
+	switch (objectType) {
+	case ExampleConstants::OBJECT_TYPE_DEVICE:
+		if (objectInstance == this->mainDevice.instance) {
+			*name = this->strings.Get(this->mainDevice.objectName, length);
+			return true;
+		}
+		return this->GetVirtualDeviceName(objectInstance, name, length);
+	case ExampleConstants::OBJECT_TYPE_NETWORK_PORT: {
+		// Network Port objects of the database belong to the main device
+		const ExampleDatabaseNetworkPort* networkPort = deviceInstance == this->mainDevice.instance ? this->FindNetworkPort(objectInstance) : NULL;
+		if (networkPort == NULL) {
+			return false;
+		}
+		*name = this->strings.Get(networkPort->objectName, length);
+		return true;
+	}
+	case ExampleConstants::OBJECT_TYPE_ANALOG_INPUT:
+		return this->GetAnalogInputName(deviceInstance, objectInstance, name, length);
+	case ExampleConstants::OBJECT_TYPE_ANALOG_OUTPUT:
+		return this->GetStoredObjectName(this->analogOutputs, deviceInstance, objectInstance, name, length);
+	case ExampleConstants::OBJECT_TYPE_BINARY_OUTPUT:
+		return this->GetStoredObjectName(this->binaryOutputs, deviceInstance, objectInstance, name, length);
+	case ExampleConstants::OBJECT_TYPE_BINARY_INPUT:
+		return this->GetStoredObjectName(this->binaryInputs, deviceInstance, objectInstance, name, length);
+	case ExampleConstants::OBJECT_TYPE_BINARY_VALUE:
+		return this->GetStoredObjectName(this->binaryValues, deviceInstance, objectInstance, name, length);
+	case ExampleConstants::OBJECT_TYPE_MULTI_STATE_VALUE:
+		return this->GetStoredObjectName(this->multiStateValues, deviceInstance, objectInstance, name, length);
+	case ExampleConstants::OBJECT_TYPE_ANALOG_VALUE:
+		return this->GetStoredObjectName(this->analogValues, deviceInstance, objectInstance, name, length);
+	default:
+		return false;
+	}
+}
+
+void ExampleDatabase::BuildNameIndex() {
+	this->nameIndex.Clear();
+	this->nameIndex.Reserve(1 + this->networkPorts.size() + this->GetVirtualDeviceCount() + this->analogInputs.Size() + this->analogOutputs.Size() + this->binaryOutputs.Size() +
+		this->binaryInputs.Size() + this->binaryValues.Size() + this->multiStateValues.Size() + this->analogValues.Size());
+
+	this->IndexObject(this->mainDevice.instance, ExampleConstants::OBJECT_TYPE_DEVICE, this->mainDevice.instance);
+	for (size_t i = 0; i < this->networkPorts.size(); i++) {
+		this->IndexObject(this->mainDevice.instance, ExampleConstants::OBJECT_TYPE_NETWORK_PORT, this->networkPorts[i].instance);
+	}
+
+	if (this->image.IsOpen()) {
+		// The devices and the analog inputs are named in the image
+		size_t length;
+		for (uint32_t i = 0; i < this->image.GetDeviceCount(); i++) {
+			const ExampleDatabaseImageDevice& device = this->image.GetDevice(i);
+			const char* name = this->image.GetString(device.objectName, &length);
+			this->nameIndex.Add(name, length, device.instance, ExampleConstants::OBJECT_TYPE_DEVICE, device.instance);
+		}
+		for (uint32_t i = 0; i < this->image.GetAnalogInputCount(); i++) {
+			const ExampleDatabaseImageAnalogInput& analogInput = this->image.GetAnalogInput(i);
+			const char* name = this->image.GetString(analogInput.objectName, &length);
+			this->nameIndex.Add(name, length, analogInput.deviceInstance, ExampleConstants::OBJECT_TYPE_ANALOG_INPUT, analogInput.instance);
+		}
+	}
+	else {
+		std::map<uint16_t, std::vector<ExampleDatabaseDevice> >::const_iterator it;
+		for (it = this->virtualDevices.begin(); it != this->virtualDevices.end(); ++it) {
+			for (size_t i = 0; i < it->second.size(); i++) {
+				size_t length;
+				const char* name = this->strings.Get(it->second[i].objectName, &length);
+				this->nameIndex.Add(name, length, it->second[i].instance, ExampleConstants::OBJECT_TYPE_DEVICE, it->second[i].instance);
+			}
+		}
+		this->IndexStoredObjects(this->analogInputs, 0, this->analogInputs.Size());
+	}
+	this->IndexStoredObjects(this->analogOutputs, 0, this->analogOutputs.Size());
+	this->IndexStoredObjects(this->binaryOutputs, 0, this->binaryOutputs.Size());
+	this->IndexStoredObjects(this->binaryInputs, 0, this->binaryInputs.Size());
+	this->IndexStoredObjects(this->binaryValues, 0, this->binaryValues.Size());
+	this->IndexStoredObjects(this->multiStateValues, 0, this->multiStateValues.Size());
+	this->IndexStoredObjects(this->analogValues, 0, this->analogValues.Size());
+	this->nameIndexBuilt = true;
+}
+
+void ExampleDatabase::IndexObject(const uint32_t deviceInstance, const uint16_t objectType, const uint32_t objectInstance) {
+	const char* name;
+	size_t length;
+	if (this->GetObjectName(deviceInstance, objectType, objectInstance, &name, &length)) {
+		this->nameIndex.Add(name, length, deviceInstance, objectType, objectInstance);
+	}
+}
+
+void ExampleDatabase::IndexDevice(const uint32_t deviceInstance) {
+	this->IndexObject(deviceInstance, ExampleConstants::OBJECT_TYPE_DEVICE, deviceInstance);
+	this->IndexDeviceObjects(this->analogInputs, deviceInstance);
+	this->IndexDeviceObjects(this->analogOutputs, deviceInstance);
+	this->IndexDeviceObjects(this->binaryOutputs, deviceInstance);
+	this->IndexDeviceObjects(this->binaryInputs, deviceInstance);
+	this->IndexDeviceObjects(this->binaryValues, deviceInstance);
+	this->IndexDeviceObjects(this->multiStateValues, deviceInstance);
+	this->IndexDeviceObjects(this->analogValues, deviceInstance);
+}
+
+size_t ExampleDatabase::FindObjectsByName(const char* name, const size_t length, ExampleDatabaseObjectReference* objects, const size_t maxCount) {
+	if (!this->nameIndexBuilt) {
+		this->BuildNameIndex();
+	}
+	size_t first;
+	const size_t count = this->nameIndex.Find(name, length, &first);
+	size_t found = 0;
+	for (size_t i = first; i < first + count; i++) {
+		// Only the hash matched so far
+		const ExampleDatabaseObjectReference& object = this->nameIndex.At(i);
+		const char* objectName;
+		size_t objectNameLength;
+		if (this->GetObjectName(object.deviceInstance, object.objectType, object.objectInstance, &objectName, &objectNameLength) &&
+			objectNameLength == length && memcmp(objectName, name, length) == 0)
+		{
+			if (found < maxCount) {
+				objects[found] = object;
+			}
+			found++;
+		}
+	}
+	return found;
+}
+
+bool ExampleDatabase::HasObjectNamed(const char* name, const size_t length, const uint32_t lowDeviceInstance, const uint32_t highDeviceInstance) {
+	if (!this->nameIndexBuilt) {
+		this->BuildNameIndex();
+	}
+	size_t first;
+	const size_t count = this->nameIndex.Find(name, length, &first);
+	for (size_t i = first; i < first + count; i++) {
+		const ExampleDatabaseObjectReference& object = this->nameIndex.At(i);
+		if (object.deviceInstance < lowDeviceInstance || object.deviceInstance > highDeviceInstance) {
+			continue;
+		}
+		const char* objectName;
+		size_t objectNameLength;
+		if (this->GetObjectName(object.deviceInstance, object.objectType, object.objectInstance, &objectName, &objectNameLength) &&
+			objectNameLength == length && memcmp(objectName, name, length) == 0)
+		{
+			return true;
+		}
+	}
+	return false;
+}
+
+static bool ImageDeviceNetworkLess(const ExampleDatabaseImageDevice& device, const uint16_t network) {
+	return device.network < network;
+}
+
+bool ExampleDatabase::HasVirtualNetwork(const uint16_t network) const {
+	if (this->image.IsOpen()) {
+		if (this->image.GetDeviceCount() == 0) {
+			return false;
+		}
+		// The image devices are in (network, instance) order
+		const ExampleDatabaseImageDevice* first = &this->image.GetDevice(0);
+		const ExampleDatabaseImageDevice* last = first + this->image.GetDeviceCount();
+		const ExampleDatabaseImageDevice* device = std::lower_bound(first, last, network, ImageDeviceNetworkLess);
+		return device != last && device->network == network;
+	}
+	return this->virtualDevices.find(network) != this->virtualDevices.end();
+}
+
+void ExampleDatabase::GetPriorityArrayMemoryUsage(size_t* compactBytes, size_t* naiveBytes, size_t* points) {
+	*compactBytes = 0;
+	*naiveBytes = 0;
+	*points = 0;
+	for (size_t i = 0; i < this->analogOutputs.Size(); i++) {
+		*compactBytes += this->analogOutputs.At(i).priorityArray.GetMemoryUsage();
+		*naiveBytes += sizeof(ExampleDatabaseNaivePriorityArray<float>);
+		(*points)++;
+	}
+	for (size_t i = 0; i < this->binaryOutputs.Size(); i++) {
+		*compactBytes += this->binaryOutputs.At(i).priorityArray.GetMemoryUsage();
+		*naiveBytes += sizeof(ExampleDatabaseNaivePriorityArray<uint8_t>);
+		(*points)++;
+	}
+}
+
+void ExampleDatabase::GetMemoryUsage(ExampleDatabaseMemoryUsage* usage) {
+	usage->devices = 0;
+	usage->objects = 0;
+	usage->recordBytes = sizeof(ExampleDatabaseDevice);
+	usage->strings = this->strings.GetCount();
+	usage->stringReferences = 0;
+	usage->stringPoolBytes = this->strings.GetMemoryUsage();
+	usage->stringBytesWithoutPool = 0;
+	usage->nameIndexBytes = this->nameIndex.GetMemoryUsage();
+
+	this->AddStringMemoryUsage(this->mainDevice.objectName, usage);
+	this->AddStringMemoryUsage(this->mainDevice.description, usage);
+	for (size_t i = 0; i < this->networkPorts.size(); i++) {
+		this->AddStringMemoryUsage(this->networkPorts[i].objectName, usage);
+	}
+
+	std::map<uint16_t, std::vector<ExampleDatabaseDevice> >::const_iterator it;
+	for (it = this->virtualDevices.begin(); it != this->virtualDevices.end(); ++it) {
+		usage->devices += it->second.size();
+		usage->recordBytes += it->second.capacity() * sizeof(ExampleDatabaseDevice);
+		for (size_t i = 0; i < it->second.size(); i++) {
+			this->AddStringMemoryUsage(it->second[i].objectName, usage);
+			this->AddStringMemoryUsage(it->second[i].description, usage);
+		}
+	}
+
+	this->AddStoreMemoryUsage(this->analogInputs, usage);
+	this->AddStoreMemoryUsage(this->binaryInputs, usage);
+	this->AddStoreMemoryUsage(this->binaryValues, usage);
+	this->AddStoreMemoryUsage(this->multiStateValues, usage);
+	this->AddStoreMemoryUsage(this->analogValues, usage);
+	this->AddStoreMemoryUsage(this->analogOutputs, usage);
+	this->AddStoreMemoryUsage(this->binaryOutputs, usage);
+}
+
+void ExampleDatabase::AddStringMemoryUsage(const ExampleDatabaseStringId id, ExampleDatabaseMemoryUsage* usage) const {
+	size_t length;
+	this->strings.Get(id, &length);
+	usage->stringReferences++;
+
+	// A std::string holds up to 15 characters inline (libstdc++ and MSVC).
+	// Longer ones are allocated, rounded up to 16 bytes with 8 bytes of
+	// malloc overhead. The record would hold the std::string instead of the id.
+	usage->stringBytesWithoutPool += sizeof(std::string) - sizeof(ExampleDatabaseStringId);
+	if (length > 15) {
+		usage->stringBytesWithoutPool += (length + 1 + 8 + 15) & ~(size_t)15;
+	}
+}
+
+ExampleDatabaseAnalogInput* ExampleDatabase::FindAnalogInput(const uint32_t deviceInstance, const uint32_t objectInstance) {
+	return this->FindRecord(this->analogInputs, deviceInstance, objectInstance);
+}
+
+bool ExampleDatabase::FindImageDevice(const uint32_t deviceInstance, uint32_t* index) {
+	void* memoized;
+	if (this->lookupMemo.Find(ExampleConstants::OBJECT_TYPE_DEVICE, deviceInstance, deviceInstance, &memoized, index)) {
+		return true;
+	}
+	if (!this->image.FindDevice(deviceInstance, index)) {
+		return false;
+	}
+	this->lookupMemo.Add(ExampleConstants::OBJECT_TYPE_DEVICE, deviceInstance, deviceInstance, NULL, *index);
+	return true;
+}
+
+bool ExampleDatabase::FindImageAnalogInput(const uint32_t deviceInstance, const uint32_t objectInstance, uint32_t* index) {
+	void* memoized;
+	if (this->lookupMemo.Find(ExampleConstants::OBJECT_TYPE_ANALOG_INPUT, deviceInstance, objectInstance, &memoized, index)) {
+		return true;
+	}
+	if (!this->image.FindAnalogInput(deviceInstance, objectInstance, index)) {
+		return false;
+	}
+	this->lookupMemo.Add(ExampleConstants::OBJECT_TYPE_ANALOG_INPUT, deviceInstance, objectInstance, NULL, *index);
+	return true;
+}
+
+bool ExampleDatabase::GetVirtualDeviceName(const uint32_t deviceInstance, const char** name, size_t* length) {
+	if (this->image.IsOpen()) {
+		uint32_t index;
+		if (!this->FindImageDevice(deviceInstance, &index)) {
+			return false;
+		}
+		*name = this->image.GetString(this->image.GetDevice(index).objectName, length);
+		return true;
+	}
+	ExampleDatabaseDevice* device = this->FindVirtualDevice(deviceInstance);
+	if (device == NULL) {
+		return false;
+	}
+	*name = this->strings.Get(device->objectName, length);
+	return true;
+}
+
+bool ExampleDatabase::GetVirtualDeviceDescription(const uint32_t deviceInstance, const char** description, size_t* length) {
+	if (this->image.IsOpen()) {
+		uint32_t index;
+		if (!this->FindImageDevice(deviceInstance, &index)) {
+			return false;
+		}
+		*description = this->image.GetString(this->image.GetDevice(index).description, length);
+		return true;
+	}
+	ExampleDatabaseDevice* device = this->FindVirtualDevice(deviceInstance);
+	if (device == NULL) {
+		return false;
+	}
+	*description = this->strings.Get(device->description, length);
+	return true;
+}
+
+bool ExampleDatabase::GetVirtualDeviceSystemStatus(const uint32_t deviceInstance, uint32_t* systemStatus) {
+	if (this->image.IsOpen()) {
+		uint32_t index;
+		if (!this->FindImageDevice(deviceInstance, &index)) {
+			return false;
+		}
+		*systemStatus = this->image.deviceSystemStatus[index];
+		return true;
+	}
+	ExampleDatabaseDevice* device = this->FindVirtualDevice(deviceInstance);
+	if (device == NULL) {
+		return false;
+	}
+	*systemStatus = device->systemStatus;
+	return true;
+}
+
+bool ExampleDatabase::GetAnalogInputName(const uint32_t deviceInstance, const uint32_t objectInstance, const char** name, size_t* length) {
+	if (this->image.IsOpen()) {
+		uint32_t index;
+		if (!this->FindImageAnalogInput(deviceInstance, objectInstance, &index)) {
+			return false;
+		}
+		*name = this->image.GetString(this->image.GetAnalogInput(index).objectName, length);
+		return true;
+	}
+	ExampleDatabaseAnalogInput* analogInput = this->FindAnalogInput(deviceInstance, objectInstance);
+	if (analogInput == NULL) {
+		return false;
+	}
+	*name = this->strings.Get(analogInput->objectName, length);
+	return true;
+}
+
+bool ExampleDatabase::GetAnalogInputPresentValue(const uint32_t deviceInstance, const uint32_t objectInstance, float* presentValue) {
+	if (this->valueCache.IsRunning() && this->valueCache.Get(deviceInstance, ExampleConstants::OBJECT_TYPE_ANALOG_INPUT, objectInstance, presentValue)) {
+		return true;
+	}
+	if (this->image.IsOpen()) {
+		uint32_t index;
+		if (!this->FindImageAnalogInput(deviceInstance, objectInstance, &index)) {
+			return false;
+		}
+		*presentValue = this->image.analogInputPresentValue[index];
+		return true;
+	}
+	ExampleDatabaseAnalogInput* analogInput = this->FindAnalogInput(deviceInstance, objectInstance);
+	if (analogInput == NULL) {
+		return false;
+	}
+	*presentValue = analogInput->presentValue;
+	return true;
+}
+
+bool ExampleDatabase::GetAnalogInputReliability(const uint32_t deviceInstance, const uint32_t objectInstance, uint32_t* reliability) {
+	if (this->image.IsOpen()) {
+		uint32_t index;
+		if (!this->FindImageAnalogInput(deviceInstance, objectInstance, &index)) {
+			return false;
+		}
+		*reliability = this->image.analogInputReliability[index];
+		return true;
+	}
+	ExampleDatabaseAnalogInput* analogInput = this->FindAnalogInput(deviceInstance, objectInstance);
+	if (analogInput == NULL) {
+		return false;
+	}
+	*reliability = analogInput->reliability;
+	return true;
+}
+
+bool ExampleDatabase::SetAnalogInputPresentValue(const uint32_t deviceInstance, const uint32_t objectInstance, const float presentValue) {
+	if (this->valueCache.IsRunning() && this->valueCache.Update(deviceInstance, ExampleConstants::OBJECT_TYPE_ANALOG_INPUT, objectInstance, presentValue)) {
+		return true;
+	}
+	if (this->image.IsOpen()) {
+		uint32_t index;
+		if (!this->FindImageAnalogInput(deviceInstance, objectInstance, &index)) {
+			return false;
+		}
+		this->image.analogInputPresentValue[index] = presentValue;
+		this->ObjectChanged(deviceInstance, ExampleConstants::OBJECT_TYPE_ANALOG_INPUT, objectInstance);
+		return true;
+	}
+	ExampleDatabaseAnalogInput* analogInput = this->FindAnalogInput(deviceInstance, objectInstance);
+	if (analogInput == NULL) {
+		return false;
+	}
+	analogInput->presentValue = presentValue;
+	this->ObjectChanged(deviceInstance, ExampleConstants::OBJECT_TYPE_ANALOG_INPUT, objectInstance);
+	return true;
+}
+
+bool ExampleDatabase::IsChangeTracked(const uint16_t objectType, const uint32_t propertyIdentifier) const {
+	return !(this->valueCache.IsRunning() && objectType == ExampleConstants::OBJECT_TYPE_ANALOG_INPUT && propertyIdentifier == ExampleConstants::PROPERTY_IDENTIFIER_PRESENT_VALUE);
+}
+
+void ExampleDatabase::GetOutputEntry(ExampleDatabaseVirtualDeviceEntry& entry) {
+	const ExampleDatabaseAnalogOutput* analogOutput = this->analogOutputs.FindFirst(entry.deviceInstance);
+	entry.hasAnalogOutput = analogOutput != NULL;
+	entry.analogOutputInstance = entry.hasAnalogOutput ? analogOutput->instance : 0;
+	const ExampleDatabaseBinaryOutput* binaryOutput = this->binaryOutputs.FindFirst(entry.deviceInstance);
+	entry.hasBinaryOutput = binaryOutput != NULL;
+	entry.binaryOutputInstance = entry.hasBinaryOutput ? binaryOutput->instance : 0;
+}
+
+void ExampleDatabase::GetVirtualDeviceList(std::vector<ExampleDatabaseVirtualDeviceEntry>& entries) {
+	entries.clear();
+	ExampleDatabaseVirtualDeviceEntry entry;
+
+	if (this->image.IsOpen()) {
+		// The image stores the devices in (network, instance) order and the
+		// analog inputs in (device, instance) order
+		entries.reserve(this->image.GetDeviceCount());
+		for (uint32_t i = 0; i < this->image.GetDeviceCount(); i++) {
+			const ExampleDatabaseImageDevice& device = this->image.GetDevice(i);
+			entry.network = device.network;
+			entry.deviceInstance = device.instance;
+			entry.hasAnalogInput = false;
+			entry.analogInputInstance = 0;
+			this->GetOutputEntry(entry);
+			entries.push_back(entry);
+		}
+		for (uint32_t i = 0; i < this->image.GetAnalogInputCount(); i++) {
+			const ExampleDatabaseImageAnalogInput& analogInput = this->image.GetAnalogInput(i);
+			uint32_t index;
+			if (this->image.FindDevice(analogInput.deviceInstance, &index)) {
+				entries[index].hasAnalogInput = true;
+				entries[index].analogInputInstance = analogInput.instance;
+			}
+		}
+		return;
+	}
+
+	std::map<uint16_t, std::vector<ExampleDatabaseDevice> >::iterator it;
+	for (it = this->virtualDevices.begin(); it != this->virtualDevices.end(); ++it) {
+		std::vector<ExampleDatabaseDevice>::iterator devIt;
+		for (devIt = it->second.begin(); devIt != it->second.end(); ++devIt) {
+			entry.network = it->first;
+			entry.deviceInstance = devIt->instance;
+			const ExampleDatabaseAnalogInput* analogInput = this->analogInputs.FindFirst(devIt->instance);
+			entry.hasAnalogInput = analogInput != NULL;
+			entry.analogInputInstance = entry.hasAnalogInput ? analogInput->instance : 0;
+			this->GetOutputEntry(entry);
+			entries.push_back(entry);
+		}
+	}
+}
+
 void ExampleDatabase::LoadNetworkPortProperties() {
 
 	// This function loads the Network port property values needed.
 	// It uses system functions to get values like the IP Address and stores them
 	// in the example database
 
-	this->networkPort.BACnetIPUDPPort = 47808;
+#ifdef _WIN32 
+	for (size_t portIndex = 0; portIndex < this->networkPorts.size(); portIndex++) {
+		this->LoadNetworkPortProperties(this->networkPorts[portIndex]);
+	}
+#elif defined(__linux__)
+	// The interface table is dumped once over rtnetlink and then kept up to
+	// date by the monitor thread. See ExampleDatabase::Loop()
+	if (!this->interfaceMonitor.IsRunning() && !this->interfaceMonitor.Start()) {
+		printf("Error starting the rtnetlink interface monitor\n");
+		return;
+	}
+	this->ApplyNetworkInterfaces();
 
+	// DNS servers are not available over rtnetlink and are not per
+	// interface, read them once
+	std::vector<uint32_t> servers;
+	CNetlinkInterfaceMonitor::LoadDNSServers(servers);
+	for (size_t portIndex = 0; portIndex < this->networkPorts.size(); portIndex++) {
+		ExampleDatabaseNetworkPort& port = this->networkPorts[portIndex];
+		port.IPDNSServers.clear();
+		for (size_t i = 0; i < servers.size(); i++) {
+			std::array<uint8_t, 4> dns;
+			memcpy(dns.data(), &servers[i], 4);
+			port.IPDNSServers.push_back(dns);
+			port.IPDNSServerLength = 4;
+		}
+	}
+#endif // _WIN32 
+	this->networkPortsRevision++;
+}
 
 #ifdef _WIN32 
+void ExampleDatabase::LoadNetworkPortProperties(ExampleDatabaseNetworkPort& port) {
 	PIP_ADAPTER_ADDRESSES pAddresses = NULL;
 	PIP_ADAPTER_INFO pAdapterInfo;
 	PIP_ADAPTER_INFO pAdapter = NULL;
@@ -115,27 +1110,32 @@ void ExampleDatabase::LoadNetworkPortProperties() {
 		pAdapter = pAdapterInfo;
 		while (pAdapter) {
 			// If this is the Ethernet port, then extract the parameters
+			// Only use the adapter that was configured for this port, if any
+			if (!port.interfaceName.empty() && port.interfaceName.compare(pAdapter->AdapterName) != 0 && port.interfaceName.compare(pAdapter->Description) != 0) {
+				pAdapter = pAdapter->Next;
+				continue;
+			}
 			if (pAdapter->Type == MIB_IF_TYPE_ETHERNET) {
 				// Ethernet adapter
 				// Extract the ethernet parameters needed for the Network Port Object
 				// IP Address
-				this->networkPort.IPAddressLength = sscanf_s(pAdapter->IpAddressList.IpAddress.String, "%hhd.%hhd.%hhd.%hhd", &this->networkPort.IPAddress[0], &this->networkPort.IPAddress[1], &this->networkPort.IPAddress[2], &this->networkPort.IPAddress[3]);
+				port.IPAddressLength = sscanf_s(pAdapter->IpAddressList.IpAddress.String, "%hhd.%hhd.%hhd.%hhd", &port.IPAddress[0], &port.IPAddress[1], &port.IPAddress[2], &port.IPAddress[3]);
 				if (strcmp(pAdapter->IpAddressList.IpAddress.String, "0.0.0.0") == 0) {
 					pAdapter = pAdapter->Next;
 					continue;
 				}
 				// Default Gateway
-				this->networkPort.IPDefaultGatewayLength = sscanf_s(pAdapter->GatewayList.IpAddress.String, "%hhd.%hhd.%hhd.%hhd", &this->networkPort.IPDefaultGateway[0], &this->networkPort.IPDefaultGateway[1], &this->networkPort.IPDefaultGateway[2], &this->networkPort.IPDefaultGateway[3]);
+				port.IPDefaultGatewayLength = sscanf_s(pAdapter->GatewayList.IpAddress.String, "%hhd.%hhd.%hhd.%hhd", &port.IPDefaultGateway[0], &port.IPDefaultGateway[1], &port.IPDefaultGateway[2], &port.IPDefaultGateway[3]);
 
 				// Subnet Mask
-				this->networkPort.IPSubnetMaskLength = sscanf_s(pAdapter->IpAddressList.IpMask.String, "%hhd.%hhd.%hhd.%hhd", &this->networkPort.IPSubnetMask[0], &this->networkPort.IPSubnetMask[1], &this->networkPort.IPSubnetMask[2], &this->networkPort.IPSubnetMask[3]);
+				port.IPSubnetMaskLength = sscanf_s(pAdapter->IpAddressList.IpMask.String, "%hhd.%hhd.%hhd.%hhd", &port.IPSubnetMask[0], &port.IPSubnetMask[1], &port.IPSubnetMask[2], &port.IPSubnetMask[3]);
 
 				// Interface Name
 				selectedAdapterName = std::string(pAdapter->AdapterName);
 
 				// Prepare the broadcast address
 				for (size_t i = 0; i < 4; i++) {
-					this->networkPort.BroadcastIPAddress[i] = this->networkPort.IPAddress[i] | ~this->networkPort.IPSubnetMask[i];
+					port.BroadcastIPAddress[i] = port.IPAddress[i] | ~port.IPSubnetMask[i];
 				}
 
 				break;
@@ -163,7 +1163,7 @@ void ExampleDatabase::LoadNetworkPortProperties() {
 
 	PIP_ADAPTER_ADDRESSES pCurrAddresses = pAddresses;
 	IP_ADAPTER_DNS_SERVER_ADDRESS* pDnServer = NULL;
-	while (pCurrAddresses && this->networkPort.IPDNSServers.size() <= 0) {
+	while (pCurrAddresses && port.IPDNSServers.size() <= 0) {
 		std::string adapterName = std::string(pCurrAddresses->AdapterName);
 		if (adapterName.compare(selectedAdapterName) == 0) {
 
@@ -173,11 +1173,11 @@ void ExampleDatabase::LoadNetworkPortProperties() {
 				SOCKADDR* sockaddr = pDnServer->Address.lpSockaddr;
 				if (sockaddr != NULL && sockaddr->sa_family == AF_INET) {
 					SOCKADDR_IN* temp = (SOCKADDR_IN*)sockaddr;
-					uint8_t* dns = new uint8_t[4];
+					std::array<uint8_t, 4> dns;
 
 					sscanf_s(inet_ntoa(temp->sin_addr), "%hhd.%hhd.%hhd.%hhd", &dns[0], &dns[1], &dns[2], &dns[3]);
-					this->networkPort.IPDNSServers.push_back(dns);
-					this->networkPort.IPDNSServerLength = 4;
+					port.IPDNSServers.push_back(dns);
+					port.IPDNSServerLength = 4;
 				}
 				pDnServer = pDnServer->Next;
 			}
@@ -192,8 +1192,96 @@ void ExampleDatabase::LoadNetworkPortProperties() {
 		FREE(pAddresses);
 	}
 
+}
 #endif // _WIN32 
+
+#ifdef __linux__
+void ExampleDatabase::ApplyNetworkInterfaces() {
+	std::vector<NetworkInterfaceAddress> interfaces;
+	this->interfaceMonitor.GetInterfaces(interfaces);
+
+	for (size_t portIndex = 0; portIndex < this->networkPorts.size(); portIndex++) {
+		ExampleDatabaseNetworkPort& port = this->networkPorts[portIndex];
+		NetworkInterfaceAddress selected;
+		if (!CNetlinkInterfaceMonitor::SelectInterface(interfaces, port.interfaceName, selected)) {
+			printf("Error no usable network interface found for port=[%u], interface=[%s]\n", port.instance, port.interfaceName.c_str());
+			continue;
+		}
+
+		memcpy(port.IPAddress, selected.IPAddress, 4);
+		port.IPAddressLength = 4;
+		memcpy(port.IPSubnetMask, selected.IPSubnetMask, 4);
+		port.IPSubnetMaskLength = 4;
+		memcpy(port.BroadcastIPAddress, selected.BroadcastIPAddress, 4);
+		if (selected.hasDefaultGateway) {
+			memcpy(port.IPDefaultGateway, selected.IPDefaultGateway, 4);
+			port.IPDefaultGatewayLength = 4;
+		}
+		else {
+			port.IPDefaultGatewayLength = 0;
+		}
+		this->ObjectChanged(this->mainDevice.instance, ExampleConstants::OBJECT_TYPE_NETWORK_PORT, port.instance);
+	}
+	this->networkPortsRevision++;
 }
+#endif // __linux__
 
 void ExampleDatabase::Loop() {
+#ifdef __linux__
+	// Pick up address changes reported by the rtnetlink monitor. This is a
+	// single atomic load unless the interface table actually changed.
+	if (this->interfaceMonitor.HasChanged()) {
+		this->ApplyNetworkInterfaces();
+	}
+#endif // __linux__
+
+	// Log the analog inputs on a fixed interval
+	if (!this->trendLogs.empty() && std::chrono::steady_clock::now() >= this->nextTrendLogTime) {
+		this->nextTrendLogTime += std::chrono::seconds(this->trendLogIntervalSeconds);
+		if (this->nextTrendLogTime < std::chrono::steady_clock::now()) {
+			// Fell behind, do not log a burst of samples to catch up
+			this->nextTrendLogTime = std::chrono::steady_clock::now() + std::chrono::seconds(this->trendLogIntervalSeconds);
+		}
+		this->LogTrends((uint64_t)std::chrono::duration_cast<std::chrono::milliseconds>(std::chrono::system_clock::now().time_since_epoch()).count());
+	}
+
+	// Apply the values published by other processes since the last loop.
+	// Only the points flagged in the change bitmap are read.
+	if (this->pointIngestion.IsOpen()) {
+		this->pointIngestionCount += this->pointIngestion.Consume([this](const PointIngestionPoint& point, const float value, const uint64_t) {
+			this->SetAnalogInputPresentValue(point.deviceInstance, point.objectInstance, value);
+		});
+	}
+}
+
+bool ExampleDatabase::OpenPointIngestion(const char* name) {
+	std::vector<ExampleDatabaseVirtualDeviceEntry> entries;
+	this->GetVirtualDeviceList(entries);
+
+	std::vector<PointIngestionPointKey> keys;
+	keys.reserve(entries.size());
+	for (size_t i = 0; i < entries.size(); i++) {
+		if (entries[i].hasAnalogInput) {
+			PointIngestionPointKey key;
+			key.deviceInstance = entries[i].deviceInstance;
+			key.objectInstance = entries[i].analogInputInstance;
+			keys.push_back(key);
+		}
+	}
+	this->pointIngestionCount = 0;
+	return this->pointIngestion.Create(name, keys);
+}
+
+bool ExampleDatabase::StartValueCache(CValueCacheBackend* backend, const uint32_t ttlMilliseconds, const uint32_t workerCount, const uint32_t deadlineMilliseconds) {
+	std::vector<ExampleDatabaseVirtualDeviceEntry> entries;
+	this->GetVirtualDeviceList(entries);
+
+	// Start from the values in the database
+	for (size_t i = 0; i < entries.size(); i++) {
+		float presentValue;
+		if (entries[i].hasAnalogInput && this->GetAnalogInputPresentValue(entries[i].deviceInstance, entries[i].analogInputInstance, &presentValue)) {
+			this->valueCache.Add(entries[i].deviceInstance, ExampleConstants::OBJECT_TYPE_ANALOG_INPUT, entries[i].analogInputInstance, presentValue);
+		}
+	}
+	return this->valueCache.Start(backend, ttlMilliseconds, workerCount, deadlineMilliseconds);
 }
\ No newline at end of file
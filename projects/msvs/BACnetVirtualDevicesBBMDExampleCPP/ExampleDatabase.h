@@ -5,8 +5,9 @@
  *
  * Data storage that contains the example data used in the BACnet Virtual 
  * Devices and BBMD Example. This data is represented by BACnet objects for this
- * example. The database will contain multiple virtual devices that have one 
- * object each.
+ * example. The database will contain multiple virtual devices that each have
+ * an Analog Input, Analog Output, Binary Output, Binary Input, Binary Value,
+ * Multi-State Value and Analog Value (see --objects-per-type).
  *
  * Created by: Alex Fontaine
  */
@@ -14,16 +15,35 @@
 #ifndef __ExampleDatabase_h__
 #define __ExampleDatabase_h__
 
+#include <array>
+#include <chrono>
+#include <functional>
 #include <string>
 #include <map>
 #include <vector>
 
+#include "NetlinkInterfaceMonitor.h"
+#include "ExampleDatabaseImage.h"
+#include "ExampleDatabaseLookupMemo.h"
+#include "ExampleDatabasePriorityArray.h"
+#include "ExampleDatabaseNameIndex.h"
+#include "ExampleDatabaseObjectStore.h"
+#include "ExampleDatabaseStringPool.h"
+#include "ExampleConstants.h"
+#include "TrendLog.h"
+#include "PointIngestion.h"
+#include "ValueCache.h"
+
 // Constants
 #define NUMBER_OF_VIRTUAL_NETWORKS		3
+#define MAX_VIRTUAL_NETWORKS			40		// The device instances of the last network stay below 4194303
 #define STARTING_VIRTUAL_NETWORK		1000
 #define VIRTUAL_NETWORK_OFFSET			1000
 #define NUMBER_OF_DEVICES_PER_NETWORK	1
-#define STARTING_DEVICE_INSTANCE		100000
+#define STARTING_DEVICE_INSTANCE		100000	// Also the size of the block of instances of each network
+#define MAIN_DEVICE_INSTANCE			389999
+#define RESERVED_DEVICE_INSTANCES		17		// The main device, and the main devices of up to 16 shard workers after it
+#define LAST_DEVICE_INSTANCE			4194302
 
 // Base class for all object types. 
 class ExampleDatabaseBaseObject
@@ -33,21 +53,163 @@ public:
 	static const uint8_t PRIORITY_ARRAY_LENGTH = 16;
 
 	// All objects will have the following properties 
-	std::string objectName;
+	ExampleDatabaseStringId objectName;	// In ExampleDatabase::strings
 	uint32_t instance;
 };
 
+// Kept in an ExampleDatabaseObjectStore, one per virtual device
 class ExampleDatabaseAnalogInput : public ExampleDatabaseBaseObject
 {
 public:
+	uint32_t deviceInstance;
+	float presentValue;
+	uint32_t reliability;
+};
+
+// Commandable objects. The present value is the winner of the priority array.
+class ExampleDatabaseAnalogOutput : public ExampleDatabaseBaseObject
+{
+public:
+	uint32_t deviceInstance;
+	ExampleDatabasePriorityArray<float> priorityArray;
+};
+
+class ExampleDatabaseBinaryOutput : public ExampleDatabaseBaseObject
+{
+public:
+	uint32_t deviceInstance;
+	ExampleDatabasePriorityArray<uint8_t> priorityArray;	// inactive (0), active (1)
+};
+
+// Object types kept in an ExampleDatabaseObjectStore. The records are owned by
+// the store, which sorts them by (deviceInstance, instance).
+class ExampleDatabaseBinaryInput : public ExampleDatabaseBaseObject
+{
+public:
+	uint32_t deviceInstance;
+	uint32_t presentValue;	// inactive (0), active (1)
+	uint32_t reliability;
+	bool outOfService;
+};
+
+class ExampleDatabaseBinaryValue : public ExampleDatabaseBaseObject
+{
+public:
+	uint32_t deviceInstance;
+	uint32_t presentValue;	// inactive (0), active (1)
+	bool outOfService;
+};
+
+class ExampleDatabaseMultiStateValue : public ExampleDatabaseBaseObject
+{
+public:
+	uint32_t deviceInstance;
+	uint32_t presentValue;	// 1 to numberOfStates
+	uint32_t numberOfStates;
+	bool outOfService;
+};
+
+class ExampleDatabaseAnalogValue : public ExampleDatabaseBaseObject
+{
+public:
+	uint32_t deviceInstance;
 	float presentValue;
 	uint32_t reliability;
+	bool outOfService;
+};
+
+template <>
+class ExampleDatabaseObjectTraits<ExampleDatabaseAnalogInput>
+{
+public:
+	typedef ExampleDatabaseAnalogInput R;
+	static const uint16_t OBJECT_TYPE = ExampleConstants::OBJECT_TYPE_ANALOG_INPUT;
+	typedef ExampleDatabaseProperties<
+		ExampleDatabaseProperty<ExampleConstants::PROPERTY_IDENTIFIER_PRESENT_VALUE, PROPERTY_KIND_REAL, R, float, &R::presentValue>,
+		ExampleDatabaseProperty<ExampleConstants::PROPERTY_IDENTIFIER_RELIABILITY, PROPERTY_KIND_ENUMERATED, R, uint32_t, &R::reliability>
+	> Properties;
+	static bool Validate(const R&, const uint32_t, const double) { return true; }
+};
+
+// The outputs are written through their priority array by the property
+// callbacks, the store only keeps them
+template <>
+class ExampleDatabaseObjectTraits<ExampleDatabaseAnalogOutput>
+{
+public:
+	static const uint16_t OBJECT_TYPE = ExampleConstants::OBJECT_TYPE_ANALOG_OUTPUT;
+	typedef ExampleDatabaseProperties<> Properties;
+	static bool Validate(const ExampleDatabaseAnalogOutput&, const uint32_t, const double) { return true; }
+};
+
+template <>
+class ExampleDatabaseObjectTraits<ExampleDatabaseBinaryOutput>
+{
+public:
+	static const uint16_t OBJECT_TYPE = ExampleConstants::OBJECT_TYPE_BINARY_OUTPUT;
+	typedef ExampleDatabaseProperties<> Properties;
+	static bool Validate(const ExampleDatabaseBinaryOutput&, const uint32_t, const double) { return true; }
+};
+
+template <>
+class ExampleDatabaseObjectTraits<ExampleDatabaseBinaryInput>
+{
+public:
+	typedef ExampleDatabaseBinaryInput R;
+	static const uint16_t OBJECT_TYPE = ExampleConstants::OBJECT_TYPE_BINARY_INPUT;
+	typedef ExampleDatabaseProperties<
+		ExampleDatabaseProperty<ExampleConstants::PROPERTY_IDENTIFIER_PRESENT_VALUE, PROPERTY_KIND_ENUMERATED, R, uint32_t, &R::presentValue>,
+		ExampleDatabaseProperty<ExampleConstants::PROPERTY_IDENTIFIER_RELIABILITY, PROPERTY_KIND_ENUMERATED, R, uint32_t, &R::reliability>,
+		ExampleDatabaseProperty<ExampleConstants::PROPERTY_IDENTIFIER_OUT_OF_SERVICE, PROPERTY_KIND_BOOLEAN, R, bool, &R::outOfService>
+	> Properties;
+	static bool Validate(const R&, const uint32_t, const double) { return true; }
+};
+
+template <>
+class ExampleDatabaseObjectTraits<ExampleDatabaseBinaryValue>
+{
+public:
+	typedef ExampleDatabaseBinaryValue R;
+	static const uint16_t OBJECT_TYPE = ExampleConstants::OBJECT_TYPE_BINARY_VALUE;
+	typedef ExampleDatabaseProperties<
+		ExampleDatabaseProperty<ExampleConstants::PROPERTY_IDENTIFIER_PRESENT_VALUE, PROPERTY_KIND_ENUMERATED, R, uint32_t, &R::presentValue, true>,
+		ExampleDatabaseProperty<ExampleConstants::PROPERTY_IDENTIFIER_OUT_OF_SERVICE, PROPERTY_KIND_BOOLEAN, R, bool, &R::outOfService>
+	> Properties;
+	static bool Validate(const R&, const uint32_t, const double value) { return value == 0 || value == 1; }
+};
+
+template <>
+class ExampleDatabaseObjectTraits<ExampleDatabaseMultiStateValue>
+{
+public:
+	typedef ExampleDatabaseMultiStateValue R;
+	static const uint16_t OBJECT_TYPE = ExampleConstants::OBJECT_TYPE_MULTI_STATE_VALUE;
+	typedef ExampleDatabaseProperties<
+		ExampleDatabaseProperty<ExampleConstants::PROPERTY_IDENTIFIER_PRESENT_VALUE, PROPERTY_KIND_UNSIGNED, R, uint32_t, &R::presentValue, true>,
+		ExampleDatabaseProperty<ExampleConstants::PROPERTY_IDENTIFIER_NUMBER_OF_STATES, PROPERTY_KIND_UNSIGNED, R, uint32_t, &R::numberOfStates>,
+		ExampleDatabaseProperty<ExampleConstants::PROPERTY_IDENTIFIER_OUT_OF_SERVICE, PROPERTY_KIND_BOOLEAN, R, bool, &R::outOfService>
+	> Properties;
+	static bool Validate(const R& record, const uint32_t, const double value) { return value >= 1 && value <= record.numberOfStates; }
+};
+
+template <>
+class ExampleDatabaseObjectTraits<ExampleDatabaseAnalogValue>
+{
+public:
+	typedef ExampleDatabaseAnalogValue R;
+	static const uint16_t OBJECT_TYPE = ExampleConstants::OBJECT_TYPE_ANALOG_VALUE;
+	typedef ExampleDatabaseProperties<
+		ExampleDatabaseProperty<ExampleConstants::PROPERTY_IDENTIFIER_PRESENT_VALUE, PROPERTY_KIND_REAL, R, float, &R::presentValue, true>,
+		ExampleDatabaseProperty<ExampleConstants::PROPERTY_IDENTIFIER_RELIABILITY, PROPERTY_KIND_ENUMERATED, R, uint32_t, &R::reliability>,
+		ExampleDatabaseProperty<ExampleConstants::PROPERTY_IDENTIFIER_OUT_OF_SERVICE, PROPERTY_KIND_BOOLEAN, R, bool, &R::outOfService>
+	> Properties;
+	static bool Validate(const R&, const uint32_t, const double) { return true; }
 };
 
 class ExampleDatabaseDevice : public ExampleDatabaseBaseObject
 {
 public:
-	std::string description;
+	ExampleDatabaseStringId description;	// In ExampleDatabase::strings
 	uint32_t systemStatus;
 };
 
@@ -62,37 +224,374 @@ public:
 	uint8_t IPDefaultGatewayLength;
 	uint8_t IPSubnetMask[4];
 	uint8_t IPSubnetMaskLength;
-	std::vector<uint8_t*> IPDNSServers;
+	std::vector<std::array<uint8_t, 4> > IPDNSServers;
 	uint8_t IPDNSServerLength;
 
 	uint8_t BroadcastIPAddress[4];
+
+	// Name of the interface to use. Empty selects the first usable interface.
+	std::string interfaceName;
 };
 
+// History of the analog input of a virtual device
+class ExampleDatabaseTrendLog
+{
+public:
+	uint32_t analogInputInstance;
+	CTrendLog log;
+};
+
+// Flat view of a virtual device and its object, used to register the
+// virtual devices with the CAS BACnet Stack.
+class ExampleDatabaseVirtualDeviceEntry
+{
+public:
+	uint16_t network;
+	uint32_t deviceInstance;
+	bool hasAnalogInput;
+	uint32_t analogInputInstance;
+	bool hasAnalogOutput;
+	uint32_t analogOutputInstance;
+	bool hasBinaryOutput;
+	uint32_t binaryOutputInstance;
+};
+
+// Told about the changes to the values of the database, see
+// ExampleDatabase::changeListener. Called from the thread that made the
+// change.
+class ExampleDatabaseChangeListener
+{
+public:
+	virtual ~ExampleDatabaseChangeListener() {}
+	// A property of the object changed, or the object was removed
+	virtual void ObjectChanged(const uint32_t deviceInstance, const uint16_t objectType, const uint32_t objectInstance) = 0;
+	// The device was removed, with all of its objects
+	virtual void DeviceChanged(const uint32_t deviceInstance) = 0;
+	// Everything was set up again
+	virtual void DatabaseChanged() = 0;
+};
+
+// Memory used by the devices, their objects and their names. The
+// "withoutPool" figures are what the same names would take as one std::string
+// per record.
+class ExampleDatabaseMemoryUsage
+{
+public:
+	size_t devices;
+	size_t objects;
+	size_t recordBytes;
+	size_t strings;					// Distinct strings in the pool
+	size_t stringReferences;		// Names and descriptions that refer to them
+	size_t stringPoolBytes;
+	size_t stringBytesWithoutPool;
+	size_t nameIndexBytes;
+};
 
 class ExampleDatabase {
 public:
 
 	ExampleDatabaseDevice mainDevice;
-	ExampleDatabaseNetworkPort networkPort;
+
+	// One Network Port object per BACnet/IP interface. The first one is the
+	// primary port that the BBMD runs on. There is always at least one.
+	std::vector<ExampleDatabaseNetworkPort> networkPorts;
+	// Incremented every time the addresses of the network ports are reloaded
+	uint32_t networkPortsRevision;
+
+	// Object names and device descriptions of everything below
+	ExampleDatabaseStringPool strings;
 
 	std::map<uint16_t, std::vector<ExampleDatabaseDevice> > virtualDevices;
-	std::map<uint32_t, ExampleDatabaseAnalogInput> analogInputs;
+	ExampleDatabaseObjectStore<ExampleDatabaseAnalogInput> analogInputs;
+	// Number of virtual devices on each virtual network created by Setup(),
+	// at most GetMaxDevicesPerNetwork()
+	uint32_t devicesPerNetwork;
+	// Number of virtual networks created by Setup(), at most MAX_VIRTUAL_NETWORKS
+	uint32_t virtualNetworkCount;
+	// With --shards, Setup() only creates the virtual networks this accepts,
+	// the ones of the shard of the process. Empty creates all of them.
+	std::function<bool(const uint16_t network)> hostsNetwork;
+	// Commandable outputs, one of each per virtual device. These only hold
+	// runtime state and are created by both Setup() and LoadImage().
+	ExampleDatabaseObjectStore<ExampleDatabaseAnalogOutput> analogOutputs;
+	ExampleDatabaseObjectStore<ExampleDatabaseBinaryOutput> binaryOutputs;
+	// Additional object types, objectsPerType of each type in every virtual
+	// device. Like the outputs these are created by both Setup() and LoadImage().
+	ExampleDatabaseObjectStore<ExampleDatabaseBinaryInput> binaryInputs;
+	ExampleDatabaseObjectStore<ExampleDatabaseBinaryValue> binaryValues;
+	ExampleDatabaseObjectStore<ExampleDatabaseMultiStateValue> multiStateValues;
+	ExampleDatabaseObjectStore<ExampleDatabaseAnalogValue> analogValues;
+	uint32_t objectsPerType;
+
+	// Compressed history of the analog input present values, by device
+	// instance. A sample of every analog input is logged each
+	// trendLogIntervalSeconds (0 disables the logging). Each log uses at most
+	// trendLogCapacity bytes.
+	std::map<uint32_t, ExampleDatabaseTrendLog> trendLogs;
+	uint32_t trendLogIntervalSeconds;
+	size_t trendLogCapacity;
+
+	// Shared memory segment that other processes publish analog input
+	// present values into, see OpenPointIngestion(). The changed points are
+	// applied by Loop(). pointIngestionCount counts the applied values.
+	CPointIngestionServer pointIngestion;
+	uint64_t pointIngestionCount;
+
+	// Analog input present values proxied from slow downstream devices, see
+	// StartValueCache(). While the cache runs the present values of the
+	// devices it was started with are read from, and written to, the cache
+	// instead of the objects. Devices added later are served from the
+	// objects.
+	CValueCache valueCache;
+
+	// Memory mapped database image. When it is open the virtual devices and
+	// their objects are served from the image and the maps above are empty.
+	ExampleDatabaseImage image;
+
+	// The objects found by the lookups below during one fpTick(), so that
+	// the callbacks for the next properties of the same object do not search
+	// for it again. The main loop calls lookupMemo.Begin() and End() around
+	// the tick.
+	ExampleDatabaseLookupMemo lookupMemo;
+
+	// Told about every change to a value, NULL for none
+	ExampleDatabaseChangeListener* changeListener;
 
 	// Constructor/Deconstructor
 	ExampleDatabase();
 	~ExampleDatabase();
 
+	// Adds a BACnet/IP interface. Must be called before Setup() or LoadImage()
+	void AddNetworkInterface(const std::string& interfaceName);
+
 	// Set all the objects to have a default value
 	void Setup();
 
+	// Load the virtual devices from a database image instead of Setup()
+	bool LoadImage(const char* path);
+	// Write the current database to an image that LoadImage() can map
+	bool SaveImage(const char* path);
+
 	// Update the values as needed
 	void Loop();
 
+	// Creates the named point ingestion segment with every analog input.
+	// Must be called after Setup() or LoadImage().
+	bool OpenPointIngestion(const char* name);
+
+	// Serves the analog input present values from the value cache, refreshed
+	// from the backend. Must be called after Setup() or LoadImage().
+	bool StartValueCache(CValueCacheBackend* backend, const uint32_t ttlMilliseconds, const uint32_t workerCount, const uint32_t deadlineMilliseconds);
+
+	// Lookups used by the property callbacks. These serve from the image
+	// when one is loaded. Strings are returned without a copy.
+	bool GetVirtualDeviceName(const uint32_t deviceInstance, const char** name, size_t* length);
+	bool GetVirtualDeviceDescription(const uint32_t deviceInstance, const char** description, size_t* length);
+	bool GetVirtualDeviceSystemStatus(const uint32_t deviceInstance, uint32_t* systemStatus);
+	bool GetAnalogInputName(const uint32_t deviceInstance, const uint32_t objectInstance, const char** name, size_t* length);
+	bool GetAnalogInputPresentValue(const uint32_t deviceInstance, const uint32_t objectInstance, float* presentValue);
+	bool GetAnalogInputReliability(const uint32_t deviceInstance, const uint32_t objectInstance, uint32_t* reliability);
+
+	// Used by the write callbacks
+	bool SetAnalogInputPresentValue(const uint32_t deviceInstance, const uint32_t objectInstance, const float presentValue);
+
+	// Commandable outputs, NULL if the object does not exist
+	ExampleDatabaseAnalogOutput* FindAnalogOutput(const uint32_t deviceInstance, const uint32_t objectInstance);
+	ExampleDatabaseBinaryOutput* FindBinaryOutput(const uint32_t deviceInstance, const uint32_t objectInstance);
+
+	// Properties of the objects in the object stores. False if the object
+	// type is not kept in a store, the object does not exist or the property
+	// is not of that kind.
+	bool GetObjectPropertyReal(const uint32_t deviceInstance, const uint16_t objectType, const uint32_t objectInstance, const uint32_t propertyIdentifier, float* value);
+	bool GetObjectPropertyEnum(const uint32_t deviceInstance, const uint16_t objectType, const uint32_t objectInstance, const uint32_t propertyIdentifier, uint32_t* value);
+	bool GetObjectPropertyUInt(const uint32_t deviceInstance, const uint16_t objectType, const uint32_t objectInstance, const uint32_t propertyIdentifier, uint32_t* value);
+	bool GetObjectPropertyBool(const uint32_t deviceInstance, const uint16_t objectType, const uint32_t objectInstance, const uint32_t propertyIdentifier, bool* value);
+	// valueIsValid is false when the property exists but the value is out of range
+	bool SetObjectPropertyReal(const uint32_t deviceInstance, const uint16_t objectType, const uint32_t objectInstance, const uint32_t propertyIdentifier, const float value, bool* valueIsValid);
+	bool SetObjectPropertyEnum(const uint32_t deviceInstance, const uint16_t objectType, const uint32_t objectInstance, const uint32_t propertyIdentifier, const uint32_t value, bool* valueIsValid);
+	bool SetObjectPropertyUInt(const uint32_t deviceInstance, const uint16_t objectType, const uint32_t objectInstance, const uint32_t propertyIdentifier, const uint32_t value, bool* valueIsValid);
+
+	// Name of any object of the database: the main device and its network
+	// ports, the virtual devices and all of their objects. The network ports
+	// that the stack creates for the virtual networks are not in the
+	// database.
+	bool GetObjectName(const uint32_t deviceInstance, const uint16_t objectType, const uint32_t objectInstance, const char** name, size_t* length);
+
+	// Lookups by object name, through the name index. The index is built on
+	// the first lookup after Setup() or LoadImage() and kept up to date by the
+	// topology changes below. Call BuildNameIndex() again after changing
+	// mainDevice or the network ports directly.
+	void BuildNameIndex();
+	// Copies up to maxCount of the objects named name to objects. Returns the
+	// number of objects with that name.
+	size_t FindObjectsByName(const char* name, const size_t length, ExampleDatabaseObjectReference* objects, const size_t maxCount);
+	// Whether a device in the range, or an object of one, has that name
+	bool HasObjectNamed(const char* name, const size_t length, const uint32_t lowDeviceInstance, const uint32_t highDeviceInstance);
+	// Whether the network is one of the virtual networks
+	bool HasVirtualNetwork(const uint16_t network) const;
+
+	// Whether a virtual device can not have this instance: the main device,
+	// the main devices of the shard workers and anything past the last
+	// valid device instance
+	static bool IsReservedDeviceInstance(const uint32_t deviceInstance) {
+		return (deviceInstance >= MAIN_DEVICE_INSTANCE && deviceInstance < MAIN_DEVICE_INSTANCE + RESERVED_DEVICE_INSTANCES) || deviceInstance > LAST_DEVICE_INSTANCE;
+	}
+	// Largest devicesPerNetwork that keeps the devices of every network
+	// inside the block of instances of their network and clear of the
+	// reserved instances
+	static constexpr uint32_t GetMaxDevicesPerNetwork(const uint32_t virtualNetworkCount) {
+		uint32_t maxDevices = STARTING_DEVICE_INSTANCE;
+		for (uint32_t networkIndex = 0; networkIndex < virtualNetworkCount && networkIndex < MAX_VIRTUAL_NETWORKS; networkIndex++) {
+			const uint32_t firstInstance = STARTING_DEVICE_INSTANCE + (networkIndex * STARTING_DEVICE_INSTANCE);
+			if (firstInstance <= MAIN_DEVICE_INSTANCE && MAIN_DEVICE_INSTANCE - firstInstance < maxDevices) {
+				maxDevices = MAIN_DEVICE_INSTANCE - firstInstance;
+			}
+			if (LAST_DEVICE_INSTANCE + 1 - firstInstance < maxDevices) {
+				maxDevices = LAST_DEVICE_INSTANCE + 1 - firstInstance;
+			}
+		}
+		return maxDevices;
+	}
+
+	// Tells the change listener about a change. The setters above and the
+	// topology changes below call it, callers that change a record found
+	// with FindAnalogOutput() or FindBinaryOutput() have to.
+	void ObjectChanged(const uint32_t deviceInstance, const uint16_t objectType, const uint32_t objectInstance) {
+		if (this->changeListener != NULL) {
+			this->changeListener->ObjectChanged(deviceInstance, objectType, objectInstance);
+		}
+	}
+	// Whether the change listener is told when the property changes. The
+	// analog input present values of the value cache change behind the back
+	// of the database.
+	bool IsChangeTracked(const uint16_t objectType, const uint32_t propertyIdentifier) const;
+
+	// Trend log of the analog input of a virtual device, NULL if there is none
+	const CTrendLog* FindTrendLog(const uint32_t deviceInstance, const uint32_t analogInputInstance);
+	void GetTrendLogMemoryUsage(size_t* bytes, uint64_t* records, size_t* points);
+
+	// Memory used by the priority arrays of all the outputs, against one
+	// optional value per priority
+	void GetPriorityArrayMemoryUsage(size_t* compactBytes, size_t* naiveBytes, size_t* points);
+
+	// Memory used by the device and object records and their names
+	void GetMemoryUsage(ExampleDatabaseMemoryUsage* usage);
+
+	// All the virtual devices, ordered by network
+	void GetVirtualDeviceList(std::vector<ExampleDatabaseVirtualDeviceEntry>& entries);
+	bool GetVirtualDeviceEntry(const uint32_t deviceInstance, ExampleDatabaseVirtualDeviceEntry* entry);
+	size_t GetVirtualDeviceCount() const;
+
+	// Changes to the topology while the main loop runs. The records and the
+	// indexes are updated in place, registering the change with the stack is
+	// up to the caller. Not available on a mapped image. A network can only
+	// be removed once it has no devices left, and only the stored object types
+	// (BI, BV, MSV, AV) can be added to or removed from a device.
+	bool AddVirtualNetwork(const uint16_t network);
+	bool RemoveVirtualNetwork(const uint16_t network);
+	bool AddVirtualDevice(const uint16_t network, const uint32_t deviceInstance);
+	bool RemoveVirtualDevice(const uint32_t deviceInstance);
+	bool AddStoredObject(const uint32_t deviceInstance, const uint16_t objectType, const uint32_t objectInstance);
+	bool RemoveStoredObject(const uint32_t deviceInstance, const uint16_t objectType, const uint32_t objectInstance);
+
+	ExampleDatabaseNetworkPort* FindNetworkPort(const uint32_t objectInstance);
+
 	// Helper functions
 	void LoadNetworkPortProperties();
 
 private:
 	const std::string GetColorName();
+	ExampleDatabaseDevice* FindVirtualDevice(const uint32_t deviceInstance, uint16_t* network = NULL);
+	ExampleDatabaseAnalogInput* FindAnalogInput(const uint32_t deviceInstance, const uint32_t objectInstance);
+
+	std::vector<std::string> networkInterfaceNames;
+	void SetupNetworkPorts();
+	void ReserveObjects(const size_t deviceCount);
+	ExampleDatabaseDevice SetupVirtualDevice(const uint32_t deviceInstance, const float presentValue);
+	void SetupOutputs(const uint32_t deviceInstance, const std::string& nameSuffix);
+	void GetOutputEntry(ExampleDatabaseVirtualDeviceEntry& entry);
+	void SetupStoredObjects(const uint32_t deviceInstance, const std::string& nameSuffix);
+	bool SetupStoredObject(const uint16_t objectType, const uint32_t deviceInstance, const uint32_t instance, const std::string& nameSuffix);
+	void SetupTrendLogs();
+	void SetupTrendLog(const ExampleDatabaseVirtualDeviceEntry& entry);
+	void LogTrends(const uint64_t timestamp);
+	std::chrono::steady_clock::time_point nextTrendLogTime;
+	ExampleDatabaseNameIndex nameIndex;
+	bool nameIndexBuilt;
+	void IndexObject(const uint32_t deviceInstance, const uint16_t objectType, const uint32_t objectInstance);
+	void IndexDevice(const uint32_t deviceInstance);
+	template <typename Record>
+	void IndexStoredObjects(const ExampleDatabaseObjectStore<Record>& store, const size_t first, const size_t count) {
+		for (size_t i = first; i < first + count; i++) {
+			const Record& record = store.At(i);
+			size_t length;
+			const char* name = this->strings.Get(record.objectName, &length);
+			this->nameIndex.Add(name, length, record.deviceInstance, store.GetObjectType(), record.instance);
+		}
+	}
+	template <typename Record>
+	void IndexDeviceObjects(ExampleDatabaseObjectStore<Record>& store, const uint32_t deviceInstance) {
+		size_t first;
+		const size_t count = store.FindDevice(deviceInstance, &first);
+		this->IndexStoredObjects(store, first, count);
+	}
+	// Finds the object through lookupMemo
+	template <typename Record>
+	Record* FindRecord(ExampleDatabaseObjectStore<Record>& store, const uint32_t deviceInstance, const uint32_t objectInstance) {
+		void* memoized;
+		uint32_t index;
+		if (this->lookupMemo.Find(store.GetObjectType(), deviceInstance, objectInstance, &memoized, &index)) {
+			return (Record*)memoized;
+		}
+		Record* record = store.Find(deviceInstance, objectInstance);
+		if (record != NULL) {
+			this->lookupMemo.Add(store.GetObjectType(), deviceInstance, objectInstance, record, 0);
+		}
+		return record;
+	}
+	bool FindImageDevice(const uint32_t deviceInstance, uint32_t* index);
+	bool FindImageAnalogInput(const uint32_t deviceInstance, const uint32_t objectInstance, uint32_t* index);
+	template <typename Record, typename Value>
+	bool GetRecordProperty(ExampleDatabaseObjectStore<Record>& store, const uint32_t deviceInstance, const uint32_t objectInstance, const uint32_t propertyIdentifier, const ExampleDatabasePropertyKind kind, Value* value) {
+		const Record* record = this->FindRecord(store, deviceInstance, objectInstance);
+		return record != NULL && store.GetRecordProperty(*record, propertyIdentifier, kind, value);
+	}
+	template <typename Record, typename Value>
+	bool SetRecordProperty(ExampleDatabaseObjectStore<Record>& store, const uint32_t deviceInstance, const uint32_t objectInstance, const uint32_t propertyIdentifier, const ExampleDatabasePropertyKind kind, const Value value, bool* valueIsValid) {
+		Record* record = this->FindRecord(store, deviceInstance, objectInstance);
+		return record != NULL && store.SetRecordProperty(*record, propertyIdentifier, kind, value, valueIsValid);
+	}
+	template <typename Record>
+	bool GetStoredObjectName(ExampleDatabaseObjectStore<Record>& store, const uint32_t deviceInstance, const uint32_t objectInstance, const char** name, size_t* length) {
+		Record* record = this->FindRecord(store, deviceInstance, objectInstance);
+		if (record == NULL) {
+			return false;
+		}
+		*name = this->strings.Get(record->objectName, length);
+		return true;
+	}
+	template <typename Record>
+	void AddStoreMemoryUsage(const ExampleDatabaseObjectStore<Record>& store, ExampleDatabaseMemoryUsage* usage) const {
+		usage->recordBytes += store.GetMemoryUsage();
+		usage->objects += store.Size();
+		for (size_t i = 0; i < store.Size(); i++) {
+			this->AddStringMemoryUsage(store.At(i).objectName, usage);
+		}
+	}
+	void AddStringMemoryUsage(const ExampleDatabaseStringId id, ExampleDatabaseMemoryUsage* usage) const;
+	template <typename Value>
+	bool GetStoredObjectProperty(const uint32_t deviceInstance, const uint16_t objectType, const uint32_t objectInstance, const uint32_t propertyIdentifier, const ExampleDatabasePropertyKind kind, Value* value);
+	template <typename Value>
+	bool SetStoredObjectProperty(const uint32_t deviceInstance, const uint16_t objectType, const uint32_t objectInstance, const uint32_t propertyIdentifier, const ExampleDatabasePropertyKind kind, const Value value, bool* valueIsValid);
+#ifdef _WIN32
+	void LoadNetworkPortProperties(ExampleDatabaseNetworkPort& port);
+#endif // _WIN32
+
+#ifdef __linux__
+	// Caches the interface table and tracks address changes
+	CNetlinkInterfaceMonitor interfaceMonitor;
+	void ApplyNetworkInterfaces();
+#endif // __linux__
 
 
 
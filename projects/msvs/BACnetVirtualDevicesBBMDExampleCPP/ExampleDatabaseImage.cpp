@@ -0,0 +1,361 @@
+/*
+ * BACnet Virtual Devices and BBMD Example C++
+ * ----------------------------------------------------------------------------
+ * ExampleDatabaseImage.cpp
+ *
+ * Writes and memory maps the binary image of the example database.
+ */
+
+#include "ExampleDatabaseImage.h"
+#include "ExampleDatabase.h"
+
+#include <algorithm>
+#include <stdio.h>
+#include <string.h>
+#include <map>
+#include <string>
+
+#ifdef _WIN32
+#include <winsock2.h>
+#include <windows.h>
+#else
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif // _WIN32
+
+// Builds the string blob. Identical strings are only stored once.
+class ExampleDatabaseImageStringWriter
+{
+public:
+	std::string blob;
+
+	ExampleDatabaseImageString Add(const std::string& value) {
+		ExampleDatabaseImageString reference;
+		std::map<std::string, uint32_t>::iterator it = this->m_offsets.find(value);
+		if (it != this->m_offsets.end()) {
+			reference.offset = it->second;
+		}
+		else {
+			reference.offset = (uint32_t)this->blob.size();
+			this->m_offsets[value] = reference.offset;
+			this->blob.append(value);
+		}
+		reference.length = (uint32_t)value.size();
+		return reference;
+	}
+
+private:
+	std::map<std::string, uint32_t> m_offsets;
+};
+
+static uint32_t AlignOffset(size_t offset) {
+	return (uint32_t)((offset + 7) & ~(size_t)7);
+}
+
+ExampleDatabaseImage::ExampleDatabaseImage() {
+	this->m_base = NULL;
+	this->m_size = 0;
+	this->m_file = NULL;
+	this->m_mapping = NULL;
+	this->m_devices = NULL;
+	this->m_deviceIndex = NULL;
+	this->m_deviceCount = 0;
+	this->m_analogInputs = NULL;
+	this->m_analogInputCount = 0;
+	this->m_strings = NULL;
+	this->m_stringsSize = 0;
+}
+
+ExampleDatabaseImage::~ExampleDatabaseImage() {
+	this->Close();
+}
+
+bool ExampleDatabaseImage::Write(const char* path, const ExampleDatabase& database) {
+	ExampleDatabaseImageStringWriter strings;
+	std::vector<ExampleDatabaseImageDevice> devices;
+	std::vector<ExampleDatabaseImageAnalogInput> analogInputs;
+
+	ExampleDatabaseImageHeader header;
+	memset(&header, 0, sizeof(header));
+	header.magic = EXAMPLE_DATABASE_IMAGE_MAGIC;
+	header.version = EXAMPLE_DATABASE_IMAGE_VERSION;
+	header.byteOrder = EXAMPLE_DATABASE_IMAGE_BYTE_ORDER;
+	header.headerSize = sizeof(ExampleDatabaseImageHeader);
+	header.mainDeviceInstance = database.mainDevice.instance;
+	header.mainDeviceSystemStatus = database.mainDevice.systemStatus;
+	header.mainDeviceName = strings.Add(database.strings.GetString(database.mainDevice.objectName));
+	header.mainDeviceDescription = strings.Add(database.strings.GetString(database.mainDevice.description));
+	header.networkPortInstance = database.networkPorts.empty() ? 0 : database.networkPorts[0].instance;
+	header.networkPortName = strings.Add(database.networkPorts.empty() ? std::string() : database.strings.GetString(database.networkPorts[0].objectName));
+
+	// Devices and their objects
+	std::map<uint16_t, std::vector<ExampleDatabaseDevice> >::const_iterator it;
+	for (it = database.virtualDevices.begin(); it != database.virtualDevices.end(); ++it) {
+		std::vector<ExampleDatabaseDevice>::const_iterator devIt;
+		for (devIt = it->second.begin(); devIt != it->second.end(); ++devIt) {
+			ExampleDatabaseImageDevice device;
+			memset(&device, 0, sizeof(device));
+			device.instance = devIt->instance;
+			device.network = it->first;
+			device.systemStatus = devIt->systemStatus;
+			device.objectName = strings.Add(database.strings.GetString(devIt->objectName));
+			device.description = strings.Add(database.strings.GetString(devIt->description));
+			devices.push_back(device);
+
+			const ExampleDatabaseAnalogInput* source = database.analogInputs.FindFirst(devIt->instance);
+			if (source != NULL) {
+				ExampleDatabaseImageAnalogInput analogInput;
+				memset(&analogInput, 0, sizeof(analogInput));
+				analogInput.deviceInstance = devIt->instance;
+				analogInput.instance = source->instance;
+				analogInput.presentValue = source->presentValue;
+				analogInput.reliability = source->reliability;
+				analogInput.objectName = strings.Add(database.strings.GetString(source->objectName));
+				analogInputs.push_back(analogInput);
+			}
+		}
+	}
+
+	// Lookup orders
+	std::vector<uint32_t> deviceIndex(devices.size());
+	for (uint32_t i = 0; i < deviceIndex.size(); i++) {
+		deviceIndex[i] = i;
+	}
+	std::sort(deviceIndex.begin(), deviceIndex.end(), [&devices](uint32_t a, uint32_t b) {
+		return devices[a].instance < devices[b].instance;
+	});
+	std::sort(analogInputs.begin(), analogInputs.end(), [](const ExampleDatabaseImageAnalogInput& a, const ExampleDatabaseImageAnalogInput& b) {
+		return a.deviceInstance != b.deviceInstance ? a.deviceInstance < b.deviceInstance : a.instance < b.instance;
+	});
+
+	// Layout
+	header.deviceCount = (uint32_t)devices.size();
+	header.deviceOffset = AlignOffset(sizeof(header));
+	header.deviceIndexOffset = AlignOffset(header.deviceOffset + devices.size() * sizeof(ExampleDatabaseImageDevice));
+	header.analogInputCount = (uint32_t)analogInputs.size();
+	header.analogInputOffset = AlignOffset(header.deviceIndexOffset + deviceIndex.size() * sizeof(uint32_t));
+	header.stringBlobOffset = AlignOffset(header.analogInputOffset + analogInputs.size() * sizeof(ExampleDatabaseImageAnalogInput));
+	header.stringBlobSize = (uint32_t)strings.blob.size();
+	header.fileSize = header.stringBlobOffset + header.stringBlobSize;
+
+	std::vector<uint8_t> buffer((size_t)header.fileSize, 0);
+	memcpy(&buffer[0], &header, sizeof(header));
+	if (!devices.empty()) {
+		memcpy(&buffer[header.deviceOffset], devices.data(), devices.size() * sizeof(ExampleDatabaseImageDevice));
+		memcpy(&buffer[header.deviceIndexOffset], deviceIndex.data(), deviceIndex.size() * sizeof(uint32_t));
+	}
+	if (!analogInputs.empty()) {
+		memcpy(&buffer[header.analogInputOffset], analogInputs.data(), analogInputs.size() * sizeof(ExampleDatabaseImageAnalogInput));
+	}
+	if (!strings.blob.empty()) {
+		memcpy(&buffer[header.stringBlobOffset], strings.blob.data(), strings.blob.size());
+	}
+
+	// Write to a temporary file and rename it into place so a reader never
+	// maps a partially written image.
+	std::string temporaryPath = std::string(path) + ".tmp";
+	FILE* file = fopen(temporaryPath.c_str(), "wb");
+	if (file == NULL) {
+		return false;
+	}
+	bool written = fwrite(buffer.data(), 1, buffer.size(), file) == buffer.size();
+	written = (fclose(file) == 0) && written;
+	if (!written) {
+		remove(temporaryPath.c_str());
+		return false;
+	}
+#ifdef _WIN32
+	remove(path);
+#endif // _WIN32
+	return rename(temporaryPath.c_str(), path) == 0;
+}
+
+bool ExampleDatabaseImage::Open(const char* path) {
+	this->Close();
+
+#ifdef _WIN32
+	HANDLE file = CreateFileA(path, GENERIC_READ, FILE_SHARE_READ, NULL, OPEN_EXISTING, FILE_ATTRIBUTE_NORMAL, NULL);
+	if (file == INVALID_HANDLE_VALUE) {
+		return false;
+	}
+	LARGE_INTEGER fileSize;
+	if (!GetFileSizeEx(file, &fileSize) || fileSize.QuadPart < (LONGLONG)sizeof(ExampleDatabaseImageHeader)) {
+		CloseHandle(file);
+		return false;
+	}
+	HANDLE mapping = CreateFileMappingA(file, NULL, PAGE_READONLY, 0, 0, NULL);
+	if (mapping == NULL) {
+		CloseHandle(file);
+		return false;
+	}
+	const void* base = MapViewOfFile(mapping, FILE_MAP_READ, 0, 0, 0);
+	if (base == NULL) {
+		CloseHandle(mapping);
+		CloseHandle(file);
+		return false;
+	}
+	this->m_file = file;
+	this->m_mapping = mapping;
+	this->m_size = (size_t)fileSize.QuadPart;
+#else
+	int file = open(path, O_RDONLY | O_CLOEXEC);
+	if (file < 0) {
+		return false;
+	}
+	struct stat fileStat;
+	if (fstat(file, &fileStat) != 0 || fileStat.st_size < (off_t)sizeof(ExampleDatabaseImageHeader)) {
+		close(file);
+		return false;
+	}
+	void* base = mmap(NULL, (size_t)fileStat.st_size, PROT_READ, MAP_SHARED, file, 0);
+	close(file); // The mapping keeps its own reference to the file
+	if (base == MAP_FAILED) {
+		return false;
+	}
+	this->m_size = (size_t)fileStat.st_size;
+#endif // _WIN32
+	this->m_base = (const uint8_t*)base;
+
+	if (!this->Validate()) {
+		this->Close();
+		return false;
+	}
+
+	const ExampleDatabaseImageHeader* header = this->GetHeader();
+	this->m_devices = (const ExampleDatabaseImageDevice*)(this->m_base + header->deviceOffset);
+	this->m_deviceIndex = (const uint32_t*)(this->m_base + header->deviceIndexOffset);
+	this->m_deviceCount = header->deviceCount;
+	this->m_analogInputs = (const ExampleDatabaseImageAnalogInput*)(this->m_base + header->analogInputOffset);
+	this->m_analogInputCount = header->analogInputCount;
+	this->m_strings = (const char*)(this->m_base + header->stringBlobOffset);
+	this->m_stringsSize = header->stringBlobSize;
+
+	// Copy out the values that change at runtime
+	this->deviceSystemStatus.resize(this->m_deviceCount);
+	for (uint32_t i = 0; i < this->m_deviceCount; i++) {
+		this->deviceSystemStatus[i] = this->m_devices[i].systemStatus;
+	}
+	this->analogInputPresentValue.resize(this->m_analogInputCount);
+	this->analogInputReliability.resize(this->m_analogInputCount);
+	for (uint32_t i = 0; i < this->m_analogInputCount; i++) {
+		this->analogInputPresentValue[i] = this->m_analogInputs[i].presentValue;
+		this->analogInputReliability[i] = this->m_analogInputs[i].reliability;
+	}
+	return true;
+}
+
+void ExampleDatabaseImage::Close() {
+	if (this->m_base != NULL) {
+#ifdef _WIN32
+		UnmapViewOfFile(this->m_base);
+		CloseHandle((HANDLE)this->m_mapping);
+		CloseHandle((HANDLE)this->m_file);
+		this->m_mapping = NULL;
+		this->m_file = NULL;
+#else
+		munmap((void*)this->m_base, this->m_size);
+#endif // _WIN32
+	}
+	this->m_base = NULL;
+	this->m_size = 0;
+	this->m_devices = NULL;
+	this->m_deviceIndex = NULL;
+	this->m_deviceCount = 0;
+	this->m_analogInputs = NULL;
+	this->m_analogInputCount = 0;
+	this->m_strings = NULL;
+	this->m_stringsSize = 0;
+	this->deviceSystemStatus.clear();
+	this->analogInputPresentValue.clear();
+	this->analogInputReliability.clear();
+}
+
+bool ExampleDatabaseImage::Validate() {
+	const ExampleDatabaseImageHeader* header = this->GetHeader();
+	if (header->magic != EXAMPLE_DATABASE_IMAGE_MAGIC) {
+		fprintf(stderr, "Error - not a database image\n");
+		return false;
+	}
+	if (header->byteOrder != EXAMPLE_DATABASE_IMAGE_BYTE_ORDER) {
+		fprintf(stderr, "Error - database image was written on a platform with a different byte order\n");
+		return false;
+	}
+	if (header->version != EXAMPLE_DATABASE_IMAGE_VERSION || header->headerSize != sizeof(ExampleDatabaseImageHeader)) {
+		fprintf(stderr, "Error - unsupported database image version=[%u]\n", header->version);
+		return false;
+	}
+	if (header->fileSize != this->m_size) {
+		fprintf(stderr, "Error - database image is truncated\n");
+		return false;
+	}
+
+	// Every table must be inside the file
+	uint64_t size = this->m_size;
+	if ((uint64_t)header->deviceOffset + (uint64_t)header->deviceCount * sizeof(ExampleDatabaseImageDevice) > size ||
+		(uint64_t)header->deviceIndexOffset + (uint64_t)header->deviceCount * sizeof(uint32_t) > size ||
+		(uint64_t)header->analogInputOffset + (uint64_t)header->analogInputCount * sizeof(ExampleDatabaseImageAnalogInput) > size ||
+		(uint64_t)header->stringBlobOffset + (uint64_t)header->stringBlobSize > size) {
+		fprintf(stderr, "Error - database image has an invalid layout\n");
+		return false;
+	}
+	const uint32_t* deviceIndex = (const uint32_t*)(this->m_base + header->deviceIndexOffset);
+	for (uint32_t i = 0; i < header->deviceCount; i++) {
+		if (deviceIndex[i] >= header->deviceCount) {
+			fprintf(stderr, "Error - database image has an invalid device index\n");
+			return false;
+		}
+	}
+	return true;
+}
+
+const char* ExampleDatabaseImage::GetString(const ExampleDatabaseImageString& reference, size_t* length) const {
+	if ((uint64_t)reference.offset + reference.length > this->m_stringsSize) {
+		*length = 0;
+		return "";
+	}
+	*length = reference.length;
+	return this->m_strings + reference.offset;
+}
+
+bool ExampleDatabaseImage::FindDevice(const uint32_t instance, uint32_t* index) const {
+	// Binary search over the instance ordered index
+	uint32_t low = 0;
+	uint32_t high = this->m_deviceCount;
+	while (low < high) {
+		uint32_t middle = low + (high - low) / 2;
+		uint32_t candidate = this->m_devices[this->m_deviceIndex[middle]].instance;
+		if (candidate < instance) {
+			low = middle + 1;
+		}
+		else {
+			high = middle;
+		}
+	}
+	if (low < this->m_deviceCount && this->m_devices[this->m_deviceIndex[low]].instance == instance) {
+		*index = this->m_deviceIndex[low];
+		return true;
+	}
+	return false;
+}
+
+bool ExampleDatabaseImage::FindAnalogInput(const uint32_t deviceInstance, const uint32_t instance, uint32_t* index) const {
+	uint32_t low = 0;
+	uint32_t high = this->m_analogInputCount;
+	while (low < high) {
+		uint32_t middle = low + (high - low) / 2;
+		const ExampleDatabaseImageAnalogInput& candidate = this->m_analogInputs[middle];
+		if (candidate.deviceInstance < deviceInstance || (candidate.deviceInstance == deviceInstance && candidate.instance < instance)) {
+			low = middle + 1;
+		}
+		else {
+			high = middle;
+		}
+	}
+	if (low < this->m_analogInputCount && this->m_analogInputs[low].deviceInstance == deviceInstance && this->m_analogInputs[low].instance == instance) {
+		*index = low;
+		return true;
+	}
+	return false;
+}
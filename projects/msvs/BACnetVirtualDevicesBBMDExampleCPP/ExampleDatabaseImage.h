@@ -0,0 +1,139 @@
+/*
+ * BACnet Virtual Devices and BBMD Example C++
+ * ----------------------------------------------------------------------------
+ * ExampleDatabaseImage.h
+ *
+ * Versioned binary image of the example database. The image is written once
+ * from a fully set up database and can then be memory mapped read-only at
+ * startup instead of rebuilding every device and object.
+ *
+ * The image is position independent. All references are byte offsets from
+ * the start of the file. Names and descriptions live in a single string blob
+ * and the devices and objects are stored as flat arrays of fixed size records.
+ *
+ * Layout:
+ *   ExampleDatabaseImageHeader
+ *   ExampleDatabaseImageDevice[deviceCount]       sorted by (network, instance)
+ *   uint32_t[deviceCount]                         device indexes sorted by instance
+ *   ExampleDatabaseImageAnalogInput[analogInputCount]  sorted by (device, instance)
+ *   char[stringBlobSize]
+ */
+
+#ifndef __ExampleDatabaseImage_h__
+#define __ExampleDatabaseImage_h__
+
+#include <stdint.h>
+#include <stddef.h>
+#include <vector>
+
+class ExampleDatabase;
+
+// Constants
+#define EXAMPLE_DATABASE_IMAGE_MAGIC		0x49444143	// "CADI"
+#define EXAMPLE_DATABASE_IMAGE_VERSION		1
+#define EXAMPLE_DATABASE_IMAGE_BYTE_ORDER	0x01020304
+
+// Reference to a string in the string blob
+struct ExampleDatabaseImageString
+{
+	uint32_t offset;
+	uint32_t length;
+};
+
+struct ExampleDatabaseImageHeader
+{
+	uint32_t magic;
+	uint32_t version;
+	uint32_t byteOrder;
+	uint32_t headerSize;
+	uint64_t fileSize;
+
+	uint32_t mainDeviceInstance;
+	uint32_t mainDeviceSystemStatus;
+	ExampleDatabaseImageString mainDeviceName;
+	ExampleDatabaseImageString mainDeviceDescription;
+	uint32_t networkPortInstance;
+	ExampleDatabaseImageString networkPortName;
+
+	uint32_t deviceCount;
+	uint32_t deviceOffset;
+	uint32_t deviceIndexOffset;
+	uint32_t analogInputCount;
+	uint32_t analogInputOffset;
+	uint32_t stringBlobOffset;
+	uint32_t stringBlobSize;
+};
+
+struct ExampleDatabaseImageDevice
+{
+	uint32_t instance;
+	uint16_t network;
+	uint16_t reserved;
+	uint32_t systemStatus;
+	ExampleDatabaseImageString objectName;
+	ExampleDatabaseImageString description;
+};
+
+struct ExampleDatabaseImageAnalogInput
+{
+	uint32_t deviceInstance;
+	uint32_t instance;
+	float presentValue;
+	uint32_t reliability;
+	ExampleDatabaseImageString objectName;
+};
+
+class ExampleDatabaseImage
+{
+public:
+	ExampleDatabaseImage();
+	~ExampleDatabaseImage();
+
+	// Writes the current contents of the database to an image file
+	static bool Write(const char* path, const ExampleDatabase& database);
+
+	// Maps an image file read-only
+	bool Open(const char* path);
+	void Close();
+	bool IsOpen() const { return this->m_base != NULL; }
+
+	const ExampleDatabaseImageHeader* GetHeader() const { return (const ExampleDatabaseImageHeader*)this->m_base; }
+	const char* GetString(const ExampleDatabaseImageString& reference, size_t* length) const;
+
+	// Devices, in (network, instance) order
+	uint32_t GetDeviceCount() const { return this->m_deviceCount; }
+	const ExampleDatabaseImageDevice& GetDevice(uint32_t index) const { return this->m_devices[index]; }
+	bool FindDevice(const uint32_t instance, uint32_t* index) const;
+
+	// Analog inputs, in (device, instance) order
+	uint32_t GetAnalogInputCount() const { return this->m_analogInputCount; }
+	const ExampleDatabaseImageAnalogInput& GetAnalogInput(uint32_t index) const { return this->m_analogInputs[index]; }
+	bool FindAnalogInput(const uint32_t deviceInstance, const uint32_t instance, uint32_t* index) const;
+
+	// The mapping is read-only. Values that change at runtime are copied out
+	// of the image when it is opened and are read and written here instead.
+	std::vector<uint32_t> deviceSystemStatus;
+	std::vector<float> analogInputPresentValue;
+	std::vector<uint32_t> analogInputReliability;
+
+private:
+	const uint8_t* m_base;
+	size_t m_size;
+
+	// File and mapping HANDLEs on Windows. Kept as void* so this header does
+	// not pull in windows.h ahead of winsock2.h.
+	void* m_file;
+	void* m_mapping;
+
+	const ExampleDatabaseImageDevice* m_devices;
+	const uint32_t* m_deviceIndex;
+	uint32_t m_deviceCount;
+	const ExampleDatabaseImageAnalogInput* m_analogInputs;
+	uint32_t m_analogInputCount;
+	const char* m_strings;
+	uint32_t m_stringsSize;
+
+	bool Validate();
+};
+
+#endif // __ExampleDatabaseImage_h__
@@ -0,0 +1,126 @@
+/*
+ * BACnet Virtual Devices and BBMD Example C++
+ * ----------------------------------------------------------------------------
+ * ExampleDatabaseLookupMemo.h
+ *
+ * The last few objects found by the property callbacks of the example
+ * database.
+ *
+ * A ReadPropertyMultiple for ALL the properties of an object comes to the
+ * callbacks as one call per property, each of which finds the object again: a
+ * binary search of its store, or of every virtual network for a device. While
+ * the memo is active (between Begin() and End(), around one fpTick()) the
+ * record found for an object is kept and the next properties of the same
+ * object use it.
+ *
+ * The records are pointers into the stores of ExampleDatabase, so anything
+ * that adds or removes records has to Clear() the memo. Objects that were not
+ * found are not kept. Called from the BACnet thread only.
+ */
+
+#ifndef __ExampleDatabaseLookupMemo_h__
+#define __ExampleDatabaseLookupMemo_h__
+
+#include <stdint.h>
+#include <stddef.h>
+#include <ostream>
+
+class ExampleDatabaseLookupMemo
+{
+public:
+	static const size_t SLOT_COUNT = 8;
+
+	ExampleDatabaseLookupMemo() {
+		this->m_enabled = true;
+		this->m_active = false;
+		this->m_hits = 0;
+		this->m_misses = 0;
+		this->Clear();
+	}
+
+	void SetEnabled(const bool enabled) {
+		this->m_enabled = enabled;
+		this->End();
+	}
+	bool IsEnabled() const { return this->m_enabled; }
+
+	// Objects are only kept between the two
+	void Begin() {
+		this->Clear();
+		this->m_active = this->m_enabled;
+	}
+	void End() {
+		this->m_active = false;
+		this->Clear();
+	}
+
+	void Clear() {
+		this->m_count = 0;
+		this->m_next = 0;
+	}
+
+	// The record, or the index for a record of the image, kept for the
+	// object. False if it is not kept.
+	bool Find(const uint16_t objectType, const uint32_t deviceInstance, const uint32_t objectInstance, void** record, uint32_t* index) {
+		if (!this->m_active) {
+			return false;
+		}
+		for (size_t i = 0; i < this->m_count; i++) {
+			const Slot& slot = this->m_slots[i];
+			if (slot.objectInstance == objectInstance && slot.deviceInstance == deviceInstance && slot.objectType == objectType) {
+				*record = slot.record;
+				*index = slot.index;
+				this->m_hits++;
+				return true;
+			}
+		}
+		this->m_misses++;
+		return false;
+	}
+
+	// Keeps the object in place of the oldest one when the slots are full
+	void Add(const uint16_t objectType, const uint32_t deviceInstance, const uint32_t objectInstance, void* record, const uint32_t index) {
+		if (!this->m_active) {
+			return;
+		}
+		Slot& slot = this->m_slots[this->m_next];
+		slot.deviceInstance = deviceInstance;
+		slot.objectInstance = objectInstance;
+		slot.objectType = objectType;
+		slot.record = record;
+		slot.index = index;
+		this->m_next = (this->m_next + 1) % SLOT_COUNT;
+		if (this->m_count < SLOT_COUNT) {
+			this->m_count++;
+		}
+	}
+
+	uint64_t GetHits() const { return this->m_hits; }
+	uint64_t GetMisses() const { return this->m_misses; }
+
+	// {"enabled":...,"hits":...,"misses":...}
+	void Report(std::ostream& out) const {
+		out << "{\"enabled\":" << (this->m_enabled ? "true" : "false") << ",\"hits\":" << this->m_hits << ",\"misses\":" << this->m_misses << "}" << std::endl;
+	}
+
+private:
+	class Slot
+	{
+	public:
+		uint32_t deviceInstance;
+		uint32_t objectInstance;
+		uint16_t objectType;
+		uint32_t index;
+		void* record;
+	};
+
+	bool m_enabled;
+	bool m_active;
+	Slot m_slots[SLOT_COUNT];
+	size_t m_count;
+	size_t m_next;			// Slot replaced by the next Add()
+	uint64_t m_hits;
+	uint64_t m_misses;
+};
+
+#endif // __ExampleDatabaseLookupMemo_h__
@@ -0,0 +1,119 @@
+/*
+ * BACnet Virtual Devices and BBMD Example C++
+ * ----------------------------------------------------------------------------
+ * ExampleDatabaseNameIndex.cpp
+ *
+ * Object name to object index of the example database.
+ */
+
+#include "ExampleDatabaseNameIndex.h"
+
+#include <algorithm>
+
+ExampleDatabaseNameIndex::ExampleDatabaseNameIndex() {
+	this->m_sortedCount = 0;
+}
+
+void ExampleDatabaseNameIndex::Add(const char* name, const size_t length, const uint32_t deviceInstance, const uint16_t objectType, const uint32_t objectInstance) {
+	Entry entry;
+	entry.hash = Hash(name, length);
+	entry.object.deviceInstance = deviceInstance;
+	entry.object.objectInstance = objectInstance;
+	entry.object.objectType = objectType;
+	const bool inOrder = this->m_sortedCount == this->m_entries.size() && (this->m_entries.empty() || Less(this->m_entries.back(), entry));
+	this->m_entries.push_back(entry);
+	if (inOrder) {
+		this->m_sortedCount = this->m_entries.size();
+	}
+}
+
+bool ExampleDatabaseNameIndex::Remove(const char* name, const size_t length, const uint32_t deviceInstance, const uint16_t objectType, const uint32_t objectInstance) {
+	size_t first;
+	const size_t count = this->Find(name, length, &first);
+	for (size_t i = first; i < first + count; i++) {
+		const ExampleDatabaseObjectReference& object = this->m_entries[i].object;
+		if (object.deviceInstance == deviceInstance && object.objectType == objectType && object.objectInstance == objectInstance) {
+			this->m_entries.erase(this->m_entries.begin() + i);
+			this->m_sortedCount = this->m_entries.size();
+			return true;
+		}
+	}
+	return false;
+}
+
+size_t ExampleDatabaseNameIndex::RemoveDevice(const uint32_t deviceInstance) {
+	// Removing keeps the order of the rest
+	const size_t sortedCount = this->m_sortedCount;
+	size_t kept = 0;
+	for (size_t i = 0; i < this->m_entries.size(); i++) {
+		if (this->m_entries[i].object.deviceInstance == deviceInstance) {
+			if (i < sortedCount) {
+				this->m_sortedCount--;
+			}
+			continue;
+		}
+		this->m_entries[kept++] = this->m_entries[i];
+	}
+	const size_t removed = this->m_entries.size() - kept;
+	this->m_entries.resize(kept);
+	return removed;
+}
+
+void ExampleDatabaseNameIndex::Clear() {
+	this->m_entries.clear();
+	this->m_sortedCount = 0;
+}
+
+void ExampleDatabaseNameIndex::Reserve(const size_t count) {
+	this->m_entries.reserve(count);
+}
+
+size_t ExampleDatabaseNameIndex::Find(const char* name, const size_t length, size_t* firstIndex) {
+	this->Sort();
+	const uint32_t hash = Hash(name, length);
+	std::vector<Entry>::const_iterator first = std::lower_bound(this->m_entries.begin(), this->m_entries.end(), hash, HashLess);
+	std::vector<Entry>::const_iterator last = first;
+	while (last != this->m_entries.end() && last->hash == hash) {
+		++last;
+	}
+	*firstIndex = (size_t)(first - this->m_entries.begin());
+	return (size_t)(last - first);
+}
+
+size_t ExampleDatabaseNameIndex::GetMemoryUsage() const {
+	return this->m_entries.capacity() * sizeof(Entry);
+}
+
+// FNV-1a
+uint32_t ExampleDatabaseNameIndex::Hash(const char* name, const size_t length) {
+	uint32_t hash = 2166136261u;
+	for (size_t i = 0; i < length; i++) {
+		hash ^= (uint8_t)name[i];
+		hash *= 16777619u;
+	}
+	return hash;
+}
+
+bool ExampleDatabaseNameIndex::Less(const Entry& a, const Entry& b) {
+	if (a.hash != b.hash) {
+		return a.hash < b.hash;
+	}
+	if (a.object.deviceInstance != b.object.deviceInstance) {
+		return a.object.deviceInstance < b.object.deviceInstance;
+	}
+	if (a.object.objectType != b.object.objectType) {
+		return a.object.objectType < b.object.objectType;
+	}
+	return a.object.objectInstance < b.object.objectInstance;
+}
+
+// Only the entries added out of order are sorted, then merged with the
+// sorted ones, as ExampleDatabaseObjectStore does
+void ExampleDatabaseNameIndex::Sort() {
+	if (this->m_sortedCount != this->m_entries.size()) {
+		std::vector<Entry>::iterator middle = this->m_entries.begin() + this->m_sortedCount;
+		std::sort(middle, this->m_entries.end(), Less);
+		std::inplace_merge(this->m_entries.begin(), middle, this->m_entries.end(), Less);
+		this->m_sortedCount = this->m_entries.size();
+	}
+}
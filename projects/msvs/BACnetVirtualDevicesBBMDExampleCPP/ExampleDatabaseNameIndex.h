@@ -0,0 +1,73 @@
+/*
+ * BACnet Virtual Devices and BBMD Example C++
+ * ----------------------------------------------------------------------------
+ * ExampleDatabaseNameIndex.h
+ *
+ * Index from object name to the objects that carry it. Who-Has and the name
+ * lookups find an object by its name without walking every device.
+ *
+ * The names are not stored, only a 32 bit hash of each one next to the
+ * object it belongs to. The entries are kept in one array sorted by hash,
+ * like the object stores, so a lookup is a binary search. Different names
+ * can share a hash, callers compare the name of every object found.
+ */
+
+#ifndef __ExampleDatabaseNameIndex_h__
+#define __ExampleDatabaseNameIndex_h__
+
+#include <stdint.h>
+#include <stddef.h>
+#include <vector>
+
+// An object as the stack addresses it
+class ExampleDatabaseObjectReference
+{
+public:
+	uint32_t deviceInstance;
+	uint32_t objectInstance;
+	uint16_t objectType;
+};
+
+class ExampleDatabaseNameIndex
+{
+public:
+	ExampleDatabaseNameIndex();
+
+	// Entries added out of order are sorted and merged into the rest on the
+	// next lookup
+	void Add(const char* name, const size_t length, const uint32_t deviceInstance, const uint16_t objectType, const uint32_t objectInstance);
+	bool Remove(const char* name, const size_t length, const uint32_t deviceInstance, const uint16_t objectType, const uint32_t objectInstance);
+	// Removes every object of the device, and the device itself. Returns the
+	// number removed.
+	size_t RemoveDevice(const uint32_t deviceInstance);
+
+	void Clear();
+	void Reserve(const size_t count);
+
+	// The objects whose names hash like name are At(*firstIndex) to
+	// At(*firstIndex + count - 1), in device order. Returns the count.
+	size_t Find(const char* name, const size_t length, size_t* firstIndex);
+
+	size_t Size() const { return this->m_entries.size(); }
+	const ExampleDatabaseObjectReference& At(const size_t index) const { return this->m_entries[index].object; }
+	size_t GetMemoryUsage() const;
+
+	static uint32_t Hash(const char* name, const size_t length);
+
+private:
+	class Entry
+	{
+	public:
+		uint32_t hash;
+		ExampleDatabaseObjectReference object;
+	};
+
+	std::vector<Entry> m_entries;
+	size_t m_sortedCount;		// The entries before it are in order
+
+	static bool Less(const Entry& a, const Entry& b);
+	static bool HashLess(const Entry& entry, const uint32_t hash) { return entry.hash < hash; }
+	void Sort();
+};
+
+#endif // __ExampleDatabaseNameIndex_h__
@@ -0,0 +1,288 @@
+/*
+ * BACnet Virtual Devices and BBMD Example C++
+ * ----------------------------------------------------------------------------
+ * ExampleDatabaseObjectStore.h
+ *
+ * Generic storage for one BACnet object type. The objects of a type are kept
+ * in one contiguous array sorted by (device instance, object instance) and
+ * found with a binary search.
+ *
+ * The properties of a type are described at compile time. Each descriptor
+ * ties an ExampleConstants::PROPERTY_IDENTIFIER_* to a field of the object
+ * record, together with the kind of value the stack asks for (REAL,
+ * ENUMERATED, ...) and whether it can be written. A property lookup is
+ * expanded by the compiler into a short chain of compares, there is no table
+ * to walk at runtime.
+ *
+ * A record needs deviceInstance, instance and objectName (an interned string
+ * id, see ExampleDatabaseStringPool) fields. To add an
+ * object type: declare the record, specialize ExampleDatabaseObjectTraits
+ * for it and add a store to ExampleDatabase.
+ */
+
+#ifndef __ExampleDatabaseObjectStore_h__
+#define __ExampleDatabaseObjectStore_h__
+
+#include <stdint.h>
+#include <stddef.h>
+#include <algorithm>
+#include <string>
+#include <vector>
+
+// Kind of value, one per CAS BACnet Stack property callback
+enum ExampleDatabasePropertyKind
+{
+	PROPERTY_KIND_REAL,
+	PROPERTY_KIND_ENUMERATED,
+	PROPERTY_KIND_UNSIGNED,
+	PROPERTY_KIND_BOOLEAN
+};
+
+// One property of a record type
+template <uint32_t PropertyIdentifier, ExampleDatabasePropertyKind Kind, typename Record, typename Field, Field Record::*Member, bool Writable = false>
+class ExampleDatabaseProperty
+{
+public:
+	template <typename Value>
+	static bool Get(const Record& record, const uint32_t propertyIdentifier, const ExampleDatabasePropertyKind kind, Value* value) {
+		if (kind != Kind || propertyIdentifier != PropertyIdentifier) {
+			return false;
+		}
+		*value = (Value)(record.*Member);
+		return true;
+	}
+
+	template <typename Value>
+	static bool Set(Record& record, const uint32_t propertyIdentifier, const ExampleDatabasePropertyKind kind, const Value value, bool* found) {
+		if (!Writable || kind != Kind || propertyIdentifier != PropertyIdentifier) {
+			return false;
+		}
+		*found = true;
+		record.*Member = (Field)value;
+		return true;
+	}
+
+	static bool IsWritable(const uint32_t propertyIdentifier) {
+		return Writable && propertyIdentifier == PropertyIdentifier;
+	}
+};
+
+// The list of properties of a record type
+template <typename... Properties>
+class ExampleDatabaseProperties;
+
+template <>
+class ExampleDatabaseProperties<>
+{
+public:
+	template <typename Record, typename Value>
+	static bool Get(const Record&, const uint32_t, const ExampleDatabasePropertyKind, Value*) { return false; }
+	template <typename Record, typename Value>
+	static bool Set(Record&, const uint32_t, const ExampleDatabasePropertyKind, const Value, bool*) { return false; }
+	static bool IsWritable(const uint32_t) { return false; }
+};
+
+template <typename First, typename... Rest>
+class ExampleDatabaseProperties<First, Rest...>
+{
+public:
+	template <typename Record, typename Value>
+	static bool Get(const Record& record, const uint32_t propertyIdentifier, const ExampleDatabasePropertyKind kind, Value* value) {
+		return First::Get(record, propertyIdentifier, kind, value) || ExampleDatabaseProperties<Rest...>::Get(record, propertyIdentifier, kind, value);
+	}
+	template <typename Record, typename Value>
+	static bool Set(Record& record, const uint32_t propertyIdentifier, const ExampleDatabasePropertyKind kind, const Value value, bool* found) {
+		return First::Set(record, propertyIdentifier, kind, value, found) || ExampleDatabaseProperties<Rest...>::Set(record, propertyIdentifier, kind, value, found);
+	}
+	static bool IsWritable(const uint32_t propertyIdentifier) {
+		return First::IsWritable(propertyIdentifier) || ExampleDatabaseProperties<Rest...>::IsWritable(propertyIdentifier);
+	}
+};
+
+// Specialized for every record type. Provides:
+//   static const uint16_t OBJECT_TYPE;
+//   typedef ExampleDatabaseProperties<...> Properties;
+//   static bool Validate(const Record&, const uint32_t propertyIdentifier, const double value);
+template <typename Record>
+class ExampleDatabaseObjectTraits;
+
+template <typename Record>
+class ExampleDatabaseObjectStore
+{
+public:
+	typedef ExampleDatabaseObjectTraits<Record> Traits;
+
+	ExampleDatabaseObjectStore() {
+		this->m_sortedCount = 0;
+	}
+
+	static uint16_t GetObjectType() { return Traits::OBJECT_TYPE; }
+
+	// Adds an object. Objects added out of order are sorted and merged into
+	// the rest on the next lookup.
+	Record& Add(const uint32_t deviceInstance, const uint32_t instance) {
+		const bool inOrder = this->IsSorted() && (this->m_records.empty() || Key(this->m_records.back()) < MakeKey(deviceInstance, instance));
+		this->m_records.push_back(Record());
+		Record& record = this->m_records.back();
+		record.deviceInstance = deviceInstance;
+		record.instance = instance;
+		if (inOrder) {
+			this->m_sortedCount = this->m_records.size();
+		}
+		return record;
+	}
+
+	bool Remove(const uint32_t deviceInstance, const uint32_t instance) {
+		Record* record = this->Find(deviceInstance, instance);
+		if (record == NULL) {
+			return false;
+		}
+		this->m_records.erase(this->m_records.begin() + (record - this->m_records.data()));
+		this->m_sortedCount = this->m_records.size();
+		return true;
+	}
+
+	// Removes every object of the device. Returns the number removed.
+	size_t RemoveDevice(const uint32_t deviceInstance) {
+		size_t first;
+		const size_t count = this->FindDevice(deviceInstance, &first);
+		this->m_records.erase(this->m_records.begin() + first, this->m_records.begin() + first + count);
+		this->m_sortedCount = this->m_records.size();
+		return count;
+	}
+
+	void Clear() {
+		this->m_records.clear();
+		this->m_sortedCount = 0;
+	}
+	void Reserve(const size_t count) {
+		this->m_records.reserve(count);
+	}
+
+	size_t Size() const { return this->m_records.size(); }
+	const Record& At(const size_t index) const { return this->m_records[index]; }
+
+	Record* Find(const uint32_t deviceInstance, const uint32_t instance) {
+		this->Sort();
+		const uint64_t key = MakeKey(deviceInstance, instance);
+		typename std::vector<Record>::iterator it = std::lower_bound(this->m_records.begin(), this->m_records.end(), key, KeyLess());
+		if (it == this->m_records.end() || Key(*it) != key) {
+			return NULL;
+		}
+		return &(*it);
+	}
+
+	// The objects of the device are At(*firstIndex) to At(*firstIndex + count - 1).
+	// Returns the count.
+	size_t FindDevice(const uint32_t deviceInstance, size_t* firstIndex) {
+		this->Sort();
+		typename std::vector<Record>::iterator first = std::lower_bound(this->m_records.begin(), this->m_records.end(), MakeKey(deviceInstance, 0), KeyLess());
+		typename std::vector<Record>::iterator last = first;
+		while (last != this->m_records.end() && last->deviceInstance == deviceInstance) {
+			++last;
+		}
+		*firstIndex = (size_t)(first - this->m_records.begin());
+		return (size_t)(last - first);
+	}
+
+	// First object of the device, whatever its instance. Does not sort, so it
+	// can be used on a const store: falls back to a scan if it is not sorted.
+	const Record* FindFirst(const uint32_t deviceInstance) const {
+		if (!this->IsSorted()) {
+			const Record* first = NULL;
+			for (size_t i = 0; i < this->m_records.size(); i++) {
+				if (this->m_records[i].deviceInstance == deviceInstance && (first == NULL || this->m_records[i].instance < first->instance)) {
+					first = &this->m_records[i];
+				}
+			}
+			return first;
+		}
+		typename std::vector<Record>::const_iterator it = std::lower_bound(this->m_records.begin(), this->m_records.end(), MakeKey(deviceInstance, 0), KeyLess());
+		if (it == this->m_records.end() || it->deviceInstance != deviceInstance) {
+			return NULL;
+		}
+		return &(*it);
+	}
+
+	template <typename Value>
+	bool GetProperty(const uint32_t deviceInstance, const uint32_t instance, const uint32_t propertyIdentifier, const ExampleDatabasePropertyKind kind, Value* value) {
+		Record* record = this->Find(deviceInstance, instance);
+		if (record == NULL) {
+			return false;
+		}
+		return GetRecordProperty(*record, propertyIdentifier, kind, value);
+	}
+
+	// Returns false if the object or writable property does not exist, or the
+	// value is not valid for it (valueIsValid is then false).
+	template <typename Value>
+	bool SetProperty(const uint32_t deviceInstance, const uint32_t instance, const uint32_t propertyIdentifier, const ExampleDatabasePropertyKind kind, const Value value, bool* valueIsValid) {
+		*valueIsValid = true;
+		Record* record = this->Find(deviceInstance, instance);
+		if (record == NULL) {
+			return false;
+		}
+		return SetRecordProperty(*record, propertyIdentifier, kind, value, valueIsValid);
+	}
+
+	// The same on a record already found
+	template <typename Value>
+	static bool GetRecordProperty(const Record& record, const uint32_t propertyIdentifier, const ExampleDatabasePropertyKind kind, Value* value) {
+		return Traits::Properties::Get(record, propertyIdentifier, kind, value);
+	}
+	template <typename Value>
+	static bool SetRecordProperty(Record& record, const uint32_t propertyIdentifier, const ExampleDatabasePropertyKind kind, const Value value, bool* valueIsValid) {
+		*valueIsValid = true;
+		if (!Traits::Properties::IsWritable(propertyIdentifier)) {
+			return false;
+		}
+		if (!Traits::Validate(record, propertyIdentifier, (double)value)) {
+			*valueIsValid = false;
+			return false;
+		}
+		bool found = false;
+		return Traits::Properties::Set(record, propertyIdentifier, kind, value, &found);
+	}
+
+	static bool IsWritable(const uint32_t propertyIdentifier) {
+		return Traits::Properties::IsWritable(propertyIdentifier);
+	}
+
+	// Bytes used by the records. The names are in the string pool.
+	size_t GetMemoryUsage() const {
+		return this->m_records.capacity() * sizeof(Record);
+	}
+
+private:
+	std::vector<Record> m_records;
+	size_t m_sortedCount;		// The records before it are in key order
+
+	bool IsSorted() const { return this->m_sortedCount == this->m_records.size(); }
+
+	static uint64_t MakeKey(const uint32_t deviceInstance, const uint32_t instance) {
+		return ((uint64_t)deviceInstance << 32) | instance;
+	}
+	static uint64_t Key(const Record& record) {
+		return MakeKey(record.deviceInstance, record.instance);
+	}
+
+	class KeyLess
+	{
+	public:
+		bool operator()(const Record& record, const uint64_t key) const { return Key(record) < key; }
+		bool operator()(const Record& a, const Record& b) const { return Key(a) < Key(b); }
+	};
+
+	// Only the records added out of order are sorted, then merged with the
+	// sorted ones, so adding a few objects at runtime does not sort everything
+	void Sort() {
+		if (!this->IsSorted()) {
+			typename std::vector<Record>::iterator middle = this->m_records.begin() + this->m_sortedCount;
+			std::sort(middle, this->m_records.end(), KeyLess());
+			std::inplace_merge(this->m_records.begin(), middle, this->m_records.end(), KeyLess());
+			this->m_sortedCount = this->m_records.size();
+		}
+	}
+};
+
+#endif // __ExampleDatabaseObjectStore_h__
@@ -0,0 +1,204 @@
+/*
+ * BACnet Virtual Devices and BBMD Example C++
+ * ----------------------------------------------------------------------------
+ * ExampleDatabasePriorityArray.h
+ *
+ * Compact priority array for commandable objects.
+ *
+ * A 16-bit mask records which of the 16 priorities hold a value. Only those
+ * values are stored, packed in priority order, so the winning value is always
+ * the first one. Up to 8 bytes worth of values are stored inline (two REALs
+ * or eight binary values), larger arrays move to the heap. The present value
+ * is cached and updated on every write, so reading PRESENT_VALUE or one
+ * PRIORITY_ARRAY slot never scans the array.
+ */
+
+#ifndef __ExampleDatabasePriorityArray_h__
+#define __ExampleDatabasePriorityArray_h__
+
+#include <stdint.h>
+#include <stddef.h>
+#include <string.h>
+#ifdef _MSC_VER
+#include <intrin.h>
+#endif
+
+// Number of set bits
+inline uint32_t ExampleDatabasePopCount16(const uint16_t value) {
+#ifdef _MSC_VER
+	return __popcnt16(value);
+#else
+	return (uint32_t)__builtin_popcount(value);
+#endif
+}
+
+template <typename T>
+class ExampleDatabasePriorityArray
+{
+public:
+	static const uint8_t PRIORITY_ARRAY_LENGTH = 16;
+	static const uint8_t INLINE_SLOTS = sizeof(void*) >= sizeof(T) ? (uint8_t)(sizeof(void*) / sizeof(T)) : 1;
+
+	ExampleDatabasePriorityArray() {
+		this->m_mask = 0;
+		this->m_capacity = INLINE_SLOTS;
+		memset(&this->m_slots, 0, sizeof(this->m_slots));
+		this->m_relinquishDefault = T();
+		this->m_presentValue = T();
+	}
+	ExampleDatabasePriorityArray(const ExampleDatabasePriorityArray& other) {
+		this->m_mask = 0;
+		this->m_capacity = INLINE_SLOTS;
+		this->CopyFrom(other);
+	}
+	ExampleDatabasePriorityArray& operator=(const ExampleDatabasePriorityArray& other) {
+		if (this != &other) {
+			this->Release();
+			this->CopyFrom(other);
+		}
+		return *this;
+	}
+	~ExampleDatabasePriorityArray() {
+		this->Release();
+	}
+
+	// Winning value, or the relinquish default when every slot is empty
+	T GetPresentValue() const { return this->m_presentValue; }
+	T GetRelinquishDefault() const { return this->m_relinquishDefault; }
+	void SetRelinquishDefault(const T value) {
+		this->m_relinquishDefault = value;
+		this->UpdatePresentValue();
+	}
+
+	// Priority 1 (highest) to 16. Returns false if the slot is empty (NULL).
+	bool Get(const uint8_t priority, T* value) const {
+		if (priority < 1 || priority > PRIORITY_ARRAY_LENGTH) {
+			return false;
+		}
+		uint16_t bit = (uint16_t)(1u << (priority - 1));
+		if ((this->m_mask & bit) == 0) {
+			return false;
+		}
+		*value = this->Slots()[ExampleDatabasePopCount16(this->m_mask & (bit - 1))];
+		return true;
+	}
+
+	// Priority that currently wins, 0 when every slot is empty
+	uint8_t GetActivePriority() const {
+		if (this->m_mask == 0) {
+			return 0;
+		}
+		return (uint8_t)(ExampleDatabasePopCount16((uint16_t)((this->m_mask & (0u - this->m_mask)) - 1)) + 1);
+	}
+
+	bool Set(const uint8_t priority, const T value) {
+		if (priority < 1 || priority > PRIORITY_ARRAY_LENGTH) {
+			return false;
+		}
+		uint16_t bit = (uint16_t)(1u << (priority - 1));
+		uint32_t index = ExampleDatabasePopCount16(this->m_mask & (bit - 1));
+		if ((this->m_mask & bit) == 0) {
+			uint32_t count = ExampleDatabasePopCount16(this->m_mask);
+			if (count + 1 > this->m_capacity) {
+				this->Grow(count + 1);
+			}
+			T* slots = this->Slots();
+			memmove(&slots[index + 1], &slots[index], (count - index) * sizeof(T));
+			this->m_mask |= bit;
+		}
+		this->Slots()[index] = value;
+		if (index == 0) {
+			this->m_presentValue = value;
+		}
+		return true;
+	}
+
+	// Writes NULL to a priority
+	bool Relinquish(const uint8_t priority) {
+		if (priority < 1 || priority > PRIORITY_ARRAY_LENGTH) {
+			return false;
+		}
+		uint16_t bit = (uint16_t)(1u << (priority - 1));
+		if ((this->m_mask & bit) == 0) {
+			return true;
+		}
+		uint32_t index = ExampleDatabasePopCount16(this->m_mask & (bit - 1));
+		uint32_t count = ExampleDatabasePopCount16(this->m_mask);
+		T* slots = this->Slots();
+		memmove(&slots[index], &slots[index + 1], (count - index - 1) * sizeof(T));
+		this->m_mask &= (uint16_t)~bit;
+		if (index == 0) {
+			this->UpdatePresentValue();
+		}
+		return true;
+	}
+
+	// Bytes used, including any heap storage
+	size_t GetMemoryUsage() const {
+		return sizeof(*this) + (this->m_capacity > INLINE_SLOTS ? this->m_capacity * sizeof(T) : 0);
+	}
+
+private:
+	// Values of the occupied slots, in priority order. Stored inline until
+	// they no longer fit in the space of the heap pointer.
+	union {
+		T inlineSlots[INLINE_SLOTS];
+		T* heapSlots;
+	} m_slots;
+	T m_presentValue;
+	T m_relinquishDefault;
+	uint16_t m_mask;
+	uint8_t m_capacity;
+
+	T* Slots() { return this->m_capacity > INLINE_SLOTS ? this->m_slots.heapSlots : this->m_slots.inlineSlots; }
+	const T* Slots() const { return this->m_capacity > INLINE_SLOTS ? this->m_slots.heapSlots : this->m_slots.inlineSlots; }
+
+	void UpdatePresentValue() {
+		this->m_presentValue = this->m_mask != 0 ? this->Slots()[0] : this->m_relinquishDefault;
+	}
+
+	void Grow(const uint32_t minimum) {
+		uint8_t capacity = (uint8_t)(this->m_capacity * 2 < minimum ? minimum : this->m_capacity * 2);
+		if (capacity > PRIORITY_ARRAY_LENGTH) {
+			capacity = PRIORITY_ARRAY_LENGTH;
+		}
+		T* slots = new T[capacity];
+		memcpy(slots, this->Slots(), ExampleDatabasePopCount16(this->m_mask) * sizeof(T));
+		this->Release();
+		this->m_slots.heapSlots = slots;
+		this->m_capacity = capacity;
+	}
+
+	void Release() {
+		if (this->m_capacity > INLINE_SLOTS) {
+			delete[] this->m_slots.heapSlots;
+		}
+		this->m_capacity = INLINE_SLOTS;
+	}
+
+	void CopyFrom(const ExampleDatabasePriorityArray& other) {
+		uint32_t count = ExampleDatabasePopCount16(other.m_mask);
+		if (count > INLINE_SLOTS) {
+			this->m_slots.heapSlots = new T[other.m_capacity];
+			this->m_capacity = other.m_capacity;
+		}
+		memcpy(this->Slots(), other.Slots(), count * sizeof(T));
+		this->m_mask = other.m_mask;
+		this->m_presentValue = other.m_presentValue;
+		this->m_relinquishDefault = other.m_relinquishDefault;
+	}
+};
+
+// The straightforward layout, one optional value per priority. Only used to
+// report how much memory the compact layout saves.
+template <typename T>
+class ExampleDatabaseNaivePriorityArray
+{
+public:
+	T values[16];
+	bool isNull[16];
+	T presentValue;
+	T relinquishDefault;
+};
+
+#endif // __ExampleDatabasePriorityArray_h__
@@ -0,0 +1,86 @@
+/*
+ * BACnet Virtual Devices and BBMD Example C++
+ * ----------------------------------------------------------------------------
+ * ExampleDatabaseStringPool.cpp
+ *
+ * Interned strings of the example database.
+ */
+
+#include "ExampleDatabaseStringPool.h"
+
+#include <string.h>
+
+static const size_t EXAMPLE_DATABASE_STRING_POOL_INITIAL_SLOTS = 64;
+
+ExampleDatabaseStringPool::ExampleDatabaseStringPool() {
+	this->Clear();
+}
+
+void ExampleDatabaseStringPool::Clear() {
+	this->m_blob.clear();
+	this->m_entries.clear();
+	this->m_slots.assign(EXAMPLE_DATABASE_STRING_POOL_INITIAL_SLOTS, 0);
+
+	// Id 0, the empty string
+	this->Intern("", 0);
+}
+
+ExampleDatabaseStringId ExampleDatabaseStringPool::Intern(const char* value, const size_t length) {
+	size_t mask = this->m_slots.size() - 1;
+	size_t slot = Hash(value, length) & mask;
+	while (this->m_slots[slot] != 0) {
+		ExampleDatabaseStringId id = this->m_slots[slot] - 1;
+		if (this->Equals(id, value, length)) {
+			return id;
+		}
+		slot = (slot + 1) & mask;
+	}
+
+	ExampleDatabaseStringPoolEntry entry;
+	entry.offset = (uint32_t)this->m_blob.size();
+	entry.length = (uint32_t)length;
+	this->m_blob.insert(this->m_blob.end(), value, value + length);
+	this->m_blob.push_back('\0');
+	ExampleDatabaseStringId id = (ExampleDatabaseStringId)this->m_entries.size();
+	this->m_entries.push_back(entry);
+	this->m_slots[slot] = id + 1;
+
+	// Keep the table at most half full
+	if (this->m_entries.size() * 2 > this->m_slots.size()) {
+		this->Grow();
+	}
+	return id;
+}
+
+size_t ExampleDatabaseStringPool::GetMemoryUsage() const {
+	return this->m_blob.capacity() + this->m_entries.capacity() * sizeof(ExampleDatabaseStringPoolEntry) + this->m_slots.capacity() * sizeof(uint32_t);
+}
+
+// FNV-1a
+uint32_t ExampleDatabaseStringPool::Hash(const char* value, const size_t length) {
+	uint32_t hash = 2166136261u;
+	for (size_t i = 0; i < length; i++) {
+		hash ^= (uint8_t)value[i];
+		hash *= 16777619u;
+	}
+	return hash;
+}
+
+bool ExampleDatabaseStringPool::Equals(const ExampleDatabaseStringId id, const char* value, const size_t length) const {
+	const ExampleDatabaseStringPoolEntry& entry = this->m_entries[id];
+	return entry.length == length && memcmp(&this->m_blob[entry.offset], value, length) == 0;
+}
+
+void ExampleDatabaseStringPool::Grow() {
+	std::vector<uint32_t> slots(this->m_slots.size() * 2, 0);
+	size_t mask = slots.size() - 1;
+	for (ExampleDatabaseStringId id = 0; id < this->m_entries.size(); id++) {
+		const ExampleDatabaseStringPoolEntry& entry = this->m_entries[id];
+		size_t slot = Hash(&this->m_blob[entry.offset], entry.length) & mask;
+		while (slots[slot] != 0) {
+			slot = (slot + 1) & mask;
+		}
+		slots[slot] = id + 1;
+	}
+	this->m_slots.swap(slots);
+}
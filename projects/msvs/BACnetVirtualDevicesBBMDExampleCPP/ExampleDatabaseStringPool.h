@@ -0,0 +1,68 @@
+/*
+ * BACnet Virtual Devices and BBMD Example C++
+ * ----------------------------------------------------------------------------
+ * ExampleDatabaseStringPool.h
+ *
+ * Interned strings of the example database. The object names and
+ * descriptions are nearly identical across thousands of virtual devices, so
+ * every distinct string is stored once and the records refer to it with a 4
+ * byte id instead of carrying their own std::string.
+ *
+ * The strings are kept back to back, NUL terminated, in one buffer and found
+ * with an open addressing hash table of ids.
+ */
+
+#ifndef __ExampleDatabaseStringPool_h__
+#define __ExampleDatabaseStringPool_h__
+
+#include <stdint.h>
+#include <stddef.h>
+#include <string>
+#include <vector>
+
+// Id of an interned string. 0 is always the empty string.
+typedef uint32_t ExampleDatabaseStringId;
+
+class ExampleDatabaseStringPoolEntry
+{
+public:
+	uint32_t offset;
+	uint32_t length;
+};
+
+class ExampleDatabaseStringPool
+{
+public:
+	ExampleDatabaseStringPool();
+
+	// Returns the id of the string, adding it if it is not in the pool yet
+	ExampleDatabaseStringId Intern(const char* value, const size_t length);
+	ExampleDatabaseStringId Intern(const std::string& value) { return this->Intern(value.data(), value.size()); }
+
+	// The string is NUL terminated. The pointer is valid until the next
+	// Intern(), so callers copy the string out right away.
+	const char* Get(const ExampleDatabaseStringId id, size_t* length) const {
+		const ExampleDatabaseStringPoolEntry& entry = this->m_entries[id];
+		*length = entry.length;
+		return &this->m_blob[entry.offset];
+	}
+	std::string GetString(const ExampleDatabaseStringId id) const {
+		const ExampleDatabaseStringPoolEntry& entry = this->m_entries[id];
+		return std::string(&this->m_blob[entry.offset], entry.length);
+	}
+
+	void Clear();
+	size_t GetCount() const { return this->m_entries.size(); }
+	size_t GetMemoryUsage() const;
+
+private:
+	std::vector<char> m_blob;
+	std::vector<ExampleDatabaseStringPoolEntry> m_entries;	// By id
+	std::vector<uint32_t> m_slots;		// id + 1, 0 for an empty slot. The size is a power of two.
+
+	static uint32_t Hash(const char* value, const size_t length);
+	bool Equals(const ExampleDatabaseStringId id, const char* value, const size_t length) const;
+	void Grow();
+};
+
+#endif // __ExampleDatabaseStringPool_h__
@@ -0,0 +1,242 @@
+/*
+ * BACnet Virtual Devices and BBMD Example C++
+ * ----------------------------------------------------------------------------
+ * IngressScheduler.cpp
+ *
+ * Priority queues between the sockets and the CAS BACnet Stack.
+ */
+
+#include "IngressScheduler.h"
+#include "NPDUHeader.h"
+#include "ExampleConstants.h"
+
+// Constants
+#define INGRESS_SCHEDULER_NONE		PACKET_POOL_NONE
+
+// APDU types, the high nibble of the first byte
+#define APDU_TYPE_CONFIRMED_REQUEST			0
+#define APDU_TYPE_UNCONFIRMED_REQUEST		1
+
+static const char* INGRESS_CLASS_NAMES[INGRESS_CLASS_COUNT] = {
+	"confirmed", "unicast", "broadcast"
+};
+
+CIngressScheduler::CIngressScheduler() {
+	this->m_pool = NULL;
+	this->m_capacity = 0;
+	this->m_queuedCount = 0;
+	this->m_sharedQueuedCount = 0;
+	this->m_receiveIndex = INGRESS_SCHEDULER_NONE;
+	this->m_deliveredIndex = INGRESS_SCHEDULER_NONE;
+	for (int i = 0; i < INGRESS_CLASS_COUNT; i++) {
+		Class& ingressClass = this->m_classes[i];
+		for (uint32_t lane = 0; lane < INGRESS_SCHEDULER_LANES; lane++) {
+			ingressClass.lanes[lane].head = INGRESS_SCHEDULER_NONE;
+			ingressClass.lanes[lane].tail = INGRESS_SCHEDULER_NONE;
+			ingressClass.lanes[lane].count = 0;
+		}
+		ingressClass.count = 0;
+		ingressClass.maxCount = 0;
+		ingressClass.weight = 1;
+		ingressClass.credit = 1;
+		ingressClass.nextLane = 0;
+		ingressClass.received = 0;
+		ingressClass.delivered = 0;
+		ingressClass.dropped = 0;
+	}
+}
+
+bool CIngressScheduler::Start(CPacketPool* pool, const uint32_t capacity, const uint32_t weights[INGRESS_CLASS_COUNT]) {
+	if (capacity == 0 || this->m_capacity != 0 || pool == NULL || pool->GetCount() < capacity + 2) {
+		return false;
+	}
+	for (int i = 0; i < INGRESS_CLASS_COUNT; i++) {
+		if (weights[i] == 0) {
+			return false;
+		}
+		this->m_classes[i].weight = weights[i];
+		this->m_classes[i].credit = weights[i];
+	}
+
+	this->m_pool = pool;
+	this->m_capacity = capacity;
+	return true;
+}
+
+IngressMessage* CIngressScheduler::GetReceiveMessage() {
+	if (this->m_receiveIndex == INGRESS_SCHEDULER_NONE) {
+		this->m_receiveIndex = this->m_pool->Allocate();
+		if (this->m_receiveIndex == INGRESS_SCHEDULER_NONE) {
+			return NULL;
+		}
+	}
+	return this->m_pool->Get(this->m_receiveIndex);
+}
+
+IngressClass CIngressScheduler::Enqueue() {
+	const uint32_t index = this->m_receiveIndex;
+	IngressMessage& message = *this->m_pool->Get(index);
+	uint16_t dnet = 0;
+	const IngressClass messageClass = Classify(message.buffer, message.length, &dnet);
+	message.ingressClass = (uint8_t)messageClass;
+	message.dnet = dnet;
+	this->m_classes[messageClass].received++;
+
+	IngressClass shedClass = INGRESS_CLASS_COUNT;
+	if (this->m_queuedCount >= this->m_capacity) {
+		// Shed from the lowest class that has a message, never from a class
+		// above the one of the new message
+		int victimClass = INGRESS_CLASS_COUNT - 1;
+		while (victimClass > (int)messageClass && this->m_classes[victimClass].count == 0) {
+			victimClass--;
+		}
+		Class& victim = this->m_classes[victimClass];
+		if (victim.count == 0) {
+			// Everything queued is more important, the receive message is reused
+			victim.dropped++;
+			return messageClass;
+		}
+
+		// Oldest message of the longest lane
+		uint32_t longestLane = 0;
+		for (uint32_t lane = 1; lane < INGRESS_SCHEDULER_LANES; lane++) {
+			if (victim.lanes[lane].count > victim.lanes[longestLane].count) {
+				longestLane = lane;
+			}
+		}
+		this->m_pool->Free(this->PopLane(victim, longestLane));
+		victim.dropped++;
+		shedClass = (IngressClass)victimClass;
+	}
+
+	message.enqueueTicks = CLatencyClock::Now();
+	this->PushLane(index);
+
+	// Taken from the pool by the next GetReceiveMessage()
+	this->m_receiveIndex = INGRESS_SCHEDULER_NONE;
+	return shedClass;
+}
+
+const IngressMessage* CIngressScheduler::Dequeue() {
+	if (this->m_deliveredIndex != INGRESS_SCHEDULER_NONE) {
+		this->m_pool->Free(this->m_deliveredIndex);
+		this->m_deliveredIndex = INGRESS_SCHEDULER_NONE;
+	}
+	if (this->m_queuedCount == 0) {
+		return NULL;
+	}
+
+	for (;;) {
+		for (int i = 0; i < INGRESS_CLASS_COUNT; i++) {
+			Class& ingressClass = this->m_classes[i];
+			if (ingressClass.count == 0 || ingressClass.credit == 0) {
+				continue;
+			}
+			ingressClass.credit--;
+
+			uint32_t lane = ingressClass.nextLane;
+			while (ingressClass.lanes[lane].count == 0) {
+				lane = (lane + 1) % INGRESS_SCHEDULER_LANES;
+			}
+			ingressClass.nextLane = (lane + 1) % INGRESS_SCHEDULER_LANES;
+
+			const uint32_t index = this->PopLane(ingressClass, lane);
+			const IngressMessage& message = *this->m_pool->Get(index);
+			ingressClass.delivered++;
+			ingressClass.wait.Record(CLatencyClock::Now() - message.enqueueTicks);
+			this->m_deliveredIndex = index;
+			return &message;
+		}
+
+		// Every class with a message has used its credit, start a new round
+		for (int i = 0; i < INGRESS_CLASS_COUNT; i++) {
+			this->m_classes[i].credit = this->m_classes[i].weight;
+		}
+	}
+}
+
+void CIngressScheduler::Report(std::ostream& out) const {
+	out << "{\"ingress\":{\"capacity\":" << this->m_capacity << ",\"queued\":" << this->m_queuedCount << ",\"classes\":[";
+	for (int i = 0; i < INGRESS_CLASS_COUNT; i++) {
+		const Class& ingressClass = this->m_classes[i];
+		if (i > 0) {
+			out << ",";
+		}
+		out << "{\"name\":\"" << INGRESS_CLASS_NAMES[i] << "\",\"weight\":" << ingressClass.weight
+			<< ",\"received\":" << ingressClass.received
+			<< ",\"delivered\":" << ingressClass.delivered
+			<< ",\"dropped\":" << ingressClass.dropped
+			<< ",\"queued\":" << ingressClass.count
+			<< ",\"maxQueued\":" << ingressClass.maxCount
+			<< ",\"wait\":";
+		ingressClass.wait.Report(out, "wait");
+		out << "}";
+	}
+	out << "]}}" << std::endl;
+}
+
+IngressClass CIngressScheduler::Classify(const uint8_t* message, const uint16_t length, uint16_t* dnet) {
+	NPDUHeader header;
+	const bool hasNPDU = ParseNPDUHeader(message, length, &header);
+	*dnet = header.destinationNetwork;
+	if (!hasNPDU) {
+		// BVLC-Result, BDT and FDT reads and writes, registrations. Anything
+		// that is not BACnet/IP is shed first.
+		const bool bvlc = message != NULL && length >= ExampleConstants::BVLC_HEADER_LENGTH && (message[0] == ExampleConstants::BVLC_TYPE_BACNET_IP || message[0] == ExampleConstants::BVLC_TYPE_BACNET_IPV6);
+		return bvlc && header.npduOffset == 0 ? INGRESS_CLASS_UNICAST : INGRESS_CLASS_BROADCAST;
+	}
+	if (header.control & ExampleConstants::NPDU_CONTROL_NETWORK_LAYER_MESSAGE) {
+		// Who-Is-Router-To-Network and the other routing messages
+		return INGRESS_CLASS_BROADCAST;
+	}
+
+	// APDU
+	switch (message[header.apduOffset] >> 4) {
+	case APDU_TYPE_CONFIRMED_REQUEST:
+		return INGRESS_CLASS_CONFIRMED;
+	case APDU_TYPE_UNCONFIRMED_REQUEST:
+		return header.broadcast ? INGRESS_CLASS_BROADCAST : INGRESS_CLASS_UNICAST;
+	default:
+		// Acks, errors, rejects and aborts of the requests sent by the stack
+		return INGRESS_CLASS_UNICAST;
+	}
+}
+
+const char* CIngressScheduler::GetClassName(const IngressClass ingressClass) {
+	return ingressClass < INGRESS_CLASS_COUNT ? INGRESS_CLASS_NAMES[ingressClass] : "none";
+}
+
+void CIngressScheduler::PushLane(const uint32_t index) {
+	IngressMessage& message = *this->m_pool->Get(index);
+	Class& ingressClass = this->m_classes[message.ingressClass];
+	Lane& lane = ingressClass.lanes[GetLaneIndex(message.dnet)];
+	message.next = INGRESS_SCHEDULER_NONE;
+	if (lane.tail == INGRESS_SCHEDULER_NONE) {
+		lane.head = index;
+	}
+	else {
+		this->m_pool->Get(lane.tail)->next = index;
+	}
+	lane.tail = index;
+	lane.count++;
+	ingressClass.count++;
+	if (ingressClass.count > ingressClass.maxCount) {
+		ingressClass.maxCount = ingressClass.count;
+	}
+	this->m_queuedCount++;
+	this->m_sharedQueuedCount.store(this->m_queuedCount, std::memory_order_relaxed);
+}
+
+uint32_t CIngressScheduler::PopLane(Class& ingressClass, const uint32_t laneIndex) {
+	Lane& lane = ingressClass.lanes[laneIndex];
+	const uint32_t index = lane.head;
+	lane.head = this->m_pool->Get(index)->next;
+	if (lane.head == INGRESS_SCHEDULER_NONE) {
+		lane.tail = INGRESS_SCHEDULER_NONE;
+	}
+	lane.count--;
+	ingressClass.count--;
+	this->m_queuedCount--;
+	this->m_sharedQueuedCount.store(this->m_queuedCount, std::memory_order_relaxed);
+	return index;
+}
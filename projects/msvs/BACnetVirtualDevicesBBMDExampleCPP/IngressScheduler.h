@@ -0,0 +1,141 @@
+/*
+ * BACnet Virtual Devices and BBMD Example C++
+ * ----------------------------------------------------------------------------
+ * IngressScheduler.h
+ *
+ * Priority queues between the sockets and the CAS BACnet Stack, so that a
+ * flood of broadcasts can not make the confirmed requests time out.
+ *
+ * The receive callback drains the sockets into the scheduler. Each message
+ * is classified from its BVLC function, NPDU and APDU type:
+ *   confirmed - confirmed requests, ReadProperty and friends
+ *   unicast   - unconfirmed requests sent to this BBMD only, acks, errors,
+ *               rejects, aborts and the BVLC control messages (BDT, FDT,
+ *               foreign device registrations)
+ *   broadcast - Who-Is, I-Am and the other unconfirmed requests that were
+ *               broadcast, Forwarded-NPDUs and the network layer messages
+ *
+ * The classes are served by weighted round robin: each round delivers up to
+ * <weight> messages from each class, in class order, so no class starves.
+ * Within a class, each destination network (DNET) has its own FIFO lane and
+ * the lanes take turns, so one busy virtual network can not crowd out the
+ * others.
+ *
+ * The messages are buffers of a CPacketPool, the lanes link them by handle.
+ * At most <capacity> are queued. When the queues are full a message is shed
+ * from the lowest class that has one, from its longest lane, oldest first. A
+ * new message is dropped only when every queued message is of a higher
+ * class. Every drop is counted on its class.
+ *
+ * The scheduler is used from the BACnet thread only and does not allocate
+ * after Start(). Only the queued count is read by other threads, from a copy.
+ */
+
+#ifndef __IngressScheduler_h__
+#define __IngressScheduler_h__
+
+#include <stdint.h>
+#include <atomic>
+#include <ostream>
+#include <vector>
+#include "LatencyHistogram.h"
+#include "PacketPool.h"
+
+// Constants
+#define INGRESS_SCHEDULER_MAX_MESSAGE_LENGTH			PACKET_POOL_MAX_MESSAGE_LENGTH
+#define INGRESS_SCHEDULER_MAX_CONNECTION_STRING_LENGTH	PACKET_POOL_MAX_CONNECTION_STRING_LENGTH
+#define INGRESS_SCHEDULER_LANE_BITS						5
+#define INGRESS_SCHEDULER_LANES							(1 << INGRESS_SCHEDULER_LANE_BITS)
+#define INGRESS_SCHEDULER_DRAIN_BATCH					64		// Largest number of messages read from the sockets per call
+
+// In priority order, the last class is shed first
+enum IngressClass
+{
+	INGRESS_CLASS_CONFIRMED,
+	INGRESS_CLASS_UNICAST,
+	INGRESS_CLASS_BROADCAST,
+	INGRESS_CLASS_COUNT
+};
+
+// A received message and the connection strings it came with, Enqueue()
+// sets its class, DNET and enqueue time
+typedef PacketBuffer IngressMessage;
+
+class CIngressScheduler
+{
+public:
+	CIngressScheduler();
+
+	// Queues up to capacity messages from the buffers of pool, which has to
+	// have at least capacity + 2: one being received and one being
+	// delivered. weights is the number of messages delivered from each class
+	// per round, at least 1.
+	bool Start(CPacketPool* pool, const uint32_t capacity, const uint32_t weights[INGRESS_CLASS_COUNT]);
+	bool IsEnabled() const { return this->m_capacity != 0; }
+
+	// The message to receive the next datagram into, NULL when the pool has
+	// no free buffer. Pass it to Enqueue() once it is filled in, or leave it
+	// for the next call.
+	IngressMessage* GetReceiveMessage();
+
+	// Classifies and queues the message from GetReceiveMessage(). Returns the
+	// class of the message that was shed to make room for it, which can be
+	// the new message itself, or INGRESS_CLASS_COUNT when nothing was shed.
+	IngressClass Enqueue();
+
+	// The next message to hand to the stack, NULL when all the queues are
+	// empty. It stays valid until the next call to Dequeue().
+	const IngressMessage* Dequeue();
+
+	// Messages queued, from any thread
+	uint32_t GetQueuedCount() const { return this->m_sharedQueuedCount.load(std::memory_order_relaxed); }
+	uint64_t GetDroppedCount(const IngressClass ingressClass) const { return this->m_classes[ingressClass].dropped; }
+
+	// {"capacity":...,"queued":...,"classes":[{"name":"confirmed",...},...]}
+	void Report(std::ostream& out) const;
+
+	// Class and destination network of a BACnet/IP (Annex J) or BACnet/IPv6
+	// (Annex U) message. Malformed messages are in the broadcast class.
+	static IngressClass Classify(const uint8_t* message, const uint16_t length, uint16_t* dnet);
+	static const char* GetClassName(const IngressClass ingressClass);
+
+private:
+	struct Lane
+	{
+		uint32_t head;
+		uint32_t tail;
+		uint32_t count;
+	};
+
+	struct Class
+	{
+		Lane lanes[INGRESS_SCHEDULER_LANES];
+		uint32_t count;
+		uint32_t maxCount;
+		uint32_t weight;
+		uint32_t credit;		// Messages left in this round
+		uint32_t nextLane;		// Round robin across the lanes
+		uint64_t received;
+		uint64_t delivered;
+		uint64_t dropped;
+		CLatencyHistogram wait;	// Time from Enqueue() to Dequeue()
+	};
+
+	// Handles of the message being received and of the one being delivered
+	CPacketPool* m_pool;
+	uint32_t m_capacity;
+	uint32_t m_queuedCount;
+	std::atomic<uint32_t> m_sharedQueuedCount;	// Copy of m_queuedCount for the other threads
+	uint32_t m_receiveIndex;
+	uint32_t m_deliveredIndex;
+	Class m_classes[INGRESS_CLASS_COUNT];
+
+	static uint32_t GetLaneIndex(const uint16_t dnet) {
+		// Fibonacci hashing, the virtual networks are often multiples of 1000
+		return (uint32_t)(dnet * 2654435761u) >> (32 - INGRESS_SCHEDULER_LANE_BITS);
+	}
+	void PushLane(const uint32_t index);
+	uint32_t PopLane(Class& ingressClass, const uint32_t laneIndex);
+};
+
+#endif // __IngressScheduler_h__
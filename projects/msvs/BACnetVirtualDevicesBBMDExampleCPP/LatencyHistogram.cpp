@@ -0,0 +1,145 @@
+/*
+ * BACnet Virtual Devices and BBMD Example C++
+ * ----------------------------------------------------------------------------
+ * LatencyHistogram.cpp
+ *
+ * Log-linear latency histograms, see LatencyHistogram.h.
+ */
+
+#include "LatencyHistogram.h"
+
+#include <chrono>
+#include <string.h>
+
+static const char* LATENCY_NAMES[LATENCY_COUNT] = {
+	"tick", "loop", "topology", "receiveMessage", "sendMessage",
+	"getPropertyCharacterString", "getPropertyEnumerated", "getPropertyOctetString", "getPropertyReal", "getPropertyUnsigned", "getPropertyBoolean",
+	"setPropertyReal", "setPropertyEnumerated", "setPropertyNull", "setPropertyUnsigned"
+};
+
+double CLatencyClock::s_ticksPerNanosecond = 1.0;
+
+void CLatencyClock::Calibrate() {
+#ifdef LATENCY_CLOCK_TSC
+	std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+	uint64_t startTicks = Now();
+	std::chrono::steady_clock::time_point end;
+	do {
+		end = std::chrono::steady_clock::now();
+	} while (end - start < std::chrono::milliseconds(20));
+	uint64_t endTicks = Now();
+	double nanoseconds = (double)std::chrono::duration_cast<std::chrono::nanoseconds>(end - start).count();
+	s_ticksPerNanosecond = (double)(endTicks - startTicks) / nanoseconds;
+#else
+	s_ticksPerNanosecond = 1.0;
+#endif
+}
+
+CLatencyHistogram::CLatencyHistogram() {
+	this->Clear();
+}
+
+void CLatencyHistogram::Clear() {
+	memset(this->m_counts, 0, sizeof(this->m_counts));
+	this->m_count = 0;
+	this->m_sum = 0;
+	this->m_max = 0;
+}
+
+uint64_t CLatencyHistogram::BucketUpperBound(const uint32_t index) {
+	if (index < LATENCY_HISTOGRAM_SUB_BUCKETS) {
+		return index;
+	}
+	uint32_t shift = (index - LATENCY_HISTOGRAM_SUB_BUCKETS) / LATENCY_HISTOGRAM_SUB_BUCKETS;
+	uint64_t subBucket = (index - LATENCY_HISTOGRAM_SUB_BUCKETS) % LATENCY_HISTOGRAM_SUB_BUCKETS + LATENCY_HISTOGRAM_SUB_BUCKETS;
+	return ((subBucket + 1) << shift) - 1;
+}
+
+uint64_t CLatencyHistogram::GetPercentileNanoseconds(const double percentile) const {
+	if (this->m_count == 0) {
+		return 0;
+	}
+	uint64_t target = (uint64_t)(percentile / 100.0 * (double)this->m_count + 0.5);
+	if (target < 1) {
+		target = 1;
+	}
+	uint64_t seen = 0;
+	for (uint32_t index = 0; index < LATENCY_HISTOGRAM_BUCKETS; index++) {
+		seen += this->m_counts[index];
+		if (seen >= target) {
+			uint64_t ticks = BucketUpperBound(index);
+			if (ticks > this->m_max) {
+				ticks = this->m_max;
+			}
+			return (uint64_t)((double)ticks / CLatencyClock::TicksPerNanosecond());
+		}
+	}
+	return this->GetMaxNanoseconds();
+}
+
+uint64_t CLatencyHistogram::GetMaxNanoseconds() const {
+	return (uint64_t)((double)this->m_max / CLatencyClock::TicksPerNanosecond());
+}
+
+uint64_t CLatencyHistogram::GetMeanNanoseconds() const {
+	if (this->m_count == 0) {
+		return 0;
+	}
+	return (uint64_t)((double)this->m_sum / (double)this->m_count / CLatencyClock::TicksPerNanosecond());
+}
+
+void CLatencyHistogram::Report(std::ostream& out, const char* name) const {
+	out << "{\"name\":\"" << name << "\",\"count\":" << this->m_count
+		<< ",\"meanNs\":" << this->GetMeanNanoseconds()
+		<< ",\"p50Ns\":" << this->GetPercentileNanoseconds(50)
+		<< ",\"p90Ns\":" << this->GetPercentileNanoseconds(90)
+		<< ",\"p99Ns\":" << this->GetPercentileNanoseconds(99)
+		<< ",\"p999Ns\":" << this->GetPercentileNanoseconds(99.9)
+		<< ",\"maxNs\":" << this->GetMaxNanoseconds() << "}";
+}
+
+CLatencyHistograms::CLatencyHistograms() {
+	this->m_overheadNanoseconds = 0;
+	this->m_activity = LATENCY_COUNT;
+}
+
+const char* CLatencyHistograms::GetName(const LatencyId id) {
+	return id < LATENCY_COUNT ? LATENCY_NAMES[id] : "mainLoop";
+}
+
+void CLatencyHistograms::Clear() {
+	for (int i = 0; i < LATENCY_COUNT; i++) {
+		this->m_histograms[i].Clear();
+	}
+}
+
+double CLatencyHistograms::MeasureOverhead() {
+	const uint32_t iterations = 1000000;
+	CLatencyHistogram histogram;
+	uint64_t start = CLatencyClock::Now();
+	for (uint32_t i = 0; i < iterations; i++) {
+		LatencyId previous = this->EnterActivity(LATENCY_TICK);
+		uint64_t scopeStart = CLatencyClock::Now();
+		histogram.Record(CLatencyClock::Now() - scopeStart);
+		this->LeaveActivity(previous);
+	}
+	uint64_t ticks = CLatencyClock::Now() - start;
+	this->m_overheadNanoseconds = (double)ticks / CLatencyClock::TicksPerNanosecond() / iterations;
+	return this->m_overheadNanoseconds;
+}
+
+void CLatencyHistograms::Report(std::ostream& out) const {
+	out << "{\"latency\":{\"ticksPerNs\":" << CLatencyClock::TicksPerNanosecond() << ",\"overheadNs\":" << this->m_overheadNanoseconds << ",\"histograms\":[";
+	bool first = true;
+	for (int i = 0; i < LATENCY_COUNT; i++) {
+		if (this->m_histograms[i].GetCount() == 0) {
+			continue;
+		}
+		if (!first) {
+			out << ",";
+		}
+		first = false;
+		this->m_histograms[i].Report(out, LATENCY_NAMES[i]);
+	}
+	out << "]}}" << std::endl;
+}
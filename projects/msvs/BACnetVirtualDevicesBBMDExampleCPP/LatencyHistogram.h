@@ -0,0 +1,197 @@
+/*
+ * BACnet Virtual Devices and BBMD Example C++
+ * ----------------------------------------------------------------------------
+ * LatencyHistogram.h
+ *
+ * Low overhead latency histograms around the registered callbacks and the
+ * main loop.
+ *
+ * Time is read from the CPU time stamp counter where there is one (x86), and
+ * from std::chrono::steady_clock elsewhere. The counter is converted to
+ * nanoseconds only when a report is printed, with a rate measured once at
+ * startup. This assumes an invariant TSC, which all current x86 CPUs have.
+ *
+ * The histograms are log-linear like HdrHistogram: each power of two range
+ * is split into 16 buckets, so every value is recorded within 1/16 (6%) of
+ * its actual value, from one tick up to 2^64 ticks, in 1024 counters.
+ *
+ * All the histograms are updated and printed from the BACnet thread only.
+ * The scope being timed can be read from any thread, see GetActivity().
+ */
+
+#ifndef __LatencyHistogram_h__
+#define __LatencyHistogram_h__
+
+#include <stdint.h>
+#include <atomic>
+#include <ostream>
+
+#if defined(_MSC_VER) && (defined(_M_X64) || defined(_M_IX86))
+#include <intrin.h>
+#define LATENCY_CLOCK_TSC
+#elif defined(__GNUC__) && (defined(__x86_64__) || defined(__i386__))
+#include <x86intrin.h>
+#define LATENCY_CLOCK_TSC
+#else
+#include <chrono>
+#endif
+
+// Constants
+#define LATENCY_HISTOGRAM_SUB_BUCKET_BITS	4
+#define LATENCY_HISTOGRAM_SUB_BUCKETS		(1 << LATENCY_HISTOGRAM_SUB_BUCKET_BITS)
+#define LATENCY_HISTOGRAM_BUCKETS			(64 * LATENCY_HISTOGRAM_SUB_BUCKETS)
+
+class CLatencyClock
+{
+public:
+	static uint64_t Now() {
+#ifdef LATENCY_CLOCK_TSC
+		return __rdtsc();
+#else
+		return (uint64_t)std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::steady_clock::now().time_since_epoch()).count();
+#endif
+	}
+
+	// Measures the rate of Now() against the steady clock, takes ~20 ms
+	static void Calibrate();
+	static double TicksPerNanosecond() { return s_ticksPerNanosecond; }
+
+private:
+	static double s_ticksPerNanosecond;
+};
+
+class CLatencyHistogram
+{
+public:
+	CLatencyHistogram();
+
+	void Record(const uint64_t ticks) {
+		this->m_counts[BucketIndex(ticks)]++;
+		this->m_count++;
+		this->m_sum += ticks;
+		if (ticks > this->m_max) {
+			this->m_max = ticks;
+		}
+	}
+
+	void Clear();
+	uint64_t GetCount() const { return this->m_count; }
+	// Upper bound of the bucket that holds the percentile (0 - 100)
+	uint64_t GetPercentileNanoseconds(const double percentile) const;
+	uint64_t GetMaxNanoseconds() const;
+	uint64_t GetMeanNanoseconds() const;
+
+	// {"name":...,"count":...,"p50Ns":...,...}
+	void Report(std::ostream& out, const char* name) const;
+
+private:
+	uint64_t m_counts[LATENCY_HISTOGRAM_BUCKETS];
+	uint64_t m_count;
+	uint64_t m_sum;
+	uint64_t m_max;
+
+	static uint32_t BucketIndex(const uint64_t ticks) {
+		if (ticks < LATENCY_HISTOGRAM_SUB_BUCKETS) {
+			return (uint32_t)ticks;
+		}
+		uint32_t highestBit = HighestBit(ticks);
+		uint32_t shift = highestBit - LATENCY_HISTOGRAM_SUB_BUCKET_BITS;
+		return LATENCY_HISTOGRAM_SUB_BUCKETS + shift * LATENCY_HISTOGRAM_SUB_BUCKETS + (uint32_t)((ticks >> shift) - LATENCY_HISTOGRAM_SUB_BUCKETS);
+	}
+	static uint64_t BucketUpperBound(const uint32_t index);
+	static uint32_t HighestBit(const uint64_t value) {
+#if defined(__GNUC__)
+		return 63 - (uint32_t)__builtin_clzll(value);
+#elif defined(_MSC_VER) && defined(_M_X64)
+		unsigned long index;
+		_BitScanReverse64(&index, value);
+		return (uint32_t)index;
+#else
+		uint32_t index = 63;
+		while ((value >> index) == 0) {
+			index--;
+		}
+		return index;
+#endif
+	}
+};
+
+// What is timed
+enum LatencyId
+{
+	LATENCY_TICK,					// fpTick(), includes the callbacks made from it
+	LATENCY_LOOP,					// ExampleDatabase::Loop()
+	LATENCY_TOPOLOGY,				// One slice of topology changes, only the loops that had some
+	LATENCY_RECEIVE_MESSAGE,		// Only the calls that returned a message
+	LATENCY_SEND_MESSAGE,
+	LATENCY_GET_PROPERTY_CHARACTER_STRING,
+	LATENCY_GET_PROPERTY_ENUMERATED,
+	LATENCY_GET_PROPERTY_OCTET_STRING,
+	LATENCY_GET_PROPERTY_REAL,
+	LATENCY_GET_PROPERTY_UNSIGNED,
+	LATENCY_GET_PROPERTY_BOOLEAN,
+	LATENCY_SET_PROPERTY_REAL,
+	LATENCY_SET_PROPERTY_ENUMERATED,
+	LATENCY_SET_PROPERTY_NULL,
+	LATENCY_SET_PROPERTY_UNSIGNED,
+	LATENCY_COUNT
+};
+
+class CLatencyHistograms
+{
+public:
+	CLatencyHistograms();
+
+	void Record(const LatencyId id, const uint64_t ticks) {
+		this->m_histograms[id].Record(ticks);
+	}
+	const CLatencyHistogram& Get(const LatencyId id) const { return this->m_histograms[id]; }
+	void Clear();
+
+	// The innermost scope being timed, LATENCY_COUNT outside of all of them.
+	// Written by the BACnet thread, read by the stall watchdog.
+	LatencyId GetActivity() const { return (LatencyId)this->m_activity.load(std::memory_order_relaxed); }
+	LatencyId EnterActivity(const LatencyId id) {
+		LatencyId previous = (LatencyId)this->m_activity.load(std::memory_order_relaxed);
+		this->m_activity.store(id, std::memory_order_relaxed);
+		return previous;
+	}
+	void LeaveActivity(const LatencyId previous) {
+		this->m_activity.store(previous, std::memory_order_relaxed);
+	}
+	static const char* GetName(const LatencyId id);
+
+	// Cost of one timed scope (two clock reads and a Record()), in
+	// nanoseconds. Measured with an empty scope.
+	double MeasureOverhead();
+
+	// Writes the histograms that have samples as one JSON object on one line
+	void Report(std::ostream& out) const;
+
+private:
+	CLatencyHistogram m_histograms[LATENCY_COUNT];
+	double m_overheadNanoseconds;
+	std::atomic<int> m_activity;
+};
+
+// Records the time from construction to destruction
+class CLatencyTimer
+{
+public:
+	CLatencyTimer(CLatencyHistograms& histograms, const LatencyId id) : m_histograms(histograms), m_id(id) {
+		this->m_previous = histograms.EnterActivity(id);
+		this->m_start = CLatencyClock::Now();
+	}
+	~CLatencyTimer() {
+		this->m_histograms.Record(this->m_id, CLatencyClock::Now() - this->m_start);
+		this->m_histograms.LeaveActivity(this->m_previous);
+	}
+
+private:
+	CLatencyHistograms& m_histograms;
+	LatencyId m_id;
+	LatencyId m_previous;
+	uint64_t m_start;
+};
+
+#endif // __LatencyHistogram_h__
@@ -0,0 +1,226 @@
+/*
+ * BACnet Virtual Devices and BBMD Example C++
+ * ----------------------------------------------------------------------------
+ * Metrics.cpp
+ *
+ * Runtime counters and gauges, and the HTTP listener that serves them.
+ */
+
+#include "Metrics.h"
+
+#include <string.h>
+#include <stdio.h>
+
+#ifdef _MSC_VER
+#include <winsock2.h>
+#include <ws2tcpip.h>
+#pragma comment(lib,"Ws2_32.lib")
+#define METRICS_INVALID_SOCKET	INVALID_SOCKET
+#define MetricsCloseSocket		closesocket
+#else
+#include <sys/socket.h>
+#include <sys/select.h>
+#include <netinet/in.h>
+#include <arpa/inet.h>
+#include <unistd.h>
+#define METRICS_INVALID_SOCKET	-1
+#define MetricsCloseSocket		close
+#endif
+
+// A scraper that hangs up early must not raise SIGPIPE
+#ifdef MSG_NOSIGNAL
+#define METRICS_SEND_FLAGS		MSG_NOSIGNAL
+#else
+#define METRICS_SEND_FLAGS		0
+#endif
+
+// Name, help and label of each value, in the order of the enums
+static const char* METRIC_COUNTER_NAMES[METRIC_COUNTER_COUNT][2] = {
+	{ "bacnet_packets_received_total", "Datagrams handed to the CAS BACnet Stack." },
+	{ "bacnet_bytes_received_total", "Bytes handed to the CAS BACnet Stack." },
+	{ "bacnet_packets_sent_total", "Datagrams sent for the CAS BACnet Stack." },
+	{ "bacnet_bytes_sent_total", "Bytes sent for the CAS BACnet Stack." },
+	{ "bacnet_socket_errors_total", "Failed socket sends and receives." },
+	{ "bacnet_loop_iterations_total", "Iterations of the main loop." },
+	{ "bacnet_ingress_dropped_confirmed_total", "Confirmed requests shed by the ingress scheduler." },
+	{ "bacnet_ingress_dropped_unicast_total", "Unicast messages shed by the ingress scheduler." },
+	{ "bacnet_ingress_dropped_broadcast_total", "Broadcast messages shed by the ingress scheduler." },
+	{ "bacnet_loop_stalls_total", "Times the main loop stopped for longer than the watchdog threshold." }
+};
+
+static const char* METRIC_GAUGE_NAMES[METRIC_GAUGE_COUNT][2] = {
+	{ "bacnet_virtual_devices", "Virtual devices registered with the CAS BACnet Stack." },
+	{ "bacnet_network_ports", "BACnet/IP Network Port objects of the main device." },
+	{ "bacnet_start_time_seconds", "Start time of the process since the epoch." }
+};
+
+static const char* METRIC_PROPERTY_TYPE_LABELS[METRIC_PROPERTY_TYPE_COUNT] = {
+	"character_string", "enumerated", "octet_string", "real", "unsigned", "boolean"
+};
+
+static void RenderHeader(std::string& out, const char* name, const char* help, const char* type) {
+	out += "# HELP ";
+	out += name;
+	out += " ";
+	out += help;
+	out += "\n# TYPE ";
+	out += name;
+	out += " ";
+	out += type;
+	out += "\n";
+}
+
+static void RenderValue(std::string& out, const char* name, const char* label, const uint64_t value) {
+	char line[160];
+	if (label != NULL) {
+		snprintf(line, sizeof(line), "%s{type=\"%s\"} %llu\n", name, label, (unsigned long long)value);
+	}
+	else {
+		snprintf(line, sizeof(line), "%s %llu\n", name, (unsigned long long)value);
+	}
+	out += line;
+}
+
+void CMetrics::Render(std::string& out) const {
+	out.clear();
+	for (int i = 0; i < METRIC_COUNTER_COUNT; i++) {
+		RenderHeader(out, METRIC_COUNTER_NAMES[i][0], METRIC_COUNTER_NAMES[i][1], "counter");
+		RenderValue(out, METRIC_COUNTER_NAMES[i][0], NULL, this->m_counters[i].Get());
+	}
+	for (int i = 0; i < METRIC_GAUGE_COUNT; i++) {
+		RenderHeader(out, METRIC_GAUGE_NAMES[i][0], METRIC_GAUGE_NAMES[i][1], "gauge");
+		RenderValue(out, METRIC_GAUGE_NAMES[i][0], NULL, this->m_gauges[i].Get());
+	}
+	RenderHeader(out, "bacnet_property_reads_total", "Property callbacks, by value type.", "counter");
+	for (int i = 0; i < METRIC_PROPERTY_TYPE_COUNT; i++) {
+		RenderValue(out, "bacnet_property_reads_total", METRIC_PROPERTY_TYPE_LABELS[i], this->m_propertyReads[i].Get());
+	}
+	RenderHeader(out, "bacnet_property_reads_unanswered_total", "Property callbacks that returned false, by value type.", "counter");
+	for (int i = 0; i < METRIC_PROPERTY_TYPE_COUNT; i++) {
+		RenderValue(out, "bacnet_property_reads_unanswered_total", METRIC_PROPERTY_TYPE_LABELS[i], this->m_propertyReadsUnanswered[i].Get());
+	}
+}
+
+CMetricsServer::CMetricsServer() {
+	this->m_metrics = NULL;
+	this->m_running = false;
+	this->m_socket = METRICS_INVALID_SOCKET;
+}
+
+CMetricsServer::~CMetricsServer() {
+	this->Stop();
+}
+
+bool CMetricsServer::Start(const CMetrics* metrics, const char* bindAddress, const uint16_t port) {
+	if (this->m_running) {
+		return false;
+	}
+	this->m_metrics = metrics;
+
+#ifdef _MSC_VER
+	WSADATA wsaData;
+	if (WSAStartup(MAKEWORD(2, 2), &wsaData) != NO_ERROR) {
+		return false;
+	}
+#endif
+
+	this->m_socket = socket(AF_INET, SOCK_STREAM, IPPROTO_TCP);
+	if (this->m_socket == (MetricsSocket)METRICS_INVALID_SOCKET) {
+		return false;
+	}
+	int reuse = 1;
+	setsockopt(this->m_socket, SOL_SOCKET, SO_REUSEADDR, (const char*)&reuse, sizeof(reuse));
+
+	struct sockaddr_in address;
+	memset(&address, 0, sizeof(address));
+	address.sin_family = AF_INET;
+	address.sin_port = htons(port);
+	if (inet_pton(AF_INET, bindAddress, &address.sin_addr) != 1 ||
+		bind(this->m_socket, (struct sockaddr*)&address, sizeof(address)) != 0 ||
+		listen(this->m_socket, 4) != 0) {
+		MetricsCloseSocket(this->m_socket);
+		this->m_socket = METRICS_INVALID_SOCKET;
+		return false;
+	}
+
+	this->m_running = true;
+	this->m_thread = std::thread(&CMetricsServer::Run, this);
+	return true;
+}
+
+void CMetricsServer::Stop() {
+	if (!this->m_running) {
+		return;
+	}
+	this->m_running = false;
+	if (this->m_thread.joinable()) {
+		this->m_thread.join();
+	}
+	MetricsCloseSocket(this->m_socket);
+	this->m_socket = METRICS_INVALID_SOCKET;
+}
+
+void CMetricsServer::Run() {
+	while (this->m_running) {
+		// Wake up regularly to notice Stop()
+		fd_set readSet;
+		FD_ZERO(&readSet);
+		FD_SET(this->m_socket, &readSet);
+		struct timeval timeout;
+		timeout.tv_sec = 0;
+		timeout.tv_usec = 200000;
+		if (select((int)this->m_socket + 1, &readSet, NULL, NULL, &timeout) <= 0) {
+			continue;
+		}
+
+		MetricsSocket client = accept(this->m_socket, NULL, NULL);
+		if (client == (MetricsSocket)METRICS_INVALID_SOCKET) {
+			continue;
+		}
+		this->Serve(client);
+		MetricsCloseSocket(client);
+	}
+}
+
+void CMetricsServer::Serve(const MetricsSocket client) {
+	// A slow client can only hold up the listener, not the BACnet thread
+#ifdef _MSC_VER
+	DWORD receiveTimeout = 1000;
+#else
+	struct timeval receiveTimeout;
+	receiveTimeout.tv_sec = 1;
+	receiveTimeout.tv_usec = 0;
+#endif
+	setsockopt(client, SOL_SOCKET, SO_RCVTIMEO, (const char*)&receiveTimeout, sizeof(receiveTimeout));
+
+	// Only the request line matters
+	char request[1024];
+	int length = (int)recv(client, request, sizeof(request) - 1, 0);
+	if (length <= 0) {
+		return;
+	}
+	request[length] = 0;
+
+	std::string body;
+	const char* status;
+	if (strncmp(request, "GET /metrics", 12) == 0 && (request[12] == ' ' || request[12] == '?')) {
+		status = "200 OK";
+		this->m_metrics->Render(body);
+	}
+	else {
+		status = "404 Not Found";
+		body = "Not Found\n";
+	}
+
+	char header[160];
+	snprintf(header, sizeof(header), "HTTP/1.0 %s\r\nContent-Type: text/plain; version=0.0.4\r\nContent-Length: %u\r\nConnection: close\r\n\r\n", status, (unsigned int)body.size());
+	std::string response = header + body;
+	size_t sent = 0;
+	while (sent < response.size()) {
+		int result = (int)send(client, response.c_str() + sent, (int)(response.size() - sent), METRICS_SEND_FLAGS);
+		if (result <= 0) {
+			return;
+		}
+		sent += (size_t)result;
+	}
+}
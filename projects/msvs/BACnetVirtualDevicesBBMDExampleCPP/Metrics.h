@@ -0,0 +1,133 @@
+/*
+ * BACnet Virtual Devices and BBMD Example C++
+ * ----------------------------------------------------------------------------
+ * Metrics.h
+ *
+ * Runtime counters and gauges, served in the Prometheus text format by a
+ * small HTTP listener on a background thread.
+ *
+ * Every value is an atomic on its own cache line. Each value has a single
+ * writer, the BACnet thread for all but the stall count, and it updates a value with a relaxed load and store, no locked
+ * instruction and no sharing of cache lines with the other values. The
+ * listener thread only reads the atomics, a scrape never waits on and never
+ * calls into the BACnet thread.
+ */
+
+#ifndef __Metrics_h__
+#define __Metrics_h__
+
+#include <stdint.h>
+#include <atomic>
+#include <string>
+#include <thread>
+
+enum MetricCounterId
+{
+	METRIC_PACKETS_RECEIVED,
+	METRIC_BYTES_RECEIVED,
+	METRIC_PACKETS_SENT,
+	METRIC_BYTES_SENT,
+	METRIC_SOCKET_ERRORS,
+	METRIC_LOOP_ITERATIONS,
+	METRIC_INGRESS_DROPPED_CONFIRMED,	// In the order of IngressClass
+	METRIC_INGRESS_DROPPED_UNICAST,
+	METRIC_INGRESS_DROPPED_BROADCAST,
+	METRIC_LOOP_STALLS,					// Written by the stall watchdog thread
+	METRIC_COUNTER_COUNT
+};
+
+enum MetricGaugeId
+{
+	METRIC_GAUGE_VIRTUAL_DEVICES,
+	METRIC_GAUGE_NETWORK_PORTS,
+	METRIC_GAUGE_START_TIME,
+	METRIC_GAUGE_COUNT
+};
+
+// Value type of a property callback
+enum MetricPropertyType
+{
+	METRIC_PROPERTY_CHARACTER_STRING,
+	METRIC_PROPERTY_ENUMERATED,
+	METRIC_PROPERTY_OCTET_STRING,
+	METRIC_PROPERTY_REAL,
+	METRIC_PROPERTY_UNSIGNED,
+	METRIC_PROPERTY_BOOLEAN,
+	METRIC_PROPERTY_TYPE_COUNT
+};
+
+// One value, alone on its cache line
+class alignas(64) CMetricValue
+{
+public:
+	std::atomic<uint64_t> value;
+
+	CMetricValue() : value(0) {}
+
+	// Single writer only
+	void Add(const uint64_t amount) {
+		this->value.store(this->value.load(std::memory_order_relaxed) + amount, std::memory_order_relaxed);
+	}
+	void Set(const uint64_t newValue) {
+		this->value.store(newValue, std::memory_order_relaxed);
+	}
+	uint64_t Get() const {
+		return this->value.load(std::memory_order_relaxed);
+	}
+};
+
+class CMetrics
+{
+public:
+	void Add(const MetricCounterId id, const uint64_t amount = 1) {
+		this->m_counters[id].Add(amount);
+	}
+	void Set(const MetricGaugeId id, const uint64_t value) {
+		this->m_gauges[id].Set(value);
+	}
+	// A property callback that answered, or returned false
+	void PropertyRead(const MetricPropertyType type, const bool answered) {
+		this->m_propertyReads[type].Add(1);
+		if (!answered) {
+			this->m_propertyReadsUnanswered[type].Add(1);
+		}
+	}
+
+	// Renders all the values in the Prometheus text exposition format
+	void Render(std::string& out) const;
+
+private:
+	CMetricValue m_counters[METRIC_COUNTER_COUNT];
+	CMetricValue m_gauges[METRIC_GAUGE_COUNT];
+	CMetricValue m_propertyReads[METRIC_PROPERTY_TYPE_COUNT];
+	CMetricValue m_propertyReadsUnanswered[METRIC_PROPERTY_TYPE_COUNT];
+};
+
+#ifdef _MSC_VER
+typedef uintptr_t MetricsSocket;	// SOCKET
+#else
+typedef int MetricsSocket;
+#endif
+
+// Serves GET /metrics over HTTP/1.0, one connection at a time
+class CMetricsServer
+{
+public:
+	CMetricsServer();
+	~CMetricsServer();
+
+	// Listens on the address (127.0.0.1 for local scrapes only) and port
+	bool Start(const CMetrics* metrics, const char* bindAddress, const uint16_t port);
+	void Stop();
+
+private:
+	const CMetrics* m_metrics;
+	std::atomic<bool> m_running;
+	std::thread m_thread;
+	MetricsSocket m_socket;
+
+	void Run();
+	void Serve(const MetricsSocket client);
+};
+
+#endif // __Metrics_h__
@@ -0,0 +1,195 @@
+/*
+ * BACnet Virtual Devices and BBMD Example C++
+ * ----------------------------------------------------------------------------
+ * MultiHomedUDP.cpp
+ *
+ * One UDP socket per network interface.
+ */
+
+#include "MultiHomedUDP.h"
+
+#include <string.h>
+#include <stdio.h>
+
+CMultiHomedUDP::CMultiHomedUDP() {
+	this->m_interfaceCount = 0;
+	this->m_nextInterface = 0;
+}
+
+CMultiHomedUDP::~CMultiHomedUDP() {
+	for (size_t i = 0; i < this->m_interfaceCount; i++) {
+		this->m_interfaces[i].udp.Disconnect();
+	}
+}
+
+int CMultiHomedUDP::AddInterface(const std::string& name, const uint8_t ipAddress[4], const uint8_t subnetMask[4], const uint16_t port) {
+	if (this->m_interfaceCount >= MULTI_HOMED_UDP_MAX_INTERFACES) {
+		return -1;
+	}
+
+	MultiHomedUDPInterface& networkInterface = this->m_interfaces[this->m_interfaceCount];
+	networkInterface.name = name;
+	networkInterface.port = port;
+	memcpy(networkInterface.IPAddress, ipAddress, 4);
+	memcpy(networkInterface.IPSubnetMask, subnetMask, 4);
+	CalculateBroadcast(networkInterface);
+
+	// With a single interface keep the original behaviour of binding to all
+	// addresses. Otherwise each socket is tied to its own interface.
+	bool connected;
+	if (name.empty()) {
+		char ipAddressString[16];
+		snprintf(ipAddressString, sizeof(ipAddressString), "%u.%u.%u.%u", ipAddress[0], ipAddress[1], ipAddress[2], ipAddress[3]);
+		connected = networkInterface.udp.Connect(port, true, this->m_interfaceCount == 0 ? NULL : ipAddressString);
+	}
+	else {
+#ifdef _WIN32
+		// Windows has no SO_BINDTODEVICE. A socket bound to the interface
+		// address still receives the broadcasts of its subnet.
+		char ipAddressString[16];
+		snprintf(ipAddressString, sizeof(ipAddressString), "%u.%u.%u.%u", ipAddress[0], ipAddress[1], ipAddress[2], ipAddress[3]);
+		connected = networkInterface.udp.Connect(port, true, ipAddressString);
+#else
+		connected = networkInterface.udp.Connect(port, true, NULL, name.c_str());
+#endif
+	}
+	if (!connected) {
+		return -1;
+	}
+
+	return (int)this->m_interfaceCount++;
+}
+
+void CMultiHomedUDP::UpdateInterface(const size_t index, const uint8_t ipAddress[4], const uint8_t subnetMask[4]) {
+	if (index >= this->m_interfaceCount) {
+		return;
+	}
+	MultiHomedUDPInterface& networkInterface = this->m_interfaces[index];
+	memcpy(networkInterface.IPAddress, ipAddress, 4);
+	memcpy(networkInterface.IPSubnetMask, subnetMask, 4);
+	CalculateBroadcast(networkInterface);
+
+	// Routes learned through the old subnet may no longer be valid
+	this->m_peerInterface.clear();
+}
+
+int CMultiHomedUDP::GetMessage(uint8_t* buffer, const uint16_t maxLength, uint8_t ipAddress[4], uint16_t* port, size_t* interfaceIndex) {
+	if (this->m_interfaceCount == 0) {
+		return 0;
+	}
+
+	fd_set readSet;
+	FD_ZERO(&readSet);
+	int maxSocket = 0;
+	for (size_t i = 0; i < this->m_interfaceCount; i++) {
+		if (!this->m_interfaces[i].udp.IsConnected() && !this->m_interfaces[i].udp.ReConnect()) {
+			continue;
+		}
+		FD_SET(this->m_interfaces[i].udp.GetSocket(), &readSet);
+		if ((int)this->m_interfaces[i].udp.GetSocket() > maxSocket) {
+			maxSocket = (int)this->m_interfaces[i].udp.GetSocket();
+		}
+	}
+
+	struct timeval timeout;
+	timeout.tv_sec = 0;
+	timeout.tv_usec = 0;
+	if (select(maxSocket + 1, &readSet, NULL, NULL, &timeout) <= 0) {
+		return 0;
+	}
+
+	bool socketError = false;
+	for (size_t offset = 0; offset < this->m_interfaceCount; offset++) {
+		size_t index = (this->m_nextInterface + offset) % this->m_interfaceCount;
+		MultiHomedUDPInterface& networkInterface = this->m_interfaces[index];
+		if (!networkInterface.udp.IsConnected() || !FD_ISSET(networkInterface.udp.GetSocket(), &readSet)) {
+			continue;
+		}
+
+		int length = networkInterface.udp.ReceiveFrom(buffer, maxLength, ipAddress, port);
+		if (length <= 0) {
+			socketError = socketError || length < 0;
+			continue;
+		}
+
+		this->m_nextInterface = (index + 1) % this->m_interfaceCount;
+		if (interfaceIndex != NULL) {
+			*interfaceIndex = index;
+		}
+		if (!IsOnSubnet(networkInterface, ipAddress)) {
+			uint32_t peer;
+			memcpy(&peer, ipAddress, 4);
+			this->m_peerInterface[peer] = index;
+		}
+		return length;
+	}
+	return socketError ? -1 : 0;
+}
+
+bool CMultiHomedUDP::SendTo(const uint8_t ipAddress[4], const uint16_t port, const uint8_t* buffer, const uint16_t length, const bool broadcast) {
+	if (this->m_interfaceCount == 0) {
+		return false;
+	}
+
+	static const uint8_t limitedBroadcast[4] = { 255, 255, 255, 255 };
+	if (broadcast) {
+		if (memcmp(ipAddress, limitedBroadcast, 4) != 0) {
+			for (size_t i = 0; i < this->m_interfaceCount; i++) {
+				if (IsOnSubnet(this->m_interfaces[i], ipAddress)) {
+					MultiHomedUDPInterface& networkInterface = this->m_interfaces[i];
+					return networkInterface.udp.SendTo(networkInterface.BroadcastIPAddress, port, buffer, length);
+				}
+			}
+		}
+
+		// Not on any of our subnets, send a local broadcast on every interface
+		bool sent = false;
+		for (size_t i = 0; i < this->m_interfaceCount; i++) {
+			MultiHomedUDPInterface& networkInterface = this->m_interfaces[i];
+			if (networkInterface.udp.SendTo(networkInterface.BroadcastIPAddress, port, buffer, length)) {
+				sent = true;
+			}
+		}
+		return sent;
+	}
+
+	return this->m_interfaces[this->Route(ipAddress)].udp.SendTo(ipAddress, port, buffer, length);
+}
+
+size_t CMultiHomedUDP::Route(const uint8_t ipAddress[4]) {
+	// Directly connected subnet
+	for (size_t i = 0; i < this->m_interfaceCount; i++) {
+		if (IsOnSubnet(this->m_interfaces[i], ipAddress)) {
+			return i;
+		}
+	}
+
+	// Reply on the interface the peer was last heard on
+	uint32_t peer;
+	memcpy(&peer, ipAddress, 4);
+	std::map<uint32_t, size_t>::const_iterator it = this->m_peerInterface.find(peer);
+	if (it != this->m_peerInterface.end() && it->second < this->m_interfaceCount) {
+		return it->second;
+	}
+
+	// Default route
+	return 0;
+}
+
+void CMultiHomedUDP::CalculateBroadcast(MultiHomedUDPInterface& networkInterface) {
+	for (size_t i = 0; i < 4; i++) {
+		networkInterface.BroadcastIPAddress[i] = networkInterface.IPAddress[i] | (uint8_t)~networkInterface.IPSubnetMask[i];
+	}
+}
+
+bool CMultiHomedUDP::IsOnSubnet(const MultiHomedUDPInterface& networkInterface, const uint8_t ipAddress[4]) {
+	uint8_t anyMask = 0;
+	for (size_t i = 0; i < 4; i++) {
+		anyMask |= networkInterface.IPSubnetMask[i];
+		if ((ipAddress[i] & networkInterface.IPSubnetMask[i]) != (networkInterface.IPAddress[i] & networkInterface.IPSubnetMask[i])) {
+			return false;
+		}
+	}
+	// An interface without an address is not on any subnet
+	return anyMask != 0;
+}
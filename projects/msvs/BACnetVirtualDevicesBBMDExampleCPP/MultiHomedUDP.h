@@ -0,0 +1,76 @@
+/*
+ * BACnet Virtual Devices and BBMD Example C++
+ * ----------------------------------------------------------------------------
+ * MultiHomedUDP.h
+ *
+ * A set of UDP sockets, one per network interface. Incoming messages are
+ * tagged with the interface they arrived on and outgoing messages are sent
+ * out of the interface whose subnet contains the destination.
+ */
+
+#ifndef __MultiHomedUDP_h__
+#define __MultiHomedUDP_h__
+
+#include <stdint.h>
+#include <map>
+#include <string>
+#include "SimpleUDP.h"
+
+// Constants
+#define MULTI_HOMED_UDP_MAX_INTERFACES	8
+
+class MultiHomedUDPInterface
+{
+public:
+	std::string name;
+	uint8_t IPAddress[4];
+	uint8_t IPSubnetMask[4];
+	uint8_t BroadcastIPAddress[4];
+	uint16_t port;
+	CSimpleUDP udp;
+};
+
+class CMultiHomedUDP
+{
+public:
+	CMultiHomedUDP();
+	~CMultiHomedUDP();
+
+	// Opens a socket for the interface. Returns the index of the interface,
+	// or -1 on failure. The name can be empty to bind to the IP address only.
+	int AddInterface(const std::string& name, const uint8_t ipAddress[4], const uint8_t subnetMask[4], const uint16_t port);
+	// Updates the address of an interface after a network change
+	void UpdateInterface(const size_t index, const uint8_t ipAddress[4], const uint8_t subnetMask[4]);
+
+	size_t GetInterfaceCount() const { return this->m_interfaceCount; }
+	const MultiHomedUDPInterface& GetInterface(const size_t index) const { return this->m_interfaces[index]; }
+
+	// Polls every socket with a single select(). Returns the length of the
+	// first message found, 0 when no message is waiting and -1 when nothing
+	// was read because of a socket error. The interfaces are polled round
+	// robin so that one busy interface can not starve the others.
+	int GetMessage(uint8_t* buffer, const uint16_t maxLength, uint8_t ipAddress[4], uint16_t* port, size_t* interfaceIndex);
+
+	// Sends a message out of the interface that can reach the destination.
+	// A broadcast is sent to the directed broadcast address of the matching
+	// interface, or of every interface when the destination is the limited
+	// broadcast address 255.255.255.255.
+	bool SendTo(const uint8_t ipAddress[4], const uint16_t port, const uint8_t* buffer, const uint16_t length, const bool broadcast);
+
+	// Selects the interface used to reach an address
+	size_t Route(const uint8_t ipAddress[4]);
+
+private:
+	MultiHomedUDPInterface m_interfaces[MULTI_HOMED_UDP_MAX_INTERFACES];
+	size_t m_interfaceCount;
+	size_t m_nextInterface;
+
+	// Interface each off-subnet peer was last heard on, so that replies to
+	// peers behind a router go back out of the interface they came in on.
+	std::map<uint32_t, size_t> m_peerInterface;
+
+	static void CalculateBroadcast(MultiHomedUDPInterface& networkInterface);
+	static bool IsOnSubnet(const MultiHomedUDPInterface& networkInterface, const uint8_t ipAddress[4]);
+};
+
+#endif // __MultiHomedUDP_h__
@@ -0,0 +1,103 @@
+/*
+ * BACnet Virtual Devices and BBMD Example C++
+ * ----------------------------------------------------------------------------
+ * NPDUHeader.cpp
+ *
+ * See NPDUHeader.h
+ */
+
+#include "NPDUHeader.h"
+#include "ExampleConstants.h"
+
+#include <string.h>
+
+bool ParseNPDUHeader(const uint8_t* message, const uint16_t length, NPDUHeader* header) {
+	memset(header, 0, sizeof(*header));
+	if (message == NULL || length < ExampleConstants::BVLC_HEADER_LENGTH) {
+		return false;
+	}
+
+	// BVLC, the offset of the NPDU and how the message was sent
+	if (message[0] == ExampleConstants::BVLC_TYPE_BACNET_IP) {
+		switch (message[1]) {
+		case ExampleConstants::BVLC_FUNCTION_ORIGINAL_UNICAST_NPDU:
+			header->npduOffset = 4;
+			break;
+		case ExampleConstants::BVLC_FUNCTION_ORIGINAL_BROADCAST_NPDU:
+		case ExampleConstants::BVLC_FUNCTION_DISTRIBUTE_BROADCAST_TO_NETWORK:
+			header->npduOffset = 4;
+			header->broadcast = true;
+			break;
+		case ExampleConstants::BVLC_FUNCTION_FORWARDED_NPDU:
+			// Followed by the address of the originating device
+			header->npduOffset = 10;
+			header->broadcast = true;
+			header->peer = message + 4;
+			header->peerLength = 6;
+			break;
+		default:
+			// BVLC-Result, BDT and FDT reads and writes, registrations
+			return false;
+		}
+	}
+	else if (message[0] == ExampleConstants::BVLC_TYPE_BACNET_IPV6) {
+		switch (message[1]) {
+		case ExampleConstants::BVLC6_FUNCTION_ORIGINAL_UNICAST_NPDU:
+			// Source and destination virtual addresses
+			header->npduOffset = 10;
+			break;
+		case ExampleConstants::BVLC6_FUNCTION_ORIGINAL_BROADCAST_NPDU:
+		case ExampleConstants::BVLC6_FUNCTION_DISTRIBUTE_BROADCAST_TO_NETWORK:
+			// Source virtual address
+			header->npduOffset = 7;
+			header->broadcast = true;
+			break;
+		case ExampleConstants::BVLC6_FUNCTION_FORWARDED_NPDU:
+			// Source virtual address and the originating B/IPv6 address
+			header->npduOffset = 25;
+			header->broadcast = true;
+			header->peer = message + 7;
+			header->peerLength = 18;
+			break;
+		default:
+			return false;
+		}
+	}
+	else {
+		return false;
+	}
+
+	// NPDU, version 1
+	uint32_t offset = header->npduOffset;
+	if (offset + 2 > length || message[offset] != ExampleConstants::NPDU_VERSION) {
+		return false;
+	}
+	header->control = message[offset + 1];
+	offset += 2;
+	if (header->control & ExampleConstants::NPDU_CONTROL_DESTINATION) {
+		if (offset + 3 > length || offset + 3 + message[offset + 2] > length) {
+			return false;
+		}
+		header->destinationNetwork = (uint16_t)(message[offset] << 8 | message[offset + 1]);
+		header->destinationAddressLength = message[offset + 2];
+		header->destinationAddress = message + offset + 3;
+		offset += 3 + header->destinationAddressLength;
+	}
+	if (header->control & ExampleConstants::NPDU_CONTROL_SOURCE) {
+		if (offset + 3 > length || offset + 3 + message[offset + 2] > length) {
+			return false;
+		}
+		header->sourceNetwork = (uint16_t)(message[offset] << 8 | message[offset + 1]);
+		header->sourceAddressLength = message[offset + 2];
+		header->sourceAddress = message + offset + 3;
+		offset += 3 + header->sourceAddressLength;
+	}
+	if (header->control & ExampleConstants::NPDU_CONTROL_DESTINATION) {
+		offset++;	// Hop count
+	}
+	if (offset >= length) {
+		return false;
+	}
+	header->apduOffset = (uint16_t)offset;
+	return true;
+}
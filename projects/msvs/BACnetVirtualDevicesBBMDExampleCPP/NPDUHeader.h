@@ -0,0 +1,39 @@
+/*
+ * BACnet Virtual Devices and BBMD Example C++
+ * ----------------------------------------------------------------------------
+ * NPDUHeader.h
+ *
+ * The BVLC and NPDU headers of a received BACnet/IP or BACnet/IPv6 message,
+ * read without the CAS BACnet Stack by the filters, queues and tracers that
+ * look at a message before it is handed to the stack.
+ */
+
+#ifndef __NPDUHeader_h__
+#define __NPDUHeader_h__
+
+#include <stdint.h>
+
+class NPDUHeader
+{
+public:
+	uint16_t npduOffset;				// 0 when the BVLC function carries no NPDU
+	bool broadcast;						// Original-Broadcast, Distribute-Broadcast-To-Network or Forwarded-NPDU
+	const uint8_t* peer;				// Originating address of a Forwarded-NPDU, or NULL
+	uint8_t peerLength;
+	uint8_t control;
+	uint16_t destinationNetwork;		// DNET, 0 when there is none
+	const uint8_t* destinationAddress;	// DADR, into the message
+	uint8_t destinationAddressLength;
+	uint16_t sourceNetwork;				// SNET, 0 when there is none
+	const uint8_t* sourceAddress;		// SADR, into the message
+	uint8_t sourceAddressLength;
+	uint16_t apduOffset;				// The APDU, or the network layer message
+};
+
+// Reads the BVLC and NPDU headers of a message. False for anything that is
+// not BACnet/IP or BACnet/IPv6, for the BVLC functions without an NPDU
+// (npduOffset is then 0), and for an NPDU whose addresses run past the end
+// of the message or that is not followed by at least one byte.
+bool ParseNPDUHeader(const uint8_t* message, const uint16_t length, NPDUHeader* header);
+
+#endif // __NPDUHeader_h__
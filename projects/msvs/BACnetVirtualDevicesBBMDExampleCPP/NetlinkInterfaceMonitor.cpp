@@ -0,0 +1,378 @@
+/*
+ * BACnet Virtual Devices and BBMD Example C++
+ * ----------------------------------------------------------------------------
+ * NetlinkInterfaceMonitor.cpp
+ *
+ * rtnetlink based interface discovery and change monitoring for Linux.
+ */
+
+#include "NetlinkInterfaceMonitor.h"
+
+#ifdef __linux__
+
+#include <errno.h>
+#include <fstream>
+#include <map>
+#include <poll.h>
+#include <string.h>
+#include <unistd.h>
+#include <arpa/inet.h>
+#include <net/if.h>
+#include <sys/socket.h>
+#include <linux/netlink.h>
+#include <linux/rtnetlink.h>
+
+// Size of the receive buffer used for dumps and events
+static const size_t NETLINK_BUFFER_SIZE = 32 * 1024;
+
+// How long the listener thread blocks before checking if it should stop
+static const int NETLINK_POLL_TIMEOUT_MS = 500;
+
+CNetlinkInterfaceMonitor::CNetlinkInterfaceMonitor() : m_changed(false), m_running(false) {
+	this->m_requestSocket = -1;
+	this->m_eventSocket = -1;
+	this->m_sequence = 0;
+}
+
+CNetlinkInterfaceMonitor::~CNetlinkInterfaceMonitor() {
+	this->Stop();
+}
+
+bool CNetlinkInterfaceMonitor::Start() {
+	if (this->IsRunning()) {
+		return true;
+	}
+
+	this->m_requestSocket = socket(AF_NETLINK, SOCK_RAW | SOCK_CLOEXEC, NETLINK_ROUTE);
+	if (this->m_requestSocket < 0) {
+		return false;
+	}
+
+	// Initial dump. This is the only time the interface table is queried,
+	// after this it is only refreshed when the kernel reports a change.
+	std::vector<NetworkInterfaceAddress> interfaces;
+	if (!this->Dump(interfaces)) {
+		this->Stop();
+		return false;
+	}
+	{
+		std::lock_guard<std::mutex> lock(this->m_mutex);
+		this->m_interfaces.swap(interfaces);
+	}
+	this->m_changed.store(true, std::memory_order_release);
+
+	// Subscribe to the address, route and link change groups
+	this->m_eventSocket = socket(AF_NETLINK, SOCK_RAW | SOCK_CLOEXEC | SOCK_NONBLOCK, NETLINK_ROUTE);
+	if (this->m_eventSocket < 0) {
+		this->Stop();
+		return false;
+	}
+	struct sockaddr_nl local;
+	memset(&local, 0, sizeof(local));
+	local.nl_family = AF_NETLINK;
+	local.nl_groups = RTMGRP_LINK | RTMGRP_IPV4_IFADDR | RTMGRP_IPV4_ROUTE;
+	if (bind(this->m_eventSocket, (struct sockaddr*)&local, sizeof(local)) != 0) {
+		this->Stop();
+		return false;
+	}
+
+	this->m_running.store(true, std::memory_order_relaxed);
+	this->m_thread = std::thread(&CNetlinkInterfaceMonitor::Run, this);
+	return true;
+}
+
+void CNetlinkInterfaceMonitor::Stop() {
+	this->m_running.store(false, std::memory_order_relaxed);
+	if (this->m_thread.joinable()) {
+		this->m_thread.join();
+	}
+	if (this->m_eventSocket >= 0) {
+		close(this->m_eventSocket);
+		this->m_eventSocket = -1;
+	}
+	if (this->m_requestSocket >= 0) {
+		close(this->m_requestSocket);
+		this->m_requestSocket = -1;
+	}
+}
+
+void CNetlinkInterfaceMonitor::GetInterfaces(std::vector<NetworkInterfaceAddress>& interfaces) {
+	std::lock_guard<std::mutex> lock(this->m_mutex);
+	this->m_changed.store(false, std::memory_order_relaxed);
+	interfaces = this->m_interfaces;
+}
+
+bool CNetlinkInterfaceMonitor::SelectInterface(const std::vector<NetworkInterfaceAddress>& interfaces, const std::string& name, NetworkInterfaceAddress& selected) {
+	std::vector<NetworkInterfaceAddress>::const_iterator it;
+	for (it = interfaces.begin(); it != interfaces.end(); ++it) {
+		if (!name.empty()) {
+			if (it->name == name) {
+				selected = *it;
+				return true;
+			}
+			continue;
+		}
+		if (it->isUp && !it->isLoopback) {
+			selected = *it;
+			return true;
+		}
+	}
+	return false;
+}
+
+void CNetlinkInterfaceMonitor::LoadDNSServers(std::vector<uint32_t>& servers) {
+	std::ifstream resolv("/etc/resolv.conf");
+	std::string line;
+	while (std::getline(resolv, line)) {
+		char address[64];
+		if (sscanf(line.c_str(), " nameserver %63s", address) != 1) {
+			continue;
+		}
+		struct in_addr addr;
+		if (inet_pton(AF_INET, address, &addr) == 1) {
+			servers.push_back(addr.s_addr);
+		}
+	}
+}
+
+bool CNetlinkInterfaceMonitor::DumpRequest(uint16_t type, uint8_t family, std::vector<uint8_t>& response) {
+	struct {
+		struct nlmsghdr header;
+		struct rtgenmsg message;
+	} request;
+	memset(&request, 0, sizeof(request));
+	request.header.nlmsg_len = NLMSG_LENGTH(sizeof(struct rtgenmsg));
+	request.header.nlmsg_type = type;
+	request.header.nlmsg_flags = NLM_F_REQUEST | NLM_F_DUMP;
+	request.header.nlmsg_seq = ++this->m_sequence;
+	request.message.rtgen_family = family;
+
+	struct sockaddr_nl kernel;
+	memset(&kernel, 0, sizeof(kernel));
+	kernel.nl_family = AF_NETLINK;
+	if (sendto(this->m_requestSocket, &request, request.header.nlmsg_len, 0, (struct sockaddr*)&kernel, sizeof(kernel)) < 0) {
+		return false;
+	}
+
+	// Collect all the parts of the multipart reply until NLMSG_DONE
+	response.clear();
+	std::vector<uint8_t> buffer(NETLINK_BUFFER_SIZE);
+	for (;;) {
+		ssize_t length = recv(this->m_requestSocket, buffer.data(), buffer.size(), 0);
+		if (length < 0) {
+			if (errno == EINTR) {
+				continue;
+			}
+			return false;
+		}
+
+		struct nlmsghdr* header = (struct nlmsghdr*)buffer.data();
+		int remaining = (int)length;
+		for (; NLMSG_OK(header, remaining); header = NLMSG_NEXT(header, remaining)) {
+			if (header->nlmsg_seq != this->m_sequence) {
+				continue;
+			}
+			if (header->nlmsg_type == NLMSG_DONE) {
+				return true;
+			}
+			if (header->nlmsg_type == NLMSG_ERROR) {
+				return false;
+			}
+			response.insert(response.end(), (uint8_t*)header, (uint8_t*)header + NLMSG_ALIGN(header->nlmsg_len));
+		}
+	}
+}
+
+bool CNetlinkInterfaceMonitor::Dump(std::vector<NetworkInterfaceAddress>& interfaces) {
+	std::vector<uint8_t> response;
+
+	// Links: name and flags by interface index
+	struct LinkInfo {
+		std::string name;
+		unsigned int flags;
+	};
+	std::map<uint32_t, LinkInfo> links;
+	if (!this->DumpRequest(RTM_GETLINK, AF_UNSPEC, response)) {
+		return false;
+	}
+	struct nlmsghdr* header = (struct nlmsghdr*)response.data();
+	int remaining = (int)response.size();
+	for (; NLMSG_OK(header, remaining); header = NLMSG_NEXT(header, remaining)) {
+		if (header->nlmsg_type != RTM_NEWLINK) {
+			continue;
+		}
+		struct ifinfomsg* info = (struct ifinfomsg*)NLMSG_DATA(header);
+		LinkInfo& link = links[info->ifi_index];
+		link.flags = info->ifi_flags;
+		int attributeLength = IFLA_PAYLOAD(header);
+		for (struct rtattr* attribute = IFLA_RTA(info); RTA_OK(attribute, attributeLength); attribute = RTA_NEXT(attribute, attributeLength)) {
+			if (attribute->rta_type == IFLA_IFNAME) {
+				link.name = std::string((const char*)RTA_DATA(attribute));
+			}
+		}
+	}
+
+	// Default gateways by outgoing interface index
+	std::map<uint32_t, uint32_t> gateways;
+	if (!this->DumpRequest(RTM_GETROUTE, AF_INET, response)) {
+		return false;
+	}
+	header = (struct nlmsghdr*)response.data();
+	remaining = (int)response.size();
+	for (; NLMSG_OK(header, remaining); header = NLMSG_NEXT(header, remaining)) {
+		if (header->nlmsg_type != RTM_NEWROUTE) {
+			continue;
+		}
+		struct rtmsg* route = (struct rtmsg*)NLMSG_DATA(header);
+		if (route->rtm_family != AF_INET || route->rtm_dst_len != 0 || route->rtm_table != RT_TABLE_MAIN) {
+			continue;
+		}
+		uint32_t gateway = 0;
+		uint32_t outputInterface = 0;
+		int attributeLength = RTM_PAYLOAD(header);
+		for (struct rtattr* attribute = RTM_RTA(route); RTA_OK(attribute, attributeLength); attribute = RTA_NEXT(attribute, attributeLength)) {
+			if (attribute->rta_type == RTA_GATEWAY) {
+				memcpy(&gateway, RTA_DATA(attribute), 4);
+			}
+			else if (attribute->rta_type == RTA_OIF) {
+				memcpy(&outputInterface, RTA_DATA(attribute), 4);
+			}
+		}
+		if (gateway != 0 && outputInterface != 0 && gateways.count(outputInterface) == 0) {
+			gateways[outputInterface] = gateway;
+		}
+	}
+
+	// IPv4 addresses
+	interfaces.clear();
+	if (!this->DumpRequest(RTM_GETADDR, AF_INET, response)) {
+		return false;
+	}
+	header = (struct nlmsghdr*)response.data();
+	remaining = (int)response.size();
+	for (; NLMSG_OK(header, remaining); header = NLMSG_NEXT(header, remaining)) {
+		if (header->nlmsg_type != RTM_NEWADDR) {
+			continue;
+		}
+		struct ifaddrmsg* address = (struct ifaddrmsg*)NLMSG_DATA(header);
+		if (address->ifa_family != AF_INET) {
+			continue;
+		}
+
+		NetworkInterfaceAddress entry;
+		memset(entry.IPAddress, 0, sizeof(entry.IPAddress));
+		memset(entry.BroadcastIPAddress, 0, sizeof(entry.BroadcastIPAddress));
+		memset(entry.IPDefaultGateway, 0, sizeof(entry.IPDefaultGateway));
+		entry.index = address->ifa_index;
+		entry.prefixLength = address->ifa_prefixlen;
+		entry.hasDefaultGateway = false;
+
+		bool hasLocal = false;
+		bool hasBroadcast = false;
+		int attributeLength = IFA_PAYLOAD(header);
+		for (struct rtattr* attribute = IFA_RTA(address); RTA_OK(attribute, attributeLength); attribute = RTA_NEXT(attribute, attributeLength)) {
+			// IFA_LOCAL is the interface address, IFA_ADDRESS is the peer on
+			// point-to-point links and the same as IFA_LOCAL otherwise.
+			if (attribute->rta_type == IFA_LOCAL) {
+				memcpy(entry.IPAddress, RTA_DATA(attribute), 4);
+				hasLocal = true;
+			}
+			else if (attribute->rta_type == IFA_ADDRESS && !hasLocal) {
+				memcpy(entry.IPAddress, RTA_DATA(attribute), 4);
+			}
+			else if (attribute->rta_type == IFA_BROADCAST) {
+				memcpy(entry.BroadcastIPAddress, RTA_DATA(attribute), 4);
+				hasBroadcast = true;
+			}
+		}
+
+		// Subnet mask from the prefix length
+		uint32_t mask = entry.prefixLength == 0 ? 0 : htonl(0xFFFFFFFFu << (32 - entry.prefixLength));
+		memcpy(entry.IPSubnetMask, &mask, 4);
+		if (!hasBroadcast) {
+			for (size_t i = 0; i < 4; i++) {
+				entry.BroadcastIPAddress[i] = entry.IPAddress[i] | ~entry.IPSubnetMask[i];
+			}
+		}
+
+		std::map<uint32_t, LinkInfo>::iterator link = links.find(entry.index);
+		if (link != links.end()) {
+			entry.name = link->second.name;
+			entry.isUp = (link->second.flags & IFF_UP) != 0;
+			entry.isLoopback = (link->second.flags & IFF_LOOPBACK) != 0;
+		}
+		else {
+			entry.isUp = false;
+			entry.isLoopback = false;
+		}
+
+		std::map<uint32_t, uint32_t>::iterator gateway = gateways.find(entry.index);
+		if (gateway != gateways.end()) {
+			memcpy(entry.IPDefaultGateway, &gateway->second, 4);
+			entry.hasDefaultGateway = true;
+		}
+
+		interfaces.push_back(entry);
+	}
+
+	return true;
+}
+
+void CNetlinkInterfaceMonitor::Run() {
+	std::vector<uint8_t> buffer(NETLINK_BUFFER_SIZE);
+	struct pollfd pfd;
+	pfd.fd = this->m_eventSocket;
+	pfd.events = POLLIN;
+
+	while (this->m_running.load(std::memory_order_relaxed)) {
+		pfd.revents = 0;
+		int ret = poll(&pfd, 1, NETLINK_POLL_TIMEOUT_MS);
+		if (ret <= 0) {
+			continue;
+		}
+
+		// Drain all the pending events. Any event in the subscribed groups
+		// invalidates the table. If the socket overran (ENOBUFS) events were
+		// lost, so the table is refreshed as well.
+		bool refresh = false;
+		for (;;) {
+			ssize_t length = recv(this->m_eventSocket, buffer.data(), buffer.size(), 0);
+			if (length < 0) {
+				if (errno == ENOBUFS) {
+					refresh = true;
+					continue;
+				}
+				break;
+			}
+			struct nlmsghdr* header = (struct nlmsghdr*)buffer.data();
+			int remaining = (int)length;
+			for (; NLMSG_OK(header, remaining); header = NLMSG_NEXT(header, remaining)) {
+				switch (header->nlmsg_type) {
+				case RTM_NEWADDR:
+				case RTM_DELADDR:
+				case RTM_NEWROUTE:
+				case RTM_DELROUTE:
+				case RTM_NEWLINK:
+				case RTM_DELLINK:
+					refresh = true;
+					break;
+				default:
+					break;
+				}
+			}
+		}
+
+		if (!refresh) {
+			continue;
+		}
+
+		std::vector<NetworkInterfaceAddress> interfaces;
+		if (this->Dump(interfaces)) {
+			std::lock_guard<std::mutex> lock(this->m_mutex);
+			this->m_interfaces.swap(interfaces);
+			this->m_changed.store(true, std::memory_order_release);
+		}
+	}
+}
+
+#endif // __linux__
@@ -0,0 +1,85 @@
+/*
+ * BACnet Virtual Devices and BBMD Example C++
+ * ----------------------------------------------------------------------------
+ * NetlinkInterfaceMonitor.h
+ *
+ * Linux network interface discovery using rtnetlink. The interface table
+ * (addresses, subnet masks, broadcast addresses and default gateways) is
+ * dumped once at startup and cached. A background thread listens for
+ * address, route and link change events and refreshes the cache, so readers
+ * never have to query the kernel. The main loop only checks an atomic flag
+ * to find out if the cached table has changed.
+ */
+
+#ifndef __NetlinkInterfaceMonitor_h__
+#define __NetlinkInterfaceMonitor_h__
+
+#ifdef __linux__
+
+#include <stdint.h>
+#include <atomic>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+
+// One IPv4 address assigned to an interface
+class NetworkInterfaceAddress
+{
+public:
+	std::string name;
+	uint32_t index;
+	bool isUp;
+	bool isLoopback;
+
+	uint8_t IPAddress[4];
+	uint8_t IPSubnetMask[4];
+	uint8_t prefixLength;
+	uint8_t BroadcastIPAddress[4];
+	uint8_t IPDefaultGateway[4];
+	bool hasDefaultGateway;
+};
+
+class CNetlinkInterfaceMonitor
+{
+public:
+	CNetlinkInterfaceMonitor();
+	~CNetlinkInterfaceMonitor();
+
+	// Dumps the interface table and starts listening for change events
+	bool Start();
+	void Stop();
+	bool IsRunning() const { return this->m_running.load(std::memory_order_relaxed); }
+
+	// Cheap check (atomic load, no syscall) used from the main loop
+	bool HasChanged() const { return this->m_changed.load(std::memory_order_acquire); }
+
+	// Copies the cached interface table and clears the changed flag
+	void GetInterfaces(std::vector<NetworkInterfaceAddress>& interfaces);
+
+	// Selects the interface to use for BACnet/IP. If name is empty, the first
+	// interface that is up, is not a loopback and has an address is used.
+	static bool SelectInterface(const std::vector<NetworkInterfaceAddress>& interfaces, const std::string& name, NetworkInterfaceAddress& selected);
+
+	// Reads the IPv4 name servers from /etc/resolv.conf
+	static void LoadDNSServers(std::vector<uint32_t>& servers);
+
+private:
+	int m_requestSocket;	// Used for the RTM_GET* dump requests
+	int m_eventSocket;		// Subscribed to the RTMGRP_* change groups
+	uint32_t m_sequence;
+
+	std::thread m_thread;
+	std::mutex m_mutex;
+	std::vector<NetworkInterfaceAddress> m_interfaces;
+	std::atomic<bool> m_changed;
+	std::atomic<bool> m_running;
+
+	bool Dump(std::vector<NetworkInterfaceAddress>& interfaces);
+	bool DumpRequest(uint16_t type, uint8_t family, std::vector<uint8_t>& response);
+	void Run();
+};
+
+#endif // __linux__
+
+#endif // __NetlinkInterfaceMonitor_h__
@@ -0,0 +1,194 @@
+/*
+ * BACnet Virtual Devices and BBMD Example C++
+ * ----------------------------------------------------------------------------
+ * PacketPool.cpp
+ *
+ * Preallocated packet buffers with a lock-free free list.
+ */
+
+#include "PacketPool.h"
+
+#include <string.h>
+
+#ifdef _WIN32
+#include <winsock2.h>
+#include <windows.h>
+#else
+#include <sys/mman.h>
+#endif // _WIN32
+
+#define PACKET_POOL_HUGE_PAGE_SIZE	(2 * 1024 * 1024)
+
+static uint64_t MakeHead(const uint32_t tag, const uint32_t handle) {
+	return (uint64_t)tag << 32 | handle;
+}
+
+static uint32_t GetHeadHandle(const uint64_t head) {
+	return (uint32_t)head;
+}
+
+static uint32_t GetHeadTag(const uint64_t head) {
+	return (uint32_t)(head >> 32);
+}
+
+CPacketPool::CPacketPool() {
+	this->m_base = NULL;
+	this->m_mappedBytes = 0;
+	this->m_count = 0;
+	this->m_backing = PACKET_POOL_BACKING_NONE;
+	this->m_head = MakeHead(0, PACKET_POOL_NONE);
+	this->m_inUse = 0;
+	this->m_maxInUse = 0;
+	this->m_allocations = 0;
+	this->m_exhausted = 0;
+}
+
+CPacketPool::~CPacketPool() {
+	this->Stop();
+}
+
+bool CPacketPool::Start(const uint32_t count, const bool hugePages) {
+	if (count == 0 || count == PACKET_POOL_NONE || this->m_base != NULL) {
+		return false;
+	}
+	size_t size = (size_t)count * PACKET_POOL_STRIDE;
+	void* base = NULL;
+
+#ifdef _WIN32
+	SIZE_T largePage = GetLargePageMinimum();
+	if (hugePages && largePage != 0) {
+		// Needs the "Lock pages in memory" privilege
+		size_t largeSize = (size + largePage - 1) / largePage * largePage;
+		base = VirtualAlloc(NULL, largeSize, MEM_COMMIT | MEM_RESERVE | MEM_LARGE_PAGES, PAGE_READWRITE);
+		if (base != NULL) {
+			size = largeSize;
+			this->m_backing = PACKET_POOL_BACKING_HUGE_PAGES;
+		}
+	}
+	if (base == NULL) {
+		base = VirtualAlloc(NULL, size, MEM_COMMIT | MEM_RESERVE, PAGE_READWRITE);
+		this->m_backing = PACKET_POOL_BACKING_PAGES;
+	}
+	if (base == NULL) {
+		this->m_backing = PACKET_POOL_BACKING_NONE;
+		return false;
+	}
+#else
+	if (hugePages) {
+		size = (size + PACKET_POOL_HUGE_PAGE_SIZE - 1) / PACKET_POOL_HUGE_PAGE_SIZE * PACKET_POOL_HUGE_PAGE_SIZE;
+#ifdef MAP_HUGETLB
+		base = mmap(NULL, size, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS | MAP_HUGETLB, -1, 0);
+		if (base == MAP_FAILED) {
+			base = NULL;
+		}
+		else {
+			this->m_backing = PACKET_POOL_BACKING_HUGE_PAGES;
+		}
+#endif // MAP_HUGETLB
+	}
+	if (base == NULL) {
+		base = mmap(NULL, size, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+		if (base == MAP_FAILED) {
+			return false;
+		}
+		this->m_backing = PACKET_POOL_BACKING_PAGES;
+#ifdef MADV_HUGEPAGE
+		if (hugePages && madvise(base, size, MADV_HUGEPAGE) == 0) {
+			this->m_backing = PACKET_POOL_BACKING_TRANSPARENT;
+		}
+#endif // MADV_HUGEPAGE
+	}
+#endif // _WIN32
+
+	// Fault the whole mapping in now rather than on the first packets
+	memset(base, 0, size);
+	this->m_base = (uint8_t*)base;
+	this->m_mappedBytes = size;
+	this->m_count = count;
+
+	std::vector<std::atomic<uint32_t> > next(count);
+	this->m_next.swap(next);
+	this->m_head = MakeHead(0, PACKET_POOL_NONE);
+	for (uint32_t handle = count; handle-- > 0;) {
+		this->Push(handle);
+	}
+	this->m_inUse = 0;
+	this->m_maxInUse = 0;
+	this->m_allocations = 0;
+	this->m_exhausted = 0;
+	return true;
+}
+
+void CPacketPool::Stop() {
+	if (this->m_base == NULL) {
+		return;
+	}
+#ifdef _WIN32
+	VirtualFree(this->m_base, 0, MEM_RELEASE);
+#else
+	munmap(this->m_base, this->m_mappedBytes);
+#endif // _WIN32
+	this->m_base = NULL;
+	this->m_mappedBytes = 0;
+	this->m_count = 0;
+	this->m_backing = PACKET_POOL_BACKING_NONE;
+	this->m_head = MakeHead(0, PACKET_POOL_NONE);
+}
+
+uint32_t CPacketPool::Allocate() {
+	uint64_t head = this->m_head.load(std::memory_order_acquire);
+	for (;;) {
+		const uint32_t handle = GetHeadHandle(head);
+		if (handle == PACKET_POOL_NONE) {
+			this->m_exhausted.fetch_add(1, std::memory_order_relaxed);
+			return PACKET_POOL_NONE;
+		}
+		// The next handle can be stale when another thread took the buffer
+		// meanwhile, the tag has changed then and the swap fails
+		const uint32_t next = this->m_next[handle].load(std::memory_order_relaxed);
+		if (this->m_head.compare_exchange_weak(head, MakeHead(GetHeadTag(head) + 1, next), std::memory_order_acquire, std::memory_order_acquire)) {
+			uint32_t inUse = this->m_inUse.fetch_add(1, std::memory_order_relaxed) + 1;
+			uint32_t maxInUse = this->m_maxInUse.load(std::memory_order_relaxed);
+			while (inUse > maxInUse && !this->m_maxInUse.compare_exchange_weak(maxInUse, inUse, std::memory_order_relaxed)) {
+			}
+			this->m_allocations.fetch_add(1, std::memory_order_relaxed);
+			return handle;
+		}
+	}
+}
+
+void CPacketPool::Free(const uint32_t handle) {
+	if (handle >= this->m_count) {
+		return;
+	}
+	this->Push(handle);
+	this->m_inUse.fetch_sub(1, std::memory_order_relaxed);
+}
+
+void CPacketPool::Push(const uint32_t handle) {
+	uint64_t head = this->m_head.load(std::memory_order_relaxed);
+	do {
+		this->m_next[handle].store(GetHeadHandle(head), std::memory_order_relaxed);
+	} while (!this->m_head.compare_exchange_weak(head, MakeHead(GetHeadTag(head), handle), std::memory_order_release, std::memory_order_relaxed));
+}
+
+const char* CPacketPool::GetBackingName(const PacketPoolBacking backing) {
+	switch (backing) {
+	case PACKET_POOL_BACKING_PAGES:
+		return "pages";
+	case PACKET_POOL_BACKING_TRANSPARENT:
+		return "transparent";
+	case PACKET_POOL_BACKING_HUGE_PAGES:
+		return "hugepages";
+	default:
+		return "none";
+	}
+}
+
+void CPacketPool::Report(std::ostream& out) const {
+	out << "{\"count\":" << this->m_count << ",\"stride\":" << PACKET_POOL_STRIDE;
+	out << ",\"backing\":\"" << GetBackingName(this->m_backing) << "\",\"mappedKb\":" << this->m_mappedBytes / 1024;
+	out << ",\"inUse\":" << this->m_inUse.load(std::memory_order_relaxed) << ",\"maxInUse\":" << this->m_maxInUse.load(std::memory_order_relaxed);
+	out << ",\"allocations\":" << this->m_allocations.load(std::memory_order_relaxed) << ",\"exhausted\":" << this->m_exhausted.load(std::memory_order_relaxed);
+	out << "}" << std::endl;
+}
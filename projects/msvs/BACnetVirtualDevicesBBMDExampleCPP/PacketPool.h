@@ -0,0 +1,114 @@
+/*
+ * BACnet Virtual Devices and BBMD Example C++
+ * ----------------------------------------------------------------------------
+ * PacketPool.h
+ *
+ * Fixed number of preallocated packet buffers, addressed by a 32 bit handle.
+ *
+ * A packet is received into a buffer of the pool, classified, queued, handed
+ * to the stack and freed, and it is the handle that moves from one stage to
+ * the next, never the bytes. Nothing is allocated after Start().
+ *
+ * The buffers are one mapping, each buffer starts on a cache line so two
+ * packets never share one. With huge pages the mapping comes from the huge
+ * page pool (MAP_HUGETLB, MEM_LARGE_PAGES), when there are none reserved the
+ * kernel is asked for transparent huge pages instead. The mapping is touched
+ * once by Start() so the first packets do not fault.
+ *
+ * The free list is a lock-free stack. Its head is the handle of the first
+ * free buffer and a tag that counts the pops, swapped with one 64 bit
+ * compare and swap, so a buffer that is popped and pushed back between the
+ * read and the swap of another thread (ABA) can not corrupt it. Allocate()
+ * and Free() can be called from any thread.
+ */
+
+#ifndef __PacketPool_h__
+#define __PacketPool_h__
+
+#include <stdint.h>
+#include <stddef.h>
+#include <atomic>
+#include <ostream>
+#include <vector>
+
+// Constants
+#define PACKET_POOL_MAX_MESSAGE_LENGTH				1500
+#define PACKET_POOL_MAX_CONNECTION_STRING_LENGTH	18		// BACnet/IPv6
+#define PACKET_POOL_DEFAULT_COUNT					1024
+#define PACKET_POOL_CACHE_LINE						64
+#define PACKET_POOL_NONE							0xFFFFFFFF
+
+// A received message, the connection strings it came with, and what the
+// stages of the receive path found out about it
+struct PacketBuffer
+{
+	uint16_t length;
+	uint8_t networkType;
+	uint8_t sourceConnectionStringLength;
+	uint8_t destinationConnectionStringLength;	// 0 when unknown
+	uint8_t ingressClass;						// Set by CIngressScheduler::Enqueue()
+	uint16_t dnet;								// 0 for the local network
+	uint32_t next;								// Handle of the next packet of a queue
+	uint64_t enqueueTicks;						// CLatencyClock
+	uint8_t sourceConnectionString[PACKET_POOL_MAX_CONNECTION_STRING_LENGTH];
+	uint8_t destinationConnectionString[PACKET_POOL_MAX_CONNECTION_STRING_LENGTH];
+	uint8_t buffer[PACKET_POOL_MAX_MESSAGE_LENGTH];
+};
+
+// Distance between two buffers, whole cache lines
+#define PACKET_POOL_STRIDE	((sizeof(PacketBuffer) + PACKET_POOL_CACHE_LINE - 1) / PACKET_POOL_CACHE_LINE * PACKET_POOL_CACHE_LINE)
+
+enum PacketPoolBacking
+{
+	PACKET_POOL_BACKING_NONE,
+	PACKET_POOL_BACKING_PAGES,				// Normal pages
+	PACKET_POOL_BACKING_TRANSPARENT,		// Normal pages, transparent huge pages requested
+	PACKET_POOL_BACKING_HUGE_PAGES			// Reserved huge pages
+};
+
+class CPacketPool
+{
+public:
+	CPacketPool();
+	~CPacketPool();
+
+	// Maps and touches count buffers
+	bool Start(const uint32_t count, const bool hugePages);
+	void Stop();
+	bool IsStarted() const { return this->m_base != NULL; }
+	uint32_t GetCount() const { return this->m_count; }
+
+	// The handle of a free buffer, PACKET_POOL_NONE when every buffer is in
+	// use. The contents of the buffer are left as they were.
+	uint32_t Allocate();
+	void Free(const uint32_t handle);
+	PacketBuffer* Get(const uint32_t handle) const { return (PacketBuffer*)(this->m_base + (size_t)handle * PACKET_POOL_STRIDE); }
+
+	uint32_t GetInUseCount() const { return this->m_inUse.load(std::memory_order_relaxed); }
+	uint32_t GetMaxInUseCount() const { return this->m_maxInUse.load(std::memory_order_relaxed); }
+	uint64_t GetExhaustedCount() const { return this->m_exhausted.load(std::memory_order_relaxed); }
+	PacketPoolBacking GetBacking() const { return this->m_backing; }
+	static const char* GetBackingName(const PacketPoolBacking backing);
+
+	// {"count":...,"stride":...,"backing":"...","mappedKb":...,"inUse":...,"maxInUse":...,"allocations":...,"exhausted":...}
+	void Report(std::ostream& out) const;
+
+private:
+	uint8_t* m_base;
+	size_t m_mappedBytes;
+	uint32_t m_count;
+	PacketPoolBacking m_backing;
+	std::vector<std::atomic<uint32_t> > m_next;		// Next free handle of each free buffer
+
+	// {tag, handle} of the first free buffer, on a cache line of its own
+	alignas(PACKET_POOL_CACHE_LINE) std::atomic<uint64_t> m_head;
+
+	alignas(PACKET_POOL_CACHE_LINE) std::atomic<uint32_t> m_inUse;
+	std::atomic<uint32_t> m_maxInUse;
+	std::atomic<uint64_t> m_allocations;
+	std::atomic<uint64_t> m_exhausted;		// Allocate() calls that found no free buffer
+
+	void Push(const uint32_t handle);
+};
+
+#endif // __PacketPool_h__
@@ -0,0 +1,310 @@
+/*
+ * BACnet Virtual Devices and BBMD Example C++
+ * ----------------------------------------------------------------------------
+ * PointIngestion.cpp
+ *
+ * Shared memory interface that lets other processes publish analog point
+ * values into the example database.
+ */
+
+#include "PointIngestion.h"
+
+#include <algorithm>
+#include <new>
+#include <string.h>
+
+#ifdef _WIN32
+#include <winsock2.h>
+#include <windows.h>
+#else
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif // _WIN32
+
+#ifdef _MSC_VER
+#include <intrin.h>
+#endif // _MSC_VER
+
+static bool ComparePoints(const PointIngestionPointKey& a, const PointIngestionPointKey& b) {
+	if (a.deviceInstance != b.deviceInstance) {
+		return a.deviceInstance < b.deviceInstance;
+	}
+	return a.objectInstance < b.objectInstance;
+}
+
+CPointIngestionSegment::CPointIngestionSegment() {
+	this->m_header = NULL;
+	this->m_points = NULL;
+	this->m_bitmap = NULL;
+	this->m_size = 0;
+#ifdef _WIN32
+	this->m_mapping = NULL;
+#endif // _WIN32
+}
+
+CPointIngestionSegment::~CPointIngestionSegment() {
+	this->Unmap();
+}
+
+bool CPointIngestionSegment::FindPoint(const uint32_t deviceInstance, const uint32_t objectInstance, uint32_t* index) const {
+	if (this->m_header == NULL) {
+		return false;
+	}
+	uint32_t low = 0;
+	uint32_t high = this->m_header->pointCount;
+	while (low < high) {
+		uint32_t middle = low + (high - low) / 2;
+		const PointIngestionPoint& point = this->m_points[middle];
+		if (point.deviceInstance < deviceInstance || (point.deviceInstance == deviceInstance && point.objectInstance < objectInstance)) {
+			low = middle + 1;
+		}
+		else {
+			high = middle;
+		}
+	}
+	if (low < this->m_header->pointCount && this->m_points[low].deviceInstance == deviceInstance && this->m_points[low].objectInstance == objectInstance) {
+		*index = low;
+		return true;
+	}
+	return false;
+}
+
+// Maps the named segment. size is only used when the segment is created,
+// otherwise the size of the existing segment is used.
+bool CPointIngestionSegment::Map(const char* name, const size_t size, const bool create) {
+	this->Unmap();
+
+	void* base = NULL;
+	size_t mappedSize = size;
+#ifdef _WIN32
+	HANDLE mapping;
+	if (create) {
+		mapping = CreateFileMappingA(INVALID_HANDLE_VALUE, NULL, PAGE_READWRITE, (DWORD)((uint64_t)size >> 32), (DWORD)size, name);
+	}
+	else {
+		mapping = OpenFileMappingA(FILE_MAP_ALL_ACCESS, FALSE, name);
+	}
+	if (mapping == NULL) {
+		return false;
+	}
+	base = MapViewOfFile(mapping, FILE_MAP_ALL_ACCESS, 0, 0, 0);
+	if (base == NULL) {
+		CloseHandle(mapping);
+		return false;
+	}
+	if (!create) {
+		MEMORY_BASIC_INFORMATION information;
+		if (VirtualQuery(base, &information, sizeof(information)) == 0) {
+			UnmapViewOfFile(base);
+			CloseHandle(mapping);
+			return false;
+		}
+		mappedSize = (size_t)information.RegionSize;
+	}
+	this->m_mapping = (void*)mapping;
+#else
+	int file;
+	if (create) {
+		// A segment left behind by a server that crashed is replaced
+		shm_unlink(name);
+		file = shm_open(name, O_CREAT | O_EXCL | O_RDWR, 0660);
+		if (file >= 0 && ftruncate(file, (off_t)size) != 0) {
+			close(file);
+			shm_unlink(name);
+			return false;
+		}
+	}
+	else {
+		file = shm_open(name, O_RDWR, 0);
+	}
+	if (file < 0) {
+		return false;
+	}
+	if (!create) {
+		struct stat fileStat;
+		if (fstat(file, &fileStat) != 0) {
+			close(file);
+			return false;
+		}
+		mappedSize = (size_t)fileStat.st_size;
+	}
+	if (mappedSize < sizeof(PointIngestionHeader)) {
+		close(file);
+		return false;
+	}
+	base = mmap(NULL, mappedSize, PROT_READ | PROT_WRITE, MAP_SHARED, file, 0);
+	// The mapping stays valid after the descriptor is closed
+	close(file);
+	if (base == MAP_FAILED) {
+		if (create) {
+			shm_unlink(name);
+		}
+		return false;
+	}
+#endif // _WIN32
+
+	this->m_header = (PointIngestionHeader*)base;
+	this->m_size = mappedSize;
+	this->m_name = name;
+	return true;
+}
+
+void CPointIngestionSegment::Unmap() {
+	if (this->m_header == NULL) {
+		return;
+	}
+#ifdef _WIN32
+	UnmapViewOfFile((void*)this->m_header);
+	CloseHandle((HANDLE)this->m_mapping);
+	this->m_mapping = NULL;
+#else
+	munmap((void*)this->m_header, this->m_size);
+#endif // _WIN32
+	this->m_header = NULL;
+	this->m_points = NULL;
+	this->m_bitmap = NULL;
+	this->m_size = 0;
+}
+
+bool CPointIngestionWriter::Open(const char* name) {
+	if (!this->Map(name, 0, false)) {
+		return false;
+	}
+
+	// Check that the segment was made by a compatible server
+	const PointIngestionHeader* header = this->m_header;
+	if (header->magic != POINT_INGESTION_MAGIC || header->version != POINT_INGESTION_VERSION ||
+		header->pointsOffset + (uint64_t)header->pointCount * sizeof(PointIngestionPoint) > this->m_size ||
+		header->bitmapOffset + (uint64_t)header->bitmapWords * sizeof(uint64_t) > this->m_size) {
+		this->Unmap();
+		return false;
+	}
+	this->m_points = (PointIngestionPoint*)((uint8_t*)this->m_header + header->pointsOffset);
+	this->m_bitmap = (std::atomic<uint64_t>*)((uint8_t*)this->m_header + header->bitmapOffset);
+	return true;
+}
+
+void CPointIngestionWriter::Publish(const uint32_t index, const float value, const uint64_t timestamp) {
+	PointIngestionPoint& point = this->m_points[index];
+	uint32_t bits;
+	memcpy(&bits, &value, sizeof(bits));
+
+	// Seqlock write. The odd sequence number must be visible before the value.
+	uint32_t sequence = point.sequence.load(std::memory_order_relaxed);
+	point.sequence.store(sequence + 1, std::memory_order_relaxed);
+	std::atomic_thread_fence(std::memory_order_release);
+	point.value.store(bits, std::memory_order_relaxed);
+	point.timestamp.store(timestamp, std::memory_order_relaxed);
+	point.sequence.store(sequence + 2, std::memory_order_release);
+
+	// Tell the server. Skip the locked instruction if the bit is already set
+	// and the server has not consumed it yet.
+	std::atomic<uint64_t>& word = this->m_bitmap[index / 64];
+	uint64_t bit = (uint64_t)1 << (index % 64);
+	if ((word.load(std::memory_order_relaxed) & bit) == 0) {
+		word.fetch_or(bit, std::memory_order_release);
+	}
+}
+
+void CPointIngestionWriter::AddPublishCount(const uint64_t count) {
+	this->m_header->publishCount.fetch_add(count, std::memory_order_relaxed);
+}
+
+CPointIngestionServer::~CPointIngestionServer() {
+	this->Close();
+}
+
+bool CPointIngestionServer::Create(const char* name, const std::vector<PointIngestionPointKey>& keys) {
+	this->Close();
+
+	std::vector<PointIngestionPointKey> sorted(keys);
+	std::sort(sorted.begin(), sorted.end(), ComparePoints);
+
+	uint32_t pointCount = (uint32_t)sorted.size();
+	uint32_t bitmapWords = (pointCount + 63) / 64;
+	size_t pointsOffset = (sizeof(PointIngestionHeader) + 63) / 64 * 64;
+	size_t bitmapOffset = pointsOffset + (size_t)pointCount * sizeof(PointIngestionPoint);
+	size_t size = bitmapOffset + (size_t)bitmapWords * sizeof(uint64_t);
+
+	if (!this->Map(name, size, true)) {
+		return false;
+	}
+
+	uint8_t* base = (uint8_t*)this->m_header;
+	memset(base, 0, size);
+	this->m_points = (PointIngestionPoint*)(base + pointsOffset);
+	this->m_bitmap = (std::atomic<uint64_t>*)(base + bitmapOffset);
+
+	for (uint32_t index = 0; index < pointCount; index++) {
+		PointIngestionPoint* point = new (&this->m_points[index]) PointIngestionPoint();
+		point->deviceInstance = sorted[index].deviceInstance;
+		point->objectInstance = sorted[index].objectInstance;
+		point->sequence.store(0, std::memory_order_relaxed);
+		point->value.store(0, std::memory_order_relaxed);
+		point->timestamp.store(0, std::memory_order_relaxed);
+	}
+	for (uint32_t word = 0; word < bitmapWords; word++) {
+		new (&this->m_bitmap[word]) std::atomic<uint64_t>(0);
+	}
+
+	PointIngestionHeader* header = new (base) PointIngestionHeader();
+	header->version = POINT_INGESTION_VERSION;
+	header->pointCount = pointCount;
+	header->bitmapWords = bitmapWords;
+	header->pointsOffset = pointsOffset;
+	header->bitmapOffset = bitmapOffset;
+	header->publishCount.store(0, std::memory_order_relaxed);
+	// Written last so that a writer never sees a half built segment
+	std::atomic_thread_fence(std::memory_order_release);
+	header->magic = POINT_INGESTION_MAGIC;
+	return true;
+}
+
+void CPointIngestionServer::Close() {
+	if (this->m_header == NULL) {
+		return;
+	}
+	this->Unmap();
+#ifndef _WIN32
+	// Windows removes the mapping with its last handle
+	shm_unlink(this->m_name.c_str());
+#endif // _WIN32
+}
+
+// Seqlock read. Fails if the producer kept changing the point.
+bool CPointIngestionServer::Read(const uint32_t index, float* value, uint64_t* timestamp) const {
+	const PointIngestionPoint& point = this->m_points[index];
+	for (int retry = 0; retry < POINT_INGESTION_MAX_RETRIES; retry++) {
+		uint32_t before = point.sequence.load(std::memory_order_acquire);
+		if ((before & 1) != 0) {
+			continue;
+		}
+		uint32_t bits = point.value.load(std::memory_order_relaxed);
+		uint64_t time = point.timestamp.load(std::memory_order_relaxed);
+		std::atomic_thread_fence(std::memory_order_acquire);
+		if (point.sequence.load(std::memory_order_relaxed) == before) {
+			memcpy(value, &bits, sizeof(bits));
+			*timestamp = time;
+			return true;
+		}
+	}
+	return false;
+}
+
+uint32_t CPointIngestionServer::LowestBit(const uint64_t value) {
+#if defined(__GNUC__)
+	return (uint32_t)__builtin_ctzll(value);
+#elif defined(_MSC_VER) && defined(_WIN64)
+	unsigned long index;
+	_BitScanForward64(&index, value);
+	return (uint32_t)index;
+#else
+	uint32_t index = 0;
+	while (((value >> index) & 1) == 0) {
+		index++;
+	}
+	return index;
+#endif
+}
@@ -0,0 +1,166 @@
+/*
+ * BACnet Virtual Devices and BBMD Example C++
+ * ----------------------------------------------------------------------------
+ * PointIngestion.h
+ *
+ * Shared memory interface that lets other processes (field drivers) publish
+ * analog point values into the example database.
+ *
+ * The server creates a named segment that mirrors its analog point table. A
+ * producer opens the segment with CPointIngestionWriter, looks its points up
+ * once and then publishes values with a few atomic stores. No sockets and no
+ * system calls are involved after the segment is mapped.
+ *
+ * Every point is guarded by a sequence counter (seqlock): odd while a
+ * producer is writing it, so the server never applies a torn value. After a
+ * value is written the point's bit is set in the change bitmap. On each
+ * Loop() the server swaps out each non zero bitmap word and reads only the
+ * points that changed, straight from the mapping.
+ *
+ * Any number of producer processes can share a segment, but each point must
+ * have a single producer.
+ *
+ * Layout:
+ *   PointIngestionHeader
+ *   PointIngestionPoint[pointCount]       sorted by (device, object instance)
+ *   std::atomic<uint64_t>[bitmapWords]    change bitmap, one bit per point
+ */
+
+#ifndef __PointIngestion_h__
+#define __PointIngestion_h__
+
+#include <stdint.h>
+#include <stddef.h>
+#include <atomic>
+#include <string>
+#include <vector>
+
+// Constants
+#define POINT_INGESTION_MAGIC		0x50494E47	// "PING"
+#define POINT_INGESTION_VERSION		1
+#define POINT_INGESTION_MAX_RETRIES	8			// Reads of a point that keeps changing, before trying on the next Loop()
+
+class PointIngestionHeader
+{
+public:
+	uint32_t magic;
+	uint32_t version;
+	uint32_t pointCount;
+	uint32_t bitmapWords;
+	uint64_t pointsOffset;
+	uint64_t bitmapOffset;
+	std::atomic<uint64_t> publishCount;	// Values published by all the producers
+};
+
+// One point, alone on its cache line so that producers of neighbouring
+// points do not slow each other down
+class alignas(64) PointIngestionPoint
+{
+public:
+	uint32_t deviceInstance;
+	uint32_t objectInstance;
+	std::atomic<uint32_t> sequence;		// Odd while a producer writes the point
+	std::atomic<uint32_t> value;		// IEEE 754 bits of the present value
+	std::atomic<uint64_t> timestamp;	// Set by the producer, milliseconds since the epoch
+};
+
+class PointIngestionPointKey
+{
+public:
+	uint32_t deviceInstance;
+	uint32_t objectInstance;
+};
+
+// Mapping shared by the server and the writers
+class CPointIngestionSegment
+{
+public:
+	CPointIngestionSegment();
+	~CPointIngestionSegment();
+
+	bool IsOpen() const { return this->m_header != NULL; }
+	uint32_t GetPointCount() const { return this->m_header != NULL ? this->m_header->pointCount : 0; }
+	const PointIngestionPoint& GetPoint(const uint32_t index) const { return this->m_points[index]; }
+	uint64_t GetPublishCount() const { return this->m_header != NULL ? this->m_header->publishCount.load(std::memory_order_relaxed) : 0; }
+
+	// Index of the point, binary search
+	bool FindPoint(const uint32_t deviceInstance, const uint32_t objectInstance, uint32_t* index) const;
+
+protected:
+	PointIngestionHeader* m_header;
+	PointIngestionPoint* m_points;
+	std::atomic<uint64_t>* m_bitmap;
+	size_t m_size;
+	std::string m_name;
+#ifdef _WIN32
+	void* m_mapping;
+#endif // _WIN32
+
+	bool Map(const char* name, const size_t size, const bool create);
+	void Unmap();
+};
+
+// Used by the producers
+class CPointIngestionWriter : public CPointIngestionSegment
+{
+public:
+	bool Open(const char* name);
+	void Close() { this->Unmap(); }
+
+	void Publish(const uint32_t index, const float value, const uint64_t timestamp);
+	// Adds to the publish count of the segment, call once in a while rather
+	// than for every value
+	void AddPublishCount(const uint64_t count);
+};
+
+// Used by the server
+class CPointIngestionServer : public CPointIngestionSegment
+{
+public:
+	~CPointIngestionServer();
+
+	// Creates the segment with one point per key. The keys do not need to be
+	// sorted. Replaces a segment of the same name left behind by a crash.
+	bool Create(const char* name, const std::vector<PointIngestionPointKey>& keys);
+	void Close();
+
+	// Calls apply(const PointIngestionPoint& point, const float value,
+	// const uint64_t timestamp) for every point that changed since the last call. Returns the number of
+	// points applied.
+	template <typename Apply>
+	uint32_t Consume(Apply apply) {
+		if (this->m_header == NULL) {
+			return 0;
+		}
+		uint32_t applied = 0;
+		const uint32_t words = this->m_header->bitmapWords;
+		for (uint32_t word = 0; word < words; word++) {
+			// Most words are zero, skip them without a locked instruction
+			if (this->m_bitmap[word].load(std::memory_order_relaxed) == 0) {
+				continue;
+			}
+			uint64_t changed = this->m_bitmap[word].exchange(0, std::memory_order_acquire);
+			while (changed != 0) {
+				uint32_t bit = LowestBit(changed);
+				changed &= changed - 1;
+				uint32_t index = word * 64 + bit;
+				float value;
+				uint64_t timestamp;
+				if (!this->Read(index, &value, &timestamp)) {
+					// Still being written, pick it up on the next call
+					this->m_bitmap[word].fetch_or((uint64_t)1 << bit, std::memory_order_relaxed);
+					continue;
+				}
+				apply(this->m_points[index], value, timestamp);
+				applied++;
+			}
+		}
+		return applied;
+	}
+
+private:
+	bool Read(const uint32_t index, float* value, uint64_t* timestamp) const;
+	static uint32_t LowestBit(const uint64_t value);
+};
+
+#endif // __PointIngestion_h__
@@ -0,0 +1,236 @@
+/*
+ * BACnet Virtual Devices and BBMD Example C++
+ * ----------------------------------------------------------------------------
+ * RealtimeProfile.cpp
+ *
+ * CPU affinity, SCHED_FIFO and locked memory for the BACnet thread.
+ */
+
+#include "RealtimeProfile.h"
+
+#include <errno.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#ifdef __linux__
+#include <dirent.h>
+#include <malloc.h>
+#include <pthread.h>
+#include <sched.h>
+#include <sys/mman.h>
+#include <sys/syscall.h>
+#include <unistd.h>
+#endif // __linux__
+
+#ifdef __linux__
+static bool ToCpuSet(const std::vector<int>& cpus, cpu_set_t* set) {
+	CPU_ZERO(set);
+	for (size_t i = 0; i < cpus.size(); i++) {
+		if (cpus[i] < 0 || cpus[i] >= CPU_SETSIZE) {
+			return false;
+		}
+		CPU_SET(cpus[i], set);
+	}
+	return true;
+}
+
+// Touches each page of the stack below the caller, so the BACnet thread
+// never faults on a deeper call
+static void PrefaultStack() {
+	volatile uint8_t stack[REALTIME_PROFILE_STACK_PREFAULT];
+	for (size_t offset = 0; offset < sizeof(stack); offset += 4096) {
+		stack[offset] = 0;
+	}
+}
+
+// VmLck of /proc/self/status
+static size_t GetLockedBytes() {
+	FILE* status = fopen("/proc/self/status", "r");
+	if (status == NULL) {
+		return 0;
+	}
+	char line[256];
+	size_t lockedKilobytes = 0;
+	while (fgets(line, sizeof(line), status) != NULL) {
+		if (strncmp(line, "VmLck:", 6) == 0) {
+			lockedKilobytes = (size_t)strtoul(line + 6, NULL, 10);
+			break;
+		}
+	}
+	fclose(status);
+	return lockedKilobytes * 1024;
+}
+#endif // __linux__
+
+CRealtimeProfile::CRealtimeProfile() {
+	this->fifoPriority = 0;
+	this->lockMemory = false;
+	Outcome none = { false, false, 0 };
+	this->m_loopAffinity = none;
+	this->m_helperAffinity = none;
+	this->m_fifo = none;
+	this->m_lock = none;
+	this->m_helperThreads = 0;
+	this->m_lockedBytes = 0;
+}
+
+bool CRealtimeProfile::ParseCpuList(const std::string& text, std::vector<int>& cpus) {
+	cpus.clear();
+	const char* position = text.c_str();
+	while (*position != 0) {
+		char* end;
+		long first = strtol(position, &end, 10);
+		if (end == position || first < 0) {
+			return false;
+		}
+		long last = first;
+		if (*end == '-') {
+			position = end + 1;
+			last = strtol(position, &end, 10);
+			if (end == position || last < first) {
+				return false;
+			}
+		}
+		for (long cpu = first; cpu <= last; cpu++) {
+			cpus.push_back((int)cpu);
+		}
+		if (*end == ',') {
+			end++;
+		}
+		else if (*end != 0) {
+			return false;
+		}
+		position = end;
+	}
+	return !cpus.empty();
+}
+
+bool CRealtimeProfile::Apply(const int processIndex) {
+	this->m_loopAffinity.requested = !this->loopCpus.empty();
+	this->m_helperAffinity.requested = !this->helperCpus.empty();
+	this->m_fifo.requested = this->fifoPriority != 0;
+	this->m_lock.requested = this->lockMemory;
+
+#ifdef __linux__
+	cpu_set_t set;
+	if (this->m_loopAffinity.requested) {
+		this->m_appliedLoopCpus = this->loopCpus;
+		if (processIndex >= 0) {
+			this->m_appliedLoopCpus.assign(1, this->loopCpus[processIndex % this->loopCpus.size()]);
+		}
+		if (!ToCpuSet(this->m_appliedLoopCpus, &set)) {
+			this->m_loopAffinity.error = EINVAL;
+		}
+		else if (sched_setaffinity(0, sizeof(set), &set) != 0) {
+			this->m_loopAffinity.error = errno;
+		}
+		else {
+			this->m_loopAffinity.applied = true;
+		}
+	}
+
+	if (this->m_helperAffinity.requested) {
+		// Every thread of the process but this one
+		DIR* tasks = opendir("/proc/self/task");
+		const pid_t self = (pid_t)syscall(SYS_gettid);
+		if (!ToCpuSet(this->helperCpus, &set)) {
+			this->m_helperAffinity.error = EINVAL;
+		}
+		else if (tasks == NULL) {
+			this->m_helperAffinity.error = errno;
+		}
+		else {
+			this->m_helperAffinity.applied = true;
+			struct dirent* task;
+			while ((task = readdir(tasks)) != NULL) {
+				pid_t thread = (pid_t)strtol(task->d_name, NULL, 10);
+				if (thread <= 0 || thread == self) {
+					continue;
+				}
+				if (sched_setaffinity(thread, sizeof(set), &set) != 0) {
+					this->m_helperAffinity.applied = false;
+					this->m_helperAffinity.error = errno;
+					continue;
+				}
+				this->m_helperThreads++;
+			}
+		}
+		if (tasks != NULL) {
+			closedir(tasks);
+		}
+	}
+
+	if (this->m_fifo.requested) {
+		struct sched_param parameters;
+		memset(&parameters, 0, sizeof(parameters));
+		parameters.sched_priority = this->fifoPriority;
+		int result = pthread_setschedparam(pthread_self(), SCHED_FIFO, &parameters);
+		if (result != 0) {
+			this->m_fifo.error = result;
+		}
+		else {
+			this->m_fifo.applied = true;
+		}
+	}
+
+	if (this->m_lock.requested) {
+		// Freed memory stays in the heap, and large blocks come from the
+		// heap instead of their own mappings, so neither is faulted in again
+		mallopt(M_TRIM_THRESHOLD, -1);
+		mallopt(M_MMAP_MAX, 0);
+		if (mlockall(MCL_CURRENT | MCL_FUTURE) != 0) {
+			this->m_lock.error = errno;
+		}
+		else {
+			this->m_lock.applied = true;
+		}
+		PrefaultStack();
+		this->m_lockedBytes = GetLockedBytes();
+	}
+#else
+	(void)processIndex;
+	Outcome* outcomes[] = { &this->m_loopAffinity, &this->m_helperAffinity, &this->m_fifo, &this->m_lock };
+	for (size_t i = 0; i < sizeof(outcomes) / sizeof(outcomes[0]); i++) {
+		if (outcomes[i]->requested) {
+			outcomes[i]->error = ENOSYS;
+		}
+	}
+#endif // __linux__
+
+	return this->m_loopAffinity.applied == this->m_loopAffinity.requested &&
+		this->m_helperAffinity.applied == this->m_helperAffinity.requested &&
+		this->m_fifo.applied == this->m_fifo.requested &&
+		this->m_lock.applied == this->m_lock.requested;
+}
+
+void CRealtimeProfile::WriteCpuList(std::ostream& out, const std::vector<int>& cpus) {
+	out << "[";
+	for (size_t i = 0; i < cpus.size(); i++) {
+		out << (i > 0 ? "," : "") << cpus[i];
+	}
+	out << "]";
+}
+
+void CRealtimeProfile::WriteOutcome(std::ostream& out, const Outcome& outcome) {
+	out << "\"requested\":" << (outcome.requested ? "true" : "false") << ",\"applied\":" << (outcome.applied ? "true" : "false");
+	if (outcome.error != 0) {
+		out << ",\"error\":\"" << strerror(outcome.error) << "\"";
+	}
+}
+
+void CRealtimeProfile::Report(std::ostream& out) const {
+	out << "{\"realtime\":{\"loopCpus\":{\"cpus\":";
+	WriteCpuList(out, this->m_loopAffinity.applied ? this->m_appliedLoopCpus : this->loopCpus);
+	out << ",";
+	WriteOutcome(out, this->m_loopAffinity);
+	out << "},\"helperCpus\":{\"cpus\":";
+	WriteCpuList(out, this->helperCpus);
+	out << ",\"threads\":" << this->m_helperThreads << ",";
+	WriteOutcome(out, this->m_helperAffinity);
+	out << "},\"schedFifo\":{\"priority\":" << this->fifoPriority << ",";
+	WriteOutcome(out, this->m_fifo);
+	out << "},\"mlock\":{\"lockedKb\":" << this->m_lockedBytes / 1024 << ",\"stackPrefaultKb\":" << (this->m_lock.requested ? REALTIME_PROFILE_STACK_PREFAULT / 1024 : 0) << ",";
+	WriteOutcome(out, this->m_lock);
+	out << "}}}" << std::endl;
+}
@@ -0,0 +1,91 @@
+/*
+ * BACnet Virtual Devices and BBMD Example C++
+ * ----------------------------------------------------------------------------
+ * RealtimeProfile.h
+ *
+ * Keeps the BACnet thread from being migrated, preempted or stalled on a
+ * page fault while it goes around the fpTick() loop.
+ *
+ * Each part of the profile is optional:
+ *   - the BACnet thread is pinned to the loop CPUs
+ *   - every other thread of the process (write backend, metrics listener,
+ *     value cache workers, control plane, stall watchdog) is pinned to the
+ *     helper CPUs. Apply() moves the threads that exist when it is called,
+ *     so it is called once they have all been started.
+ *   - the BACnet thread runs SCHED_FIFO at a priority. A busy FIFO thread
+ *     owns its CPU, so give it one with nothing else to do. The kernel keeps
+ *     5% of each second for the other threads (sched_rt_runtime_us).
+ *   - all the memory is locked with mlockall(). Locking faults in every page
+ *     that is mapped, the database, the packet and the queue buffers, and
+ *     MCL_FUTURE does the same for later allocations. The stack of the
+ *     BACnet thread is prefaulted as well and the heap is never trimmed, so
+ *     a freed page never has to be faulted in again.
+ * The outcome of each setting is reported at startup, a setting that could
+ * not be applied (no permission, a CPU that does not exist) is reported
+ * with its error and the application carries on without it.
+ *
+ * Linux only, elsewhere every setting is reported as not supported.
+ */
+
+#ifndef __RealtimeProfile_h__
+#define __RealtimeProfile_h__
+
+#include <stdint.h>
+#include <stddef.h>
+#include <ostream>
+#include <string>
+#include <vector>
+
+// Constants
+#define REALTIME_PROFILE_DEFAULT_PRIORITY		50
+#define REALTIME_PROFILE_STACK_PREFAULT			(256 * 1024)
+
+class CRealtimeProfile
+{
+public:
+	CRealtimeProfile();
+
+	// "2", "0-3" or "0,2,4-5"
+	static bool ParseCpuList(const std::string& text, std::vector<int>& cpus);
+
+	// Settings, see the options in main()
+	std::vector<int> loopCpus;
+	std::vector<int> helperCpus;
+	int fifoPriority;				// 0 leaves the scheduling policy alone
+	bool lockMemory;
+
+	bool IsEnabled() const { return !this->loopCpus.empty() || !this->helperCpus.empty() || this->fifoPriority != 0 || this->lockMemory; }
+
+	// Applies the profile to the calling thread, the BACnet thread, and to
+	// the other threads of the process. With processIndex >= 0, for the
+	// processes of --shards, the BACnet thread is pinned to one CPU of the
+	// loop CPUs, the (processIndex % count)th, instead of all of them.
+	// Returns false when a setting could not be applied.
+	bool Apply(const int processIndex = -1);
+
+	// {"realtime":{"loopCpus":{...},"helperCpus":{...},"schedFifo":{...},"mlock":{...}}},
+	// each with "requested", "applied" and the "error" of a failed setting
+	void Report(std::ostream& out) const;
+
+private:
+	// Outcome of one setting
+	struct Outcome
+	{
+		bool requested;
+		bool applied;
+		int error;		// errno
+	};
+
+	Outcome m_loopAffinity;
+	Outcome m_helperAffinity;
+	Outcome m_fifo;
+	Outcome m_lock;
+	std::vector<int> m_appliedLoopCpus;
+	uint32_t m_helperThreads;		// Threads moved to the helper CPUs
+	size_t m_lockedBytes;
+
+	static void WriteCpuList(std::ostream& out, const std::vector<int>& cpus);
+	static void WriteOutcome(std::ostream& out, const Outcome& outcome);
+};
+
+#endif // __RealtimeProfile_h__
@@ -0,0 +1,414 @@
+/*
+ * BACnet Virtual Devices and BBMD Example C++
+ * ----------------------------------------------------------------------------
+ * ResponseCache.cpp
+ *
+ * Encoded ReadProperty answers, kept until their object changes.
+ */
+
+#include "ResponseCache.h"
+#include "NPDUHeader.h"
+#include "ExampleConstants.h"
+
+#include <string.h>
+
+// APDU types, the high nibble of the first byte
+#define APDU_TYPE_CONFIRMED_REQUEST			0
+#define APDU_TYPE_SIMPLE_ACK				2
+#define APDU_TYPE_COMPLEX_ACK				3
+#define APDU_TYPE_ERROR						5
+#define APDU_TYPE_REJECT					6
+#define APDU_TYPE_ABORT						7
+#define APDU_SEGMENTED_MESSAGE				0x08
+#define APDU_SEGMENTED_RESPONSE_ACCEPTED	0x02
+
+// Confirmed service choices
+#define SERVICE_READ_PROPERTY				12
+#define SERVICE_READ_PROPERTY_MULTIPLE		14
+
+// Context tags of the ReadProperty request
+#define READ_PROPERTY_TAG_OBJECT_IDENTIFIER	0x0C	// Context 0, 4 bytes
+#define READ_PROPERTY_TAG_PROPERTY			0x18	// Context 1, the length in the low bits
+#define READ_PROPERTY_TAG_ARRAY_INDEX		0x28	// Context 2, the length in the low bits
+
+#define INSTANCE_BITS						22
+#define INSTANCE_MASK						0x3FFFFF
+
+// The unsigned value of a context tag of 1 to 4 bytes at offset
+static bool ParseContextUnsigned(const uint8_t* apdu, const uint16_t length, uint16_t* offset, const uint8_t tag, uint32_t* value) {
+	if (*offset >= length || (apdu[*offset] & 0xF8) != tag) {
+		return false;
+	}
+	const uint8_t valueLength = apdu[*offset] & 0x07;
+	if (valueLength == 0 || valueLength > 4 || *offset + 1 + valueLength > length) {
+		return false;
+	}
+	*value = 0;
+	for (uint8_t i = 0; i < valueLength; i++) {
+		*value = *value << 8 | apdu[*offset + 1 + i];
+	}
+	*offset += 1 + valueLength;
+	return true;
+}
+
+CResponseCache::CResponseCache() {
+	this->m_capacity = 0;
+	this->m_verify = false;
+	this->m_nextPending = 0;
+	this->m_current = NULL;
+	this->m_changeCount = 0;
+	for (size_t i = 0; i < RESPONSE_CACHE_PENDING; i++) {
+		this->m_pending[i].used = false;
+		this->m_pending[i].expected.reserve(RESPONSE_CACHE_MAX_RESPONSE_LENGTH);
+	}
+	this->m_hits = 0;
+	this->m_misses = 0;
+	this->m_learnt = 0;
+	this->m_notCached = 0;
+	this->m_invalidated = 0;
+	this->m_verified = 0;
+	this->m_mismatches = 0;
+}
+
+void CResponseCache::SetCapacity(const size_t maxEntries) {
+	this->m_capacity = maxEntries;
+	this->Clear();
+	this->m_entries.reserve(maxEntries);
+}
+
+void CResponseCache::Clear() {
+	this->m_entries.clear();
+	this->m_objects.clear();
+	for (size_t i = 0; i < RESPONSE_CACHE_PENDING; i++) {
+		this->m_pending[i].used = false;
+	}
+	this->m_current = NULL;
+}
+
+bool CResponseCache::Request(const uint8_t* message, const uint16_t length, const uint8_t* connectionString, const uint8_t connectionStringLength, uint8_t* response, uint16_t* responseLength, const uint16_t maxResponseLength) {
+	if (!this->IsEnabled() || connectionStringLength > RESPONSE_CACHE_MAX_PEER_LENGTH) {
+		return false;
+	}
+	// The stack answers one message at a time
+	this->m_current = NULL;
+	Key key;
+	uint8_t invokeId;
+	uint8_t service;
+	if (!ParseRequest(message, length, &key, &invokeId, &service)) {
+		return false;
+	}
+	if (service != SERVICE_READ_PROPERTY) {
+		if (service != SERVICE_READ_PROPERTY_MULTIPLE) {
+			// The stack may answer differently after it
+			this->RemoveDestination(key);
+		}
+		return false;
+	}
+	if (key.objectType == 0xFFFF) {
+		// A ReadProperty that could not be read
+		return false;
+	}
+
+	EntryMap::iterator it = this->m_entries.find(key);
+	const bool hit = it != this->m_entries.end();
+	if (hit) {
+		this->m_hits++;
+	}
+	else {
+		this->m_misses++;
+	}
+	if (hit && !this->m_verify) {
+		const Entry& entry = it->second;
+		if (entry.response.size() > maxResponseLength) {
+			return false;
+		}
+		memcpy(response, entry.response.data(), entry.response.size());
+		response[entry.invokeIdOffset] = invokeId;
+		*responseLength = (uint16_t)entry.response.size();
+		return true;
+	}
+
+	// The stack answers it, Response() learns or verifies the answer
+	Pending* pending = this->FindPending(invokeId, connectionString, connectionStringLength);
+	if (pending == NULL) {
+		pending = &this->m_pending[this->m_nextPending];
+		this->m_nextPending = (this->m_nextPending + 1) % RESPONSE_CACHE_PENDING;
+	}
+	pending->used = true;
+	pending->learnt = false;
+	pending->invokeId = invokeId;
+	memcpy(pending->peer, connectionString, connectionStringLength);
+	pending->peerLength = connectionStringLength;
+	pending->changeCount = this->m_changeCount;
+	pending->key = key;
+	pending->verifying = hit;
+	if (hit) {
+		const Entry& entry = it->second;
+		pending->expected.assign(entry.response.begin(), entry.response.end());
+		pending->expected[entry.invokeIdOffset] = invokeId;
+	}
+	this->m_current = pending;
+	return false;
+}
+
+void CResponseCache::PropertyRead(const uint32_t deviceInstance, const uint16_t objectType, const uint32_t objectInstance, const uint32_t propertyIdentifier, const bool answered) {
+	Pending* pending = this->m_current;
+	if (pending == NULL || !answered) {
+		return;
+	}
+	if (pending->key.objectType != objectType || pending->key.objectInstance != objectInstance || pending->key.propertyIdentifier != propertyIdentifier) {
+		return;
+	}
+	pending->learnt = true;
+	pending->deviceInstance = deviceInstance;
+	pending->changeCount = this->m_changeCount;
+}
+
+void CResponseCache::Response(const uint8_t* message, const uint16_t length, const uint8_t* connectionString, const uint8_t connectionStringLength) {
+	if (!this->IsEnabled() || message == NULL || length < ExampleConstants::BVLC_HEADER_LENGTH) {
+		return;
+	}
+	if (message[0] != ExampleConstants::BVLC_TYPE_BACNET_IP || message[1] != ExampleConstants::BVLC_FUNCTION_ORIGINAL_UNICAST_NPDU) {
+		return;
+	}
+	NPDUHeader header;
+	if (!ParseNPDUHeader(message, length, &header) || (header.control & ExampleConstants::NPDU_CONTROL_NETWORK_LAYER_MESSAGE)) {
+		return;
+	}
+	if (header.apduOffset + 3 > length) {
+		return;
+	}
+	const uint8_t* apdu = message + header.apduOffset;
+	switch (apdu[0] >> 4) {
+	case APDU_TYPE_SIMPLE_ACK:
+	case APDU_TYPE_COMPLEX_ACK:
+	case APDU_TYPE_ERROR:
+	case APDU_TYPE_REJECT:
+	case APDU_TYPE_ABORT:
+		break;
+	default:
+		return;
+	}
+	Pending* pending = this->FindPending(apdu[1], connectionString, connectionStringLength);
+	if (pending == NULL) {
+		return;
+	}
+	pending->used = false;
+	if (this->m_current == pending) {
+		this->m_current = NULL;
+	}
+	if (pending->changeCount != this->m_changeCount) {
+		// The database changed after the value was read
+		this->m_notCached++;
+		return;
+	}
+
+	if (pending->verifying) {
+		if (length == pending->expected.size() && memcmp(message, pending->expected.data(), length) == 0) {
+			this->m_verified++;
+			return;
+		}
+		this->m_mismatches++;
+		EntryMap::iterator it = this->m_entries.find(pending->key);
+		if (it != this->m_entries.end()) {
+			this->Remove(it);
+		}
+		return;
+	}
+
+	// An unsegmented Complex-ACK whose value came from the database
+	if (apdu[0] != (APDU_TYPE_COMPLEX_ACK << 4) || apdu[2] != SERVICE_READ_PROPERTY || !pending->learnt ||
+		length > RESPONSE_CACHE_MAX_RESPONSE_LENGTH || this->m_entries.size() >= this->m_capacity)
+	{
+		this->m_notCached++;
+		return;
+	}
+	std::pair<EntryMap::iterator, bool> inserted = this->m_entries.insert(std::make_pair(pending->key, Entry()));
+	Entry& entry = inserted.first->second;
+	entry.deviceInstance = pending->deviceInstance;
+	entry.invokeIdOffset = (uint16_t)(header.apduOffset + 1);
+	entry.response.assign(message, message + length);
+	if (inserted.second) {
+		this->m_objects[MakeObjectKey(pending->deviceInstance, pending->key.objectType, pending->key.objectInstance)].push_back(pending->key);
+	}
+	this->m_learnt++;
+}
+
+void CResponseCache::ObjectChanged(const uint32_t deviceInstance, const uint16_t objectType, const uint32_t objectInstance) {
+	this->m_changeCount++;
+	std::unordered_map<uint64_t, std::vector<Key> >::iterator object = this->m_objects.find(MakeObjectKey(deviceInstance, objectType, objectInstance));
+	if (object == this->m_objects.end()) {
+		return;
+	}
+	for (size_t i = 0; i < object->second.size(); i++) {
+		this->m_invalidated += this->m_entries.erase(object->second[i]);
+	}
+	this->m_objects.erase(object);
+}
+
+void CResponseCache::DeviceChanged(const uint32_t deviceInstance) {
+	this->m_changeCount++;
+	std::unordered_map<uint64_t, std::vector<Key> >::iterator object = this->m_objects.begin();
+	while (object != this->m_objects.end()) {
+		if ((uint32_t)(object->first >> 32) != deviceInstance) {
+			++object;
+			continue;
+		}
+		for (size_t i = 0; i < object->second.size(); i++) {
+			this->m_invalidated += this->m_entries.erase(object->second[i]);
+		}
+		object = this->m_objects.erase(object);
+	}
+}
+
+void CResponseCache::DatabaseChanged() {
+	this->m_changeCount++;
+	this->m_invalidated += this->m_entries.size();
+	this->Clear();
+}
+
+void CResponseCache::Report(std::ostream& out) const {
+	const uint64_t requests = this->m_hits + this->m_misses;
+	out << "{\"enabled\":" << (this->IsEnabled() ? "true" : "false") << ",\"verify\":" << (this->m_verify ? "true" : "false");
+	out << ",\"entries\":" << this->m_entries.size() << ",\"hits\":" << this->m_hits << ",\"misses\":" << this->m_misses;
+	out << ",\"hitRate\":" << (requests != 0 ? (double)this->m_hits / requests : 0.0) << ",\"learnt\":" << this->m_learnt;
+	out << ",\"notCached\":" << this->m_notCached << ",\"invalidated\":" << this->m_invalidated;
+	out << ",\"verified\":" << this->m_verified << ",\"mismatches\":" << this->m_mismatches << "}" << std::endl;
+}
+
+// False if it is not a confirmed request in an Original-Unicast-NPDU. The
+// object type of the key is 0xFFFF for a ReadProperty that is not understood.
+bool CResponseCache::ParseRequest(const uint8_t* message, const uint16_t length, Key* key, uint8_t* invokeId, uint8_t* service) {
+	if (message == NULL || length < ExampleConstants::BVLC_HEADER_LENGTH || message[0] != ExampleConstants::BVLC_TYPE_BACNET_IP || message[1] != ExampleConstants::BVLC_FUNCTION_ORIGINAL_UNICAST_NPDU) {
+		return false;
+	}
+	NPDUHeader header;
+	if (!ParseNPDUHeader(message, length, &header) || (header.control & ExampleConstants::NPDU_CONTROL_NETWORK_LAYER_MESSAGE)) {
+		return false;
+	}
+	if (header.destinationAddressLength > RESPONSE_CACHE_MAX_ADDRESS_LENGTH || header.sourceAddressLength > RESPONSE_CACHE_MAX_ADDRESS_LENGTH || header.destinationNetwork == ExampleConstants::NPDU_GLOBAL_BROADCAST) {
+		return false;
+	}
+	memset(key, 0, sizeof(*key));
+	key->priority = header.control & ExampleConstants::NPDU_CONTROL_PRIORITY;
+	key->destinationNetwork = header.destinationNetwork;
+	key->destinationAddressLength = header.destinationAddressLength;
+	memcpy(key->destinationAddress, header.destinationAddress, header.destinationAddressLength);
+	key->sourceNetwork = header.sourceNetwork;
+	key->sourceAddressLength = header.sourceAddressLength;
+	memcpy(key->sourceAddress, header.sourceAddress, header.sourceAddressLength);
+	const uint16_t offset = header.apduOffset;
+
+	// APDU header. A segmented request has the sequence number and window
+	// size before the service choice.
+	if (offset + 4 > length || (message[offset] >> 4) != APDU_TYPE_CONFIRMED_REQUEST) {
+		return false;
+	}
+	const uint8_t* apdu = message + offset;
+	const uint16_t apduLength = length - offset;
+	*invokeId = apdu[2];
+	key->objectType = 0xFFFF;
+	if (apdu[0] & APDU_SEGMENTED_MESSAGE) {
+		if (apduLength < 6) {
+			return false;
+		}
+		*service = apdu[5];
+		return true;
+	}
+	*service = apdu[3];
+	if (*service != SERVICE_READ_PROPERTY) {
+		return true;
+	}
+	key->segmentation = (uint8_t)(apdu[1] | (apdu[0] & APDU_SEGMENTED_RESPONSE_ACCEPTED) << 6);
+
+	// Object identifier, property and the optional array index, nothing after
+	uint16_t serviceOffset = 4;
+	if (serviceOffset + 5 > apduLength || apdu[serviceOffset] != READ_PROPERTY_TAG_OBJECT_IDENTIFIER) {
+		return true;
+	}
+	const uint32_t objectIdentifier = (uint32_t)apdu[serviceOffset + 1] << 24 | (uint32_t)apdu[serviceOffset + 2] << 16 | (uint32_t)apdu[serviceOffset + 3] << 8 | apdu[serviceOffset + 4];
+	serviceOffset += 5;
+	uint32_t propertyIdentifier;
+	if (!ParseContextUnsigned(apdu, apduLength, &serviceOffset, READ_PROPERTY_TAG_PROPERTY, &propertyIdentifier)) {
+		return true;
+	}
+	uint32_t arrayIndex = 0;
+	const bool hasArrayIndex = ParseContextUnsigned(apdu, apduLength, &serviceOffset, READ_PROPERTY_TAG_ARRAY_INDEX, &arrayIndex);
+	if (serviceOffset != apduLength) {
+		return true;
+	}
+	key->objectType = (uint16_t)(objectIdentifier >> INSTANCE_BITS);
+	key->objectInstance = objectIdentifier & INSTANCE_MASK;
+	key->propertyIdentifier = propertyIdentifier;
+	key->hasArrayIndex = hasArrayIndex ? 1 : 0;
+	key->arrayIndex = arrayIndex;
+	return true;
+}
+
+uint64_t CResponseCache::MakeObjectKey(const uint32_t deviceInstance, const uint16_t objectType, const uint32_t objectInstance) {
+	return (uint64_t)deviceInstance << 32 | (uint64_t)objectType << INSTANCE_BITS | objectInstance;
+}
+
+CResponseCache::Pending* CResponseCache::FindPending(const uint8_t invokeId, const uint8_t* peer, const uint8_t peerLength) {
+	for (size_t i = 0; i < RESPONSE_CACHE_PENDING; i++) {
+		Pending& pending = this->m_pending[i];
+		if (pending.used && pending.invokeId == invokeId && pending.peerLength == peerLength && memcmp(pending.peer, peer, peerLength) == 0) {
+			return &pending;
+		}
+	}
+	return NULL;
+}
+
+void CResponseCache::Remove(EntryMap::iterator it) {
+	const Key key = it->first;
+	std::unordered_map<uint64_t, std::vector<Key> >::iterator object = this->m_objects.find(MakeObjectKey(it->second.deviceInstance, key.objectType, key.objectInstance));
+	this->m_entries.erase(it);
+	this->m_invalidated++;
+	if (object == this->m_objects.end()) {
+		return;
+	}
+	std::vector<Key>& keys = object->second;
+	for (size_t i = 0; i < keys.size(); i++) {
+		if (KeyEqual()(keys[i], key)) {
+			keys.erase(keys.begin() + i);
+			break;
+		}
+	}
+	if (keys.empty()) {
+		this->m_objects.erase(object);
+	}
+}
+
+void CResponseCache::RemoveDestination(const Key& key) {
+	EntryMap::iterator it = this->m_entries.begin();
+	while (it != this->m_entries.end()) {
+		const Key& entryKey = it->first;
+		if (entryKey.destinationNetwork != key.destinationNetwork || entryKey.destinationAddressLength != key.destinationAddressLength ||
+			memcmp(entryKey.destinationAddress, key.destinationAddress, key.destinationAddressLength) != 0)
+		{
+			++it;
+			continue;
+		}
+		EntryMap::iterator next = it;
+		++next;
+		this->Remove(it);
+		it = next;
+	}
+}
+
+// FNV-1a over the key 8 bytes at a time, it is cleared before it is filled in
+size_t CResponseCache::KeyHash::operator()(const Key& key) const {
+	static_assert(sizeof(Key) % sizeof(uint64_t) == 0, "Key is hashed in 8 byte words");
+	const uint8_t* bytes = (const uint8_t*)&key;
+	uint64_t hash = 14695981039346656037ull;
+	for (size_t i = 0; i < sizeof(Key); i += sizeof(uint64_t)) {
+		uint64_t word;
+		memcpy(&word, bytes + i, sizeof(word));
+		hash = (hash ^ word) * 1099511628211ull;
+	}
+	return (size_t)(hash ^ hash >> 32);
+}
+
+bool CResponseCache::KeyEqual::operator()(const Key& a, const Key& b) const {
+	return memcmp(&a, &b, sizeof(Key)) == 0;
+}
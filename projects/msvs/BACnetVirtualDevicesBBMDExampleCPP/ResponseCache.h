@@ -0,0 +1,170 @@
+/*
+ * BACnet Virtual Devices and BBMD Example C++
+ * ----------------------------------------------------------------------------
+ * ResponseCache.h
+ *
+ * Answers the ReadProperty requests that were answered before, with the
+ * Complex-ACK the stack sent then, before they reach the stack.
+ *
+ * Supervisors poll the same present values every few seconds from several
+ * clients, and each poll is decoded, answered through the property
+ * callbacks and encoded again by the stack. The cache keeps the encoded
+ * answer under the request with its invoke ID left out: the networks and MAC
+ * addresses of its NPDU, the segmentation and maximum APDU it accepts, and
+ * the object, property and array index it reads. A hit is answered with the
+ * invoke ID of the new request, to the address it came from.
+ *
+ * An answer is learnt from the stack:
+ *   - Request() sees a ReadProperty that is not in the cache and remembers it.
+ *   - PropertyRead() is called by the property callbacks. The property has to
+ *     be answered from the database, which gives the device instance of the
+ *     object. Properties the stack answers itself are never cached.
+ *   - Response() sees the Complex-ACK to it and keeps it.
+ *
+ * Entries are dropped by the database, as a change listener, when the value
+ * of their object changes, and when their device is removed. Any other
+ * confirmed request (WriteProperty, ...) drops the entries of the device it
+ * is sent to, the stack may change what it answers.
+ *
+ * Only BACnet/IP Original-Unicast-NPDU requests and unsegmented answers of at
+ * most RESPONSE_CACHE_MAX_RESPONSE_LENGTH bytes are cached.
+ *
+ * With SetVerify() the hits are not answered but passed to the stack, and its
+ * answer is compared with the cached one.
+ *
+ * Called from the BACnet thread only.
+ */
+
+#ifndef __ResponseCache_h__
+#define __ResponseCache_h__
+
+#include <stdint.h>
+#include <stddef.h>
+#include <ostream>
+#include <unordered_map>
+#include <vector>
+
+#include "ExampleDatabase.h"
+
+// Constants
+#define RESPONSE_CACHE_MAX_ADDRESS_LENGTH		8
+#define RESPONSE_CACHE_MAX_RESPONSE_LENGTH		512
+#define RESPONSE_CACHE_MAX_PEER_LENGTH			18
+#define RESPONSE_CACHE_PENDING					16		// Requests on their way through the stack
+
+class CResponseCache : public ExampleDatabaseChangeListener
+{
+public:
+	CResponseCache();
+
+	// At most maxEntries answers are kept, 0 disables the cache
+	void SetCapacity(const size_t maxEntries);
+	bool IsEnabled() const { return this->m_capacity != 0; }
+	void SetVerify(const bool verify) { this->m_verify = verify; }
+
+	// A received message. True when it was answered from the cache, the
+	// answer is then in response and the message is not for the stack.
+	bool Request(const uint8_t* message, const uint16_t length, const uint8_t* connectionString, const uint8_t connectionStringLength, uint8_t* response, uint16_t* responseLength, const uint16_t maxResponseLength);
+
+	// From the property callbacks, for the request the stack is answering
+	void PropertyRead(const uint32_t deviceInstance, const uint16_t objectType, const uint32_t objectInstance, const uint32_t propertyIdentifier, const bool answered);
+
+	// A message sent by the stack
+	void Response(const uint8_t* message, const uint16_t length, const uint8_t* connectionString, const uint8_t connectionStringLength);
+
+	// ExampleDatabaseChangeListener
+	virtual void ObjectChanged(const uint32_t deviceInstance, const uint16_t objectType, const uint32_t objectInstance);
+	virtual void DeviceChanged(const uint32_t deviceInstance);
+	virtual void DatabaseChanged();
+
+	void Clear();
+	size_t GetSize() const { return this->m_entries.size(); }
+	uint64_t GetHits() const { return this->m_hits; }
+	uint64_t GetMisses() const { return this->m_misses; }
+	uint64_t GetMismatches() const { return this->m_mismatches; }
+
+	// {"enabled":...,"verify":...,"entries":...,"hits":...,"misses":...,"hitRate":...,
+	//  "learnt":...,"notCached":...,"invalidated":...,"verified":...,"mismatches":...}
+	void Report(std::ostream& out) const;
+
+private:
+	// The request, without its invoke ID. Compared as bytes, so it is
+	// cleared before it is filled in.
+	struct Key
+	{
+		uint16_t destinationNetwork;	// DNET of the device, 0 when there is none
+		uint16_t sourceNetwork;			// SNET of the client, 0 when there is none
+		uint8_t destinationAddress[RESPONSE_CACHE_MAX_ADDRESS_LENGTH];
+		uint8_t sourceAddress[RESPONSE_CACHE_MAX_ADDRESS_LENGTH];
+		uint8_t destinationAddressLength;
+		uint8_t sourceAddressLength;
+		uint8_t priority;				// NPDU network priority
+		uint8_t segmentation;			// Segmented-Response-Accepted, max segments and max APDU
+		uint16_t objectType;
+		uint16_t hasArrayIndex;
+		uint32_t objectInstance;
+		uint32_t propertyIdentifier;
+		uint32_t arrayIndex;
+	};
+
+	class KeyHash
+	{
+	public:
+		size_t operator()(const Key& key) const;
+	};
+	class KeyEqual
+	{
+	public:
+		bool operator()(const Key& a, const Key& b) const;
+	};
+
+	struct Entry
+	{
+		uint32_t deviceInstance;
+		uint16_t invokeIdOffset;
+		std::vector<uint8_t> response;
+	};
+
+	struct Pending
+	{
+		bool used;
+		bool verifying;					// Its cached answer is in expected
+		bool learnt;					// A callback answered it from the database
+		uint8_t invokeId;
+		uint8_t peer[RESPONSE_CACHE_MAX_PEER_LENGTH];
+		uint8_t peerLength;
+		uint32_t deviceInstance;
+		uint64_t changeCount;			// m_changeCount when the callback answered
+		Key key;
+		std::vector<uint8_t> expected;
+	};
+
+	typedef std::unordered_map<Key, Entry, KeyHash, KeyEqual> EntryMap;
+
+	size_t m_capacity;
+	bool m_verify;
+	EntryMap m_entries;
+	// The keys of the entries of each object, see MakeObjectKey()
+	std::unordered_map<uint64_t, std::vector<Key> > m_objects;
+
+	Pending m_pending[RESPONSE_CACHE_PENDING];
+	size_t m_nextPending;
+	Pending* m_current;				// The request the stack is answering
+	uint64_t m_changeCount;			// Changes told by the database
+
+	uint64_t m_hits;
+	uint64_t m_misses;
+	uint64_t m_learnt;
+	uint64_t m_notCached;			// Answered by the stack itself, segmented, too long, full, ...
+	uint64_t m_invalidated;
+	uint64_t m_verified;
+	uint64_t m_mismatches;
+
+	static bool ParseRequest(const uint8_t* message, const uint16_t length, Key* key, uint8_t* invokeId, uint8_t* service);
+	static uint64_t MakeObjectKey(const uint32_t deviceInstance, const uint16_t objectType, const uint32_t objectInstance);
+	Pending* FindPending(const uint8_t invokeId, const uint8_t* peer, const uint8_t peerLength);
+	void Remove(EntryMap::iterator it);
+	void RemoveDestination(const Key& key);
+};
+
+#endif // __ResponseCache_h__
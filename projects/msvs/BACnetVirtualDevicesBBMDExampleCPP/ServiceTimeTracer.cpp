@@ -0,0 +1,264 @@
+/*
+ * BACnet Virtual Devices and BBMD Example C++
+ * ----------------------------------------------------------------------------
+ * ServiceTimeTracer.cpp
+ *
+ * Confirmed request to answer times, matched by invoke ID.
+ */
+
+#include "ServiceTimeTracer.h"
+#include "NPDUHeader.h"
+#include "ExampleConstants.h"
+
+#include <string.h>
+
+// APDU types, the high nibble of the first byte
+#define APDU_TYPE_CONFIRMED_REQUEST			0
+#define APDU_TYPE_SIMPLE_ACK				2
+#define APDU_TYPE_COMPLEX_ACK				3
+#define APDU_TYPE_ERROR						5
+#define APDU_TYPE_REJECT					6
+#define APDU_TYPE_ABORT						7
+#define APDU_SEGMENTED_MESSAGE				0x08
+
+// Confirmed service choices
+#define SERVICE_READ_PROPERTY				12
+#define SERVICE_READ_PROPERTY_MULTIPLE		14
+#define SERVICE_WRITE_PROPERTY				15
+#define SERVICE_WRITE_PROPERTY_MULTIPLE		16
+
+static const char* SERVICE_TIME_SERVICE_NAMES[SERVICE_TIME_COUNT] = {
+	"readProperty", "readPropertyMultiple", "writeProperty", "writePropertyMultiple", "other"
+};
+
+static const char* SERVICE_TIME_OUTCOME_NAMES[SERVICE_TIME_OUTCOME_COUNT] = {
+	"ack", "error", "reject", "abort"
+};
+
+CServiceTimeTracer::CServiceTimeTracer() {
+	memset(this->m_slots, 0, sizeof(this->m_slots));
+	this->m_pendingCount = 0;
+	this->m_networkCount = 0;
+	for (uint32_t i = 0; i <= SERVICE_TIME_TRACER_MAX_NETWORKS; i++) {
+		this->m_networks[i].dnet = 0;
+	}
+	this->Clear();
+}
+
+void CServiceTimeTracer::Clear() {
+	this->m_unmatched = 0;
+	this->m_replaced = 0;
+	this->m_expired = 0;
+	for (int i = 0; i < SERVICE_TIME_COUNT; i++) {
+		this->m_services[i].Clear();
+		for (int outcome = 0; outcome < SERVICE_TIME_OUTCOME_COUNT; outcome++) {
+			this->m_outcomes[i][outcome] = 0;
+		}
+	}
+	for (uint32_t i = 0; i <= SERVICE_TIME_TRACER_MAX_NETWORKS; i++) {
+		this->m_networks[i].time.Clear();
+	}
+}
+
+void CServiceTimeTracer::Request(const uint8_t* message, const uint16_t length, const uint8_t* connectionString, const uint8_t connectionStringLength) {
+	NPDUHeader header;
+	if (!ParseNPDUHeader(message, length, &header) || (header.control & ExampleConstants::NPDU_CONTROL_NETWORK_LAYER_MESSAGE)) {
+		return;
+	}
+	const uint8_t* apdu = message + header.apduOffset;
+	const uint16_t apduLength = length - header.apduOffset;
+	if (apduLength < 4 || (apdu[0] >> 4) != APDU_TYPE_CONFIRMED_REQUEST) {
+		return;
+	}
+	// Segmented requests have the sequence number and window size before
+	// the service choice
+	const uint16_t serviceOffset = (apdu[0] & APDU_SEGMENTED_MESSAGE) ? 5 : 3;
+	if (apduLength <= serviceOffset) {
+		return;
+	}
+	ServiceTimeService service;
+	switch (apdu[serviceOffset]) {
+	case SERVICE_READ_PROPERTY:
+		service = SERVICE_TIME_READ_PROPERTY;
+		break;
+	case SERVICE_READ_PROPERTY_MULTIPLE:
+		service = SERVICE_TIME_READ_PROPERTY_MULTIPLE;
+		break;
+	case SERVICE_WRITE_PROPERTY:
+		service = SERVICE_TIME_WRITE_PROPERTY;
+		break;
+	case SERVICE_WRITE_PROPERTY_MULTIPLE:
+		service = SERVICE_TIME_WRITE_PROPERTY_MULTIPLE;
+		break;
+	default:
+		service = SERVICE_TIME_OTHER;
+		break;
+	}
+
+	// The client is the source of the request, the server its destination
+	const uint8_t* peer = header.peer != NULL ? header.peer : connectionString;
+	const uint8_t peerLength = header.peer != NULL ? header.peerLength : connectionStringLength;
+	const uint64_t key = HashKey(peer, peerLength, header.sourceNetwork, header.sourceAddress, header.sourceAddressLength, header.destinationNetwork, header.destinationAddress, header.destinationAddressLength, apdu[2]);
+
+	// A free slot, else a request that timed out, else the oldest request
+	const uint64_t now = CLatencyClock::Now();
+	const uint64_t timeoutTicks = (uint64_t)(SERVICE_TIME_TRACER_TIMEOUT_MILLISECONDS * 1e6 * CLatencyClock::TicksPerNanosecond());
+	const uint32_t first = (uint32_t)key & (SERVICE_TIME_TRACER_SLOTS - 1);
+	Slot* target = NULL;
+	for (uint32_t probe = 0; probe < SERVICE_TIME_TRACER_PROBE; probe++) {
+		Slot& slot = this->m_slots[(first + probe) & (SERVICE_TIME_TRACER_SLOTS - 1)];
+		if (slot.key == key) {
+			// A retry of a request that is still being answered, keep the
+			// time of the first one
+			return;
+		}
+		if (slot.key == 0) {
+			if (target == NULL || target->key != 0) {
+				target = &slot;
+			}
+		}
+		else if (target == NULL || (target->key != 0 && slot.startTicks < target->startTicks)) {
+			target = &slot;
+		}
+	}
+	if (target->key == 0) {
+		this->m_pendingCount++;
+	}
+	else if (now - target->startTicks > timeoutTicks) {
+		this->m_expired++;
+	}
+	else {
+		this->m_replaced++;
+	}
+	target->key = key;
+	target->startTicks = now;
+	target->service = (uint8_t)service;
+	target->network = this->GetNetworkIndex(header.destinationNetwork);
+}
+
+void CServiceTimeTracer::Response(const uint8_t* message, const uint16_t length, const uint8_t* connectionString, const uint8_t connectionStringLength) {
+	NPDUHeader header;
+	if (!ParseNPDUHeader(message, length, &header) || (header.control & ExampleConstants::NPDU_CONTROL_NETWORK_LAYER_MESSAGE)) {
+		return;
+	}
+	const uint8_t* apdu = message + header.apduOffset;
+	if (length - header.apduOffset < 2) {
+		return;
+	}
+	ServiceTimeOutcome outcome;
+	switch (apdu[0] >> 4) {
+	case APDU_TYPE_SIMPLE_ACK:
+		outcome = SERVICE_TIME_ACK;
+		break;
+	case APDU_TYPE_COMPLEX_ACK:
+		if ((apdu[0] & APDU_SEGMENTED_MESSAGE) && length - header.apduOffset >= 3 && apdu[2] != 0) {
+			// Not the first segment
+			return;
+		}
+		outcome = SERVICE_TIME_ACK;
+		break;
+	case APDU_TYPE_ERROR:
+		outcome = SERVICE_TIME_ERROR;
+		break;
+	case APDU_TYPE_REJECT:
+		outcome = SERVICE_TIME_REJECT;
+		break;
+	case APDU_TYPE_ABORT:
+		outcome = SERVICE_TIME_ABORT;
+		break;
+	default:
+		return;
+	}
+
+	// The server is the source of the answer, the client its destination
+	const uint64_t key = HashKey(connectionString, connectionStringLength, header.destinationNetwork, header.destinationAddress, header.destinationAddressLength, header.sourceNetwork, header.sourceAddress, header.sourceAddressLength, apdu[1]);
+	const uint32_t first = (uint32_t)key & (SERVICE_TIME_TRACER_SLOTS - 1);
+	for (uint32_t probe = 0; probe < SERVICE_TIME_TRACER_PROBE; probe++) {
+		Slot& slot = this->m_slots[(first + probe) & (SERVICE_TIME_TRACER_SLOTS - 1)];
+		if (slot.key != key) {
+			continue;
+		}
+		const uint64_t ticks = CLatencyClock::Now() - slot.startTicks;
+		this->m_services[slot.service].Record(ticks);
+		this->m_outcomes[slot.service][outcome]++;
+		this->m_networks[slot.network].time.Record(ticks);
+		slot.key = 0;
+		this->m_pendingCount--;
+		return;
+	}
+	this->m_unmatched++;
+}
+
+uint64_t CServiceTimeTracer::HashKey(const uint8_t* peer, const uint8_t peerLength, const uint16_t clientNetwork, const uint8_t* clientAddress, const uint8_t clientAddressLength, const uint16_t serverNetwork, const uint8_t* serverAddress, const uint8_t serverAddressLength, const uint8_t invokeId) {
+	// FNV-1a
+	uint64_t hash = 14695981039346656037ull;
+	for (uint8_t i = 0; i < peerLength; i++) {
+		hash = (hash ^ peer[i]) * 1099511628211ull;
+	}
+	hash = (hash ^ clientNetwork) * 1099511628211ull;
+	for (uint8_t i = 0; i < clientAddressLength; i++) {
+		hash = (hash ^ clientAddress[i]) * 1099511628211ull;
+	}
+	hash = (hash ^ serverNetwork) * 1099511628211ull;
+	for (uint8_t i = 0; i < serverAddressLength; i++) {
+		hash = (hash ^ serverAddress[i]) * 1099511628211ull;
+	}
+	hash = (hash ^ invokeId) * 1099511628211ull;
+	return hash != 0 ? hash : 1;
+}
+
+uint8_t CServiceTimeTracer::GetNetworkIndex(const uint16_t dnet) {
+	for (uint32_t i = 0; i < this->m_networkCount; i++) {
+		if (this->m_networks[i].dnet == dnet) {
+			return (uint8_t)i;
+		}
+	}
+	if (this->m_networkCount == SERVICE_TIME_TRACER_MAX_NETWORKS) {
+		return SERVICE_TIME_TRACER_MAX_NETWORKS;
+	}
+	this->m_networks[this->m_networkCount].dnet = dnet;
+	return (uint8_t)this->m_networkCount++;
+}
+
+const char* CServiceTimeTracer::GetServiceName(const ServiceTimeService service) {
+	return service < SERVICE_TIME_COUNT ? SERVICE_TIME_SERVICE_NAMES[service] : "none";
+}
+
+void CServiceTimeTracer::Report(std::ostream& out) const {
+	out << "{\"pending\":" << this->m_pendingCount << ",\"unmatched\":" << this->m_unmatched;
+	out << ",\"replaced\":" << this->m_replaced << ",\"expired\":" << this->m_expired << ",\"services\":[";
+	bool first = true;
+	for (int i = 0; i < SERVICE_TIME_COUNT; i++) {
+		if (this->m_services[i].GetCount() == 0) {
+			continue;
+		}
+		out << (first ? "" : ",");
+		first = false;
+		out << "{\"service\":\"" << SERVICE_TIME_SERVICE_NAMES[i] << "\",\"time\":";
+		this->m_services[i].Report(out, "serviceTime");
+		for (int outcome = 0; outcome < SERVICE_TIME_OUTCOME_COUNT; outcome++) {
+			out << ",\"" << SERVICE_TIME_OUTCOME_NAMES[outcome] << "\":" << this->m_outcomes[i][outcome];
+		}
+		out << "}";
+	}
+	out << "],\"networks\":[";
+	first = true;
+	for (uint32_t i = 0; i <= SERVICE_TIME_TRACER_MAX_NETWORKS; i++) {
+		if (this->m_networks[i].time.GetCount() == 0) {
+			continue;
+		}
+		out << (first ? "" : ",");
+		first = false;
+		out << "{\"dnet\":";
+		if (i == SERVICE_TIME_TRACER_MAX_NETWORKS) {
+			out << "\"other\"";
+		}
+		else {
+			out << this->m_networks[i].dnet;
+		}
+		out << ",\"time\":";
+		this->m_networks[i].time.Report(out, "serviceTime");
+		out << "}";
+	}
+	out << "]}" << std::endl;
+}
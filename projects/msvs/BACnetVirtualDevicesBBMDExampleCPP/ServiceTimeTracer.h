@@ -0,0 +1,113 @@
+/*
+ * BACnet Virtual Devices and BBMD Example C++
+ * ----------------------------------------------------------------------------
+ * ServiceTimeTracer.h
+ *
+ * Time from a confirmed request arriving to its answer leaving, by service
+ * and by the virtual network (DNET) of the device that answered it.
+ *
+ * Only the BVLC, NPDU and the first bytes of the APDU are read, the message
+ * is never decoded:
+ *   - Request() is called with each received message. A confirmed request
+ *     is put in a table under its peer, the networks and MAC addresses of
+ *     its NPDU and its invoke ID, with the time it arrived.
+ *   - Response() is called with each message the stack sends. A Simple-ACK,
+ *     Complex-ACK, Error, Reject or Abort is looked up under its destination
+ *     and the same fields, the source and destination swapped, and the time
+ *     since the request goes into the histograms.
+ *
+ * The table has a fixed number of slots. A request can go in any of the 16
+ * slots after the hash of its key. When they are all taken the oldest one is
+ * replaced, and a request that was never answered within the APDU timeout
+ * is dropped when its slot is needed. Segmented answers are timed to their
+ * first segment.
+ *
+ * Called from the BACnet thread only.
+ */
+
+#ifndef __ServiceTimeTracer_h__
+#define __ServiceTimeTracer_h__
+
+#include <stdint.h>
+#include <ostream>
+#include "LatencyHistogram.h"
+
+// Constants
+#define SERVICE_TIME_TRACER_SLOTS					1024	// Power of two
+#define SERVICE_TIME_TRACER_PROBE					16
+#define SERVICE_TIME_TRACER_MAX_NETWORKS			48		// Networks past these are counted together
+#define SERVICE_TIME_TRACER_TIMEOUT_MILLISECONDS	10000	// Requests older than this were not answered
+
+enum ServiceTimeService
+{
+	SERVICE_TIME_READ_PROPERTY,
+	SERVICE_TIME_READ_PROPERTY_MULTIPLE,
+	SERVICE_TIME_WRITE_PROPERTY,
+	SERVICE_TIME_WRITE_PROPERTY_MULTIPLE,
+	SERVICE_TIME_OTHER,
+	SERVICE_TIME_COUNT
+};
+
+enum ServiceTimeOutcome
+{
+	SERVICE_TIME_ACK,		// Simple-ACK or Complex-ACK
+	SERVICE_TIME_ERROR,
+	SERVICE_TIME_REJECT,
+	SERVICE_TIME_ABORT,
+	SERVICE_TIME_OUTCOME_COUNT
+};
+
+class CServiceTimeTracer
+{
+public:
+	CServiceTimeTracer();
+
+	// The connection string is the peer, the source of a request and the
+	// destination of a response
+	void Request(const uint8_t* message, const uint16_t length, const uint8_t* connectionString, const uint8_t connectionStringLength);
+	void Response(const uint8_t* message, const uint16_t length, const uint8_t* connectionString, const uint8_t connectionStringLength);
+
+	uint32_t GetPendingCount() const { return this->m_pendingCount; }
+	void Clear();
+
+	// {"pending":...,"unmatched":...,"replaced":...,"expired":...,
+	//  "services":[{"service":"readProperty","time":{...},"ack":...,"error":...,"reject":...,"abort":...},...],
+	//  "networks":[{"dnet":1000,"time":{...}},...]}, the services and networks
+	// that have been answered
+	void Report(std::ostream& out) const;
+
+	static const char* GetServiceName(const ServiceTimeService service);
+
+private:
+	struct Slot
+	{
+		uint64_t key;			// 0 when free
+		uint64_t startTicks;	// CLatencyClock
+		uint8_t service;
+		uint8_t network;		// Index into m_networks
+	};
+
+	struct Network
+	{
+		uint16_t dnet;
+		CLatencyHistogram time;
+	};
+
+	Slot m_slots[SERVICE_TIME_TRACER_SLOTS];
+	uint32_t m_pendingCount;
+	uint64_t m_unmatched;		// Answers with no request in the table
+	uint64_t m_replaced;		// Requests pushed out by a newer one
+	uint64_t m_expired;			// Requests never answered
+
+	CLatencyHistogram m_services[SERVICE_TIME_COUNT];
+	uint64_t m_outcomes[SERVICE_TIME_COUNT][SERVICE_TIME_OUTCOME_COUNT];
+
+	// The last one collects the networks that did not fit
+	Network m_networks[SERVICE_TIME_TRACER_MAX_NETWORKS + 1];
+	uint32_t m_networkCount;
+
+	static uint64_t HashKey(const uint8_t* peer, const uint8_t peerLength, const uint16_t clientNetwork, const uint8_t* clientAddress, const uint8_t clientAddressLength, const uint16_t serverNetwork, const uint8_t* serverAddress, const uint8_t serverAddressLength, const uint8_t invokeId);
+	uint8_t GetNetworkIndex(const uint16_t dnet);
+};
+
+#endif // __ServiceTimeTracer_h__
@@ -0,0 +1,303 @@
+/*
+ * BACnet Virtual Devices and BBMD Example C++
+ * ----------------------------------------------------------------------------
+ * ShardRouter.cpp
+ *
+ * Front end and workers of the sharded virtual networks.
+ */
+
+#include "ShardRouter.h"
+#include "ExampleDatabase.h"
+#include "ExampleConstants.h"
+#include "NPDUHeader.h"
+
+#include <string.h>
+
+#ifndef _WIN32
+#include <errno.h>
+#include <signal.h>
+#include <sys/socket.h>
+#include <sys/types.h>
+#include <sys/uio.h>
+#include <sys/wait.h>
+#include <unistd.h>
+#ifdef __linux__
+#include <sys/prctl.h>
+#endif // __linux__
+#endif // _WIN32
+
+CShardWorker::CShardWorker() {
+	this->m_socket = -1;
+	this->m_index = 0;
+}
+
+CShardWorker::~CShardWorker() {
+	this->Close();
+}
+
+void CShardWorker::Close() {
+#ifndef _WIN32
+	if (this->m_socket >= 0) {
+		close(this->m_socket);
+	}
+#endif // _WIN32
+	this->m_socket = -1;
+}
+
+int CShardWorker::Receive(uint8_t* message, const uint16_t maxMessageLength, ShardMessageHeader* header) {
+#ifndef _WIN32
+	struct iovec parts[2];
+	parts[0].iov_base = header;
+	parts[0].iov_len = sizeof(*header);
+	parts[1].iov_base = message;
+	parts[1].iov_len = maxMessageLength;
+	struct msghdr datagram;
+	memset(&datagram, 0, sizeof(datagram));
+	datagram.msg_iov = parts;
+	datagram.msg_iovlen = 2;
+
+	ssize_t length = recvmsg(this->m_socket, &datagram, MSG_DONTWAIT);
+	if (length < 0) {
+		return errno == EAGAIN || errno == EWOULDBLOCK ? 0 : -1;
+	}
+	if ((size_t)length <= sizeof(*header) || (datagram.msg_flags & MSG_TRUNC) != 0) {
+		return 0;
+	}
+	return (int)(length - sizeof(*header));
+#else
+	return -1;
+#endif // _WIN32
+}
+
+bool CShardWorker::Send(const uint8_t* message, const uint16_t messageLength, const ShardMessageHeader& header) {
+#ifndef _WIN32
+	struct iovec parts[2];
+	parts[0].iov_base = (void*)&header;
+	parts[0].iov_len = sizeof(header);
+	parts[1].iov_base = (void*)message;
+	parts[1].iov_len = messageLength;
+	struct msghdr datagram;
+	memset(&datagram, 0, sizeof(datagram));
+	datagram.msg_iov = parts;
+	datagram.msg_iovlen = 2;
+
+	// Blocks while the front end is behind, the stack waits for it like it
+	// would for a full UDP socket
+	return sendmsg(this->m_socket, &datagram, 0) == (ssize_t)(sizeof(header) + messageLength);
+#else
+	return false;
+#endif // _WIN32
+}
+
+CShardFrontEnd::CShardFrontEnd() {
+	this->m_nextWorker = 0;
+	this->m_localCount = 0;
+	this->m_filteredCount = 0;
+}
+
+CShardFrontEnd::~CShardFrontEnd() {
+	this->Stop();
+}
+
+uint32_t CShardFrontEnd::GetShard(const uint16_t network, const uint32_t workerCount) {
+	return ((uint32_t)network / VIRTUAL_NETWORK_OFFSET) % workerCount;
+}
+
+int CShardFrontEnd::Route(const uint8_t* message, const uint16_t length, const uint32_t workerCount) {
+	NPDUHeader header;
+	if (message == NULL || length == 0 || message[0] != ExampleConstants::BVLC_TYPE_BACNET_IP || !ParseNPDUHeader(message, length, &header)) {
+		return SHARD_ROUTE_LOCAL;
+	}
+	if ((header.control & ExampleConstants::NPDU_CONTROL_DESTINATION) == 0) {
+		// Who-Is-Router-To-Network and the other network layer messages are
+		// answered by each router, the virtual networks of every worker
+		return header.broadcast || (header.control & ExampleConstants::NPDU_CONTROL_NETWORK_LAYER_MESSAGE) != 0 ? SHARD_ROUTE_ALL : SHARD_ROUTE_LOCAL;
+	}
+	if (header.destinationNetwork == ExampleConstants::NPDU_GLOBAL_BROADCAST) {
+		return SHARD_ROUTE_ALL;
+	}
+	return (int)GetShard(header.destinationNetwork, workerCount);
+}
+
+bool CShardFrontEnd::IsRoutedMessage(const uint8_t* message, const uint16_t length) {
+	NPDUHeader header;
+	if (message == NULL || length == 0 || message[0] != ExampleConstants::BVLC_TYPE_BACNET_IP || !ParseNPDUHeader(message, length, &header)) {
+		return false;
+	}
+	return (header.control & (ExampleConstants::NPDU_CONTROL_SOURCE | ExampleConstants::NPDU_CONTROL_NETWORK_LAYER_MESSAGE)) != 0;
+}
+
+int CShardFrontEnd::Start(const uint32_t workerCount, CShardWorker* worker) {
+#ifndef _WIN32
+	if (workerCount == 0 || workerCount > SHARD_ROUTER_MAX_WORKERS || this->IsRunning()) {
+		return -1;
+	}
+
+	// All the socket pairs first, each worker closes the ends of the others
+	std::vector<int> workerSockets;
+	for (uint32_t index = 0; index < workerCount; index++) {
+		int sockets[2];
+		if (socketpair(AF_UNIX, SOCK_DGRAM, 0, sockets) != 0) {
+			break;
+		}
+		int bufferSize = SHARD_ROUTER_SOCKET_BUFFER;
+		for (int end = 0; end < 2; end++) {
+			setsockopt(sockets[end], SOL_SOCKET, SO_SNDBUF, &bufferSize, sizeof(bufferSize));
+			setsockopt(sockets[end], SOL_SOCKET, SO_RCVBUF, &bufferSize, sizeof(bufferSize));
+		}
+		Worker entry;
+		entry.socket = sockets[0];
+		entry.pid = -1;
+		entry.forwarded = 0;
+		entry.dropped = 0;
+		entry.received = 0;
+		this->m_workers.push_back(entry);
+		workerSockets.push_back(sockets[1]);
+	}
+	if (workerSockets.size() != workerCount) {
+		for (size_t index = 0; index < workerSockets.size(); index++) {
+			close(workerSockets[index]);
+		}
+		this->Stop();
+		return -1;
+	}
+
+	for (uint32_t index = 0; index < workerCount; index++) {
+		pid_t pid = fork();
+		if (pid == 0) {
+#ifdef __linux__
+			// Do not outlive the front end
+			prctl(PR_SET_PDEATHSIG, SIGTERM);
+#endif // __linux__
+			for (uint32_t other = 0; other < workerCount; other++) {
+				close(this->m_workers[other].socket);
+				if (other > index) {
+					close(workerSockets[other]);
+				}
+			}
+			this->m_workers.clear();
+			worker->m_socket = workerSockets[index];
+			worker->m_index = index;
+			return (int)index;
+		}
+		if (pid < 0) {
+			for (size_t other = index; other < workerSockets.size(); other++) {
+				close(workerSockets[other]);
+			}
+			this->Stop();
+			return -1;
+		}
+		this->m_workers[index].pid = pid;
+		close(workerSockets[index]);
+	}
+	return (int)workerCount;
+#else
+	return -1;
+#endif // _WIN32
+}
+
+void CShardFrontEnd::Stop() {
+#ifndef _WIN32
+	for (size_t index = 0; index < this->m_workers.size(); index++) {
+		close(this->m_workers[index].socket);
+		if (this->m_workers[index].pid > 0) {
+			kill(this->m_workers[index].pid, SIGTERM);
+		}
+	}
+	for (size_t index = 0; index < this->m_workers.size(); index++) {
+		if (this->m_workers[index].pid > 0) {
+			int status;
+			waitpid(this->m_workers[index].pid, &status, 0);
+		}
+	}
+#endif // _WIN32
+	this->m_workers.clear();
+}
+
+bool CShardFrontEnd::SendToWorker(Worker& worker, const uint8_t* message, const uint16_t messageLength, const ShardMessageHeader& header) {
+#ifndef _WIN32
+	struct iovec parts[2];
+	parts[0].iov_base = (void*)&header;
+	parts[0].iov_len = sizeof(header);
+	parts[1].iov_base = (void*)message;
+	parts[1].iov_len = messageLength;
+	struct msghdr datagram;
+	memset(&datagram, 0, sizeof(datagram));
+	datagram.msg_iov = parts;
+	datagram.msg_iovlen = 2;
+
+	if (sendmsg(worker.socket, &datagram, MSG_DONTWAIT) != (ssize_t)(sizeof(header) + messageLength)) {
+		worker.dropped++;
+		return false;
+	}
+	worker.forwarded++;
+	return true;
+#else
+	return false;
+#endif // _WIN32
+}
+
+bool CShardFrontEnd::Forward(const uint8_t* message, const uint16_t messageLength, const ShardMessageHeader& header) {
+	const int route = Route(message, messageLength, (uint32_t)this->m_workers.size());
+	if (route >= 0) {
+		this->SendToWorker(this->m_workers[route], message, messageLength, header);
+		return false;
+	}
+	if (route == SHARD_ROUTE_ALL) {
+		for (size_t index = 0; index < this->m_workers.size(); index++) {
+			this->SendToWorker(this->m_workers[index], message, messageLength, header);
+		}
+	}
+	this->m_localCount++;
+	return true;
+}
+
+int CShardFrontEnd::Receive(uint8_t* message, const uint16_t maxMessageLength, ShardMessageHeader* header) {
+#ifndef _WIN32
+	struct iovec parts[2];
+	parts[0].iov_base = header;
+	parts[0].iov_len = sizeof(*header);
+	parts[1].iov_base = message;
+	parts[1].iov_len = maxMessageLength;
+	struct msghdr datagram;
+	memset(&datagram, 0, sizeof(datagram));
+	datagram.msg_iov = parts;
+	datagram.msg_iovlen = 2;
+
+	// One pass over the workers, starting after the one that was read last
+	const uint32_t workerCount = (uint32_t)this->m_workers.size();
+	for (uint32_t attempt = 0; attempt < workerCount; attempt++) {
+		Worker& worker = this->m_workers[this->m_nextWorker];
+		this->m_nextWorker = (this->m_nextWorker + 1) % workerCount;
+		for (;;) {
+			ssize_t length = recvmsg(worker.socket, &datagram, MSG_DONTWAIT);
+			if (length <= 0) {
+				break;
+			}
+			const uint16_t messageLength = length > (ssize_t)sizeof(*header) ? (uint16_t)(length - sizeof(*header)) : 0;
+			if (messageLength == 0 || (datagram.msg_flags & MSG_TRUNC) != 0 || !IsRoutedMessage(message, messageLength)) {
+				this->m_filteredCount++;
+				continue;
+			}
+			worker.received++;
+			return messageLength;
+		}
+	}
+#endif // _WIN32
+	return 0;
+}
+
+void CShardFrontEnd::Report(std::ostream& out) const {
+	out << "{\"shards\":{\"workers\":[";
+	for (size_t index = 0; index < this->m_workers.size(); index++) {
+		const Worker& worker = this->m_workers[index];
+		if (index > 0) {
+			out << ",";
+		}
+		out << "{\"pid\":" << worker.pid
+			<< ",\"forwarded\":" << worker.forwarded
+			<< ",\"dropped\":" << worker.dropped
+			<< ",\"received\":" << worker.received << "}";
+	}
+	out << "],\"local\":" << this->m_localCount << ",\"filtered\":" << this->m_filteredCount << "}}" << std::endl;
+}
@@ -0,0 +1,143 @@
+/*
+ * BACnet Virtual Devices and BBMD Example C++
+ * ----------------------------------------------------------------------------
+ * ShardRouter.h
+ *
+ * Runs the virtual networks in worker processes, so that they are not all
+ * served from the one core of the BACnet thread.
+ *
+ * The front end is the process started by the user. It owns the UDP sockets,
+ * the Network Ports and the BBMD, and forks one worker per shard before
+ * anything else starts. Each worker runs its own CAS BACnet Stack with the
+ * virtual networks of its shard, network N belongs to shard
+ * (N / VIRTUAL_NETWORK_OFFSET) % workerCount. The processes are connected by
+ * a pair of UNIX datagram sockets per worker, one datagram per BACnet
+ * message, with its connection strings in a ShardMessageHeader.
+ *
+ * Messages received from the network are routed by their NPDU:
+ *   - a DNET of a virtual network goes to the worker of that network only
+ *   - a global broadcast (DNET 0xFFFF), a local broadcast and a network
+ *     layer message without a DNET go to every worker and to the front end
+ *   - anything else, the BVLC control messages and the messages to the
+ *     main device, stays in the front end
+ * The front end sends the messages of the workers out of its sockets. Only
+ * the messages that come from a virtual network (with an SNET) and the
+ * network layer messages are sent, the main device of a worker is never
+ * seen on the network.
+ *
+ * The front end uses its sockets without blocking, a message for a worker
+ * whose socket is full is dropped and counted. Not available on Windows.
+ */
+
+#ifndef __ShardRouter_h__
+#define __ShardRouter_h__
+
+#include <stdint.h>
+#include <ostream>
+#include <vector>
+
+// Constants
+#define SHARD_ROUTER_MAX_WORKERS					16
+#define SHARD_ROUTER_MAX_MESSAGE_LENGTH				1500
+#define SHARD_ROUTER_MAX_CONNECTION_STRING_LENGTH	18		// BACnet/IPv6
+#define SHARD_ROUTER_SOCKET_BUFFER					(1024 * 1024)
+#define SHARD_ROUTER_FORWARD_BATCH					64		// Largest number of messages forwarded per receive call
+
+// Destinations of a message received by the front end, or a worker index
+#define SHARD_ROUTE_LOCAL		-1		// The front end only
+#define SHARD_ROUTE_ALL			-2		// Every worker and the front end
+
+// Sent before each message. To a worker, connectionString is the source of
+// the message and destinationConnectionString the interface it arrived on.
+// From a worker, connectionString is the destination.
+struct ShardMessageHeader
+{
+	uint8_t networkType;
+	uint8_t broadcast;
+	uint8_t connectionStringLength;
+	uint8_t destinationConnectionStringLength;
+	uint8_t connectionString[SHARD_ROUTER_MAX_CONNECTION_STRING_LENGTH];
+	uint8_t destinationConnectionString[SHARD_ROUTER_MAX_CONNECTION_STRING_LENGTH];
+};
+
+// The end of a worker
+class CShardWorker
+{
+public:
+	CShardWorker();
+	~CShardWorker();
+
+	bool IsOpen() const { return this->m_socket >= 0; }
+	uint32_t GetIndex() const { return this->m_index; }
+	// For poll()
+	int GetSocket() const { return this->m_socket; }
+
+	// Next message for this worker, without blocking. 0 when there is none,
+	// -1 on an error.
+	int Receive(uint8_t* message, const uint16_t maxMessageLength, ShardMessageHeader* header);
+	// Hands a message of the stack to the front end
+	bool Send(const uint8_t* message, const uint16_t messageLength, const ShardMessageHeader& header);
+
+private:
+	friend class CShardFrontEnd;
+	int m_socket;
+	uint32_t m_index;
+
+	void Close();
+};
+
+class CShardFrontEnd
+{
+public:
+	CShardFrontEnd();
+	~CShardFrontEnd();
+
+	// The shard of a virtual network
+	static uint32_t GetShard(const uint16_t network, const uint32_t workerCount);
+	// Where a message received from the network goes, a worker index or
+	// SHARD_ROUTE_LOCAL or SHARD_ROUTE_ALL
+	static int Route(const uint8_t* message, const uint16_t length, const uint32_t workerCount);
+	// True for a message of a worker that may be sent to the network
+	static bool IsRoutedMessage(const uint8_t* message, const uint16_t length);
+
+	// Forks workerCount workers. Returns workerCount in the front end and
+	// the index of the worker in each worker, where worker is then open and
+	// this object is not. Returns -1 when the workers can not be started.
+	// Must be called before any thread is started.
+	int Start(const uint32_t workerCount, CShardWorker* worker);
+	// Stops the workers and waits for them
+	void Stop();
+	bool IsRunning() const { return !this->m_workers.empty(); }
+	uint32_t GetWorkerCount() const { return (uint32_t)this->m_workers.size(); }
+	// For poll()
+	int GetSocket(const uint32_t index) const { return this->m_workers[index].socket; }
+
+	// Sends a message received from the network to the workers that host
+	// its DNET. Returns true when the front end must process it as well.
+	bool Forward(const uint8_t* message, const uint16_t messageLength, const ShardMessageHeader& header);
+	// Next message sent by a worker, without blocking, the workers take
+	// turns. 0 when there is none.
+	int Receive(uint8_t* message, const uint16_t maxMessageLength, ShardMessageHeader* header);
+
+	// {"shards":{"workers":[{"pid":...,"forwarded":...,"dropped":...,"received":...},...],"local":...,"filtered":...}}
+	void Report(std::ostream& out) const;
+
+private:
+	struct Worker
+	{
+		int socket;
+		int pid;
+		uint64_t forwarded;		// Messages sent to the worker
+		uint64_t dropped;		// Messages for the worker that did not fit in its socket
+		uint64_t received;		// Messages of the worker sent to the network
+	};
+
+	std::vector<Worker> m_workers;
+	uint32_t m_nextWorker;
+	uint64_t m_localCount;		// Messages processed by the front end
+	uint64_t m_filteredCount;	// Messages of the workers not sent to the network
+
+	bool SendToWorker(Worker& worker, const uint8_t* message, const uint16_t messageLength, const ShardMessageHeader& header);
+};
+
+#endif // __ShardRouter_h__
@@ -53,10 +53,16 @@ to create a unique and verifiable version.
 
 #include "SimpleUDP.h"
 #include <sstream>
+#include <vector>
 
 CSimpleUDP::CSimpleUDP() {
 	m_connected = false;
+	m_bindport = true;
 	m_port = 0;
+	m_family = AF_INET;
+	m_interfaceIndex = 0;
+	m_hasMulticastGroup = false;
+	memset(m_multicastGroup, 0, sizeof(m_multicastGroup));
 	this->m_socket = 0;
 }
 
@@ -67,8 +73,15 @@ bool CSimpleUDP::ReConnect() {
 	}
 
 	// Connect using the existing port
+	if (this->m_port > 0 && this->m_family == AF_INET6) {
+		unsigned char multicastGroup[16];
+		memcpy(multicastGroup, this->m_multicastGroup, sizeof(multicastGroup));
+		return this->ConnectIPv6(this->m_port, this->m_hasMulticastGroup ? multicastGroup : NULL, this->m_interfaceIndex);
+	}
 	if (this->m_port > 0) {
-		return this->Connect(this->m_port);
+		std::string bindAddress = this->m_bindAddress;
+		std::string interfaceName = this->m_interfaceName;
+		return this->Connect(this->m_port, this->m_bindport, bindAddress.empty() ? NULL : bindAddress.c_str(), interfaceName.empty() ? NULL : interfaceName.c_str());
 	}
 
 	return false;
@@ -90,7 +103,7 @@ void CSimpleUDP::Disconnect() {
 	this->m_connected = false;
 }
 
-bool CSimpleUDP::Connect(unsigned short port, bool bindport /* = true */, const char * ipAddress /* = NULL */) {
+bool CSimpleUDP::Connect(unsigned short port, bool bindport /* = true */, const char * ipAddress /* = NULL */, const char * interfaceName /* = NULL */) {
 
 	struct sockaddr_in addr;
 	struct timeval tv;
@@ -101,6 +114,10 @@ bool CSimpleUDP::Connect(unsigned short port, bool bindport /* = true */, const
 
 	// Set the port internally
 	this->m_port = port;
+	this->m_bindport = bindport;
+	this->m_bindAddress = ipAddress == NULL ? "" : ipAddress;
+	this->m_interfaceName = interfaceName == NULL ? "" : interfaceName;
+	this->m_family = AF_INET;
 
 	// If Windows, setup Winsock
 #ifdef _MSC_VER
@@ -147,6 +164,19 @@ bool CSimpleUDP::Connect(unsigned short port, bool bindport /* = true */, const
 	// Zero out the sockaddr_in structure
 	memset((char*)&addr, 0, sizeof(addr));
 
+#if defined(__linux__)
+	// Bind to a named interface. The socket is still bound to INADDR_ANY so
+	// that it receives the subnet broadcasts of that interface, which a socket
+	// bound to the interface address does not on Linux.
+	if (interfaceName != NULL && interfaceName[0] != 0) {
+		if (setsockopt(this->m_socket, SOL_SOCKET, SO_BINDTODEVICE, interfaceName, (socklen_t)strlen(interfaceName)) == SOCKET_ERROR) {
+			this->Disconnect();
+			return false;
+		}
+		ipAddress = NULL;
+	}
+#endif
+
 	// Prepare the sockaddr_in structure
 	addr.sin_family = AF_INET;
 	addr.sin_port = htons(port);
@@ -286,6 +316,301 @@ int CSimpleUDP::GetMessage(unsigned char * buffer, unsigned short maxLength, cha
 }
 
 
+bool CSimpleUDP::ConnectIPv6(const unsigned short port, const unsigned char * multicastGroup /* = NULL */, const unsigned int interfaceIndex /* = 0 */) {
+	struct sockaddr_in6 addr;
+	struct timeval tv;
+
+	// Disconnect if already connected
+	this->Disconnect();
+
+	// Store the settings for ReConnect()
+	this->m_port = port;
+	this->m_family = AF_INET6;
+	this->m_interfaceIndex = interfaceIndex;
+	this->m_hasMulticastGroup = multicastGroup != NULL;
+	if (multicastGroup != NULL) {
+		memcpy(this->m_multicastGroup, multicastGroup, sizeof(this->m_multicastGroup));
+	}
+
+#ifdef _MSC_VER
+	WSADATA  wsaData;
+	if (WSAStartup(MAKEWORD(2, 2), &wsaData) != NO_ERROR) {
+		return false;
+	}
+#endif
+
+	// Create the UDP socket
+	this->m_socket = socket(AF_INET6, SOCK_DGRAM, IPPROTO_UDP);
+	if ((int)m_socket < 0) {
+		this->Disconnect();
+		return false;
+	}
+
+	// Set socket options
+	int bOptVal = 1;
+	int bOptLen = sizeof(int);
+	if (setsockopt(this->m_socket, SOL_SOCKET, SO_REUSEADDR, (char*)&bOptVal, bOptLen) == SOCKET_ERROR) {
+		this->Disconnect();
+		return false;
+	}
+	// IPv6 only, IPv4 is served by its own socket on the same port
+	if (setsockopt(this->m_socket, IPPROTO_IPV6, IPV6_V6ONLY, (char*)&bOptVal, bOptLen) == SOCKET_ERROR) {
+		this->Disconnect();
+		return false;
+	}
+	tv.tv_sec = 1;
+	tv.tv_usec = 0;
+	if (setsockopt(this->m_socket, SOL_SOCKET, SO_RCVTIMEO, (char *)&tv, sizeof(struct timeval)) == SOCKET_ERROR) {
+		this->Disconnect();
+		return false;
+	}
+
+	// Bind to all addresses
+	memset((char*)&addr, 0, sizeof(addr));
+	addr.sin6_family = AF_INET6;
+	addr.sin6_port = htons(port);
+	addr.sin6_addr = in6addr_any;
+	if (bind(this->m_socket, (struct sockaddr*)&addr, sizeof(addr)) != 0) {
+		this->Disconnect();
+		return false;
+	}
+
+	// Outgoing multicasts use the selected interface
+	if (interfaceIndex != 0) {
+		unsigned int multicastInterface = interfaceIndex;
+		if (setsockopt(this->m_socket, IPPROTO_IPV6, IPV6_MULTICAST_IF, (char*)&multicastInterface, sizeof(multicastInterface)) == SOCKET_ERROR) {
+			this->Disconnect();
+			return false;
+		}
+	}
+
+	// Join the multicast group
+	if (multicastGroup != NULL) {
+		struct ipv6_mreq membership;
+		memset(&membership, 0, sizeof(membership));
+		memcpy(&membership.ipv6mr_multiaddr, multicastGroup, 16);
+		membership.ipv6mr_interface = interfaceIndex;
+		if (setsockopt(this->m_socket, IPPROTO_IPV6, IPV6_JOIN_GROUP, (char*)&membership, sizeof(membership)) == SOCKET_ERROR) {
+			this->Disconnect();
+			return false;
+		}
+	}
+
+	this->m_connected = true;
+	return true;
+}
+
+socklen_t CSimpleUDP::ToSocketAddress(const unsigned char * ipAddress, unsigned short port, struct sockaddr_storage * socketAddress) {
+	memset(socketAddress, 0, sizeof(struct sockaddr_storage));
+	if (this->m_family == AF_INET6) {
+		struct sockaddr_in6 * addr = (struct sockaddr_in6 *)socketAddress;
+		addr->sin6_family = AF_INET6;
+		addr->sin6_port = htons(port);
+		memcpy(&addr->sin6_addr, ipAddress, 16);
+		// Link-local and multicast destinations need the interface
+		if (ipAddress[0] == 0xFF || (ipAddress[0] == 0xFE && (ipAddress[1] & 0xC0) == 0x80)) {
+			addr->sin6_scope_id = this->m_interfaceIndex;
+		}
+		return sizeof(struct sockaddr_in6);
+	}
+	struct sockaddr_in * addr = (struct sockaddr_in *)socketAddress;
+	addr->sin_family = AF_INET;
+	addr->sin_port = htons(port);
+	memcpy(&addr->sin_addr, ipAddress, 4);
+	return sizeof(struct sockaddr_in);
+}
+
+void CSimpleUDP::FromSocketAddress(const struct sockaddr_storage * socketAddress, unsigned char * ipAddress, unsigned short * port) {
+	if (socketAddress->ss_family == AF_INET6) {
+		const struct sockaddr_in6 * addr = (const struct sockaddr_in6 *)socketAddress;
+		if (ipAddress != NULL) {
+			memcpy(ipAddress, &addr->sin6_addr, 16);
+		}
+		if (port != NULL) {
+			*port = ntohs(addr->sin6_port);
+		}
+		return;
+	}
+	const struct sockaddr_in * addr = (const struct sockaddr_in *)socketAddress;
+	if (ipAddress != NULL) {
+		memcpy(ipAddress, &addr->sin_addr, 4);
+	}
+	if (port != NULL) {
+		*port = ntohs(addr->sin_port);
+	}
+}
+
+// Windows has no MSG_DONTWAIT, check the socket before reading from it
+bool CSimpleUDP::IsReadable() {
+#ifdef _MSC_VER
+	timeval timeout;
+	timeout.tv_sec = 0;
+	timeout.tv_usec = 0;
+	fd_set readflds;
+	readflds.fd_count = 1;
+	readflds.fd_array[0] = this->m_socket;
+	return select(0, &readflds, NULL, NULL, &timeout) > 0;
+#else
+	return true;
+#endif
+}
+
+bool CSimpleUDP::SendTo(const unsigned char * ipAddress, unsigned short portnum, const unsigned char * buffer, unsigned short bufferLength) {
+	struct sockaddr_storage toAddr;
+	int ret;
+
+	// Check to see if we have created a connection 
+	if (!this->IsConnected()) {
+		if (!this->ReConnect()) {
+			return false;
+		}
+	}
+
+	// Check parameters
+	if (ipAddress == NULL || buffer == NULL || bufferLength == 0) {
+		return false;
+	}
+
+	socklen_t toAddrLength = this->ToSocketAddress(ipAddress, portnum, &toAddr);
+	ret = sendto(this->m_socket, (const char*)buffer, bufferLength, 0, (struct sockaddr *)&toAddr, toAddrLength);
+	if (ret == bufferLength) {
+		return true;
+	}
+
+	if (ret == SOCKET_ERROR) {
+		// Issue with the socket, disconnect
+		this->Disconnect();
+	}
+	return false;
+}
+
+int CSimpleUDP::ReceiveFrom(unsigned char * buffer, unsigned short maxLength, unsigned char * ipAddress, unsigned short * port) {
+	// Check to see if we have created a connection 
+	if (!this->IsConnected()) {
+		if (!this->ReConnect()) {
+			return 0;
+		}
+	}
+
+	// Check parameters
+	if (buffer == NULL || maxLength == 0) {
+		return 0;
+	}
+
+	struct sockaddr_storage fromAddr;
+	socklen_t fromAddrLength = sizeof(fromAddr);
+#ifdef _MSC_VER
+	if (!this->IsReadable()) {
+		return 0;
+	}
+	int ret = recvfrom(this->m_socket, (char*)buffer, maxLength, 0, (sockaddr *)&fromAddr, &fromAddrLength);
+	if (ret == SOCKET_ERROR) {
+		return WSAGetLastError() == WSAEWOULDBLOCK ? 0 : -1;
+	}
+#elif defined(__GNUC__)
+	int ret = (int)recvfrom(this->m_socket, (char*)buffer, maxLength, MSG_DONTWAIT, (sockaddr *)&fromAddr, &fromAddrLength);
+	if (ret < 0) {
+		return (errno == EAGAIN || errno == EWOULDBLOCK || errno == EINTR) ? 0 : -1;
+	}
+#endif
+	if (ret > 0) {
+		this->FromSocketAddress(&fromAddr, ipAddress, port);
+	}
+	return ret;
+}
+
+int CSimpleUDP::SendBatch(const SimpleUDPDatagram * datagrams, int count) {
+	if (!this->IsConnected()) {
+		if (!this->ReConnect()) {
+			return -1;
+		}
+	}
+	if (datagrams == NULL || count <= 0) {
+		return 0;
+	}
+	if (count > SIMPLE_UDP_MAX_BATCH) {
+		count = SIMPLE_UDP_MAX_BATCH;
+	}
+
+#if defined(__linux__)
+	struct mmsghdr messages[SIMPLE_UDP_MAX_BATCH];
+	struct iovec vectors[SIMPLE_UDP_MAX_BATCH];
+	struct sockaddr_storage addresses[SIMPLE_UDP_MAX_BATCH];
+	for (int i = 0; i < count; i++) {
+		vectors[i].iov_base = datagrams[i].buffer;
+		vectors[i].iov_len = datagrams[i].length;
+		memset(&messages[i], 0, sizeof(messages[i]));
+		messages[i].msg_hdr.msg_name = &addresses[i];
+		messages[i].msg_hdr.msg_namelen = this->ToSocketAddress(datagrams[i].address, datagrams[i].port, &addresses[i]);
+		messages[i].msg_hdr.msg_iov = &vectors[i];
+		messages[i].msg_hdr.msg_iovlen = 1;
+	}
+	int ret = sendmmsg(this->m_socket, messages, (unsigned int)count, 0);
+	if (ret < 0) {
+		return (errno == EAGAIN || errno == EWOULDBLOCK || errno == EINTR) ? 0 : -1;
+	}
+	return ret;
+#else
+	int sent = 0;
+	for (int i = 0; i < count; i++) {
+		if (!this->SendTo(datagrams[i].address, datagrams[i].port, datagrams[i].buffer, datagrams[i].length)) {
+			break;
+		}
+		sent++;
+	}
+	return sent;
+#endif
+}
+
+int CSimpleUDP::ReceiveBatch(SimpleUDPDatagram * datagrams, int count) {
+	if (!this->IsConnected()) {
+		if (!this->ReConnect()) {
+			return -1;
+		}
+	}
+	if (datagrams == NULL || count <= 0) {
+		return 0;
+	}
+	if (count > SIMPLE_UDP_MAX_BATCH) {
+		count = SIMPLE_UDP_MAX_BATCH;
+	}
+
+#if defined(__linux__)
+	struct mmsghdr messages[SIMPLE_UDP_MAX_BATCH];
+	struct iovec vectors[SIMPLE_UDP_MAX_BATCH];
+	struct sockaddr_storage addresses[SIMPLE_UDP_MAX_BATCH];
+	for (int i = 0; i < count; i++) {
+		vectors[i].iov_base = datagrams[i].buffer;
+		vectors[i].iov_len = datagrams[i].maxLength;
+		memset(&messages[i], 0, sizeof(messages[i]));
+		messages[i].msg_hdr.msg_name = &addresses[i];
+		messages[i].msg_hdr.msg_namelen = sizeof(addresses[i]);
+		messages[i].msg_hdr.msg_iov = &vectors[i];
+		messages[i].msg_hdr.msg_iovlen = 1;
+	}
+	int ret = recvmmsg(this->m_socket, messages, (unsigned int)count, MSG_DONTWAIT, NULL);
+	if (ret < 0) {
+		return (errno == EAGAIN || errno == EWOULDBLOCK || errno == EINTR) ? 0 : -1;
+	}
+	for (int i = 0; i < ret; i++) {
+		datagrams[i].length = (unsigned short)messages[i].msg_len;
+		this->FromSocketAddress(&addresses[i], datagrams[i].address, &datagrams[i].port);
+	}
+	return ret;
+#else
+	int received = 0;
+	while (received < count) {
+		int length = this->ReceiveFrom(datagrams[received].buffer, datagrams[received].maxLength, datagrams[received].address, &datagrams[received].port);
+		if (length <= 0) {
+			break;
+		}
+		datagrams[received].length = (unsigned short)length;
+		received++;
+	}
+	return received;
+#endif
+}
+
 int CSimpleUDP::GetBroadcastIPAddress(char * broadcastIPAddress, unsigned short maxLength) {
 #ifdef _MSC_VER
 	unsigned long ulSize = 0;
@@ -341,37 +666,47 @@ int CSimpleUDP::GetBroadcastIPAddress(char * broadcastIPAddress, unsigned short
 	delete(pbBuffer);
 #elif defined (__GNUC__)
 	struct ifconf ifc;
-	struct ifreq ifr[10];
+	std::vector<struct ifreq> ifr;
 	int ifc_num, i;
 	char * temp;
 
 	if (this->m_socket > 0) {
-		ifc.ifc_len = sizeof(ifr);
-		ifc.ifc_ifcu.ifcu_buf = (caddr_t)ifr;
+		// Grow the request buffer until the kernel returns less than we asked
+		// for, otherwise interfaces past the end of the buffer are dropped.
+		ifr.resize(16);
+		for (;;) {
+			ifc.ifc_len = (int)(ifr.size() * sizeof(struct ifreq));
+			ifc.ifc_ifcu.ifcu_buf = (caddr_t)ifr.data();
+			if (ioctl(this->m_socket, SIOCGIFCONF, &ifc) != 0) {
+				return 0;
+			}
+			if ((size_t)ifc.ifc_len < ifr.size() * sizeof(struct ifreq)) {
+				break;
+			}
+			ifr.resize(ifr.size() * 2);
+		}
 
-		if (ioctl(this->m_socket, SIOCGIFCONF, &ifc) == 0) {
-			ifc_num = ifc.ifc_len / sizeof(struct ifreq);
-			for (i = 0; i < ifc_num; ++i) {
-				if (ifr[i].ifr_addr.sa_family != AF_INET) {
-					continue;
-				}
+		ifc_num = ifc.ifc_len / sizeof(struct ifreq);
+		for (i = 0; i < ifc_num; ++i) {
+			if (ifr[i].ifr_addr.sa_family != AF_INET) {
+				continue;
+			}
 
-				// Retrieve the IP Address
-				if (ioctl(this->m_socket, SIOCGIFADDR, &ifr[i]) == 0) {
-					temp = inet_ntoa(((struct sockaddr_in *)(&ifr[i].ifr_addr))->sin_addr);
-					if (strcmp(temp, "127.0.0.1") == 0 || // local host
-						strcmp(temp, "0.0.0.0") == 0) {  // invalid / unconnected resource
-						continue;
-					}
-				}
-				else {
+			// Retrieve the IP Address
+			if (ioctl(this->m_socket, SIOCGIFADDR, &ifr[i]) == 0) {
+				temp = inet_ntoa(((struct sockaddr_in *)(&ifr[i].ifr_addr))->sin_addr);
+				if (strcmp(temp, "127.0.0.1") == 0 || // local host
+					strcmp(temp, "0.0.0.0") == 0) {  // invalid / unconnected resource
 					continue;
 				}
+			}
+			else {
+				continue;
+			}
 
-				if (ioctl(this->m_socket, SIOCGIFBRDADDR, &ifr[i]) == 0) {
-					temp = inet_ntoa(((struct sockaddr_in *)(&ifr[i].ifr_netmask))->sin_addr);
-					return snprintf(broadcastIPAddress, maxLength, "%s", temp);
-				}
+			if (ioctl(this->m_socket, SIOCGIFBRDADDR, &ifr[i]) == 0) {
+				temp = inet_ntoa(((struct sockaddr_in *)(&ifr[i].ifr_broadaddr))->sin_addr);
+				return snprintf(broadcastIPAddress, maxLength, "%s", temp);
 			}
 		}
 	}
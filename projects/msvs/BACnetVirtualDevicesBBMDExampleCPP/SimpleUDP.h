@@ -64,6 +64,10 @@ to create a unique and verifiable version.
 *     0.04  25 Sep 2017     ACF     Made class platform independent
 *     0.05  25 Sep 2017     ACF     Added header files needed for linux
 *									Cleaned up the code for use with linux
+*     0.06  19 Oct 2026             Added binding to a named interface, SendTo
+*									and ReceiveFrom with binary addresses
+*     0.07  19 Oct 2026             Added IPv6 sockets with multicast group join
+*									and batched send and receive
 *
 */
 
@@ -71,6 +75,7 @@ to create a unique and verifiable version.
 
 #include <string.h>
 #include <stdio.h>
+#include <string>
 
 #ifdef _MSC_VER
 #include <winsock2.h>
@@ -104,6 +109,23 @@ to create a unique and verifiable version.
 
 #endif
 
+// Largest number of datagrams handled by one SendBatch() or ReceiveBatch() call
+#define SIMPLE_UDP_MAX_BATCH	32
+
+// Largest binary address, IPv6
+#define SIMPLE_UDP_MAX_ADDRESS_LENGTH	16
+
+// One datagram of a batch. The buffer is owned by the caller so that no
+// memory is allocated while sending or receiving.
+struct SimpleUDPDatagram
+{
+	unsigned char * buffer;
+	unsigned short maxLength;		// Size of the buffer
+	unsigned short length;			// Bytes to send, or bytes received
+	unsigned char address[SIMPLE_UDP_MAX_ADDRESS_LENGTH];	// 4 bytes for IPv4, 16 bytes for IPv6
+	unsigned short port;			// Host order
+};
+
 
 class CSimpleUDP
 {
@@ -111,6 +133,13 @@ class CSimpleUDP
 private:
 	unsigned short		m_port;			// Stores the port that the resource is connected to	
 	bool				m_connected;	// flag that gets set when the resource is successfully connected
+	bool				m_bindport;		// Connect() parameters, reused by ReConnect()
+	std::string			m_bindAddress;
+	std::string			m_interfaceName;
+	int					m_family;		// AF_INET or AF_INET6
+	unsigned int		m_interfaceIndex;	// IPv6 only, 0 for the default interface
+	bool				m_hasMulticastGroup;
+	unsigned char		m_multicastGroup[16];
 	
 #ifdef _MSC_VER
 	SOCKET				m_socket;
@@ -118,11 +147,11 @@ private:
 	int m_socket;
 #endif
 
+public:
+
 	//Function used to force a reconnect of the resource to the stored port
 	bool ReConnect();
 
-public:
-
 	CSimpleUDP();
 	~CSimpleUDP() {
 		this->Disconnect();
@@ -131,12 +160,43 @@ public:
 	bool IsConnected() { return m_connected; }
 	void Disconnect();
 
-	bool Connect(const unsigned short port, bool bindport = true, const char * ipAddress = NULL);
+	bool Connect(const unsigned short port, bool bindport = true, const char * ipAddress = NULL, const char * interfaceName = NULL);
 	bool SendMessage(const char * ipAddress, unsigned short port, unsigned char * buffer, unsigned short bufferLength);
 	int GetMessage(unsigned char * buffer, unsigned short maxLength, char * ipAddress, unsigned short * port = NULL);
+
+	// Opens an IPv6 socket bound to all addresses. If multicastGroup (16 bytes)
+	// is set, the group is joined on the interface so that broadcasts, which are
+	// multicasts in IPv6, are received. interfaceIndex 0 is the default interface.
+	bool ConnectIPv6(const unsigned short port, const unsigned char * multicastGroup = NULL, const unsigned int interfaceIndex = 0);
+	bool IsIPv6() { return this->m_family == AF_INET6; }
+	// Length of the binary addresses used by SendTo and ReceiveFrom, 4 or 16
+	unsigned char GetAddressLength() { return this->m_family == AF_INET6 ? 16 : 4; }
+
+	// Same as SendMessage/GetMessage, but with the binary address in network
+	// order (see GetAddressLength()) and the port in host order. No string
+	// conversions. ReceiveFrom does not wait.
+	bool SendTo(const unsigned char * ipAddress, unsigned short port, const unsigned char * buffer, unsigned short bufferLength);
+	int ReceiveFrom(unsigned char * buffer, unsigned short maxLength, unsigned char * ipAddress, unsigned short * port);
+
+	// Sends or receives up to SIMPLE_UDP_MAX_BATCH datagrams with one system
+	// call where the platform supports it (sendmmsg/recvmmsg on Linux).
+	// Returns the number of datagrams sent or received, -1 on a socket error.
+	// ReceiveBatch does not wait.
+	int SendBatch(const SimpleUDPDatagram * datagrams, int count);
+	int ReceiveBatch(SimpleUDPDatagram * datagrams, int count);
+
+#ifdef _MSC_VER
+	SOCKET GetSocket() { return m_socket; }
+#elif defined(__GNUC__)
+	int GetSocket() { return m_socket; }
+#endif
 		 
 	int GetBroadcastIPAddress(char * broadcastIPAddress, unsigned short maxLength);
-	
+
+private:
+	socklen_t ToSocketAddress(const unsigned char * ipAddress, unsigned short port, struct sockaddr_storage * socketAddress);
+	void FromSocketAddress(const struct sockaddr_storage * socketAddress, unsigned char * ipAddress, unsigned short * port);
+	bool IsReadable();
 
 
 };
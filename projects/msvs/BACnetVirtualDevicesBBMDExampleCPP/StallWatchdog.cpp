@@ -0,0 +1,276 @@
+/*
+ * BACnet Virtual Devices and BBMD Example C++
+ * ----------------------------------------------------------------------------
+ * StallWatchdog.cpp
+ *
+ * Watchdog thread of the main loop and its diagnostic snapshot.
+ */
+
+#include "StallWatchdog.h"
+
+#include <string.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <chrono>
+#include <iostream>
+#include <sstream>
+
+#ifdef STALL_WATCHDOG_STACK_TRACE
+#include <execinfo.h>
+#include <signal.h>
+
+// Filled in by the BACnet thread in the signal handler. One trace at a time:
+// the watchdog sets s_requested to a new generation, the handler claims it by
+// swapping in 0, fills the frames and then publishes the generation. The
+// frames are only read after their generation was published, and no other
+// handler can claim a request until the next one.
+static void* s_frames[STALL_WATCHDOG_MAX_FRAMES];
+static int s_frameCount = 0;
+static std::atomic<uint32_t> s_requested(0);
+static std::atomic<uint32_t> s_published(0);
+static uint32_t s_generation = 0;		// Watchdog thread only
+
+static void StackTraceSignalHandler(int) {
+	uint32_t generation = s_requested.exchange(0, std::memory_order_acquire);
+	if (generation == 0) {
+		// Late, the watchdog gave up on this request
+		return;
+	}
+	s_frameCount = backtrace(s_frames, STALL_WATCHDOG_MAX_FRAMES);
+	s_published.store(generation, std::memory_order_release);
+}
+#endif
+
+CStallWatchdog::CStallWatchdog() {
+	this->m_running = false;
+	this->m_thresholdMilliseconds = 0;
+	this->m_activity = NULL;
+	this->m_probe = NULL;
+	this->m_metrics = NULL;
+	this->m_heartbeat = 0;
+	this->m_beats = 0;
+	this->m_packetCount = 0;
+	for (int i = 0; i < STALL_WATCHDOG_PACKETS; i++) {
+		this->m_packets[i].sequence = 0;
+	}
+	this->m_stallCount = 0;
+	this->m_stalled = false;
+}
+
+CStallWatchdog::~CStallWatchdog() {
+	this->Stop();
+}
+
+bool CStallWatchdog::Start(const uint32_t thresholdMilliseconds, const CLatencyHistograms* activity, StallWatchdogProbe probe, CMetrics* metrics) {
+	if (thresholdMilliseconds == 0 || this->m_running) {
+		return false;
+	}
+	this->m_thresholdMilliseconds = thresholdMilliseconds;
+	this->m_activity = activity;
+	this->m_probe = probe;
+	this->m_metrics = metrics;
+
+#ifdef STALL_WATCHDOG_STACK_TRACE
+	// The first call to backtrace() loads libgcc, which must not happen
+	// inside the signal handler
+	backtrace(s_frames, STALL_WATCHDOG_MAX_FRAMES);
+	this->m_bacnetThread = pthread_self();
+
+	struct sigaction action;
+	memset(&action, 0, sizeof(action));
+	action.sa_handler = StackTraceSignalHandler;
+	action.sa_flags = SA_RESTART;
+	sigemptyset(&action.sa_mask);
+	if (sigaction(SIGURG, &action, NULL) != 0) {
+		return false;
+	}
+#endif
+
+	this->m_running = true;
+	this->m_thread = std::thread(&CStallWatchdog::Run, this);
+	return true;
+}
+
+void CStallWatchdog::Stop() {
+	if (!this->m_running) {
+		return;
+	}
+	this->m_running = false;
+	if (this->m_thread.joinable()) {
+		this->m_thread.join();
+	}
+}
+
+void CStallWatchdog::RecordPacket(const bool sent, const uint8_t* message, const uint16_t length) {
+	uint32_t index = this->m_packetCount.load(std::memory_order_relaxed);
+	PacketHeader& packet = this->m_packets[index & (STALL_WATCHDOG_PACKETS - 1)];
+
+	// Sequence lock, the watchdog skips a header that changed while it read it
+	uint32_t sequence = packet.sequence.load(std::memory_order_relaxed);
+	packet.sequence.store(sequence + 1, std::memory_order_relaxed);
+	std::atomic_thread_fence(std::memory_order_release);
+	packet.timestamp = CLatencyClock::Now();
+	packet.length = length;
+	packet.sent = sent;
+	memcpy(packet.header, message, length < STALL_WATCHDOG_HEADER_LENGTH ? length : STALL_WATCHDOG_HEADER_LENGTH);
+	packet.sequence.store(sequence + 2, std::memory_order_release);
+
+	this->m_packetCount.store(index + 1, std::memory_order_relaxed);
+}
+
+void CStallWatchdog::Run() {
+	const uint32_t periodMilliseconds = this->m_thresholdMilliseconds >= 10 ? this->m_thresholdMilliseconds / 10 : 1;
+	uint64_t lastBeat = this->m_heartbeat.load(std::memory_order_relaxed);
+	std::chrono::steady_clock::time_point lastChange = std::chrono::steady_clock::now();
+
+	while (this->m_running) {
+		std::this_thread::sleep_for(std::chrono::milliseconds(periodMilliseconds));
+		uint64_t beat = this->m_heartbeat.load(std::memory_order_relaxed);
+		std::chrono::steady_clock::time_point now = std::chrono::steady_clock::now();
+		uint64_t stalledMilliseconds = (uint64_t)std::chrono::duration_cast<std::chrono::milliseconds>(now - lastChange).count();
+
+		if (beat != lastBeat) {
+			lastBeat = beat;
+			lastChange = now;
+			std::lock_guard<std::mutex> lock(this->m_mutex);
+			if (this->m_stalled) {
+				this->m_stalled = false;
+				this->m_durations.Record((uint64_t)(stalledMilliseconds * 1000000.0 * CLatencyClock::TicksPerNanosecond()));
+				std::cout << "FYI: Main loop running again after [" << stalledMilliseconds << "] ms" << std::endl;
+			}
+			continue;
+		}
+		if (this->m_stalled || stalledMilliseconds < this->m_thresholdMilliseconds) {
+			continue;
+		}
+
+		// A new stall, one snapshot for it
+		std::string snapshot;
+		this->TakeSnapshot(stalledMilliseconds, snapshot);
+		{
+			std::lock_guard<std::mutex> lock(this->m_mutex);
+			this->m_stalled = true;
+			this->m_stallCount++;
+			this->m_lastSnapshot = snapshot;
+		}
+		if (this->m_metrics != NULL) {
+			this->m_metrics->Add(METRIC_LOOP_STALLS);
+		}
+		std::cout << "FYI: Stall: {\"stall\":" << snapshot << "}" << std::endl;
+	}
+}
+
+void CStallWatchdog::TakeSnapshot(const uint64_t stalledMilliseconds, std::string& snapshot) {
+	std::ostringstream out;
+	out << "{\"stalledMs\":" << stalledMilliseconds;
+	if (this->m_activity != NULL) {
+		out << ",\"activity\":\"" << CLatencyHistograms::GetName(this->m_activity->GetActivity()) << "\"";
+	}
+	out << ",\"iterations\":" << this->m_heartbeat.load(std::memory_order_relaxed);
+	out << ",\"queues\":{";
+	if (this->m_probe != NULL) {
+		this->m_probe(out);
+	}
+	out << "},\"packets\":[";
+	this->WritePackets(out);
+	out << "],\"stack\":[";
+	this->WriteStackTrace(out);
+	out << "]}";
+	snapshot = out.str();
+}
+
+void CStallWatchdog::WritePackets(std::ostream& out) {
+	uint32_t count = this->m_packetCount.load(std::memory_order_relaxed);
+	uint32_t first = count > STALL_WATCHDOG_PACKETS ? count - STALL_WATCHDOG_PACKETS : 0;
+	uint64_t now = CLatencyClock::Now();
+	bool firstPacket = true;
+	for (uint32_t index = first; index < count; index++) {
+		PacketHeader& packet = this->m_packets[index & (STALL_WATCHDOG_PACKETS - 1)];
+		uint32_t sequence = packet.sequence.load(std::memory_order_acquire);
+		uint64_t timestamp = packet.timestamp;
+		uint16_t length = packet.length;
+		bool sent = packet.sent;
+		uint8_t header[STALL_WATCHDOG_HEADER_LENGTH];
+		memcpy(header, packet.header, sizeof(header));
+		std::atomic_thread_fence(std::memory_order_acquire);
+		if ((sequence & 1) != 0 || packet.sequence.load(std::memory_order_relaxed) != sequence) {
+			continue;
+		}
+
+		if (!firstPacket) {
+			out << ",";
+		}
+		firstPacket = false;
+		char hex[STALL_WATCHDOG_HEADER_LENGTH * 2 + 1];
+		uint16_t headerLength = length < STALL_WATCHDOG_HEADER_LENGTH ? length : STALL_WATCHDOG_HEADER_LENGTH;
+		for (uint16_t i = 0; i < headerLength; i++) {
+			snprintf(hex + i * 2, 3, "%02x", header[i]);
+		}
+		hex[headerLength * 2] = 0;
+		out << "{\"ageMs\":" << (uint64_t)((now - timestamp) / CLatencyClock::TicksPerNanosecond() / 1000000.0)
+			<< ",\"direction\":\"" << (sent ? "sent" : "received") << "\""
+			<< ",\"length\":" << length
+			<< ",\"header\":\"" << hex << "\"}";
+	}
+}
+
+void CStallWatchdog::WriteStackTrace(std::ostream& out) {
+#ifdef STALL_WATCHDOG_STACK_TRACE
+	if (++s_generation == 0) {
+		s_generation = 1;
+	}
+	const uint32_t generation = s_generation;
+	s_requested.store(generation, std::memory_order_release);
+	bool published = false;
+	if (pthread_kill(this->m_bacnetThread, SIGURG) == 0) {
+		// A thread blocked with the signal masked never answers
+		for (int wait = 0; wait < 100 && !published; wait++) {
+			std::this_thread::sleep_for(std::chrono::milliseconds(1));
+			published = s_published.load(std::memory_order_acquire) == generation;
+		}
+	}
+	if (!published) {
+		// Withdraw the request. If a handler claimed it already it is
+		// walking the stack right now, wait for it to finish.
+		if (s_requested.exchange(0, std::memory_order_acq_rel) == generation) {
+			return;
+		}
+		while (s_published.load(std::memory_order_acquire) != generation) {
+			std::this_thread::yield();
+		}
+	}
+	const int frameCount = s_frameCount;
+	if (frameCount <= 0) {
+		return;
+	}
+	char** symbols = backtrace_symbols(s_frames, frameCount);
+	if (symbols == NULL) {
+		return;
+	}
+	for (int i = 0; i < frameCount; i++) {
+		if (i > 0) {
+			out << ",";
+		}
+		out << "\"";
+		for (const char* c = symbols[i]; *c != 0; c++) {
+			if (*c == '"' || *c == '\\') {
+				out << '\\';
+			}
+			out << *c;
+		}
+		out << "\"";
+	}
+	free(symbols);
+#else
+	(void)out;
+#endif
+}
+
+void CStallWatchdog::Report(std::ostream& out) {
+	std::lock_guard<std::mutex> lock(this->m_mutex);
+	out << "{\"stalls\":{\"thresholdMs\":" << this->m_thresholdMilliseconds
+		<< ",\"count\":" << this->m_stallCount
+		<< ",\"stalled\":" << (this->m_stalled ? "true" : "false") << ",\"durations\":";
+	this->m_durations.Report(out, "stall");
+	out << ",\"last\":" << (this->m_lastSnapshot.empty() ? "null" : this->m_lastSnapshot) << "}}" << std::endl;
+}
@@ -0,0 +1,116 @@
+/*
+ * BACnet Virtual Devices and BBMD Example C++
+ * ----------------------------------------------------------------------------
+ * StallWatchdog.h
+ *
+ * Detects when the BACnet thread stops going around the main loop, for
+ * example in a slow property callback or behind a burst of console output,
+ * and records what it was doing.
+ *
+ * The main loop calls Beat() once per iteration, a relaxed store of an
+ * iteration count. A watchdog thread samples the count ten times per
+ * threshold. When it has not moved for the threshold, one snapshot is taken
+ * for the stall:
+ *   - the callback or scope being timed, from CLatencyHistograms
+ *   - the queue depths, from a probe function. It reads atomic copies of the
+ *     counts that the owning threads keep up to date, never the queues.
+ *   - the headers of the last packets received and sent
+ *   - a stack trace of the BACnet thread (glibc only, link with -rdynamic
+ *     for function names). The thread is interrupted with SIGURG and walks
+ *     its own stack in the signal handler. Each request for a trace has a
+ *     generation, and the handler only writes the frames after it claimed
+ *     the current one, so a late signal of a request that timed out can not
+ *     overwrite frames that are being symbolized.
+ * The snapshot is printed and kept for the stall command. When the loop
+ * moves again the length of the stall goes into a histogram, to within one
+ * sample period.
+ */
+
+#ifndef __StallWatchdog_h__
+#define __StallWatchdog_h__
+
+#include <stdint.h>
+#include <atomic>
+#include <mutex>
+#include <ostream>
+#include <string>
+#include <thread>
+#include "LatencyHistogram.h"
+#include "Metrics.h"
+
+#ifdef __GLIBC__
+#include <pthread.h>
+#define STALL_WATCHDOG_STACK_TRACE
+#endif
+
+// Constants
+#define STALL_WATCHDOG_PACKETS				16		// Headers kept, must be a power of two
+#define STALL_WATCHDOG_HEADER_LENGTH		24		// BVLC, NPDU and the start of the APDU
+#define STALL_WATCHDOG_MAX_FRAMES			32
+
+// Writes the queue depths as JSON members, "name":value,...
+typedef void (*StallWatchdogProbe)(std::ostream& out);
+
+class CStallWatchdog
+{
+public:
+	CStallWatchdog();
+	~CStallWatchdog();
+
+	// Must be called from the BACnet thread, the one that calls Beat()
+	bool Start(const uint32_t thresholdMilliseconds, const CLatencyHistograms* activity, StallWatchdogProbe probe, CMetrics* metrics);
+	void Stop();
+	bool IsRunning() const { return this->m_running; }
+
+	// Once per iteration of the main loop
+	void Beat() {
+		this->m_heartbeat.store(++this->m_beats, std::memory_order_relaxed);
+	}
+
+	// The first bytes of a packet, from the BACnet thread
+	void RecordPacket(const bool sent, const uint8_t* message, const uint16_t length);
+
+	// {"stalls":{"thresholdMs":...,"count":...,"stalled":...,"durations":{...},"last":{...}}}
+	void Report(std::ostream& out);
+
+private:
+	struct PacketHeader
+	{
+		std::atomic<uint32_t> sequence;		// Odd while it is written
+		uint64_t timestamp;					// CLatencyClock
+		uint16_t length;
+		bool sent;
+		uint8_t header[STALL_WATCHDOG_HEADER_LENGTH];
+	};
+
+	std::atomic<bool> m_running;
+	std::thread m_thread;
+	uint32_t m_thresholdMilliseconds;
+	const CLatencyHistograms* m_activity;
+	StallWatchdogProbe m_probe;
+	CMetrics* m_metrics;
+
+	// Written by the BACnet thread only
+	std::atomic<uint64_t> m_heartbeat;
+	uint64_t m_beats;
+	PacketHeader m_packets[STALL_WATCHDOG_PACKETS];
+	std::atomic<uint32_t> m_packetCount;
+
+	// Written by the watchdog thread, under m_mutex
+	std::mutex m_mutex;
+	uint64_t m_stallCount;
+	bool m_stalled;
+	CLatencyHistogram m_durations;
+	std::string m_lastSnapshot;
+
+#ifdef STALL_WATCHDOG_STACK_TRACE
+	pthread_t m_bacnetThread;
+#endif
+
+	void Run();
+	void TakeSnapshot(const uint64_t stalledMilliseconds, std::string& snapshot);
+	void WritePackets(std::ostream& out);
+	void WriteStackTrace(std::ostream& out);
+};
+
+#endif // __StallWatchdog_h__
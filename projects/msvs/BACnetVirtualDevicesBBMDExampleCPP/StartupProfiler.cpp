@@ -0,0 +1,58 @@
+/*
+ * BACnet Virtual Devices and BBMD Example C++
+ * ----------------------------------------------------------------------------
+ * StartupProfiler.cpp
+ *
+ * Timed breakdown of the application startup phases.
+ */
+
+#include "StartupProfiler.h"
+
+CStartupProfiler::CStartupProfiler() {
+	this->m_startupStart = std::chrono::steady_clock::now();
+	this->m_phaseStart = this->m_startupStart;
+	this->m_inPhase = false;
+}
+
+void CStartupProfiler::Begin(const char* name) {
+	if (this->m_inPhase) {
+		this->End();
+	}
+
+	StartupProfilerPhase phase;
+	phase.name = name;
+	phase.durationMicroseconds = 0;
+	phase.items = 0;
+	this->m_phases.push_back(phase);
+
+	this->m_inPhase = true;
+	this->m_phaseStart = std::chrono::steady_clock::now();
+}
+
+void CStartupProfiler::End(uint32_t items /* = 0 */) {
+	if (!this->m_inPhase) {
+		return;
+	}
+	StartupProfilerPhase& phase = this->m_phases.back();
+	phase.durationMicroseconds = (uint64_t)std::chrono::duration_cast<std::chrono::microseconds>(std::chrono::steady_clock::now() - this->m_phaseStart).count();
+	phase.items = items;
+	this->m_inPhase = false;
+}
+
+void CStartupProfiler::Report(std::ostream& out) {
+	if (this->m_inPhase) {
+		this->End();
+	}
+
+	uint64_t totalMicroseconds = (uint64_t)std::chrono::duration_cast<std::chrono::microseconds>(std::chrono::steady_clock::now() - this->m_startupStart).count();
+
+	out << "{\"startup\":{\"totalUs\":" << totalMicroseconds << ",\"phases\":[";
+	for (size_t i = 0; i < this->m_phases.size(); i++) {
+		const StartupProfilerPhase& phase = this->m_phases[i];
+		if (i > 0) {
+			out << ",";
+		}
+		out << "{\"name\":\"" << phase.name << "\",\"us\":" << phase.durationMicroseconds << ",\"items\":" << phase.items << "}";
+	}
+	out << "]}}" << std::endl;
+}
@@ -0,0 +1,47 @@
+/*
+ * BACnet Virtual Devices and BBMD Example C++
+ * ----------------------------------------------------------------------------
+ * StartupProfiler.h
+ *
+ * Records how long each phase of the application startup takes (loading the
+ * stack, connecting the socket, registering devices, ...) and prints the
+ * breakdown as a single report once startup is complete.
+ */
+
+#ifndef __StartupProfiler_h__
+#define __StartupProfiler_h__
+
+#include <stdint.h>
+#include <chrono>
+#include <ostream>
+#include <string>
+#include <vector>
+
+class StartupProfilerPhase
+{
+public:
+	std::string name;
+	uint64_t durationMicroseconds;
+	uint32_t items;	// Number of devices, objects, messages, ... handled by the phase
+};
+
+class CStartupProfiler
+{
+public:
+	CStartupProfiler();
+
+	// Starts a new phase. Any phase that is still running is ended first.
+	void Begin(const char* name);
+	void End(uint32_t items = 0);
+
+	// Writes all the phases as a single JSON object on one line
+	void Report(std::ostream& out);
+
+private:
+	std::vector<StartupProfilerPhase> m_phases;
+	std::chrono::steady_clock::time_point m_startupStart;
+	std::chrono::steady_clock::time_point m_phaseStart;
+	bool m_inPhase;
+};
+
+#endif // __StartupProfiler_h__
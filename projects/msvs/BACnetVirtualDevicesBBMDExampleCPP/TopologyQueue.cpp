@@ -0,0 +1,106 @@
+/*
+ * BACnet Virtual Devices and BBMD Example C++
+ * ----------------------------------------------------------------------------
+ * TopologyQueue.cpp
+ *
+ * Topology changes applied between two ticks of the main loop.
+ */
+
+#include "TopologyQueue.h"
+
+CTopologyQueue::CTopologyQueue() {
+	this->m_sharedPendingCount = 0;
+	this->m_inDelta = false;
+	this->m_deltaMicroseconds = 0;
+	this->m_applied = 0;
+	this->m_failed = 0;
+	this->m_slices = 0;
+	this->m_maxSliceMicroseconds = 0;
+}
+
+void CTopologyQueue::AddNetwork(const uint16_t network) {
+	this->Push(TOPOLOGY_ADD_NETWORK, network, 0, 0, 0);
+}
+
+void CTopologyQueue::RemoveNetwork(const uint16_t network) {
+	this->Push(TOPOLOGY_REMOVE_NETWORK, network, 0, 0, 0);
+}
+
+void CTopologyQueue::AddDevice(const uint16_t network, const uint32_t deviceInstance) {
+	this->Push(TOPOLOGY_ADD_DEVICE, network, deviceInstance, 0, 0);
+}
+
+void CTopologyQueue::RemoveDevice(const uint32_t deviceInstance) {
+	this->Push(TOPOLOGY_REMOVE_DEVICE, 0, deviceInstance, 0, 0);
+}
+
+void CTopologyQueue::AddObject(const uint32_t deviceInstance, const uint16_t objectType, const uint32_t objectInstance) {
+	this->Push(TOPOLOGY_ADD_OBJECT, 0, deviceInstance, objectType, objectInstance);
+}
+
+void CTopologyQueue::RemoveObject(const uint32_t deviceInstance, const uint16_t objectType, const uint32_t objectInstance) {
+	this->Push(TOPOLOGY_REMOVE_OBJECT, 0, deviceInstance, objectType, objectInstance);
+}
+
+void CTopologyQueue::Push(const TopologyChangeType type, const uint16_t network, const uint32_t deviceInstance, const uint16_t objectType, const uint32_t objectInstance) {
+	TopologyChange change;
+	change.type = type;
+	change.network = network;
+	change.deviceInstance = deviceInstance;
+	change.objectType = objectType;
+	change.objectInstance = objectInstance;
+	this->m_pending.push_back(change);
+	this->m_sharedPendingCount.store((uint32_t)this->m_pending.size(), std::memory_order_relaxed);
+}
+
+bool CTopologyQueue::Apply(CTopologyApplier* applier, const uint32_t budgetMicroseconds) {
+	if (this->m_pending.empty()) {
+		return false;
+	}
+
+	std::chrono::steady_clock::time_point sliceStart = std::chrono::steady_clock::now();
+	if (!this->m_inDelta) {
+		this->m_inDelta = true;
+		this->m_deltaStart = sliceStart;
+		this->m_applied = 0;
+		this->m_failed = 0;
+		this->m_slices = 0;
+		this->m_maxSliceMicroseconds = 0;
+	}
+
+	std::chrono::steady_clock::time_point deadline = sliceStart + std::chrono::microseconds(budgetMicroseconds);
+	std::chrono::steady_clock::time_point now;
+	do {
+		if (applier->Apply(this->m_pending.front())) {
+			this->m_applied++;
+		}
+		else {
+			this->m_failed++;
+		}
+		this->m_pending.pop_front();
+		this->m_sharedPendingCount.store((uint32_t)this->m_pending.size(), std::memory_order_relaxed);
+		now = std::chrono::steady_clock::now();
+	} while (!this->m_pending.empty() && now < deadline);
+
+	uint64_t sliceMicroseconds = (uint64_t)std::chrono::duration_cast<std::chrono::microseconds>(now - sliceStart).count();
+	this->m_slices++;
+	if (sliceMicroseconds > this->m_maxSliceMicroseconds) {
+		this->m_maxSliceMicroseconds = sliceMicroseconds;
+	}
+	this->m_deltaMicroseconds = (uint64_t)std::chrono::duration_cast<std::chrono::microseconds>(now - this->m_deltaStart).count();
+
+	if (!this->m_pending.empty()) {
+		return false;
+	}
+	this->m_inDelta = false;
+	return true;
+}
+
+void CTopologyQueue::Report(std::ostream& out) const {
+	out << "{\"topology\":{\"pending\":" << this->m_pending.size()
+		<< ",\"applied\":" << this->m_applied
+		<< ",\"failed\":" << this->m_failed
+		<< ",\"totalUs\":" << this->m_deltaMicroseconds
+		<< ",\"slices\":" << this->m_slices
+		<< ",\"maxSliceUs\":" << this->m_maxSliceMicroseconds << "}}" << std::endl;
+}
@@ -0,0 +1,95 @@
+/*
+ * BACnet Virtual Devices and BBMD Example C++
+ * ----------------------------------------------------------------------------
+ * TopologyQueue.h
+ *
+ * Changes to the virtual networks, devices and objects that are applied
+ * while the main loop runs, a few at a time between two ticks.
+ *
+ * Each call to Apply() works through the queue until it is empty or the
+ * time budget is used up, so a large delta (commissioning a floor of 1000
+ * devices) is spread over many loop iterations and requests keep being
+ * answered in between. A call overruns the budget by at most one change.
+ *
+ * A delta starts with the first change applied to an empty queue and ends
+ * when the queue is empty again. Its duration, number of slices and longest
+ * slice are kept for Report().
+ */
+
+#ifndef __TopologyQueue_h__
+#define __TopologyQueue_h__
+
+#include <stdint.h>
+#include <atomic>
+#include <chrono>
+#include <deque>
+#include <ostream>
+
+enum TopologyChangeType
+{
+	TOPOLOGY_ADD_NETWORK,
+	TOPOLOGY_REMOVE_NETWORK,	// Once all its devices are removed
+	TOPOLOGY_ADD_DEVICE,
+	TOPOLOGY_REMOVE_DEVICE,
+	TOPOLOGY_ADD_OBJECT,
+	TOPOLOGY_REMOVE_OBJECT
+};
+
+class TopologyChange
+{
+public:
+	TopologyChangeType type;
+	uint16_t network;			// Networks and added devices
+	uint32_t deviceInstance;	// Devices and objects
+	uint16_t objectType;		// Objects
+	uint32_t objectInstance;
+};
+
+// Applies one change to the database and the stack
+class CTopologyApplier
+{
+public:
+	virtual ~CTopologyApplier() {}
+	virtual bool Apply(const TopologyChange& change) = 0;
+};
+
+class CTopologyQueue
+{
+public:
+	CTopologyQueue();
+
+	void AddNetwork(const uint16_t network);
+	void RemoveNetwork(const uint16_t network);
+	void AddDevice(const uint16_t network, const uint32_t deviceInstance);
+	void RemoveDevice(const uint32_t deviceInstance);
+	void AddObject(const uint32_t deviceInstance, const uint16_t objectType, const uint32_t objectInstance);
+	void RemoveObject(const uint32_t deviceInstance, const uint16_t objectType, const uint32_t objectInstance);
+
+	bool IsEmpty() const { return this->m_pending.empty(); }
+	// Changes not applied yet, from any thread
+	uint32_t GetPendingCount() const { return this->m_sharedPendingCount.load(std::memory_order_relaxed); }
+
+	// Applies changes for up to budgetMicroseconds. Returns true when this
+	// call finished a delta.
+	bool Apply(CTopologyApplier* applier, const uint32_t budgetMicroseconds);
+
+	// {"topology":{"pending":...,"applied":...,"failed":...,"totalUs":...,"slices":...,"maxSliceUs":...}}
+	// for the delta in progress, or the last one
+	void Report(std::ostream& out) const;
+
+private:
+	std::deque<TopologyChange> m_pending;
+	std::atomic<uint32_t> m_sharedPendingCount;	// Copy of m_pending.size() for the other threads
+
+	bool m_inDelta;
+	std::chrono::steady_clock::time_point m_deltaStart;
+	uint64_t m_deltaMicroseconds;
+	uint32_t m_applied;
+	uint32_t m_failed;
+	uint32_t m_slices;
+	uint64_t m_maxSliceMicroseconds;
+
+	void Push(const TopologyChangeType type, const uint16_t network, const uint32_t deviceInstance, const uint16_t objectType, const uint32_t objectInstance);
+};
+
+#endif // __TopologyQueue_h__
@@ -0,0 +1,231 @@
+/*
+ * BACnet Virtual Devices and BBMD Example C++
+ * ----------------------------------------------------------------------------
+ * TrendLog.cpp
+ *
+ * Compressed history of one point, see TrendLog.h for the encoding.
+ */
+
+#include "TrendLog.h"
+
+#include <string.h>
+
+CTrendLog::CTrendLog() {
+	this->m_maxBlocks = 2;
+	this->m_oldest = 0;
+	this->m_recordCount = 0;
+	this->m_nextSequenceNumber = 1;
+	this->m_lastTimestamp = 0;
+	this->m_lastDelta = 0;
+	this->m_lastValue = 0;
+}
+
+void CTrendLog::SetCapacity(const size_t bytes) {
+	this->m_maxBlocks = bytes / sizeof(TrendLogBlock);
+	if (this->m_maxBlocks < 2) {
+		this->m_maxBlocks = 2;
+	}
+	std::vector<TrendLogBlock>().swap(this->m_blocks);
+	this->m_oldest = 0;
+	this->m_recordCount = 0;
+}
+
+TrendLogBlock& CTrendLog::StartBlock(const uint64_t timestamp, const uint32_t value) {
+	TrendLogBlock* block;
+	if (this->m_blocks.size() < this->m_maxBlocks) {
+		// Grow up to the capacity, without overshooting it
+		if (this->m_blocks.size() == this->m_blocks.capacity()) {
+			size_t capacity = this->m_blocks.capacity() < 2 ? 2 : this->m_blocks.capacity() * 2;
+			this->m_blocks.reserve(capacity < this->m_maxBlocks ? capacity : this->m_maxBlocks);
+		}
+		this->m_blocks.resize(this->m_blocks.size() + 1);
+		block = &this->m_blocks.back();
+	}
+	else {
+		// Drop the oldest block
+		block = &this->m_blocks[this->m_oldest];
+		this->m_recordCount -= block->count;
+		this->m_oldest = (this->m_oldest + 1) % this->m_blocks.size();
+	}
+
+	block->firstSequenceNumber = this->m_nextSequenceNumber;
+	block->firstTimestamp = timestamp;
+	block->firstValue = value;
+	block->count = 1;
+	block->used = 0;
+
+	// Every block is decoded on its own
+	this->m_lastDelta = 0;
+	return *block;
+}
+
+void CTrendLog::Add(const uint64_t timestamp, const float value) {
+	uint32_t bits;
+	memcpy(&bits, &value, sizeof(bits));
+
+	// The binary search by time needs the timestamps in order
+	uint64_t time = timestamp;
+	if (this->m_recordCount > 0 && time < this->m_lastTimestamp) {
+		time = this->m_lastTimestamp;
+	}
+
+	if (this->m_blocks.empty()) {
+		this->StartBlock(time, bits);
+	}
+	else {
+		// Encode the sample against the previous one
+		uint8_t encoded[TREND_LOG_MAX_SAMPLE_SIZE];
+		uint8_t length = 0;
+
+		int64_t delta = (int64_t)(time - this->m_lastTimestamp);
+		int64_t deltaOfDelta = delta - this->m_lastDelta;
+		uint64_t zigzag = ((uint64_t)deltaOfDelta << 1) ^ (uint64_t)(deltaOfDelta >> 63);
+		while (zigzag >= 0x80) {
+			encoded[length++] = (uint8_t)(zigzag | 0x80);
+			zigzag >>= 7;
+		}
+		encoded[length++] = (uint8_t)zigzag;
+
+		uint32_t difference = bits ^ this->m_lastValue;
+		if (difference == 0) {
+			encoded[length++] = 0;
+		}
+		else {
+			uint8_t trailingBytes = 0;
+			while ((difference & 0xFF) == 0) {
+				difference >>= 8;
+				trailingBytes++;
+			}
+			uint8_t significantBytes = 0;
+			uint8_t* header = &encoded[length++];
+			while (difference != 0) {
+				encoded[length++] = (uint8_t)difference;
+				difference >>= 8;
+				significantBytes++;
+			}
+			*header = (uint8_t)((trailingBytes << 4) | significantBytes);
+		}
+
+		TrendLogBlock* block = &this->m_blocks[(this->m_oldest + this->m_blocks.size() - 1) % this->m_blocks.size()];
+		if (block->used + length > TREND_LOG_BLOCK_DATA_SIZE || block->count == UINT16_MAX) {
+			this->StartBlock(time, bits);
+		}
+		else {
+			memcpy(block->data + block->used, encoded, length);
+			block->used += length;
+			block->count++;
+			this->m_lastDelta = delta;
+		}
+	}
+	this->m_lastTimestamp = time;
+	this->m_lastValue = bits;
+	this->m_nextSequenceNumber++;
+	this->m_recordCount++;
+}
+
+uint64_t CTrendLog::GetRecordCount() const {
+	return this->m_recordCount;
+}
+
+uint64_t CTrendLog::GetFirstSequenceNumber() const {
+	if (this->m_blocks.empty()) {
+		return this->m_nextSequenceNumber;
+	}
+	return this->GetBlock(0).firstSequenceNumber;
+}
+
+size_t CTrendLog::GetMemoryUsage() const {
+	return sizeof(CTrendLog) + this->m_blocks.capacity() * sizeof(TrendLogBlock);
+}
+
+size_t CTrendLog::FindBlockBySequenceNumber(const uint64_t sequenceNumber) const {
+	size_t low = 0;
+	size_t high = this->m_blocks.size();
+	while (high - low > 1) {
+		size_t middle = low + (high - low) / 2;
+		if (this->GetBlock(middle).firstSequenceNumber <= sequenceNumber) {
+			low = middle;
+		}
+		else {
+			high = middle;
+		}
+	}
+	return low;
+}
+
+size_t CTrendLog::FindBlockByTime(const uint64_t timestamp) const {
+	// Samples with the same timestamp can span blocks, so look for the last
+	// block that starts before the timestamp.
+	size_t low = 0;
+	size_t high = this->m_blocks.size();
+	while (high - low > 1) {
+		size_t middle = low + (high - low) / 2;
+		if (this->GetBlock(middle).firstTimestamp < timestamp) {
+			low = middle;
+		}
+		else {
+			high = middle;
+		}
+	}
+	return low;
+}
+
+uint32_t CTrendLog::ReadBySequenceNumber(const uint64_t firstSequenceNumber, const uint32_t count, TrendLogRecord* records) const {
+	if (this->m_blocks.empty() || count == 0) {
+		return 0;
+	}
+	return this->Read(this->FindBlockBySequenceNumber(firstSequenceNumber), firstSequenceNumber, 0, count, records);
+}
+
+uint32_t CTrendLog::ReadByTime(const uint64_t timestamp, const uint32_t count, TrendLogRecord* records) const {
+	if (this->m_blocks.empty() || count == 0) {
+		return 0;
+	}
+	return this->Read(this->FindBlockByTime(timestamp), 0, timestamp, count, records);
+}
+
+uint32_t CTrendLog::Read(size_t logicalIndex, const uint64_t firstSequenceNumber, const uint64_t timestamp, const uint32_t count, TrendLogRecord* records) const {
+	uint32_t read = 0;
+	for (; logicalIndex < this->m_blocks.size() && read < count; logicalIndex++) {
+		const TrendLogBlock& block = this->GetBlock(logicalIndex);
+
+		TrendLogRecord record;
+		record.sequenceNumber = block.firstSequenceNumber;
+		record.timestamp = block.firstTimestamp;
+		uint32_t bits = block.firstValue;
+		int64_t delta = 0;
+		uint16_t position = 0;
+
+		for (uint16_t sample = 0; sample < block.count && read < count; sample++) {
+			if (sample > 0) {
+				uint64_t zigzag = 0;
+				uint8_t shift = 0;
+				uint8_t byte;
+				do {
+					byte = block.data[position++];
+					zigzag |= (uint64_t)(byte & 0x7F) << shift;
+					shift += 7;
+				} while (byte & 0x80);
+				delta += (int64_t)(zigzag >> 1) ^ -(int64_t)(zigzag & 1);
+				record.timestamp += delta;
+
+				uint8_t header = block.data[position++];
+				if (header != 0) {
+					uint8_t significantBytes = header & 0x0F;
+					uint32_t difference = 0;
+					for (uint8_t i = 0; i < significantBytes; i++) {
+						difference |= (uint32_t)block.data[position++] << (8 * i);
+					}
+					bits ^= difference << (8 * (header >> 4));
+				}
+				record.sequenceNumber++;
+			}
+
+			if (record.sequenceNumber >= firstSequenceNumber && record.timestamp >= timestamp) {
+				memcpy(&record.value, &bits, sizeof(bits));
+				records[read++] = record;
+			}
+		}
+	}
+	return read;
+}
@@ -0,0 +1,100 @@
+/*
+ * BACnet Virtual Devices and BBMD Example C++
+ * ----------------------------------------------------------------------------
+ * TrendLog.h
+ *
+ * Compressed history of one point. Samples are stored in a ring of fixed size
+ * blocks. The first sample of a block is stored as is in the block header, the
+ * following samples are delta encoded:
+ *
+ *   timestamp	Delta of the delta to the previous sample, zigzag varint.
+ *				A fixed log interval encodes to one byte.
+ *   value		XOR with the previous value. One byte if unchanged, otherwise
+ *				a length byte and the bytes that changed.
+ *
+ * When the ring is full the oldest block is dropped. A ReadRange only decodes
+ * the blocks that hold the requested window, found with a binary search on the
+ * block headers.
+ */
+
+#ifndef __TrendLog_h__
+#define __TrendLog_h__
+
+#include <stdint.h>
+#include <stddef.h>
+#include <vector>
+
+// Constants
+#define TREND_LOG_BLOCK_DATA_SIZE		232		// Bytes of encoded samples per block, 256 bytes per block
+#define TREND_LOG_MAX_SAMPLE_SIZE		15		// 10 byte varint and 5 byte value
+
+// One decoded sample
+class TrendLogRecord
+{
+public:
+	uint64_t sequenceNumber;	// Starts at 1, never reused
+	uint64_t timestamp;			// Milliseconds since 1970-01-01 UTC
+	float value;
+};
+
+class TrendLogBlock
+{
+public:
+	uint64_t firstSequenceNumber;
+	uint64_t firstTimestamp;
+	uint32_t firstValue;		// IEEE 754 bits
+	uint16_t count;				// Samples in the block, including the first one
+	uint16_t used;				// Bytes of data used
+	uint8_t data[TREND_LOG_BLOCK_DATA_SIZE];
+};
+
+class CTrendLog
+{
+public:
+	CTrendLog();
+
+	// Largest amount of memory used by the blocks. Rounded down to whole
+	// blocks, at least two. Clears the log.
+	void SetCapacity(const size_t bytes);
+
+	void Add(const uint64_t timestamp, const float value);
+
+	// ReadRange by sequence number: up to count records starting at the first
+	// record with a sequence number of at least firstSequenceNumber.
+	// Returns the number of records read.
+	uint32_t ReadBySequenceNumber(const uint64_t firstSequenceNumber, const uint32_t count, TrendLogRecord* records) const;
+	// ReadRange by time: up to count records starting at the first record
+	// logged at or after timestamp
+	uint32_t ReadByTime(const uint64_t timestamp, const uint32_t count, TrendLogRecord* records) const;
+
+	// Number of records held, and the total number of records logged
+	uint64_t GetRecordCount() const;
+	uint64_t GetTotalRecordCount() const { return this->m_nextSequenceNumber - 1; }
+	uint64_t GetFirstSequenceNumber() const;
+
+	size_t GetMemoryUsage() const;
+
+private:
+	std::vector<TrendLogBlock> m_blocks;
+	size_t m_maxBlocks;
+	size_t m_oldest;			// Index of the oldest block once the ring is full
+	uint64_t m_recordCount;
+
+	// Encoder state, the last sample added
+	uint64_t m_nextSequenceNumber;
+	uint64_t m_lastTimestamp;
+	int64_t m_lastDelta;
+	uint32_t m_lastValue;
+
+	const TrendLogBlock& GetBlock(const size_t logicalIndex) const {
+		return this->m_blocks[(this->m_oldest + logicalIndex) % this->m_blocks.size()];
+	}
+	TrendLogBlock& StartBlock(const uint64_t timestamp, const uint32_t value);
+	// Index of the last block whose first sample is not after the key, 0 if none
+	size_t FindBlockBySequenceNumber(const uint64_t sequenceNumber) const;
+	size_t FindBlockByTime(const uint64_t timestamp) const;
+	// Decodes from logicalIndex on, skipping the records that do not match
+	uint32_t Read(size_t logicalIndex, const uint64_t firstSequenceNumber, const uint64_t timestamp, const uint32_t count, TrendLogRecord* records) const;
+};
+
+#endif // __TrendLog_h__
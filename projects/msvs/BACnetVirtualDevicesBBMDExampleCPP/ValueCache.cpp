@@ -0,0 +1,256 @@
+/*
+ * BACnet Virtual Devices and BBMD Example C++
+ * ----------------------------------------------------------------------------
+ * ValueCache.cpp
+ *
+ * Stale-while-revalidate cache of point values proxied from slow devices.
+ */
+
+#include "ValueCache.h"
+
+#include <math.h>
+#include <random>
+
+CSimulatedValueCacheBackend::CSimulatedValueCacheBackend(const uint32_t minimumMilliseconds, const uint32_t maximumMilliseconds) {
+	this->m_minimumMilliseconds = minimumMilliseconds;
+	this->m_maximumMilliseconds = maximumMilliseconds < minimumMilliseconds ? minimumMilliseconds : maximumMilliseconds;
+	this->m_reads = 0;
+}
+
+bool CSimulatedValueCacheBackend::Read(const uint32_t deviceInstance, const uint16_t, const uint32_t objectInstance, const std::chrono::steady_clock::time_point& deadline, float* value) {
+	static thread_local std::mt19937 random(std::random_device{}());
+	std::uniform_int_distribution<uint32_t> roundTrip(this->m_minimumMilliseconds, this->m_maximumMilliseconds);
+	std::chrono::steady_clock::time_point answer = std::chrono::steady_clock::now() + std::chrono::milliseconds(roundTrip(random));
+	this->m_reads++;
+
+	// Give up at the deadline, like a request that timed out
+	if (answer > deadline) {
+		std::this_thread::sleep_until(deadline);
+		return false;
+	}
+	std::this_thread::sleep_until(answer);
+
+	// A temperature that drifts slowly, different for every point
+	double seconds = std::chrono::duration<double>(answer.time_since_epoch()).count();
+	*value = (float)(21.0 + 2.0 * sin(seconds / 60.0 + deviceInstance * 0.1 + objectInstance));
+	return true;
+}
+
+CValueCache::CValueCache() {
+	this->m_backend = NULL;
+	this->m_ttlNanoseconds = 0;
+	this->m_deadlineMilliseconds = 0;
+	this->m_running = false;
+	this->m_reads = 0;
+	this->m_staleReads = 0;
+	this->m_queuedRefreshes = 0;
+	this->m_coalescedRefreshes = 0;
+	this->m_refreshed = 0;
+	this->m_expired = 0;
+	this->m_late = 0;
+	this->m_superseded = 0;
+	this->m_failed = 0;
+	this->m_refreshTotalNanoseconds = 0;
+	this->m_refreshMaxNanoseconds = 0;
+	this->m_busyWorkers = 0;
+	this->m_maxBusyWorkers = 0;
+}
+
+CValueCache::~CValueCache() {
+	this->Stop();
+}
+
+void CValueCache::Add(const uint32_t deviceInstance, const uint16_t objectType, const uint32_t objectInstance, const float value) {
+	uint32_t index;
+	if (this->m_running || this->Find(deviceInstance, objectType, objectInstance, &index)) {
+		return;
+	}
+	this->m_entries.emplace_back();
+	ValueCacheEntry& entry = this->m_entries.back();
+	entry.deviceInstance = deviceInstance;
+	entry.objectType = objectType;
+	entry.objectInstance = objectInstance;
+	entry.value = NextValue(0, value);
+	entry.updated = Now();
+	entry.queued = false;
+	this->m_index[Key(deviceInstance, objectType, objectInstance)] = (uint32_t)(this->m_entries.size() - 1);
+}
+
+bool CValueCache::Start(CValueCacheBackend* backend, const uint32_t ttlMilliseconds, const uint32_t workerCount, const uint32_t deadlineMilliseconds) {
+	if (this->m_running) {
+		return true;
+	}
+	if (backend == NULL || workerCount == 0) {
+		return false;
+	}
+	this->m_backend = backend;
+	this->m_ttlNanoseconds = (int64_t)ttlMilliseconds * 1000000;
+	this->m_deadlineMilliseconds = deadlineMilliseconds;
+	this->m_running = true;
+	for (uint32_t i = 0; i < workerCount; i++) {
+		this->m_workers.push_back(std::thread(&CValueCache::Run, this));
+	}
+	return true;
+}
+
+void CValueCache::Stop() {
+	{
+		std::lock_guard<std::mutex> lock(this->m_queueLock);
+		this->m_running = false;
+	}
+	this->m_queueSignal.notify_all();
+	for (size_t i = 0; i < this->m_workers.size(); i++) {
+		this->m_workers[i].join();
+	}
+	this->m_workers.clear();
+
+	// The points that were still queued are refreshed again after a restart
+	for (size_t i = 0; i < this->m_queue.size(); i++) {
+		this->m_entries[this->m_queue[i].index].queued.store(false, std::memory_order_relaxed);
+	}
+	this->m_queue.clear();
+}
+
+bool CValueCache::Get(const uint32_t deviceInstance, const uint16_t objectType, const uint32_t objectInstance, float* value, uint64_t* ageMilliseconds /* = NULL */) {
+	uint32_t index;
+	if (!this->Find(deviceInstance, objectType, objectInstance, &index)) {
+		return false;
+	}
+	ValueCacheEntry* entry = &this->m_entries[index];
+	this->m_reads++;
+
+	uint64_t current = entry->value.load(std::memory_order_relaxed);
+	uint32_t bits = (uint32_t)current;
+	memcpy(value, &bits, sizeof(bits));
+	int64_t age = Now() - entry->updated.load(std::memory_order_relaxed);
+	if (ageMilliseconds != NULL) {
+		*ageMilliseconds = age > 0 ? (uint64_t)age / 1000000 : 0;
+	}
+	if (age <= this->m_ttlNanoseconds || !this->m_running) {
+		return true;
+	}
+
+	// Stale. Serve it anyway and have it refreshed, unless it already is.
+	this->m_staleReads++;
+	if (entry->queued.load(std::memory_order_relaxed) || entry->queued.exchange(true, std::memory_order_acquire)) {
+		this->m_coalescedRefreshes++;
+		return true;
+	}
+	ValueCacheRequest request;
+	request.index = index;
+	request.value = current;
+	request.deadline = std::chrono::steady_clock::now() + std::chrono::milliseconds(this->m_deadlineMilliseconds);
+	{
+		std::lock_guard<std::mutex> lock(this->m_queueLock);
+		this->m_queue.push_back(request);
+	}
+	this->m_queueSignal.notify_one();
+	this->m_queuedRefreshes++;
+	return true;
+}
+
+bool CValueCache::Update(const uint32_t deviceInstance, const uint16_t objectType, const uint32_t objectInstance, const float value) {
+	uint32_t index;
+	if (!this->Find(deviceInstance, objectType, objectInstance, &index)) {
+		return false;
+	}
+	ValueCacheEntry* entry = &this->m_entries[index];
+	uint64_t previous = entry->value.load(std::memory_order_relaxed);
+	while (!entry->value.compare_exchange_weak(previous, NextValue(previous, value), std::memory_order_relaxed)) {
+	}
+	entry->updated.store(Now(), std::memory_order_relaxed);
+	return true;
+}
+
+void CValueCache::Remove(const uint32_t deviceInstance, const uint16_t objectType, const uint32_t objectInstance) {
+	this->m_index.erase(Key(deviceInstance, objectType, objectInstance));
+}
+
+bool CValueCache::Find(const uint32_t deviceInstance, const uint16_t objectType, const uint32_t objectInstance, uint32_t* index) const {
+	std::unordered_map<uint64_t, uint32_t>::const_iterator it = this->m_index.find(Key(deviceInstance, objectType, objectInstance));
+	if (it == this->m_index.end()) {
+		return false;
+	}
+	*index = it->second;
+	return true;
+}
+
+void CValueCache::Run() {
+	for (;;) {
+		ValueCacheRequest request;
+		{
+			std::unique_lock<std::mutex> lock(this->m_queueLock);
+			while (this->m_running && this->m_queue.empty()) {
+				this->m_queueSignal.wait(lock);
+			}
+			if (!this->m_running) {
+				return;
+			}
+			request = this->m_queue.front();
+			this->m_queue.pop_front();
+		}
+		this->Refresh(request);
+	}
+}
+
+void CValueCache::Refresh(const ValueCacheRequest& request) {
+	ValueCacheEntry& entry = this->m_entries[request.index];
+	std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+	if (start >= request.deadline) {
+		// Waited in the queue for too long, all the workers were busy
+		this->m_expired++;
+		entry.queued.store(false, std::memory_order_release);
+		return;
+	}
+
+	uint32_t busy = ++this->m_busyWorkers;
+	uint32_t maxBusy = this->m_maxBusyWorkers.load(std::memory_order_relaxed);
+	while (busy > maxBusy && !this->m_maxBusyWorkers.compare_exchange_weak(maxBusy, busy, std::memory_order_relaxed)) {
+	}
+
+	float value;
+	uint64_t expected = request.value;
+	bool ok = this->m_backend->Read(entry.deviceInstance, entry.objectType, entry.objectInstance, request.deadline, &value);
+	std::chrono::steady_clock::time_point end = std::chrono::steady_clock::now();
+	this->m_busyWorkers--;
+
+	if (!ok) {
+		this->m_failed++;
+	}
+	else if (end > request.deadline) {
+		this->m_late++;
+	}
+	else if (!entry.value.compare_exchange_strong(expected, NextValue(expected, value), std::memory_order_relaxed)) {
+		// Update() stored a newer value while the backend was read
+		this->m_superseded++;
+	}
+	else {
+		entry.updated.store(Now(), std::memory_order_relaxed);
+		this->m_refreshed++;
+
+		uint64_t nanoseconds = (uint64_t)std::chrono::duration_cast<std::chrono::nanoseconds>(end - start).count();
+		this->m_refreshTotalNanoseconds += nanoseconds;
+		uint64_t maxNanoseconds = this->m_refreshMaxNanoseconds.load(std::memory_order_relaxed);
+		while (nanoseconds > maxNanoseconds && !this->m_refreshMaxNanoseconds.compare_exchange_weak(maxNanoseconds, nanoseconds, std::memory_order_relaxed)) {
+		}
+	}
+	entry.queued.store(false, std::memory_order_release);
+}
+
+void CValueCache::Report(std::ostream& out) {
+	size_t queueLength;
+	{
+		std::lock_guard<std::mutex> lock(this->m_queueLock);
+		queueLength = this->m_queue.size();
+	}
+	uint64_t refreshed = this->m_refreshed;
+	out << "{\"valueCache\":{\"points\":" << this->m_entries.size();
+	out << ",\"ttlMs\":" << this->m_ttlNanoseconds / 1000000 << ",\"workers\":" << this->m_workers.size() << ",\"deadlineMs\":" << this->m_deadlineMilliseconds;
+	out << ",\"reads\":" << this->m_reads << ",\"staleReads\":" << this->m_staleReads;
+	out << ",\"queued\":" << this->m_queuedRefreshes << ",\"coalesced\":" << this->m_coalescedRefreshes << ",\"queueLength\":" << queueLength;
+	out << ",\"refreshed\":" << refreshed << ",\"expired\":" << this->m_expired << ",\"late\":" << this->m_late << ",\"superseded\":" << this->m_superseded << ",\"failed\":" << this->m_failed;
+	out << ",\"refreshMeanMs\":" << (refreshed > 0 ? this->m_refreshTotalNanoseconds / refreshed / 1000000 : 0);
+	out << ",\"refreshMaxMs\":" << this->m_refreshMaxNanoseconds / 1000000;
+	out << ",\"maxBusyWorkers\":" << this->m_maxBusyWorkers;
+	out << "}}" << std::endl;
+}
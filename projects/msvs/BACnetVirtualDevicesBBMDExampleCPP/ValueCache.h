@@ -0,0 +1,168 @@
+/*
+ * BACnet Virtual Devices and BBMD Example C++
+ * ----------------------------------------------------------------------------
+ * ValueCache.h
+ *
+ * Stale-while-revalidate cache of point values that are proxied from slow
+ * downstream devices.
+ *
+ * The property callbacks must answer from memory, so a read is always served
+ * right away with the last known value. If that value is older than the TTL
+ * a refresh of the point is queued. A point is queued at most once: reads of
+ * a point that is already waiting for a refresh are coalesced into it. A
+ * pool of worker threads takes the refreshes from the queue and reads the
+ * points from a pluggable backend (CValueCacheBackend).
+ *
+ * Every refresh has a deadline, counted from the time it was queued. A
+ * refresh that is still queued at its deadline is dropped, and a backend
+ * result that arrives after it is discarded. Either way the next read of the
+ * point queues it again. A backend result is also discarded if Update() stored
+ * a value while the refresh was running, the refresh would be older.
+ *
+ * The points are registered before Start(). After that the index is only
+ * used by the BACnet thread, which may Remove() points, so Get() and Update()
+ * take no lock. Only the queue is locked, and only when a refresh is queued.
+ */
+
+#ifndef __ValueCache_h__
+#define __ValueCache_h__
+
+#include <stdint.h>
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <deque>
+#include <mutex>
+#include <ostream>
+#include <string.h>
+#include <thread>
+#include <unordered_map>
+#include <vector>
+
+// Reads points from the downstream devices. Called from the worker threads,
+// concurrently, so implementations must be thread safe.
+class CValueCacheBackend
+{
+public:
+	virtual ~CValueCacheBackend() {}
+
+	// Reads the present value of the object. Should give up and return false
+	// once the deadline has passed.
+	virtual bool Read(const uint32_t deviceInstance, const uint16_t objectType, const uint32_t objectInstance, const std::chrono::steady_clock::time_point& deadline, float* value) = 0;
+};
+
+// Backend with a random round trip between minimum and maximum, the way a
+// BACnet MS/TP or Modbus device behind a gateway answers
+class CSimulatedValueCacheBackend : public CValueCacheBackend
+{
+public:
+	CSimulatedValueCacheBackend(const uint32_t minimumMilliseconds, const uint32_t maximumMilliseconds);
+
+	virtual bool Read(const uint32_t deviceInstance, const uint16_t objectType, const uint32_t objectInstance, const std::chrono::steady_clock::time_point& deadline, float* value);
+
+	uint64_t GetReadCount() const { return this->m_reads.load(std::memory_order_relaxed); }
+
+private:
+	uint32_t m_minimumMilliseconds;
+	uint32_t m_maximumMilliseconds;
+	std::atomic<uint64_t> m_reads;
+};
+
+class ValueCacheEntry
+{
+public:
+	uint32_t deviceInstance;
+	uint16_t objectType;
+	uint32_t objectInstance;
+	std::atomic<uint64_t> value;			// Generation << 32 | IEEE 754 bits, every store bumps the generation
+	std::atomic<int64_t> updated;			// steady_clock nanoseconds
+	std::atomic<bool> queued;				// Waiting for, or being refreshed
+};
+
+class ValueCacheRequest
+{
+public:
+	uint32_t index;
+	uint64_t value;							// ValueCacheEntry::value when queued
+	std::chrono::steady_clock::time_point deadline;
+};
+
+class CValueCache
+{
+public:
+	CValueCache();
+	~CValueCache();
+
+	// Registers a point with its initial value. Must be called before Start().
+	void Add(const uint32_t deviceInstance, const uint16_t objectType, const uint32_t objectInstance, const float value);
+	size_t GetPointCount() const { return this->m_entries.size(); }
+
+	// Values older than ttlMilliseconds are refreshed by workerCount threads,
+	// each refresh within deadlineMilliseconds. The backend must outlive the
+	// cache.
+	bool Start(CValueCacheBackend* backend, const uint32_t ttlMilliseconds, const uint32_t workerCount, const uint32_t deadlineMilliseconds);
+	void Stop();
+	bool IsRunning() const { return this->m_running; }
+
+	// Last known value, never waits. Queues a refresh if the value is stale.
+	// age is optional. Only called from the BACnet thread.
+	bool Get(const uint32_t deviceInstance, const uint16_t objectType, const uint32_t objectInstance, float* value, uint64_t* ageMilliseconds = NULL);
+	// Stores a value that is known to be current, for example one that was
+	// just written to the point
+	bool Update(const uint32_t deviceInstance, const uint16_t objectType, const uint32_t objectInstance, const float value);
+	// Forgets a point whose object was removed. Its entry stays in place for
+	// a refresh that is still running. Only called from the BACnet thread.
+	void Remove(const uint32_t deviceInstance, const uint16_t objectType, const uint32_t objectInstance);
+
+	// Writes the statistics as a single JSON object on one line
+	void Report(std::ostream& out);
+
+private:
+	std::deque<ValueCacheEntry> m_entries;	// Entries are never moved
+	std::unordered_map<uint64_t, uint32_t> m_index;
+
+	CValueCacheBackend* m_backend;
+	int64_t m_ttlNanoseconds;
+	uint32_t m_deadlineMilliseconds;
+	std::atomic<bool> m_running;
+	std::vector<std::thread> m_workers;
+
+	std::mutex m_queueLock;
+	std::condition_variable m_queueSignal;
+	std::deque<ValueCacheRequest> m_queue;
+
+	// BACnet thread statistics
+	uint64_t m_reads;
+	uint64_t m_staleReads;
+	uint64_t m_queuedRefreshes;
+	uint64_t m_coalescedRefreshes;
+
+	// Worker statistics
+	std::atomic<uint64_t> m_refreshed;
+	std::atomic<uint64_t> m_expired;			// Deadline passed while queued
+	std::atomic<uint64_t> m_late;				// Backend answered after the deadline
+	std::atomic<uint64_t> m_superseded;		// Update() stored a newer value meanwhile
+	std::atomic<uint64_t> m_failed;
+	std::atomic<uint64_t> m_refreshTotalNanoseconds;
+	std::atomic<uint64_t> m_refreshMaxNanoseconds;
+	std::atomic<uint32_t> m_busyWorkers;
+	std::atomic<uint32_t> m_maxBusyWorkers;
+
+	bool Find(const uint32_t deviceInstance, const uint16_t objectType, const uint32_t objectInstance, uint32_t* index) const;
+	static uint64_t Key(const uint32_t deviceInstance, const uint16_t objectType, const uint32_t objectInstance) {
+		// The device instance and the BACnet object identifier
+		return ((uint64_t)deviceInstance << 32) | ((uint64_t)objectType << 22) | (objectInstance & 0x3FFFFF);
+	}
+	static uint64_t NextValue(const uint64_t previous, const float value) {
+		uint32_t bits;
+		memcpy(&bits, &value, sizeof(bits));
+		return ((previous >> 32) + 1) << 32 | bits;
+	}
+	static int64_t Now() {
+		return (int64_t)std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::steady_clock::now().time_since_epoch()).count();
+	}
+	void Run();
+	void Refresh(const ValueCacheRequest& request);
+};
+
+#endif // __ValueCache_h__
@@ -0,0 +1,177 @@
+/*
+ * BACnet Virtual Devices and BBMD Example C++
+ * ----------------------------------------------------------------------------
+ * WhoHasFilter.cpp
+ *
+ * Who-Has requests for names none of the devices have.
+ */
+
+#include "WhoHasFilter.h"
+#include "ExampleDatabase.h"
+#include "NPDUHeader.h"
+
+#include <string.h>
+
+// Unconfirmed-Request PDU, Who-Has service choice
+#define APDU_TYPE_UNCONFIRMED_REQUEST		0x10
+#define SERVICE_WHO_HAS						7
+
+// Context tags of the Who-Has request
+#define WHO_HAS_TAG_LOW_LIMIT				0
+#define WHO_HAS_TAG_HIGH_LIMIT				1
+#define WHO_HAS_TAG_OBJECT_IDENTIFIER		2
+#define WHO_HAS_TAG_OBJECT_NAME				3
+
+#define CHARACTER_SET_UTF8					0
+#define MAX_DEVICE_INSTANCE					0x3FFFFF
+
+// Names the stack gives the network ports of the virtual networks
+static const char GENERATED_NAME_PREFIX[] = "Network Port ";
+
+// A context tag at offset: its number and the offset and length of its
+// contents. Opening and closing tags are not used by Who-Has.
+static bool ParseContextTag(const uint8_t* apdu, const uint16_t length, uint16_t* offset, uint8_t* tagNumber, uint32_t* contentLength) {
+	if (*offset >= length) {
+		return false;
+	}
+	const uint8_t tag = apdu[*offset];
+	if ((tag & 0x08) == 0 || (tag & 0xF0) == 0xF0 || (tag & 0x07) > 5) {
+		return false;
+	}
+	*tagNumber = tag >> 4;
+	*contentLength = tag & 0x07;
+	(*offset)++;
+	if (*contentLength == 5) {
+		// Extended length, one, two or four bytes
+		if (*offset >= length) {
+			return false;
+		}
+		*contentLength = apdu[(*offset)++];
+		if (*contentLength == 254) {
+			if (*offset + 2 > length) {
+				return false;
+			}
+			*contentLength = (uint32_t)apdu[*offset] << 8 | apdu[*offset + 1];
+			*offset += 2;
+		}
+		else if (*contentLength == 255) {
+			if (*offset + 4 > length) {
+				return false;
+			}
+			*contentLength = (uint32_t)apdu[*offset] << 24 | (uint32_t)apdu[*offset + 1] << 16 | (uint32_t)apdu[*offset + 2] << 8 | apdu[*offset + 3];
+			*offset += 4;
+		}
+	}
+	return *offset + *contentLength <= length;
+}
+
+static bool ParseUnsigned(const uint8_t* contents, const uint32_t length, uint32_t* value) {
+	if (length == 0 || length > 4) {
+		return false;
+	}
+	*value = 0;
+	for (uint32_t i = 0; i < length; i++) {
+		*value = *value << 8 | contents[i];
+	}
+	return true;
+}
+
+CWhoHasFilter::CWhoHasFilter() {
+	this->m_enabled = false;
+	this->m_forwardsBroadcasts = false;
+	this->Clear();
+}
+
+void CWhoHasFilter::Clear() {
+	this->m_byName = 0;
+	this->m_dropped = 0;
+	this->m_other = 0;
+}
+
+bool CWhoHasFilter::ParseWhoHas(const uint8_t* apdu, const uint16_t length, uint32_t* lowDeviceInstance, uint32_t* highDeviceInstance, uint8_t* characterSet, const char** name, size_t* nameLength) {
+	if (length < 3 || apdu[0] != APDU_TYPE_UNCONFIRMED_REQUEST || apdu[1] != SERVICE_WHO_HAS) {
+		return false;
+	}
+	uint16_t offset = 2;
+	uint8_t tagNumber;
+	uint32_t contentLength;
+	if (!ParseContextTag(apdu, length, &offset, &tagNumber, &contentLength)) {
+		return false;
+	}
+
+	// The limits come both or not at all
+	*lowDeviceInstance = 0;
+	*highDeviceInstance = MAX_DEVICE_INSTANCE;
+	if (tagNumber == WHO_HAS_TAG_LOW_LIMIT) {
+		if (!ParseUnsigned(apdu + offset, contentLength, lowDeviceInstance)) {
+			return false;
+		}
+		offset += (uint16_t)contentLength;
+		if (!ParseContextTag(apdu, length, &offset, &tagNumber, &contentLength) || tagNumber != WHO_HAS_TAG_HIGH_LIMIT ||
+			!ParseUnsigned(apdu + offset, contentLength, highDeviceInstance))
+		{
+			return false;
+		}
+		offset += (uint16_t)contentLength;
+		if (!ParseContextTag(apdu, length, &offset, &tagNumber, &contentLength)) {
+			return false;
+		}
+	}
+
+	// A character string, its first byte is the character set
+	if (tagNumber != WHO_HAS_TAG_OBJECT_NAME || contentLength == 0) {
+		return false;
+	}
+	*characterSet = apdu[offset];
+	*name = (const char*)apdu + offset + 1;
+	*nameLength = contentLength - 1;
+	return true;
+}
+
+bool CWhoHasFilter::Filter(const uint8_t* message, const uint16_t length, ExampleDatabase& database) {
+	if (!this->m_enabled) {
+		return false;
+	}
+
+	// Who-Has can only be an APDU
+	NPDUHeader header;
+	if (!ParseNPDUHeader(message, length, &header) || (header.control & ExampleConstants::NPDU_CONTROL_NETWORK_LAYER_MESSAGE)) {
+		return false;
+	}
+	if (header.broadcast && this->m_forwardsBroadcasts) {
+		return false;
+	}
+	// Quick reject of everything else before the APDU is parsed
+	const uint8_t* apdu = message + header.apduOffset;
+	const uint16_t apduLength = length - header.apduOffset;
+	if (apduLength < 2 || apdu[0] != APDU_TYPE_UNCONFIRMED_REQUEST || apdu[1] != SERVICE_WHO_HAS) {
+		return false;
+	}
+
+	uint32_t lowDeviceInstance, highDeviceInstance;
+	uint8_t characterSet;
+	const char* name;
+	size_t nameLength;
+	if (!ParseWhoHas(apdu, apduLength, &lowDeviceInstance, &highDeviceInstance, &characterSet, &name, &nameLength)) {
+		this->m_other++;
+		return false;
+	}
+	this->m_byName++;
+	if (characterSet != CHARACTER_SET_UTF8 || (nameLength >= sizeof(GENERATED_NAME_PREFIX) - 1 && memcmp(name, GENERATED_NAME_PREFIX, sizeof(GENERATED_NAME_PREFIX) - 1) == 0)) {
+		return false;
+	}
+	if (header.destinationNetwork != 0 && header.destinationNetwork != ExampleConstants::NPDU_GLOBAL_BROADCAST && !database.HasVirtualNetwork(header.destinationNetwork)) {
+		return false;
+	}
+	if (database.HasObjectNamed(name, nameLength, lowDeviceInstance, highDeviceInstance)) {
+		return false;
+	}
+	this->m_dropped++;
+	return true;
+}
+
+void CWhoHasFilter::Report(std::ostream& out) const {
+	out << "{\"enabled\":" << (this->m_enabled ? "true" : "false") << ",\"byName\":" << this->m_byName;
+	out << ",\"dropped\":" << this->m_dropped << ",\"passed\":" << this->m_byName - this->m_dropped;
+	out << ",\"other\":" << this->m_other << "}" << std::endl;
+}
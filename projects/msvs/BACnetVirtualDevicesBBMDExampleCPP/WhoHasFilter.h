@@ -0,0 +1,67 @@
+/*
+ * BACnet Virtual Devices and BBMD Example C++
+ * ----------------------------------------------------------------------------
+ * WhoHasFilter.h
+ *
+ * Drops the Who-Has requests that none of the devices can answer before they
+ * reach the stack.
+ *
+ * For a Who-Has by object name the stack walks every object of every device
+ * in the range and reads its name through the callbacks, to answer nothing
+ * most of the time: the name is looked for on the whole site and belongs to
+ * one device, elsewhere. Filter() looks the name up in the name index of the
+ * database instead and drops the message when no device in the range has an
+ * object of that name. When one does the message goes to the stack, which
+ * sends the I-Have from the right device.
+ *
+ * Passed on untouched:
+ *   - Who-Has by object identifier.
+ *   - Names in a character set other than UTF-8.
+ *   - Names starting with "Network Port ", the stack names the network
+ *     ports of the virtual networks itself.
+ *   - Messages for a network that is not one of the virtual networks.
+ *   - Broadcasts, when this process is the BBMD (SetForwardsBroadcasts()),
+ *     it has to distribute them whatever they ask for.
+ *
+ * Called from the BACnet thread only.
+ */
+
+#ifndef __WhoHasFilter_h__
+#define __WhoHasFilter_h__
+
+#include <stdint.h>
+#include <stddef.h>
+#include <ostream>
+
+class ExampleDatabase;
+
+class CWhoHasFilter
+{
+public:
+	CWhoHasFilter();
+
+	void SetEnabled(const bool enabled) { this->m_enabled = enabled; }
+	bool IsEnabled() const { return this->m_enabled; }
+	void SetForwardsBroadcasts(const bool forwardsBroadcasts) { this->m_forwardsBroadcasts = forwardsBroadcasts; }
+
+	// True when the message is to be dropped
+	bool Filter(const uint8_t* message, const uint16_t length, ExampleDatabase& database);
+
+	void Clear();
+
+	// {"enabled":...,"byName":...,"dropped":...,"passed":...,"other":...}
+	void Report(std::ostream& out) const;
+
+	// The device range and the object name of a Who-Has, at the start of the
+	// APDU. False if it is not a Who-Has or it asks for an object identifier.
+	static bool ParseWhoHas(const uint8_t* apdu, const uint16_t length, uint32_t* lowDeviceInstance, uint32_t* highDeviceInstance, uint8_t* characterSet, const char** name, size_t* nameLength);
+
+private:
+	bool m_enabled;
+	bool m_forwardsBroadcasts;
+	uint64_t m_byName;			// Who-Has by object name
+	uint64_t m_dropped;
+	uint64_t m_other;			// Who-Has by object identifier, or not understood
+};
+
+#endif // __WhoHasFilter_h__
@@ -0,0 +1,172 @@
+/*
+ * BACnet Virtual Devices and BBMD Example C++
+ * ----------------------------------------------------------------------------
+ * WriteBackend.cpp
+ *
+ * Batched write-through of WriteProperty values to a simulated backend.
+ */
+
+#include "WriteBackend.h"
+
+CWriteBackend::CWriteBackend() {
+	this->m_head = 0;
+	this->m_tail = 0;
+	this->m_running = false;
+	this->m_idle = false;
+	this->m_busDelayMicroseconds = 0;
+	this->m_enqueued = 0;
+	this->m_rejected = 0;
+	this->m_ackCount = 0;
+	this->m_ackTotalNanoseconds = 0;
+	this->m_ackMaxNanoseconds = 0;
+	this->m_batches = 0;
+	this->m_written = 0;
+	for (size_t i = 0; i < WRITE_BACKEND_HISTOGRAM_BUCKETS; i++) {
+		this->m_batchSizeHistogram[i] = 0;
+	}
+	this->m_writeThroughTotalNanoseconds = 0;
+	this->m_writeThroughMaxNanoseconds = 0;
+}
+
+CWriteBackend::~CWriteBackend() {
+	this->Stop();
+}
+
+bool CWriteBackend::Start(const uint32_t busDelayMicroseconds) {
+	if (this->m_running) {
+		return true;
+	}
+	this->m_busDelayMicroseconds = busDelayMicroseconds;
+	this->m_running = true;
+	this->m_thread = std::thread(&CWriteBackend::Run, this);
+	return true;
+}
+
+void CWriteBackend::Stop() {
+	{
+		std::lock_guard<std::mutex> lock(this->m_idleLock);
+		this->m_running = false;
+	}
+	this->m_idleSignal.notify_all();
+	if (this->m_thread.joinable()) {
+		this->m_thread.join();
+	}
+}
+
+bool CWriteBackend::Enqueue(const WriteBackendRecord& record) {
+	uint32_t head = this->m_head.load(std::memory_order_relaxed);
+	uint32_t tail = this->m_tail.load(std::memory_order_acquire);
+	if (head - tail >= WRITE_BACKEND_QUEUE_SIZE) {
+		this->m_rejected++;
+		return false;
+	}
+	this->m_queue[head & (WRITE_BACKEND_QUEUE_SIZE - 1)] = record;
+	// Sequentially consistent with m_idle, so that either the worker sees the
+	// record before it waits or this sees that it is waiting
+	this->m_head.store(head + 1, std::memory_order_seq_cst);
+	this->m_enqueued++;
+	if (this->m_idle.load(std::memory_order_seq_cst)) {
+		std::lock_guard<std::mutex> lock(this->m_idleLock);
+		this->m_idleSignal.notify_one();
+	}
+	return true;
+}
+
+void CWriteBackend::RecordAckLatency(const uint64_t nanoseconds) {
+	this->m_ackCount++;
+	this->m_ackTotalNanoseconds += nanoseconds;
+	if (nanoseconds > this->m_ackMaxNanoseconds) {
+		this->m_ackMaxNanoseconds = nanoseconds;
+	}
+}
+
+void CWriteBackend::Run() {
+	WriteBackendRecord batch[WRITE_BACKEND_MAX_BATCH];
+	for (;;) {
+		uint32_t tail = this->m_tail.load(std::memory_order_relaxed);
+		uint32_t head = this->m_head.load(std::memory_order_acquire);
+		if (head == tail) {
+			// Drain everything before stopping
+			if (!this->m_running) {
+				return;
+			}
+			// Wait for Enqueue() or Stop()
+			std::unique_lock<std::mutex> lock(this->m_idleLock);
+			this->m_idle.store(true, std::memory_order_seq_cst);
+			while (this->m_running && this->m_head.load(std::memory_order_seq_cst) == tail) {
+				this->m_idleSignal.wait(lock);
+			}
+			this->m_idle.store(false, std::memory_order_relaxed);
+			continue;
+		}
+
+		// Take everything that is waiting, up to one batch. The slots are
+		// copied out before they are released to the producer.
+		uint32_t count = head - tail;
+		if (count > WRITE_BACKEND_MAX_BATCH) {
+			count = WRITE_BACKEND_MAX_BATCH;
+		}
+		for (uint32_t i = 0; i < count; i++) {
+			batch[i] = this->m_queue[(tail + i) & (WRITE_BACKEND_QUEUE_SIZE - 1)];
+		}
+		this->m_tail.store(tail + count, std::memory_order_release);
+
+		this->Flush(batch, count);
+	}
+}
+
+void CWriteBackend::Flush(const WriteBackendRecord* records, const uint32_t count) {
+	// Simulated backend, one round trip per batch
+	if (this->m_busDelayMicroseconds > 0) {
+		std::this_thread::sleep_for(std::chrono::microseconds(this->m_busDelayMicroseconds));
+	}
+
+	std::chrono::steady_clock::time_point now = std::chrono::steady_clock::now();
+	uint64_t total = 0;
+	uint64_t maximum = this->m_writeThroughMaxNanoseconds.load(std::memory_order_relaxed);
+	for (uint32_t i = 0; i < count; i++) {
+		uint64_t latency = (uint64_t)std::chrono::duration_cast<std::chrono::nanoseconds>(now - records[i].queued).count();
+		total += latency;
+		if (latency > maximum) {
+			maximum = latency;
+		}
+	}
+
+	size_t bucket = 0;
+	while ((2u << bucket) <= count && bucket < WRITE_BACKEND_HISTOGRAM_BUCKETS - 1) {
+		bucket++;
+	}
+	this->m_batchSizeHistogram[bucket].fetch_add(1, std::memory_order_relaxed);
+	this->m_batches.fetch_add(1, std::memory_order_relaxed);
+	this->m_written.fetch_add(count, std::memory_order_relaxed);
+	this->m_writeThroughTotalNanoseconds.fetch_add(total, std::memory_order_relaxed);
+	this->m_writeThroughMaxNanoseconds.store(maximum, std::memory_order_relaxed);
+}
+
+void CWriteBackend::Report(std::ostream& out) {
+	uint64_t batches = this->m_batches.load(std::memory_order_relaxed);
+	uint64_t written = this->m_written.load(std::memory_order_relaxed);
+
+	out << "{\"writeBackend\":{\"enqueued\":" << this->m_enqueued << ",\"rejected\":" << this->m_rejected;
+	out << ",\"queued\":" << (this->m_head.load() - this->m_tail.load());
+	out << ",\"ack\":{\"count\":" << this->m_ackCount << ",\"avgNs\":" << (this->m_ackCount > 0 ? this->m_ackTotalNanoseconds / this->m_ackCount : 0) << ",\"maxNs\":" << this->m_ackMaxNanoseconds << "}";
+	out << ",\"backend\":{\"batches\":" << batches << ",\"written\":" << written << ",\"avgBatch\":" << (batches > 0 ? (double)written / batches : 0.0);
+	out << ",\"avgWriteThroughUs\":" << (written > 0 ? this->m_writeThroughTotalNanoseconds.load() / written / 1000 : 0) << ",\"maxWriteThroughUs\":" << this->m_writeThroughMaxNanoseconds.load() / 1000;
+	out << ",\"batchSizes\":{";
+	for (size_t i = 0; i < WRITE_BACKEND_HISTOGRAM_BUCKETS; i++) {
+		if (i > 0) {
+			out << ",";
+		}
+		if (i == WRITE_BACKEND_HISTOGRAM_BUCKETS - 1) {
+			out << "\"" << (1u << i) << "+\":";
+		}
+		else if (i == 0) {
+			out << "\"1\":";
+		}
+		else {
+			out << "\"" << (1u << i) << "-" << ((2u << i) - 1) << "\":";
+		}
+		out << this->m_batchSizeHistogram[i].load(std::memory_order_relaxed);
+	}
+	out << "}}}}" << std::endl;
+}
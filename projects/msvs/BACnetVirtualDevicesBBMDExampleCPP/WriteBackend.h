@@ -0,0 +1,104 @@
+/*
+ * BACnet Virtual Devices and BBMD Example C++
+ * ----------------------------------------------------------------------------
+ * WriteBackend.h
+ *
+ * Write-through of WriteProperty values to a backend (field bus, PLC, ...).
+ * The property callbacks update the example database right away and push the
+ * change into a lock-free single producer / single consumer queue. A worker
+ * thread drains the queue in batches, so a slow backend never stalls fpTick().
+ * When the queue is empty the worker waits on a condition variable, and the
+ * producer only takes the lock to wake it when it is waiting.
+ *
+ * The backend in this example is simulated: every batch costs a fixed round
+ * trip delay, the way one multi-point write to a field bus would.
+ */
+
+#ifndef __WriteBackend_h__
+#define __WriteBackend_h__
+
+#include <stdint.h>
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <mutex>
+#include <ostream>
+#include <thread>
+
+// Constants
+#define WRITE_BACKEND_QUEUE_SIZE			4096	// Must be a power of two
+#define WRITE_BACKEND_MAX_BATCH				64
+#define WRITE_BACKEND_HISTOGRAM_BUCKETS		7		// 1, 2-3, 4-7, ... 32-63, 64
+
+// One written value. For the commandable outputs a write and a relinquish
+// both carry the present value the output ends up at, the winner of its
+// priority array, so the backend always mirrors the output. priority is the
+// slot that was written or relinquished.
+class WriteBackendRecord
+{
+public:
+	uint32_t deviceInstance;
+	uint16_t objectType;
+	uint32_t objectInstance;
+	uint32_t propertyIdentifier;
+	float value;
+	uint8_t priority;
+	std::chrono::steady_clock::time_point queued;
+};
+
+class CWriteBackend
+{
+public:
+	CWriteBackend();
+	~CWriteBackend();
+
+	// Starts the worker thread. busDelayMicroseconds is the simulated cost of
+	// writing one batch to the backend.
+	bool Start(const uint32_t busDelayMicroseconds);
+	void Stop();
+
+	// Producer side, only called from the thread that runs fpTick().
+	// Returns false if the queue is full.
+	bool Enqueue(const WriteBackendRecord& record);
+	// Time from the start of the write callback until it acknowledged the write
+	void RecordAckLatency(const uint64_t nanoseconds);
+
+	// Writes the statistics as a single JSON object on one line
+	void Report(std::ostream& out);
+	// Records queued and not yet written, from any thread
+	uint32_t GetQueuedCount() const { return this->m_head.load(std::memory_order_relaxed) - this->m_tail.load(std::memory_order_relaxed); }
+
+private:
+	WriteBackendRecord m_queue[WRITE_BACKEND_QUEUE_SIZE];
+
+	// Written by the producer and the consumer respectively. Kept on separate
+	// cache lines so that the two threads do not invalidate each other.
+	alignas(64) std::atomic<uint32_t> m_head;
+	alignas(64) std::atomic<uint32_t> m_tail;
+	alignas(64) std::atomic<bool> m_running;
+	std::atomic<bool> m_idle;				// The worker waits for m_idleSignal
+
+	std::mutex m_idleLock;
+	std::condition_variable m_idleSignal;
+	std::thread m_thread;
+	uint32_t m_busDelayMicroseconds;
+
+	// Producer statistics
+	uint64_t m_enqueued;
+	uint64_t m_rejected;
+	uint64_t m_ackCount;
+	uint64_t m_ackTotalNanoseconds;
+	uint64_t m_ackMaxNanoseconds;
+
+	// Consumer statistics, read by Report() from the producer thread
+	std::atomic<uint64_t> m_batches;
+	std::atomic<uint64_t> m_written;
+	std::atomic<uint64_t> m_batchSizeHistogram[WRITE_BACKEND_HISTOGRAM_BUCKETS];
+	std::atomic<uint64_t> m_writeThroughTotalNanoseconds;
+	std::atomic<uint64_t> m_writeThroughMaxNanoseconds;
+
+	void Run();
+	void Flush(const WriteBackendRecord* records, const uint32_t count);
+};
+
+#endif // __WriteBackend_h__